@@ -0,0 +1,98 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// BTreeMap against Map (RBTree) and AVLMap with 64 bit keys and values:
+// inserts in random order, lookups of present keys in random order,
+// an in-order scan, and the heap bytes per key counted by operator new.
+// usage: BenchBTree [n ...]    (default 1000000 10000000)
+
+#include <flak/AVLMap.h>
+#include <flak/BTreeMap.h>
+#include <flak/Map.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+static size_t allocatedBytes = 0;
+
+void* operator new(size_t n) {
+    allocatedBytes += n;
+    void* p = malloc(n ? n : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+template<class Tree>
+void run(const char* name, const vector<uint64_t>& keys, const vector<uint64_t>& queries) {
+    const size_t n = keys.size();
+    Tree* t = new Tree();
+    allocatedBytes = 0;
+    Timer timer;
+    for (size_t i = 0; i < n; i++) {
+        t->insert(typename Tree::value_type(keys[i], i));
+    }
+    double insertMs = timer.elapsedMs();
+    double bytes = (double) allocatedBytes / n;
+
+    timer.reset();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += t->find(queries[i])->second;
+    }
+    double findMs = timer.elapsedMs();
+
+    timer.reset();
+    for (auto it = t->begin(); it != t->end(); ++it) {
+        sum += it->first;
+    }
+    double scanMs = timer.elapsedMs();
+    doNotOptimize(sum);
+
+    printf("%-9s n=%-9zu insert %7.1f ns/op   find %7.1f ns/op   scan %6.2f ns/op   %5.1f bytes/key\n",
+           name, n, nsPerOp(insertMs, n), nsPerOp(findMs, n), nsPerOp(scanMs, n), bytes);
+    delete t;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 10000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = rng();
+        }
+        vector<uint64_t> queries(keys);
+        shuffle(queries.begin(), queries.end(), rng);
+        run<Map<uint64_t, uint64_t>>("Map", keys, queries);
+        run<AVLMap<uint64_t, uint64_t>>("AVLMap", keys, queries);
+        run<BTreeMap<uint64_t, uint64_t>>("BTreeMap", keys, queries);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Compare the prime modulo buckets with the power of two fibonacci buckets.
+// The tables are small enough to stay in cache,
+// so the cost of finding the bucket is what we measure.
+// usage: BenchBucketPolicy [n ...]    (default 1000 10000 100000)
+
+#include <flak/HashTable.h>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+template<class Policy>
+using Table = HashTable<uint64_t, uint64_t, hash<uint64_t>, _Identity<uint64_t>,
+        equal_to<uint64_t>, allocator<uint64_t>, Policy>;
+
+template<class Policy>
+void run(const char* name, const vector<uint64_t>& keys, size_t rounds) {
+    const size_t n = keys.size();
+    Table<Policy> ht(n, hash<uint64_t>(), equal_to<uint64_t>());
+
+    Timer t;
+    for (size_t i = 0; i < n; i++) {
+        ht.insertUnique(keys[i]);
+    }
+    // inserting existing keys only probes
+    for (size_t r = 1; r < rounds; r++) {
+        for (size_t i = 0; i < n; i++) {
+            ht.insertUnique(keys[i]);
+        }
+    }
+    double insertMs = t.elapsedMs();
+
+    t.reset();
+    size_t found = 0;
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < n; i++) {
+            found += ht.find(keys[i] + r % 2) != ht.end();
+        }
+    }
+    double findMs = t.elapsedMs();
+    doNotOptimize(found);
+
+    printf("%-12s n=%-8zu buckets=%-8zu insertUnique %6.2f ns/op   find %6.2f ns/op\n",
+           name, n, ht.bucketCount(),
+           nsPerOp(insertMs, n * rounds), nsPerOp(findMs, n * rounds));
+    ht.clear();
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000, 10000, 100000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = rng() << 1;
+        }
+        const size_t rounds = 20000000 / n + 1;
+        run<PrimeBucketPolicy>("prime", keys, rounds);
+        run<PowerOfTwoBucketPolicy>("power-of-two", keys, rounds);
+    }
+}
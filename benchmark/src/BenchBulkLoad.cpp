@@ -0,0 +1,98 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Building Map (RBTree) and AVLMap from sorted 64 bit keys:
+// one insert per key against the O(n) bulk build of the range constructor,
+// then lookups in random order and an in-order scan of each tree,
+// whose nodes lie in key order in one block after the bulk build.
+// usage: BenchBulkLoad [n ...]    (default 1000000 10000000)
+
+#include <flak/AVLMap.h>
+#include <flak/Map.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+template<class Tree>
+void measure(const char* name, size_t n, double buildMs, Tree* t, const vector<uint64_t>& queries) {
+    Timer timer;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += t->find(queries[i])->second;
+    }
+    double findMs = timer.elapsedMs();
+
+    timer.reset();
+    for (auto it = t->begin(); it != t->end(); ++it) {
+        sum += it->first;
+    }
+    double scanMs = timer.elapsedMs();
+    doNotOptimize(sum);
+
+    printf("%-16s n=%-9zu build %7.1f ns/op   find %7.1f ns/op   scan %6.2f ns/op\n",
+           name, n, nsPerOp(buildMs, n), nsPerOp(findMs, n), nsPerOp(scanMs, n));
+}
+
+template<class Tree>
+void run(const char* name, const vector<pair<uint64_t, uint64_t>>& sorted,
+         const vector<uint64_t>& queries) {
+    const size_t n = sorted.size();
+    char label[64];
+
+    Timer timer;
+    Tree* t = new Tree();
+    for (size_t i = 0; i < n; i++) {
+        t->insert(sorted[i]);
+    }
+    double buildMs = timer.elapsedMs();
+    snprintf(label, sizeof(label), "%s insert", name);
+    measure(label, n, buildMs, t, queries);
+    delete t;
+
+    timer.reset();
+    t = new Tree(sorted.begin(), sorted.end());
+    buildMs = timer.elapsedMs();
+    snprintf(label, sizeof(label), "%s bulk", name);
+    measure(label, n, buildMs, t, queries);
+    delete t;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 10000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<pair<uint64_t, uint64_t>> sorted(n);
+        for (size_t i = 0; i < n; i++) {
+            sorted[i] = make_pair(rng(), i);
+        }
+        sort(sorted.begin(), sorted.end());
+        vector<uint64_t> queries(n);
+        for (size_t i = 0; i < n; i++) {
+            queries[i] = sorted[i].first;
+        }
+        shuffle(queries.begin(), queries.end(), rng);
+        run<Map<uint64_t, uint64_t>>("Map", sorted, queries);
+        run<AVLMap<uint64_t, uint64_t>>("AVLMap", sorted, queries);
+    }
+}
@@ -0,0 +1,106 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Throughput of ConcurrentHashMap and of a HashMap behind one mutex,
+// from 1 to 64 threads. Every thread does 90% finds and 10% upserts
+// on keys picked at random from n keys.
+// usage: BenchConcurrentHashMap [n ...]    (default 1000000)
+
+#include <flak/ConcurrentHashMap.h>
+#include <flak/HashMap.h>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+const size_t ops_per_thread = 1000000;
+
+// the way we shared a map before
+class LockedMap {
+public:
+    bool find(uint64_t key, uint64_t& val) {
+        lock_guard<mutex> lock(mutex_);
+        auto it = map_.find(key);
+        if (it == map_.end()) {
+            return false;
+        }
+        val = it->second;
+        return true;
+    }
+
+    void insertOrAssign(uint64_t key, uint64_t val) {
+        lock_guard<mutex> lock(mutex_);
+        map_[key] = val;
+    }
+
+private:
+    mutex mutex_;
+    HashMap<uint64_t, uint64_t> map_;
+};
+
+template<class Map>
+double run(Map& m, size_t n, int threads) {
+    vector<thread> ts;
+    Timer t;
+    for (int i = 0; i < threads; i++) {
+        ts.emplace_back([&m, n, i]() {
+            mt19937_64 rng(i + 1);
+            uint64_t found = 0, val;
+            for (size_t k = 0; k < ops_per_thread; k++) {
+                uint64_t r = rng();
+                uint64_t key = r % n;
+                if ((r >> 48) % 10 == 0) {
+                    m.insertOrAssign(key, r);
+                } else {
+                    found += m.find(key, val);
+                }
+            }
+            doNotOptimize(found);
+        });
+    }
+    for (auto& th : ts) {
+        th.join();
+    }
+    double ms = t.elapsedMs();
+    return threads * ops_per_thread / ms / 1e3; // Mops/s
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000});
+    for (size_t n : sizes) {
+        ConcurrentHashMap<uint64_t, uint64_t> cm(64, n);
+        LockedMap lm;
+        for (size_t i = 0; i < n; i++) {
+            cm.insertOrAssign(i, i);
+            lm.insertOrAssign(i, i);
+        }
+        printf("n=%zu, hardware threads %u\n", n, thread::hardware_concurrency());
+        printf("%8s %22s %22s\n", "threads", "ConcurrentHashMap", "HashMap + mutex");
+        for (int threads = 1; threads <= 64; threads *= 2) {
+            double c = run(cm, n, threads);
+            double l = run(lm, n, threads);
+            printf("%8d %16.2f Mop/s %16.2f Mop/s\n", threads, c, l);
+        }
+    }
+}
@@ -0,0 +1,135 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Inserting long strings by copy, by move and in place.
+// Every container is filled three times, and the global operator new
+// is counted, so the saved allocations show up next to the times.
+// usage: BenchEmplace [n ...]    (default 100000 1000000)
+
+#include <flak/HashMap.h>
+#include <flak/List.h>
+#include <flak/Map.h>
+#include <flak/Vector.h>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+static size_t allocations = 0;
+
+void* operator new(size_t n) {
+    ++allocations;
+    void* p = malloc(n ? n : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// the strings are too long for the small string buffer,
+// emplace builds them from (length(i), letter(i)) without a temporary
+size_t length(size_t i) { return 48 + i % 32; }
+
+char letter(size_t i) { return (char) ('a' + i % 26); }
+
+string value(size_t i) { return string(length(i), letter(i)); }
+
+void report(const char* name, const char* how, size_t n, double ms, size_t allocs) {
+    printf("%-8s %-8s n=%-8zu %8.2f ns/op %6.2f allocs/op\n",
+           name, how, n, nsPerOp(ms, n), (double) allocs / n);
+}
+
+// fill(c, i, mode): 0 copies value(i), 1 moves it, 2 constructs it in place
+template<class Container, class Fill>
+void run(const char* name, size_t n, Fill fill) {
+    const char* hows[] = {"copy", "move", "emplace"};
+    for (int mode = 0; mode < 3; mode++) {
+        Container c;
+        allocations = 0;
+        Timer t;
+        for (size_t i = 0; i < n; i++) {
+            fill(c, i, mode);
+        }
+        double ms = t.elapsedMs();
+        report(name, hows[mode], n, ms, allocations);
+        doNotOptimize(c.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {100000, 1000000});
+    for (size_t n : sizes) {
+        run<Vector<string>>("Vector", n, [](Vector<string>& c, size_t i, int mode) {
+            if (mode == 2) {
+                c.emplace_back(length(i), letter(i));
+                return;
+            }
+            string s = value(i);
+            if (mode == 0) {
+                c.push_back(s);
+            } else {
+                c.push_back(std::move(s));
+            }
+        });
+        run<List<string>>("List", n, [](List<string>& c, size_t i, int mode) {
+            if (mode == 2) {
+                c.emplace_back(length(i), letter(i));
+                return;
+            }
+            string s = value(i);
+            if (mode == 0) {
+                c.push_back(s);
+            } else {
+                c.push_back(std::move(s));
+            }
+        });
+        run<Map<size_t, string>>("Map", n, [](Map<size_t, string>& c, size_t i, int mode) {
+            if (mode == 2) {
+                c.tryEmplace(i, length(i), letter(i));
+                return;
+            }
+            pair<const size_t, string> p(i, value(i));
+            if (mode == 0) {
+                c.insert(p);
+            } else {
+                c.insert(std::move(p));
+            }
+        });
+        run<HashMap<size_t, string>>("HashMap", n, [](HashMap<size_t, string>& c, size_t i, int mode) {
+            if (mode == 2) {
+                c.tryEmplace(i, length(i), letter(i));
+                return;
+            }
+            pair<const size_t, string> p(i, value(i));
+            if (mode == 0) {
+                c.insert(p);
+            } else {
+                c.insert(std::move(p));
+            }
+        });
+    }
+}
@@ -0,0 +1,96 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Look up random keys one by one with find() and in batches with findBatch().
+// The tables should be larger than the cache to see the prefetching.
+// usage: BenchFindBatch [n ...]    (default 10000 10000000)
+
+#include <flak/HashMap.h>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+const size_t batch = 1024;
+
+template<class Engine>
+void run(const char* name, const vector<uint64_t>& keys, const vector<uint64_t>& queries) {
+    typedef HashMap<uint64_t, uint64_t, hash<uint64_t>, equal_to<uint64_t>,
+            allocator<uint64_t>, Engine> Map;
+    Map m;
+    for (size_t i = 0; i < keys.size(); i++) {
+        m.insert(make_pair(keys[i], i));
+    }
+    const Map& cm = m;
+
+    Timer t;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < queries.size(); i++) {
+        auto it = cm.find(queries[i]);
+        if (it != cm.end()) {
+            sum += it->second;
+        }
+    }
+    double findMs = t.elapsedMs();
+
+    t.reset();
+    uint64_t batchSum = 0;
+    vector<typename Map::const_iterator> out(batch);
+    for (size_t i = 0; i < queries.size(); i += batch) {
+        size_t n = min(batch, queries.size() - i);
+        cm.findBatch(&queries[i], n, out.data());
+        for (size_t j = 0; j < n; j++) {
+            if (out[j] != cm.end()) {
+                batchSum += out[j]->second;
+            }
+        }
+    }
+    double batchMs = t.elapsedMs();
+    doNotOptimize(sum);
+    if (sum != batchSum) {
+        printf("mismatch\n");
+    }
+
+    printf("%-8s n=%-9zu find %7.2f ns/op   findBatch %7.2f ns/op\n", name, keys.size(),
+           nsPerOp(findMs, queries.size()), nsPerOp(batchMs, queries.size()));
+    m.clear();
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {10000, 10000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = rng() << 1;
+        }
+        // half hits, half misses
+        vector<uint64_t> queries(4000000);
+        for (size_t i = 0; i < queries.size(); i++) {
+            queries[i] = keys[rng() % n] | (i & 1);
+        }
+        run<FlatHashing>("flat", keys, queries);
+        run<GroupHashing>("group", keys, queries);
+        run<ChainedHashing>("chained", keys, queries);
+    }
+}
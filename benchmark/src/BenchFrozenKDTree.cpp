@@ -0,0 +1,93 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// The 8 nearest of random points in KDTree (bulk built), its int FrozenKDTree
+// copy and a float FrozenKDTree of the same points, in 3 and 8 dimensions.
+// The float one uses the SSE2 kernels, or AVX2 when configured with
+// -DCMAKE_CXX_FLAGS=-mavx2.
+// usage: BenchFrozenKDTree [n ...]    (default 10000 100000 1000000)
+
+#include <flak/FrozenKDTree.h>
+#include <flak/KDTree.h>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+const size_t queries = 5000;
+const size_t k = 8;
+
+template<class Tree, class Point>
+double knn(const Tree& t, vector<Point>& qs) {
+    Timer timer;
+    size_t found = 0;
+    for (auto& q : qs) {
+        found += t.findKNearest(q, k).size();
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(found);
+    return ms;
+}
+
+void run(size_t n, size_t dim) {
+    // integer coordinates, the float distances are exact below 2^24
+    mt19937 rng(1);
+    uniform_int_distribution<int> coord(0, 1000);
+    vector<pair<vector<int>, int>> points;
+    vector<pair<vector<float>, int>> floatPoints;
+    for (size_t i = 0; i < n; i++) {
+        vector<int> p;
+        for (size_t d = 0; d < dim; d++) {
+            p.push_back(coord(rng));
+        }
+        points.push_back({p, int(i)});
+        floatPoints.push_back({vector<float>(p.begin(), p.end()), int(i)});
+    }
+    vector<vector<int>> qs;
+    vector<vector<float>> floatQs;
+    for (size_t i = 0; i < queries; i++) {
+        vector<int> q;
+        for (size_t d = 0; d < dim; d++) {
+            q.push_back(coord(rng));
+        }
+        qs.push_back(q);
+        floatQs.push_back(vector<float>(q.begin(), q.end()));
+    }
+
+    KDTree<vector<int>, int> t(points.begin(), points.end(), dim);
+    KDTree<vector<int>, int>::frozen_type frozen = t.freeze();
+    FrozenKDTree<float, int> floatFrozen(floatPoints.begin(), floatPoints.end(), dim);
+
+    double treeMs = knn(t, qs);
+    double frozenMs = knn(frozen, qs);
+    double floatMs = knn(floatFrozen, floatQs);
+    printf("dim=%zu n=%-8zu KDTree %8.1f ns/query   frozen int %7.1f ns/query   frozen float %7.1f ns/query\n",
+           dim, n, nsPerOp(treeMs, queries), nsPerOp(frozenMs, queries), nsPerOp(floatMs, queries));
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {10000, 100000, 1000000});
+    for (size_t dim : {3, 8}) {
+        for (size_t n : sizes) {
+            run(n, dim);
+        }
+    }
+}
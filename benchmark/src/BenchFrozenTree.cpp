@@ -0,0 +1,96 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Lookups of random 64 bit keys in Map (RBTree), AVLMap, their FrozenTree
+// copies and binary search over a sorted vector, with half of the keys missing.
+// usage: BenchFrozenTree [n ...]    (default 100000 1000000 10000000)
+
+#include <flak/AVLMap.h>
+#include <flak/Map.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+const size_t queries = 2000000;
+
+template<class Tree>
+double lookups(const Tree& t, const vector<uint64_t>& keys) {
+    Timer timer;
+    uint64_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        found += t.find(keys[i]) != t.end();
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(found);
+    return ms;
+}
+
+double sortedVector(const vector<pair<uint64_t, uint64_t>>& sorted, const vector<uint64_t>& keys) {
+    Timer timer;
+    uint64_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto it = lower_bound(sorted.begin(), sorted.end(), keys[i],
+                              [](const pair<uint64_t, uint64_t>& p, uint64_t k) { return p.first < k; });
+        found += it != sorted.end() && it->first == keys[i];
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(found);
+    return ms;
+}
+
+template<class Tree>
+void run(const char* name, const vector<pair<uint64_t, uint64_t>>& sorted, const vector<uint64_t>& keys) {
+    Tree t;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        t.insert(sorted[i]);
+    }
+    Timer timer;
+    typename Tree::frozen_type f = t.freeze();
+    double freezeMs = timer.elapsedMs();
+    double treeMs = lookups(t, keys);
+    double frozenMs = lookups(f, keys);
+    printf("%-8s n=%-9zu find %6.1f ns/op   frozen find %6.1f ns/op   freeze %6.1f ns/value\n",
+           name, sorted.size(), nsPerOp(treeMs, keys.size()), nsPerOp(frozenMs, keys.size()),
+           nsPerOp(freezeMs, sorted.size()));
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {100000, 1000000, 10000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<pair<uint64_t, uint64_t>> sorted(n);
+        vector<uint64_t> keys(queries);
+        for (size_t i = 0; i < n; i++) {
+            sorted[i] = make_pair(rng(), i);
+        }
+        for (size_t i = 0; i < queries; i++) {
+            keys[i] = i % 2 ? sorted[rng() % n].first : rng();
+        }
+        shuffle(sorted.begin(), sorted.end(), rng);
+        run<Map<uint64_t, uint64_t>>("Map", sorted, keys);
+        run<AVLMap<uint64_t, uint64_t>>("AVLMap", sorted, keys);
+        sort(sorted.begin(), sorted.end());
+        printf("%-8s n=%-9zu find %6.1f ns/op\n", "vector", n, nsPerOp(sortedVector(sorted, keys), queries));
+    }
+}
@@ -0,0 +1,80 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// HashTable with string keys, with and without the hash codes in the nodes.
+// Insert grows the table from a few buckets, so it includes the resizes.
+// usage: BenchHashCache [n ...]    (default 100000 1000000)
+
+#include <flak/HashTable.h>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+template<bool CacheHash>
+void run(const char* name, const vector<string>& keys, const vector<string>& misses) {
+    typedef HashTable<string, string, hash<string>, _Identity<string>, equal_to<string>,
+            allocator<string>, PrimeBucketPolicy, CacheHash> Table;
+    Table ht(10, hash<string>(), equal_to<string>());
+    const size_t n = keys.size();
+
+    Timer t;
+    for (size_t i = 0; i < n; i++) {
+        ht.insertUnique(keys[i]);
+    }
+    double insertMs = t.elapsedMs();
+
+    const Table& cht = ht;
+    t.reset();
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++) {
+        found += cht.find(keys[i]) != cht.end();
+    }
+    double hitMs = t.elapsedMs();
+
+    t.reset();
+    for (size_t i = 0; i < n; i++) {
+        found += cht.find(misses[i]) != cht.end();
+    }
+    double missMs = t.elapsedMs();
+    doNotOptimize(found);
+
+    printf("%-10s n=%-8zu insertUnique %7.2f ns/op   find hit %7.2f ns/op   find miss %7.2f ns/op\n",
+           name, n, nsPerOp(insertMs, n), nsPerOp(hitMs, n), nsPerOp(missMs, n));
+    ht.clear();
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {100000, 1000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<string> keys(n), misses(n);
+        // long keys with a common prefix are slow to hash and to compare
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = "event/dimension/" + to_string(rng()) + "/key";
+            misses[i] = "event/dimension/" + to_string(rng()) + "/miss";
+        }
+        run<false>("no cache", keys, misses);
+        run<true>("cached", keys, misses);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Compare the chained HashTable with the open addressing FlatHashTable,
+// with linear probing and with group probing.
+// usage: BenchHashTable [n ...]    (default 1000000 100000000)
+
+#include <flak/HashTable.h>
+#include <flak/FlatHashTable.h>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+typedef HashTable<uint64_t, uint64_t, hash<uint64_t>,
+        _Identity<uint64_t>, equal_to<uint64_t>> ChainedTable;
+typedef FlatHashTable<uint64_t, uint64_t, hash<uint64_t>,
+        _Identity<uint64_t>, equal_to<uint64_t>> FlatTable;
+typedef FlatHashTable<uint64_t, uint64_t, hash<uint64_t>,
+        _Identity<uint64_t>, equal_to<uint64_t>,
+        allocator<uint64_t>, GroupProbe> GroupTable;
+
+template<class Table>
+void run(const char* name, const vector<uint64_t>& keys, const vector<uint64_t>& misses) {
+    Table ht(0, hash<uint64_t>(), equal_to<uint64_t>());
+    const size_t n = keys.size();
+
+    Timer t;
+    for (size_t i = 0; i < n; i++) {
+        ht.insertUnique(keys[i]);
+    }
+    double insertMs = t.elapsedMs();
+
+    t.reset();
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++) {
+        found += ht.find(keys[i]) != ht.end();
+    }
+    double hitMs = t.elapsedMs();
+
+    t.reset();
+    for (size_t i = 0; i < n; i++) {
+        found += ht.find(misses[i]) != ht.end();
+    }
+    double missMs = t.elapsedMs();
+    doNotOptimize(found);
+
+    printf("%-10s n=%-10zu insert %7.1f ns/op   hit %7.1f ns/op   miss %7.1f ns/op\n",
+           name, n, nsPerOp(insertMs, n), nsPerOp(hitMs, n), nsPerOp(missMs, n));
+    ht.clear();
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 100000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(n), misses(n);
+        // even keys are inserted, odd keys are always missed
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = rng() << 1;
+            misses[i] = (rng() << 1) | 1;
+        }
+        // the chained table leaves a million freed nodes in the heap,
+        // so it runs last to not slow down the others.
+        run<FlatTable>("flat", keys, misses);
+        run<GroupTable>("group", keys, misses);
+        run<ChainedTable>("chained", keys, misses);
+    }
+}
@@ -0,0 +1,107 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Map (RBTree) and AVLMap fed with increasing and nearly sorted 64 bit keys,
+// insert(value) against insert(hint, value): end() as hint for the sorted run,
+// the position of the last insert as hint for the nearly sorted one,
+// where one key in 16 is swapped with a neighbour up to 8 places away.
+// usage: BenchHintedInsert [n ...]    (default 1000000 10000000)
+
+#include <flak/AVLMap.h>
+#include <flak/Map.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+template<class Tree>
+double plain(const vector<uint64_t>& keys) {
+    Tree* t = new Tree();
+    Timer timer;
+    for (size_t i = 0; i < keys.size(); i++) {
+        t->insert(typename Tree::value_type(keys[i], i));
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(t->size());
+    delete t;
+    return ms;
+}
+
+template<class Tree>
+double atEnd(const vector<uint64_t>& keys) {
+    Tree* t = new Tree();
+    Timer timer;
+    for (size_t i = 0; i < keys.size(); i++) {
+        t->insert(t->end(), typename Tree::value_type(keys[i], i));
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(t->size());
+    delete t;
+    return ms;
+}
+
+template<class Tree>
+double atLast(const vector<uint64_t>& keys) {
+    Tree* t = new Tree();
+    Timer timer;
+    typename Tree::iterator hint = t->end();
+    for (size_t i = 0; i < keys.size(); i++) {
+        hint = t->insert(hint, typename Tree::value_type(keys[i], i));
+        ++hint;
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(t->size());
+    delete t;
+    return ms;
+}
+
+template<class Tree>
+void run(const char* name, const vector<uint64_t>& sorted, const vector<uint64_t>& nearly) {
+    const size_t n = sorted.size();
+    plain<Tree>(sorted); // the first run pays for the page faults
+    double sortedMs = plain<Tree>(sorted);
+    double endMs = atEnd<Tree>(sorted);
+    double nearlyMs = plain<Tree>(nearly);
+    double lastMs = atLast<Tree>(nearly);
+    printf("%-8s n=%-9zu sorted: insert %6.1f  end() hint %6.1f   "
+           "nearly sorted: insert %6.1f  last hint %6.1f  ns/op\n",
+           name, n, nsPerOp(sortedMs, n), nsPerOp(endMs, n), nsPerOp(nearlyMs, n), nsPerOp(lastMs, n));
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 10000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> sorted(n);
+        for (size_t i = 0; i < n; i++) {
+            sorted[i] = rng();
+        }
+        sort(sorted.begin(), sorted.end());
+        vector<uint64_t> nearly(sorted);
+        for (size_t i = 0; i + 8 < n; i += 16) {
+            swap(nearly[i], nearly[i + 1 + rng() % 8]);
+        }
+        run<Map<uint64_t, uint64_t>>("Map", sorted, nearly);
+        run<AVLMap<uint64_t, uint64_t>>("AVLMap", sorted, nearly);
+    }
+}
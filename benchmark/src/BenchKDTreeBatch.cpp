@@ -0,0 +1,83 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// The 8 nearest of many random 3-d points in a bulk built KDTree: findKNearest
+// one by one, then findKNearestBatch on 1 to 16 threads, in the order given
+// and along the Z-order curve.
+// usage: BenchKDTreeBatch [n ...]    (default 100000 1000000)
+
+#include <flak/KDTree.h>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+typedef KDTree<vector<int>, int> Tree;
+typedef vector<vector<pair<Tree::distance_type, Tree::iterator>>> Results;
+
+const size_t queries = 200000;
+const size_t k = 8;
+
+double batch(const Tree& t, const vector<vector<int>>& qs, Results& out,
+             unsigned threads, bool curve) {
+    Timer timer;
+    t.findKNearestBatch(qs, k, out, threads, curve);
+    double ms = timer.elapsedMs();
+    doNotOptimize(out[0].size());
+    return ms;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {100000, 1000000});
+    printf("hardware threads %u, %zu queries\n", std::thread::hardware_concurrency(), queries);
+    for (size_t n : sizes) {
+        mt19937 rng(1);
+        uniform_int_distribution<int> coord(0, 20000);
+        vector<pair<vector<int>, int>> points;
+        for (size_t i = 0; i < n; i++) {
+            points.push_back({vector<int>{coord(rng), coord(rng), coord(rng)}, int(i)});
+        }
+        vector<vector<int>> qs;
+        for (size_t i = 0; i < queries; i++) {
+            qs.push_back(vector<int>{coord(rng), coord(rng), coord(rng)});
+        }
+        Tree t(points.begin(), points.end(), 3);
+
+        Timer timer;
+        size_t found = 0;
+        for (auto& q : qs) {
+            found += t.findKNearest(q, k).size();
+        }
+        double singleMs = timer.elapsedMs();
+        doNotOptimize(found);
+        printf("n=%-8zu findKNearest             %8.1f ns/query\n", n, nsPerOp(singleMs, queries));
+
+        Results out;
+        batch(t, qs, out, 1, false);  // warm up the result vectors
+        for (unsigned threads : {1, 2, 4, 8, 16}) {
+            double plainMs = batch(t, qs, out, threads, false);
+            double curveMs = batch(t, qs, out, threads, true);
+            printf("n=%-8zu batch %2u threads          %8.1f ns/query   z-order %8.1f ns/query\n",
+                   n, threads, nsPerOp(plainMs, queries), nsPerOp(curveMs, queries));
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Building a KDTree from clustered 2-d points that arrive along random walks,
+// like GPS tracks, by insert one by one and by the bulk constructor with both
+// split rules and 1 or all the threads, then the 8 nearest of points near them.
+// usage: BenchKDTreeBuild [n ...]    (default 10000 100000 1000000)
+// The one by one insert is skipped above 100000 points, it gets too deep.
+
+#include <flak/KDTree.h>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+typedef KDTree<vector<int>, int> Tree;
+
+const size_t queries = 20000;
+const size_t k = 8;
+
+vector<pair<vector<int>, int>> tracks(size_t n) {
+    mt19937 rng(1);
+    uniform_int_distribution<int> start(0, 10000), step(-3, 3);
+    vector<pair<vector<int>, int>> points;
+    points.reserve(n);
+    int x = 0, y = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (i % 1000 == 0) {  // a new track
+            x = start(rng);
+            y = start(rng);
+        }
+        x += step(rng);
+        y += step(rng);
+        points.push_back({vector<int>{x, y}, int(i)});
+    }
+    return points;
+}
+
+double knn(const Tree& t, vector<vector<int>>& qs) {
+    Timer timer;
+    size_t found = 0;
+    for (auto& q : qs) {
+        found += t.findKNearest(q, k).size();
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(found);
+    return ms;
+}
+
+void report(const char* name, size_t n, double buildMs, double queryMs) {
+    printf("%-22s n=%-8zu build %8.1f ns/point   %zu-nn %9.1f ns/query\n",
+           name, n, nsPerOp(buildMs, n), k, nsPerOp(queryMs, queries));
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {10000, 100000, 1000000});
+    printf("hardware threads %u\n", std::thread::hardware_concurrency());
+    for (size_t n : sizes) {
+        vector<pair<vector<int>, int>> points = tracks(n);
+        // near the points, off by a few steps
+        mt19937 rng(2);
+        uniform_int_distribution<size_t> which(0, n - 1);
+        uniform_int_distribution<int> off(-20, 20);
+        vector<vector<int>> qs;
+        for (size_t i = 0; i < queries; i++) {
+            const vector<int>& p = points[which(rng)].first;
+            qs.push_back(vector<int>{p[0] + off(rng), p[1] + off(rng)});
+        }
+
+        if (n <= 100000) {
+            Timer timer;
+            Tree t(2);
+            for (auto& p : points) {
+                t.insert(p.first, p.second);
+            }
+            double buildMs = timer.elapsedMs();
+            report("insert", n, buildMs, knn(t, qs));
+        }
+
+        struct {
+            const char* name;
+            Tree::SplitRule rule;
+            unsigned threads;
+        } runs[] = {
+                {"bulk cycle 1 thread", Tree::split_cycle, 1},
+                {"bulk cycle", Tree::split_cycle, 0},
+                {"bulk spread 1 thread", Tree::split_spread, 1},
+                {"bulk spread", Tree::split_spread, 0},
+        };
+        for (auto& r : runs) {
+            Timer timer;
+            Tree t(points.begin(), points.end(), 2, r.rule, r.threads);
+            double buildMs = timer.elapsedMs();
+            report(r.name, n, buildMs, knn(t, qs));
+        }
+    }
+}
@@ -0,0 +1,112 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Radius and box queries over uniform 2-d points, as in geofencing: the points
+// of KDTree::forEachInRadius and forEachInBox, and the same in its FrozenKDTree
+// copy, with the counts of both, where the frozen one counts whole subtrees.
+// usage: BenchKDTreeRange [n ...]    (default 100000 1000000)
+
+#include <flak/FrozenKDTree.h>
+#include <flak/KDTree.h>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+typedef KDTree<vector<int>, int> Tree;
+
+const size_t queries = 2000;
+const int side = 100000;
+const int radius = 1000;
+
+struct Query {
+    vector<int> center, lo, hi;
+};
+
+template<class T, class Visit>
+double timed(const T& t, const vector<Query>& qs, size_t& found, Visit visit) {
+    Timer timer;
+    found = 0;
+    for (auto& q : qs) {
+        found += visit(t, q);
+    }
+    double ms = timer.elapsedMs();
+    doNotOptimize(found);
+    return ms;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {100000, 1000000});
+    for (size_t n : sizes) {
+        mt19937 rng(1);
+        uniform_int_distribution<int> coord(0, side);
+        vector<pair<vector<int>, int>> points;
+        for (size_t i = 0; i < n; i++) {
+            points.push_back({vector<int>{coord(rng), coord(rng)}, int(i)});
+        }
+        vector<Query> qs;
+        for (size_t i = 0; i < queries; i++) {
+            Query q;
+            q.center = {coord(rng), coord(rng)};
+            q.lo = {q.center[0] - radius, q.center[1] - radius};
+            q.hi = {q.center[0] + radius, q.center[1] + radius};
+            qs.push_back(q);
+        }
+        Tree t(points.begin(), points.end(), 2);
+        Tree::frozen_type f = t.freeze();
+        const Tree::distance_type r = Tree::distance_type(radius) * radius;
+
+        size_t found;
+        double treeRadius = timed(t, qs, found, [&](const Tree& x, const Query& q) {
+            size_t c = 0;
+            x.forEachInRadius(q.center, r, [&](Tree::iterator, Tree::distance_type) { c++; });
+            return c;
+        });
+        double frozenRadius = timed(f, qs, found, [&](const Tree::frozen_type& x, const Query& q) {
+            size_t c = 0;
+            x.forEachInRadius(q.center, r, [&](size_t, Tree::distance_type) { c++; });
+            return c;
+        });
+        double frozenCountRadius = timed(f, qs, found, [&](const Tree::frozen_type& x, const Query& q) {
+            return x.countInRadius(q.center, r);
+        });
+        printf("n=%-8zu radius: %6.1f points/query   KDTree %8.1f us   frozen %8.1f us   frozen count %8.1f us\n",
+               n, double(found) / queries, treeRadius * 1e3 / queries, frozenRadius * 1e3 / queries,
+               frozenCountRadius * 1e3 / queries);
+
+        double treeBox = timed(t, qs, found, [&](const Tree& x, const Query& q) {
+            size_t c = 0;
+            x.forEachInBox(q.lo, q.hi, [&](Tree::iterator) { c++; });
+            return c;
+        });
+        double frozenBox = timed(f, qs, found, [&](const Tree::frozen_type& x, const Query& q) {
+            size_t c = 0;
+            x.forEachInBox(q.lo, q.hi, [&](size_t) { c++; });
+            return c;
+        });
+        double frozenCountBox = timed(f, qs, found, [&](const Tree::frozen_type& x, const Query& q) {
+            return x.countInBox(q.lo, q.hi);
+        });
+        printf("n=%-8zu box:    %6.1f points/query   KDTree %8.1f us   frozen %8.1f us   frozen count %8.1f us\n",
+               n, double(found) / queries, treeBox * 1e3 / queries, frozenBox * 1e3 / queries,
+               frozenCountBox * 1e3 / queries);
+    }
+}
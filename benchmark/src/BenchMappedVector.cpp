@@ -0,0 +1,114 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Records in a file, sorted and searched in place by a MappedVector,
+// against reading the file into a Vector first.
+// The startup is the time from opening the file to the first search result.
+// The file is written to the current directory and removed at the end.
+// usage: BenchMappedVector [n ...]    (default 1000000 10000000)
+
+#include <flak/MappedVector.h>
+#include <flak/Vector.h>
+#include <flak/alg/Search.h>
+#include <flak/alg/Sort.h>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+struct Record {
+    long key;
+    long payload;
+
+    bool operator<(const Record& x) const { return key < x.key; }
+};
+
+const char* path = "BenchMappedVector.bin";
+
+template<class It>
+size_t search(It first, It last, const vector<Record>& queries) {
+    size_t found = 0;
+    for (const Record& q : queries) {
+        found += binarySearch(first, last, q);
+    }
+    return found;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 10000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<Record> queries(100000);
+        for (Record& q : queries) {
+            q.key = (long) (rng() % (4 * n));
+        }
+
+        Timer t;
+        {
+            MappedVector<Record> w(path, MappedVector<Record>::create);
+            w.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                w.push_back(Record{(long) (rng() % (4 * n)), (long) i});
+            }
+            double writeMs = t.elapsedMs();
+            t.reset();
+            Sort(w.begin(), w.end());
+            double sortMs = t.elapsedMs();
+            printf("n=%-10zu write %8.2f ms   sort in the mapping %9.2f ms\n", n, writeMs, sortMs);
+        }
+
+        // read the whole file into a Vector
+        t.reset();
+        {
+            Vector<Record> v;
+            v.reserve(n);
+            FILE* f = fopen(path, "rb");
+            Record r;
+            while (fread(&r, sizeof(r), 1, f) == 1) {
+                v.push_back(r);
+            }
+            fclose(f);
+            double loadMs = t.elapsedMs();
+            t.reset();
+            size_t found = search(v.begin(), v.end(), queries);
+            double searchMs = t.elapsedMs();
+            doNotOptimize(found);
+            printf("n=%-10zu Vector        startup %8.3f ms   search %7.2f ns/op\n",
+                   n, loadMs, nsPerOp(searchMs, queries.size()));
+        }
+
+        // map it
+        t.reset();
+        {
+            MappedVector<Record> m(path, MappedVector<Record>::readOnly);
+            const MappedVector<Record>& cm = m;
+            size_t found = binarySearch(cm.begin(), cm.end(), queries[0]);
+            double openMs = t.elapsedMs();
+            t.reset();
+            found += search(cm.begin(), cm.end(), queries);
+            double searchMs = t.elapsedMs();
+            doNotOptimize(found);
+            printf("n=%-10zu MappedVector  startup %8.3f ms   search %7.2f ns/op\n",
+                   n, openMs, nsPerOp(searchMs, queries.size()));
+        }
+        remove(path);
+    }
+}
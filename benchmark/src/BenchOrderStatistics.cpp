@@ -0,0 +1,91 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Map and AVLMap with and without OrderStatistics, 64 bit keys:
+// inserts and erases in random order, which pay for the subtree sizes,
+// and the k-th key found by select() against advancing an iterator.
+// usage: BenchOrderStatistics [n ...]    (default 100000 1000000)
+
+#include <flak/AVLMap.h>
+#include <flak/Map.h>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+typedef allocator<pair<const uint64_t, uint64_t>> PairAlloc;
+
+template<class Tree>
+uint64_t kth(Tree& t, size_t k, true_type) { return t.select(k)->first; }
+
+template<class Tree>
+uint64_t kth(Tree& t, size_t k, false_type) { return next(t.begin(), k)->first; }
+
+template<class Tree, bool Sized>
+void run(const char* name, const vector<uint64_t>& keys) {
+    const size_t n = keys.size();
+    Tree* t = new Tree();
+    Timer timer;
+    for (size_t i = 0; i < n; i++) {
+        t->insert(typename Tree::value_type(keys[i], i));
+    }
+    double insertMs = timer.elapsedMs();
+
+    // advancing is O(n), so it gets fewer queries
+    mt19937_64 rng(n);
+    const size_t queries = Sized ? n : 100;
+    timer.reset();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < queries; i++) {
+        sum += kth(*t, rng() % n, integral_constant<bool, Sized>());
+    }
+    double kthMs = timer.elapsedMs();
+
+    timer.reset();
+    for (size_t i = 0; i < n; i++) {
+        t->erase(keys[i]);
+    }
+    double eraseMs = timer.elapsedMs();
+    doNotOptimize(sum);
+
+    printf("%-14s n=%-9zu insert %7.1f ns/op   erase %7.1f ns/op   k-th %10.1f ns/op\n",
+           name, n, nsPerOp(insertMs, n), nsPerOp(eraseMs, n), nsPerOp(kthMs, queries));
+    delete t;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {100000, 1000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = rng();
+        }
+        run<Map<uint64_t, uint64_t>, false>("Map", keys);
+        run<Map<uint64_t, uint64_t, less<uint64_t>, PairAlloc, true>, true>("Map sized", keys);
+        run<AVLMap<uint64_t, uint64_t>, false>("AVLMap", keys);
+        run<AVLMap<uint64_t, uint64_t, less<uint64_t>, PairAlloc, true>, true>("AVLMap sized", keys);
+    }
+}
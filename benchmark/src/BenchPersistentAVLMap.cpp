@@ -0,0 +1,93 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// AVLMap against PersistentAVLMap on random 64 bit keys: inserts,
+// finds, and upserts with a snapshot taken every [gap] upserts and kept
+// until the next one, so the nodes on the paths are copied once per snapshot.
+// usage: BenchPersistentAVLMap [n ...]    (default 100000 1000000)
+
+#include <flak/AVLMap.h>
+#include <flak/PersistentAVLMap.h>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+// AVLMap has no snapshots
+double upserts(AVLMap<uint64_t, uint64_t>& m, const vector<uint64_t>& keys, size_t) {
+    Timer timer;
+    for (size_t i = 0; i < keys.size(); i++) {
+        m[keys[(i * 104729) % keys.size()]] = i;
+    }
+    return timer.elapsedMs();
+}
+
+double upserts(PersistentAVLMap<uint64_t, uint64_t>& m, const vector<uint64_t>& keys, size_t gap) {
+    Timer timer;
+    PersistentAVLMap<uint64_t, uint64_t> snap;
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i % gap == 0) {
+            snap = m.snapshot();
+        }
+        m.insertOrAssign(keys[(i * 104729) % keys.size()], i);
+    }
+    return timer.elapsedMs();
+}
+
+template<class M>
+void run(const char* name, const vector<uint64_t>& keys, size_t gap) {
+    const size_t n = keys.size();
+    M m;
+    Timer timer;
+    for (size_t i = 0; i < n; i++) {
+        m.insert(typename M::value_type(keys[i], i));
+    }
+    double insertMs = timer.elapsedMs();
+
+    timer.reset();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += m.find(keys[(i * 7919) % n])->second;
+    }
+    double findMs = timer.elapsedMs();
+
+    double upsertMs = upserts(m, keys, gap);
+    doNotOptimize(sum);
+
+    printf("%-18s n=%-9zu insert %6.1f   find %6.1f   upsert, snapshot per %-5zu %6.1f  ns/op\n",
+           name, n, nsPerOp(insertMs, n), nsPerOp(findMs, n), gap, nsPerOp(upsertMs, n));
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {100000, 1000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = rng();
+        }
+        run<AVLMap<uint64_t, uint64_t>>("AVLMap", keys, n);
+        run<PersistentAVLMap<uint64_t, uint64_t>>("PersistentAVLMap", keys, n);
+        run<PersistentAVLMap<uint64_t, uint64_t>>("PersistentAVLMap", keys, 1000);
+        run<PersistentAVLMap<uint64_t, uint64_t>>("PersistentAVLMap", keys, 10);
+    }
+}
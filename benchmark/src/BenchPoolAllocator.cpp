@@ -0,0 +1,125 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Insert and erase churn on the node based containers,
+// with std::allocator and with PoolAllocator.
+// The containers keep about n elements while keys come and go.
+// The List is also churned at the sizes around the end of a slab.
+// usage: BenchPoolAllocator [n ...]    (default 1000 100000)
+
+#include <flak/PoolAllocator.h>
+#include <flak/Set.h>
+#include <flak/AVLSet.h>
+#include <flak/HashSet.h>
+#include <flak/List.h>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+template<class Container>
+void churn(const char* name, const char* alloc, const vector<uint64_t>& keys, size_t rounds) {
+    const size_t n = keys.size() / 2;
+    Container c;
+    for (size_t i = 0; i < n; i++) {
+        c.insert(keys[i]);
+    }
+    Timer t;
+    for (size_t r = 0; r < rounds; r++) {
+        // replace the first half with the second half and back again
+        const size_t from = (r % 2) * n, to = n - from;
+        for (size_t i = 0; i < n; i++) {
+            c.erase(keys[from + i]);
+            c.insert(keys[to + i]);
+        }
+    }
+    double ms = t.elapsedMs();
+    doNotOptimize(c.size());
+    printf("%-8s %-16s n=%-8zu %7.2f ns/op\n", name, alloc, n, nsPerOp(ms, 2 * n * rounds));
+}
+
+template<class Alloc>
+void listChurn(const char* alloc, size_t n, size_t rounds) {
+    List<uint64_t, Alloc> ls;
+    for (size_t i = 0; i < n; i++) {
+        ls.push_back(i);
+    }
+    Timer t;
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < n; i++) {
+            ls.pop_front();
+            ls.push_back(i);
+        }
+    }
+    double ms = t.elapsedMs();
+    doNotOptimize(ls.size());
+    printf("%-8s %-16s n=%-8zu %7.2f ns/op\n", "List", alloc, n, nsPerOp(ms, 2 * n * rounds));
+}
+
+// push and pop one element at a list that fills its slabs up to [fill] chunks,
+// the header node of the list takes a chunk too
+template<class Alloc>
+void boundaryChurn(const char* alloc, long fill) {
+    const size_t cap = NodePool::capacity((sizeof(ListNode<uint64_t>) - 1) / NodePool::granularity);
+    const size_t n = cap + fill - 1;
+    const size_t ops = 2000000;
+    List<uint64_t, Alloc> ls;
+    for (size_t i = 0; i < n; i++) {
+        ls.push_back(i);
+    }
+    Timer t;
+    for (size_t i = 0; i < ops; i++) {
+        ls.push_back(i);
+        ls.pop_back();
+    }
+    double ms = t.elapsedMs();
+    doNotOptimize(ls.size());
+    printf("%-8s %-16s n=%-8zu %7.2f ns/op  (slab end %+ld)\n", "List", alloc, n, nsPerOp(ms, 2 * ops), fill);
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000, 100000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(2 * n);
+        for (size_t i = 0; i < keys.size(); i++) {
+            keys[i] = rng();
+        }
+        const size_t rounds = 4000000 / n + 1;
+
+        typedef std::allocator<uint64_t> Std;
+        typedef PoolAllocator<uint64_t> Pool;
+        churn<Set<uint64_t, less<uint64_t>, Std>>("Set", "std::allocator", keys, rounds);
+        churn<Set<uint64_t, less<uint64_t>, Pool>>("Set", "PoolAllocator", keys, rounds);
+        churn<AVLSet<uint64_t, less<uint64_t>, Std>>("AVLSet", "std::allocator", keys, rounds);
+        churn<AVLSet<uint64_t, less<uint64_t>, Pool>>("AVLSet", "PoolAllocator", keys, rounds);
+        churn<HashSet<uint64_t, hash<uint64_t>, equal_to<uint64_t>, Std>>("HashSet", "std::allocator", keys, rounds);
+        churn<HashSet<uint64_t, hash<uint64_t>, equal_to<uint64_t>, Pool>>("HashSet", "PoolAllocator", keys, rounds);
+        listChurn<Std>("std::allocator", n, rounds);
+        listChurn<Pool>("PoolAllocator", n, rounds);
+    }
+    for (long fill = -1; fill <= 1; fill++) {
+        boundaryChurn<std::allocator<uint64_t>>("std::allocator", fill);
+        boundaryChurn<PoolAllocator<uint64_t>>("PoolAllocator", fill);
+    }
+}
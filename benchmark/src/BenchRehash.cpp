@@ -0,0 +1,71 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// The latency of single inserts when the table grows,
+// with resize() all at once and with incremental rehashing.
+// usage: BenchRehash [n ...]    (default 1000000 10000000)
+
+#include <flak/HashTable.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+typedef HashTable<uint64_t, uint64_t, hash<uint64_t>, _Identity<uint64_t>,
+        equal_to<uint64_t>> Table;
+
+void run(const char* name, const vector<uint64_t>& keys, size_t step) {
+    const size_t n = keys.size();
+    Table ht(50, hash<uint64_t>(), equal_to<uint64_t>());
+    ht.setRehashStep(step);
+
+    vector<double> lat(n);
+    Timer total;
+    for (size_t i = 0; i < n; i++) {
+        Timer t;
+        ht.insertUnique(keys[i]);
+        lat[i] = t.elapsedMs();
+    }
+    double totalMs = total.elapsedMs();
+
+    sort(lat.begin(), lat.end());
+    printf("%-14s n=%-9zu total %8.1f ms   p99 %7.3f us   p99.99 %9.3f us   max %10.3f us\n",
+           name, n, totalMs, lat[n * 99 / 100] * 1e3,
+           lat[n * 9999 / 10000] * 1e3, lat[n - 1] * 1e3);
+    ht.clear();
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 10000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = rng();
+        }
+        run("all at once", keys, 0);
+        run("step 1", keys, 1);
+        run("step 16", keys, 16);
+    }
+}
@@ -0,0 +1,78 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// Many short lived vectors of a few elements, as a request handler builds them.
+// Every round constructs a vector, pushes k elements, sums them and destroys it.
+// The global operator new is counted to show the allocations per round.
+// usage: BenchSmallVector [rounds ...]    (default 1000000)
+
+#include <flak/SmallVector.h>
+#include <flak/Vector.h>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+static size_t allocations = 0;
+
+void* operator new(size_t n) {
+    ++allocations;
+    void* p = malloc(n ? n : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+template<class Container>
+void run(const char* name, size_t rounds, size_t k) {
+    allocations = 0;
+    long sum = 0;
+    Timer t;
+    for (size_t r = 0; r < rounds; r++) {
+        Container c;
+        for (size_t i = 0; i < k; i++) {
+            c.push_back((long) (r + i));
+        }
+        for (size_t i = 0; i < c.size(); i++) {
+            sum += c[i];
+        }
+    }
+    double ms = t.elapsedMs();
+    doNotOptimize(sum);
+    printf("%-22s k=%-3zu %8.2f ns/round %6.2f allocs/round\n",
+           name, k, nsPerOp(ms, rounds), (double) allocations / rounds);
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000});
+    for (size_t rounds : sizes) {
+        for (size_t k : {1, 4, 8, 16}) {
+            run<Vector<long>>("Vector", rounds, k);
+            run<SmallVector<long, 8>>("SmallVector<8>", rounds, k);
+            run<vector<long>>("std::vector", rounds, k);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// split() and join() of Set against moving the keys one by one, cutting
+// off 1% and 50% of the keys, with and without the OrderStatistics that
+// split() counts the sizes with,
+// and setUnion/setIntersection/setDifference of Set and AVLSet on one
+// thread and on all the cores against inserting or erasing every key.
+// usage: BenchSplitJoin [n ...]    (default 1000000 4000000)
+
+#include <flak/AVLSet.h>
+#include <flak/Set.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+template<class S>
+void splitJoin(const char* name, const vector<uint64_t>& keys, double fraction) {
+    const size_t n = keys.size();
+    vector<uint64_t> sorted(keys);
+    sort(sorted.begin(), sorted.end());
+    const uint64_t cut = sorted[(size_t) (n * (1 - fraction))];
+    S a(keys.begin(), keys.end()), b;
+    Timer timer;
+    a.split(cut, b);
+    a.join(b);
+    double relinkMs = timer.elapsedMs();
+
+    timer.reset();
+    for (auto it = a.lowerBound(cut); it != a.end(); ++it) {
+        b.insert(*it);
+    }
+    a.erase(a.lowerBound(cut), a.end());
+    for (auto it = b.begin(); it != b.end(); ++it) {
+        a.insert(*it);
+    }
+    b.clear();
+    double moveMs = timer.elapsedMs();
+    doNotOptimize(a.size());
+
+    printf("%-13s n=%-9zu cut %2.0f%%   split+join %10.1f us   move the keys %10.1f us\n",
+           name, n, fraction * 100, relinkMs * 1000, moveMs * 1000);
+}
+
+template<class S>
+void setOps(const char* name, const vector<uint64_t>& x, const vector<uint64_t>& y) {
+    const unsigned cores = std::thread::hardware_concurrency();
+    for (unsigned threads : {1u, cores}) {
+        double ms[3];
+        for (int op = 0; op < 3; op++) {
+            S a(x.begin(), x.end()), b(y.begin(), y.end());
+            Timer timer;
+            if (op == 0) a.setUnion(b, threads);
+            if (op == 1) a.setIntersection(b, threads);
+            if (op == 2) a.setDifference(b, threads);
+            ms[op] = timer.elapsedMs();
+        }
+        printf("%-13s n=%-9zu threads %-3u union %8.1f ms   intersection %8.1f ms   difference %8.1f ms\n",
+               name, x.size(), threads, ms[0], ms[1], ms[2]);
+    }
+
+    // the one by one way on the iterators
+    double ms[3];
+    for (int op = 0; op < 3; op++) {
+        S a(x.begin(), x.end()), b(y.begin(), y.end());
+        Timer timer;
+        if (op == 0) {
+            for (auto it = b.begin(); it != b.end(); ++it) a.insert(*it);
+        } else if (op == 1) {
+            for (auto it = a.begin(); it != a.end();) {
+                if (b.count(*it) == 0) a.erase(it++); else ++it;
+            }
+        } else {
+            for (auto it = b.begin(); it != b.end(); ++it) a.erase(*it);
+        }
+        ms[op] = timer.elapsedMs();
+    }
+    printf("%-13s n=%-9zu one by one  union %8.1f ms   intersection %8.1f ms   difference %8.1f ms\n",
+           name, x.size(), ms[0], ms[1], ms[2]);
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 4000000});
+    for (size_t n : sizes) {
+        mt19937_64 rng(n);
+        vector<uint64_t> x(n), y(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = rng() % (4 * n);
+            y[i] = rng() % (4 * n);
+        }
+        for (double fraction : {0.01, 0.5}) {
+            splitJoin<Set<uint64_t>>("Set", x, fraction);
+            splitJoin<Set<uint64_t, less<uint64_t>, allocator<uint64_t>, true>>("Set sized", x, fraction);
+            splitJoin<AVLSet<uint64_t>>("AVLSet", x, fraction);
+        }
+        setOps<Set<uint64_t>>("Set", x, y);
+        setOps<AVLSet<uint64_t>>("AVLSet", x, y);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// push_back into a Vector that grows from empty, for strings and PODs.
+// "copy growth" wraps the element in a type whose move constructor may throw,
+// so the Vector copies the elements when it grows, as it did before the
+// relocation by move and memcpy. std::vector is shown for reference.
+// usage: BenchVectorGrowth [n ...]    (default 1000000 10000000, the request was 100000000)
+
+#include <flak/Vector.h>
+#include <cstdio>
+#include <ratio>
+#include <string>
+#include <vector>
+#include "Timer.h"
+using namespace std;
+using namespace flak;
+using namespace flak::bench;
+
+// the move constructor is not noexcept, so growing copies
+template<class T>
+struct CopyGrowth {
+    T v;
+    CopyGrowth(const T& x) : v(x) {}
+    CopyGrowth(const CopyGrowth& x) : v(x.v) {}
+    CopyGrowth(CopyGrowth&& x) : v(std::move(x.v)) {}
+    CopyGrowth& operator=(const CopyGrowth&) = default;
+    CopyGrowth& operator=(CopyGrowth&&) = default;
+};
+
+struct Point {
+    double x, y, z;
+    long id;
+};
+
+// longer than the small string buffer, so a copy allocates
+string makeString(size_t i) { return "a string on the heap, number " + to_string(i); }
+
+Point makePoint(size_t i) { return Point{(double) i, 1.0, 2.0, (long) i}; }
+
+template<class Container, class Make>
+void run(const char* name, size_t n, Make make) {
+    Container c;
+    Timer t;
+    for (size_t i = 0; i < n; i++) {
+        c.push_back(make(i));
+    }
+    double ms = t.elapsedMs();
+    printf("%-34s n=%-10zu %8.2f ns/op\n", name, n, nsPerOp(ms, n));
+    doNotOptimize(c.size());
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = sizesFromArgs(argc, argv, {1000000, 10000000});
+    for (size_t n : sizes) {
+        run<Vector<string>>("Vector<string>", n, makeString);
+        run<Vector<CopyGrowth<string>>>("Vector<string> copy growth", n, makeString);
+        run<Vector<string, allocator<string>, ratio<3, 2>>>("Vector<string> growth 1.5", n, makeString);
+        run<vector<string>>("std::vector<string>", n, makeString);
+        run<Vector<Point>>("Vector<Point>", n, makePoint);
+        run<Vector<CopyGrowth<Point>>>("Vector<Point> copy growth", n, makePoint);
+        run<Vector<Point, allocator<Point>, ratio<3, 2>>>("Vector<Point> growth 1.5", n, makePoint);
+        run<vector<Point>>("std::vector<Point>", n, makePoint);
+    }
+}
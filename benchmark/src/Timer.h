@@ -0,0 +1,74 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Helpers shared by the benchmarks.
+
+#ifndef FLAK_BENCH_TIMER_H
+#define FLAK_BENCH_TIMER_H
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace flak {
+namespace bench {
+
+class Timer {
+public:
+    Timer() : start_(std::chrono::steady_clock::now()) {}
+
+    void reset() { start_ = std::chrono::steady_clock::now(); }
+
+    double elapsedMs() const {
+        return std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// nanoseconds per operation
+inline double nsPerOp(double ms, size_t ops) {
+    return ops == 0 ? 0 : ms * 1e6 / ops;
+}
+
+// Read the element counts from the command line,
+// or use [defaults] if there are no arguments.
+inline std::vector<size_t> sizesFromArgs(int argc, char** argv,
+                                         std::vector<size_t> defaults) {
+    if (argc <= 1) {
+        return defaults;
+    }
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    return sizes;
+}
+
+// keep the optimizer from dropping a result
+template<class T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
+}
+
+#endif //FLAK_BENCH_TIMER_H
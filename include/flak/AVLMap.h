@@ -21,13 +21,16 @@ limitations under the License.
 
 #include "AVLTree.h"
 #include <functional>
+#include <tuple>
 using std::pair;
 
 namespace flak {
 
+// [OrderStatistics] keeps the subtree sizes for select() and rank()
 template <class Key, class T,
         class Compare = std::less<Key>,
-        class Alloc = std::allocator<pair<const Key, T>>>
+        class Alloc = std::allocator<pair<const Key, T>>,
+        bool OrderStatistics = false>
 class AVLMap {
 public:
     typedef Key key_value;
@@ -50,11 +53,11 @@ public:
     typedef typename Alloc::template rebind<value_type>::other PairValueAlloc;
     typedef std::allocator_traits<PairValueAlloc> PairValueAllocTraits;
 
-    typedef AVLMap<Key, T, Compare, PairValueAlloc> Self;
+    typedef AVLMap<Key, T, Compare, PairValueAlloc, OrderStatistics> Self;
 
 private:
     typedef AVLTree<key_value, value_type, std::_Select1st<value_type>,
-    key_compare, PairValueAlloc> rep_type;
+    key_compare, PairValueAlloc, OrderStatistics> rep_type;
 
     rep_type t_;
 public:
@@ -64,6 +67,7 @@ public:
     typedef typename rep_type::const_reference const_reference;
     typedef typename rep_type::iterator iterator;
     typedef typename rep_type::const_iterator const_iterator;
+    typedef typename rep_type::frozen_type frozen_type;
 
     typedef typename rep_type::size_type size_type;
     typedef typename rep_type::difference_type difference_typ;
@@ -96,7 +100,7 @@ public:
     size_type max_size() const { return t_.max_size(); }
 
     T& operator[](const Key& k) {
-        return (*( insert(value_type(k, T())).first )).second;
+        return tryEmplace(k).first->second;
     }
 
     void swap(Self& x) { t_.swap(x.t_); }
@@ -105,10 +109,54 @@ public:
         return t_.insertUnique(x);
     }
 
+    pair<iterator, bool> insert(value_type&& x) {
+        return t_.insertUnique(std::move(x));
+    }
+
+    // construct the element in place
+    template <class... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        return t_.emplaceUnique(std::forward<Args>(args)...);
+    }
+
+    // construct the mapped value from [args] only if [k] does not exist
+    template <class... Args>
+    pair<iterator, bool> tryEmplace(const Key& k, Args&&... args) {
+        iterator it = find(k);
+        if (it != end()) {
+            return pair<iterator, bool>(it, false);
+        }
+        return t_.emplaceUnique(std::piecewise_construct, std::forward_as_tuple(k),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <class... Args>
+    pair<iterator, bool> tryEmplace(Key&& k, Args&&... args) {
+        iterator it = find(k);
+        if (it != end()) {
+            return pair<iterator, bool>(it, false);
+        }
+        return t_.emplaceUnique(std::piecewise_construct, std::forward_as_tuple(std::move(k)),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    // [pos] is a hint, inserting right before it or at end() for increasing keys skips the search
     iterator insert(iterator pos, const value_type& x) {
         return t_.insertUnique(pos, x);
     }
 
+    iterator insert(iterator pos, value_type&& x) {
+        return t_.insertUnique(pos, std::move(x));
+    }
+
+    iterator insert(const_iterator pos, const value_type& x) {
+        return t_.insertUnique(pos, x);
+    }
+
+    iterator insert(const_iterator pos, value_type&& x) {
+        return t_.insertUnique(pos, std::move(x));
+    }
+
     template <class InputIterator>
     void insert(InputIterator first, InputIterator last) {
         t_.insertUnique(first, last);
@@ -123,6 +171,20 @@ public:
     const_iterator find(const Key& k) const { return t_.find(k); }
 
     size_type count(const Key& k) { return t_.count(k); }
+
+    // select(), rank() and countRange() need OrderStatistics, see AVLTree
+    iterator select(size_type k) { return t_.select(k); }
+    const_iterator select(size_type k) const { return t_.select(k); }
+    size_type rank(const Key& k) const { return t_.rank(k); }
+    size_type countRange(const Key& lo, const Key& hi) const { return t_.countRange(lo, hi); }
+
+    // an immutable copy that is faster to search, see FrozenTree
+    frozen_type freeze() const { return t_.freeze(); }
+
+    // move the keys not less than [k] to [x], see AVLTree::split
+    void split(const Key& k, Self& x) { t_.split(k, x.t_); }
+    // move all the keys of [x] here, see AVLTree::join
+    void join(Self& x) { t_.join(x.t_); }
     iterator lowerBound(const Key &k) { return t_.lowerBound(k); }
     const_iterator lowerBound(const Key &k) const { return t_.lowerBound(k); }
     iterator upperBound(const Key& k) { return t_.upperBound(k); }
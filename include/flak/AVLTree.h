@@ -22,16 +22,22 @@ limitations under the License.
 #include <cstddef>
 #include <iterator>
 #include <cassert>
+#include <stdexcept>
+#include <utility>
+#include "FrozenTree.h"
+#include "NodeBlocks.h"
+#include "SubtreeSize.h"
 
 using std::pair;
 
 namespace flak {
 
 
-template<typename T>
-struct AVLNode {
-    typedef AVLNode<T>* NodePtr;
-    typedef const AVLNode<T>* ConstNodePtr;
+// [Sized] adds the subtree size, see SubtreeSize.h
+template<typename T, bool Sized = false>
+struct AVLNode : SubtreeSize<Sized> {
+    typedef AVLNode<T, Sized>* NodePtr;
+    typedef const AVLNode<T, Sized>* ConstNodePtr;
 
     T value_;
     NodePtr parent_;
@@ -62,7 +68,7 @@ struct AVLNode {
     }
 };
 
-template<typename T, typename Ref, typename Ptr>
+template<typename T, typename Ref, typename Ptr, bool Sized = false>
 struct AVLTreeIterator {
     typedef T value_type;
     typedef Ref reference;
@@ -70,8 +76,8 @@ struct AVLTreeIterator {
     typedef ptrdiff_t difference_type;
     typedef std::bidirectional_iterator_tag iterator_category;
 
-    typedef AVLTreeIterator<T, Ref, Ptr> Self;
-    typedef AVLNode<T>* NodePtr;
+    typedef AVLTreeIterator<T, Ref, Ptr, Sized> Self;
+    typedef AVLNode<T, Sized>* NodePtr;
     NodePtr node_;
 
     AVLTreeIterator() : node_() {}
@@ -154,9 +160,14 @@ struct AVLTreeIterator {
     }
 };
 
+// With [OrderStatistics] every node keeps the size of its subtree,
+// which select(), rank() and countRange() need.
 template<typename Key, typename Val,
-        typename KeyOfValue, typename Compare, typename Alloc=std::allocator<Val>>
+        typename KeyOfValue, typename Compare, typename Alloc=std::allocator<Val>,
+        bool OrderStatistics = false>
 class AVLTree {
+    template<class Tree> friend struct TreeSetOps;
+
 public:
     typedef Key key_type;
     typedef Val value_type;
@@ -167,8 +178,8 @@ public:
     typedef size_t size_type;
     typedef ptrdiff_t difference_type;
 
-    typedef AVLNode<Val>* NodePtr;
-    typedef AVLNode<Val> Node;
+    typedef AVLNode<Val, OrderStatistics>* NodePtr;
+    typedef AVLNode<Val, OrderStatistics> Node;
     typedef const NodePtr ConstNodePtr;
 
 protected:
@@ -178,28 +189,39 @@ protected:
     typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
 
     NodeAlloc nodeAlloc;
+    NodeBlocks<Node, NodeAlloc> blocks_;   // the nodes of the bulk builds
 
     NodePtr getNode() {
         return NodeAllocTraits::allocate(nodeAlloc, 1);
     }
 
     void putNode(NodePtr p) {
-        NodeAllocTraits::deallocate(nodeAlloc, p, 1);
+        if (blocks_.empty() || !blocks_.deallocate(nodeAlloc, p)) {
+            NodeAllocTraits::deallocate(nodeAlloc, p, 1);
+        }
     }
 
-    NodePtr createNode(const Val& x) {
+    // construct the value in place from [args]
+    template<class... Args>
+    NodePtr createNode(Args&&... args) {
         NodePtr tmp = getNode();
-        NodeAllocTraits::construct(nodeAlloc, &(tmp->value_), x);
+        try {
+            NodeAllocTraits::construct(nodeAlloc, &(tmp->value_), std::forward<Args>(args)...);
+        } catch (...) {
+            putNode(tmp);
+            throw;
+        }
         return tmp;
     }
 
     void destroyNode(NodePtr p) {
         NodeAllocTraits::destroy(nodeAlloc, &(p->value_));
-        NodeAllocTraits::destroy(nodeAlloc, p);
         putNode(p);
     }
 
 private:
+    typedef SubtreeSize<OrderStatistics> Sizes;
+
     Compare keyComp_;
     NodePtr header_;
     size_type nodeCount_;
@@ -223,7 +245,7 @@ protected:
         return KeyOfValue()(value(x));
     }
 
-    typedef AVLTree<Key, Val, KeyOfValue, Compare, Alloc> Self;
+    typedef AVLTree<Key, Val, KeyOfValue, Compare, Alloc, OrderStatistics> Self;
 
     void init() {
         header_ = getNode();
@@ -235,8 +257,9 @@ protected:
     }
 
 public:
-    typedef AVLTreeIterator<Val, Val&, Val*> iterator;
-    typedef AVLTreeIterator<Val, const Val&, const Val*> const_iterator;
+    typedef AVLTreeIterator<Val, Val&, Val*, OrderStatistics> iterator;
+    typedef AVLTreeIterator<Val, const Val&, const Val*, OrderStatistics> const_iterator;
+    typedef FrozenTree<Key, Val, KeyOfValue, Compare, Alloc> frozen_type;
 
     AVLTree() { init(); }
 
@@ -256,6 +279,8 @@ public:
 
     size_type max_size() const { return NodeAllocTraits::max_size(nodeAlloc); }
 
+    Alloc get_allocator() const { return Alloc(nodeAlloc); }
+
     void clear() {
         _erase(root());
         leftmost() = header_;
@@ -267,52 +292,287 @@ public:
 public:
 
     pair<iterator, bool> insertUnique(const Val& v) {
-        NodePtr x = root();
-        NodePtr y = header_;
-        bool comp = true;
-        while (x != nullptr) {
-            y = x;
-            comp = keyComp_(KeyOfValue()(v), key(x));
-            x = comp ? left(x) : right(x);
+        NodePtr y;
+        if (NodePtr j = _insertUniquePos(KeyOfValue()(v), y)) {
+            return pair<iterator, bool>(iterator(j), false);
         }
-        iterator j = iterator(y);
-        if (comp) { // left
-            if (j == begin()) { // leftmost
-                return pair<iterator, bool>(_insert(x, y, v), true);
-            } else {
-                --j;
-            }
+        return pair<iterator, bool>(_insert(nullptr, y, v), true);
+    }
+
+    pair<iterator, bool> insertUnique(Val&& v) {
+        NodePtr y;
+        if (NodePtr j = _insertUniquePos(KeyOfValue()(v), y)) {
+            return pair<iterator, bool>(iterator(j), false);
         }
+        return pair<iterator, bool>(_insert(nullptr, y, std::move(v)), true);
+    }
 
-        if (keyComp_(key(j.node_), KeyOfValue()(v))) {
-            return pair<iterator, bool>(_insert(x, y, v), true);
+    // Construct the value from [args] and insert it if the key does not exist,
+    // else the new node is destroyed.
+    template<class... Args>
+    pair<iterator, bool> emplaceUnique(Args&&... args) {
+        NodePtr z = createNode(std::forward<Args>(args)...);
+        NodePtr y;
+        if (NodePtr j = _insertUniquePos(key(z), y)) {
+            destroyNode(z);
+            return pair<iterator, bool>(iterator(j), false);
         }
-        return pair<iterator, bool>(j, false);
+        return pair<iterator, bool>(_insertNode(nullptr, y, z), true);
     }
 
+    // An empty tree is built in O(n) if the values are sorted, see assignUniqueSorted().
     template<class II>
     void insertUnique(II first, II last) {
-        for (; first != last; ++first) {
-            insertUnique(*first);
+        _insertUnique(first, last, typename std::iterator_traits<II>::iterator_category());
+    }
+
+    // Replace the values by [first, last), which is sorted by the keys,
+    // the later values of equal keys are dropped.
+    // The tree is built balanced in O(n), its nodes are allocated in one block
+    // and lie in key order. If the values are not sorted, they are inserted one by one.
+    template<class FI>
+    void assignUniqueSorted(FI first, FI last) {
+        clear();
+        if (!_buildUnique(first, last)) {
+            for (; first != last; ++first) {
+                insertUnique(*first);
+            }
         }
     }
 
-    void insertUnique(iterator first, iterator last) {
+private:
+    template<class II>
+    void _insertUnique(II first, II last, std::input_iterator_tag) {
         for (; first != last; ++first) {
             insertUnique(*first);
         }
     }
 
+    template<class FI>
+    void _insertUnique(FI first, FI last, std::forward_iterator_tag) {
+        if (nodeCount_ == 0 && _buildUnique(first, last)) {
+            return;
+        }
+        _insertUnique(first, last, std::input_iterator_tag());
+    }
+
+    // build the empty tree from the sorted values, return false if they are not sorted
+    template<class FI>
+    bool _buildUnique(FI first, FI last) {
+        size_type n = 0;
+        for (FI prev = first, cur = first; cur != last; prev = cur, ++cur) {
+            if (cur != first) {
+                if (keyComp_(KeyOfValue()(*cur), KeyOfValue()(*prev))) {
+                    return false;
+                }
+                if (!keyComp_(KeyOfValue()(*prev), KeyOfValue()(*cur))) {
+                    continue; // equal key
+                }
+            }
+            n++;
+        }
+        if (n == 0) {
+            return true;
+        }
+
+        NodePtr nodes = blocks_.allocate(nodeAlloc, n);
+        size_type i = 0;
+        try {
+            for (FI prev = first, cur = first; cur != last; prev = cur, ++cur) {
+                if (cur == first || keyComp_(KeyOfValue()(*prev), KeyOfValue()(*cur))) {
+                    NodeAllocTraits::construct(nodeAlloc, &(nodes[i].value_), *cur);
+                    i++;
+                }
+            }
+        } catch (...) {
+            // the block is freed with the last of its nodes
+            for (size_type j = i; j < n; j++) {
+                putNode(nodes + j);
+            }
+            while (i > 0) {
+                destroyNode(nodes + --i);
+            }
+            throw;
+        }
+
+        int h;
+        root() = _link(nodes, 0, n, header_, h);
+        leftmost() = nodes;
+        rightmost() = nodes + n - 1;
+        nodeCount_ = n;
+        return true;
+    }
+
+    // link nodes[lo, hi) as a balanced subtree, the middle one is the root,
+    // [h] is set to its height
+    NodePtr _link(NodePtr nodes, size_type lo, size_type hi, NodePtr p, int& h) {
+        if (lo >= hi) {
+            h = 0;
+            return nullptr;
+        }
+        const size_type mid = lo + (hi - lo) / 2;
+        NodePtr x = nodes + mid;
+        int hl, hr;
+        x->parent_ = p;
+        x->left_ = _link(nodes, lo, mid, x, hl);
+        x->right_ = _link(nodes, mid + 1, hi, x, hr);
+        x->balFactor_ = hr - hl;
+        h = std::max(hl, hr) + 1;
+        Sizes::update(x);
+        return x;
+    }
+
+public:
+
     iterator insertEqual(const Val& v) {
-        NodePtr x = root();
-        NodePtr y = header_;
-        while (x != nullptr) {
-            y = x;
-            x = keyComp_(KeyOfValue()(v), key(x)) ? left(x) : right(x);
+        return _insert(nullptr, _insertEqualPos(KeyOfValue()(v)), v);
+    }
+
+    iterator insertEqual(Val&& v) {
+        NodePtr y = _insertEqualPos(KeyOfValue()(v));
+        return _insert(nullptr, y, std::move(v));
+    }
+
+    template<class... Args>
+    iterator emplaceEqual(Args&&... args) {
+        NodePtr z = createNode(std::forward<Args>(args)...);
+        return _insertNode(nullptr, _insertEqualPos(key(z)), z);
+    }
+
+    // Insert [v] if its key does not exist, return the node with the key.
+    // The position right before or after [pos] is tried first, and the
+    // descent from the root is skipped if [v] belongs there. Passing end()
+    // for increasing keys appends them at the rightmost node in O(1) amortized.
+    iterator insertUnique(const_iterator pos, const Val& v) { return _insertUniqueHint(pos.node_, v); }
+
+    iterator insertUnique(const_iterator pos, Val&& v) { return _insertUniqueHint(pos.node_, std::move(v)); }
+
+    iterator insertUnique(iterator pos, const Val& v) { return _insertUniqueHint(pos.node_, v); }
+
+    iterator insertUnique(iterator pos, Val&& v) { return _insertUniqueHint(pos.node_, std::move(v)); }
+
+    // insert [v] right before or after [pos] if it belongs there, else as insertEqual(v)
+    iterator insertEqual(const_iterator pos, const Val& v) { return _insertEqualHint(pos.node_, v); }
+
+    iterator insertEqual(const_iterator pos, Val&& v) { return _insertEqualHint(pos.node_, std::move(v)); }
+
+    iterator insertEqual(iterator pos, const Val& v) { return _insertEqualHint(pos.node_, v); }
+
+    iterator insertEqual(iterator pos, Val&& v) { return _insertEqualHint(pos.node_, std::move(v)); }
+
+private:
+    template<class V>
+    iterator _insertUniqueHint(NodePtr pos, V&& v) {
+        NodePtr x, y;
+        if (NodePtr j = _hintUniquePos(pos, KeyOfValue()(v), x, y)) {
+            return iterator(j);
+        }
+        return _insert(x, y, std::forward<V>(v));
+    }
+
+    template<class V>
+    iterator _insertEqualHint(NodePtr pos, V&& v) {
+        NodePtr x, y;
+        _hintEqualPos(pos, KeyOfValue()(v), x, y);
+        return _insert(x, y, std::forward<V>(v));
+    }
+
+    // Find where to insert the key [k] next to [pos] as _insertNode(x, p) takes it,
+    // a non-null [x] puts the node at the left of [p].
+    // Return the node holding k if it exists, else nullptr.
+    NodePtr _hintUniquePos(NodePtr pos, const Key& k, NodePtr& x, NodePtr& y) {
+        x = nullptr;
+        if (pos == header_) {
+            if (nodeCount_ > 0 && keyComp_(key(rightmost()), k)) {
+                y = rightmost();
+                return nullptr;
+            }
+            return _insertUniquePos(k, y);
+        }
+        if (keyComp_(k, key(pos))) {
+            if (pos == leftmost()) {
+                x = y = pos;
+                return nullptr;
+            }
+            iterator before(pos);
+            --before;
+            if (keyComp_(key(before.node_), k)) {
+                if (right(before.node_) == nullptr) {
+                    y = before.node_;
+                } else {
+                    x = y = pos;
+                }
+                return nullptr;
+            }
+            return _insertUniquePos(k, y);
+        }
+        if (keyComp_(key(pos), k)) {
+            if (pos == rightmost()) {
+                y = pos;
+                return nullptr;
+            }
+            iterator after(pos);
+            ++after;
+            if (keyComp_(k, key(after.node_))) {
+                if (right(pos) == nullptr) {
+                    y = pos;
+                } else {
+                    x = y = after.node_;
+                }
+                return nullptr;
+            }
+            return _insertUniquePos(k, y);
+        }
+        return pos; // equal key
+    }
+
+    // as _hintUniquePos(), the equal keys stay in the order of insertion
+    void _hintEqualPos(NodePtr pos, const Key& k, NodePtr& x, NodePtr& y) {
+        x = nullptr;
+        if (pos == header_) {
+            if (nodeCount_ > 0 && !keyComp_(k, key(rightmost()))) {
+                y = rightmost();
+            } else {
+                y = _insertEqualPos(k);
+            }
+            return;
         }
-        return _insert(x, y, v);
+        if (!keyComp_(key(pos), k)) {
+            if (pos == leftmost()) {
+                x = y = pos;
+                return;
+            }
+            iterator before(pos);
+            --before;
+            if (!keyComp_(k, key(before.node_))) {
+                if (right(before.node_) == nullptr) {
+                    y = before.node_;
+                } else {
+                    x = y = pos;
+                }
+                return;
+            }
+        } else {
+            if (pos == rightmost()) {
+                y = pos;
+                return;
+            }
+            iterator after(pos);
+            ++after;
+            if (!keyComp_(key(after.node_), k)) {
+                if (right(pos) == nullptr) {
+                    y = pos;
+                } else {
+                    x = y = after.node_;
+                }
+                return;
+            }
+        }
+        y = _insertEqualPos(k);
     }
 
+public:
+
     iterator lowerBound(const Key& k) {
         NodePtr y = header_;
         NodePtr x = root();
@@ -415,11 +675,108 @@ public:
     }
 
     size_type count(const Key& k) const {
-        pair<iterator, iterator> p = equalRange(k);
+        pair<const_iterator, const_iterator> p = equalRange(k);
         size_type n = std::distance(p.first, p.second);
         return n;
     }
 
+    // The k-th smallest value counting from 0, end() if k >= size().
+    // select(), rank() and countRange() need OrderStatistics.
+    iterator select(size_type k) { return iterator(_select(k)); }
+
+    const_iterator select(size_type k) const { return const_iterator(_select(k)); }
+
+    // the number of the values whose keys are less than [k], the index of lowerBound(k)
+    size_type rank(const Key& k) const {
+        static_assert(OrderStatistics, "rank() needs the subtree sizes of OrderStatistics");
+        size_type n = 0;
+        NodePtr x = root();
+        while (x != nullptr) {
+            if (keyComp_(key(x), k)) {
+                n += Sizes::size(left(x)) + 1;
+                x = right(x);
+            } else {
+                x = left(x);
+            }
+        }
+        return n;
+    }
+
+    // the number of the values whose keys are in [lo, hi)
+    size_type countRange(const Key& lo, const Key& hi) const {
+        return keyComp_(lo, hi) ? rank(hi) - rank(lo) : 0;
+    }
+
+    // copy the values in O(n) to an immutable array that is faster to search, see FrozenTree
+    frozen_type freeze() const { return frozen_type(begin(), nodeCount_, keyComp_); }
+
+    // Move the values whose keys are not less than [k] to [other], which is cleared first.
+    // The nodes are relinked in O(log n) without allocation. Without OrderStatistics
+    // the sizes of the trees are counted from the cut, in O(min(size(), other.size())).
+    // Like std::list::splice, relinking needs get_allocator() == other.get_allocator(),
+    // else the values are copied to nodes of [other] one by one in O(m log m).
+    void split(const Key& k, Self& other) {
+        if (&other == this) {
+            return;
+        }
+        other.clear();
+        if (!(nodeAlloc == other.nodeAlloc)) {
+            iterator first = lowerBound(k);
+            for (iterator i = first; i != end(); ++i) {
+                other.insertEqual(other.end(), *i);
+            }
+            erase(first, end());
+            return;
+        }
+        other.blocks_.merge(blocks_);
+        const size_type n = nodeCount_;
+        int h;
+        NodePtr x = _detach(h);
+        NodePtr l, r;
+        int lh, rh;
+        _splitTree(x, h, k, l, lh, nullptr, r, rh);
+        _attach(l, 0);
+        other._attach(r, 0);
+        size_type m = Sizes::enabled ? Sizes::size(r) : _countFromCut(other, n);
+        nodeCount_ = n - m;
+        other.nodeCount_ = m;
+    }
+
+    // Move all the values of [other] to this tree in O(log n) without allocation.
+    // The keys of one tree must all be less than the keys of the other,
+    // else std::invalid_argument is thrown and both trees are left as they were.
+    // As for split(), the nodes are relinked only if the allocators compare equal,
+    // else the values of [other] are copied one by one in O(m) and [other] is cleared.
+    void join(Self& other) {
+        if (&other == this || other.nodeCount_ == 0) {
+            return;
+        }
+        if (nodeCount_ != 0 && !keyComp_(key(rightmost()), key(other.leftmost()))
+            && !keyComp_(key(other.rightmost()), key(leftmost()))) {
+            throw std::invalid_argument("AVLTree::join: the keys of the trees overlap");
+        }
+        bool after = nodeCount_ != 0 && keyComp_(key(other.rightmost()), key(leftmost()));
+        if (!(nodeAlloc == other.nodeAlloc)) {
+            // the values of [other] go right before begin() or end(), the hint always holds
+            iterator pos = after ? begin() : end();
+            for (iterator i = other.begin(); i != other.end(); ++i) {
+                insertEqual(pos, *i);
+            }
+            other.clear();
+            return;
+        }
+        blocks_.merge(other.blocks_);
+        const size_type n = nodeCount_ + other.nodeCount_;
+        int lh, rh, h;
+        NodePtr l = _detach(lh);
+        NodePtr r = other._detach(rh);
+        if (after) {
+            std::swap(l, r);
+            std::swap(lh, rh);
+        }
+        _attach(_join2(l, lh, r, rh, h), n);
+    }
+
     bool operator==(Self& x) {
         return size() == x.size() && std::equal(begin(), end(), x.begin(), x.end());
     }
@@ -445,6 +802,223 @@ public:
     }
 
 private:
+    // The node trees of split() and join() are detached from the header,
+    // the parent of their root is nullptr.
+
+    // detach the nodes from the header, the tree becomes empty
+    NodePtr _detach(int& h) {
+        NodePtr x = root();
+        h = 0;
+        if (x != nullptr) {
+            x->parent_ = nullptr;
+            for (NodePtr y = x; y != nullptr; y = y->balFactor_ == 1 ? right(y) : left(y)) {
+                h++;
+            }
+        }
+        root() = nullptr;
+        leftmost() = header_;
+        rightmost() = header_;
+        nodeCount_ = 0;
+        return x;
+    }
+
+    // the nodes of [x] become the tree
+    void _attach(NodePtr x, size_type n) {
+        root() = x;
+        if (x != nullptr) {
+            x->parent_ = header_;
+            leftmost() = Node::minimum(x);
+            rightmost() = Node::maximum(x);
+        } else {
+            leftmost() = header_;
+            rightmost() = header_;
+        }
+        nodeCount_ = n;
+    }
+
+    // the size of [other], counted together with this tree from the cut between them
+    size_type _countFromCut(Self& other, size_type n) {
+        iterator i = end();
+        iterator j = other.begin();
+        for (size_type m = 0; ; m++) {
+            if (i == begin()) {
+                return n - m;
+            }
+            if (j == other.end()) {
+                return m;
+            }
+            --i;
+            ++j;
+        }
+    }
+
+    // cut the children of [x] of height [h] off as two trees
+    void _detachChildren(NodePtr x, int h, NodePtr& l, int& lh, NodePtr& r, int& rh) {
+        l = left(x);
+        r = right(x);
+        lh = h - 1 - (x->balFactor_ == 1);
+        rh = h - 1 - (x->balFactor_ == -1);
+        if (l != nullptr) l->parent_ = nullptr;
+        if (r != nullptr) r->parent_ = nullptr;
+        left(x) = nullptr;
+        right(x) = nullptr;
+    }
+
+    // The subtree [x] replaced one a level lower, retrace the balance up to [root].
+    // Return whether the tree grew.
+    bool _growRetrace(NodePtr x, NodePtr& root) {
+        while (x != root) {
+            NodePtr p = x->parent_;
+            const int side = x == p->left_ ? -1 : 1;
+            if (p->balFactor_ == -side) {
+                p->balFactor_ = 0;
+                return false;
+            }
+            if (p->balFactor_ == 0) {
+                p->balFactor_ = side;
+                x = p;
+                continue;
+            }
+            if (side == -1) {
+                if (x->balFactor_ == 1) {
+                    _rotateLeftRight(p, root);
+                } else {
+                    _rotateRight(p, root);
+                }
+            } else {
+                if (x->balFactor_ == -1) {
+                    _rotateRightLeft(p, root);
+                } else {
+                    _rotateLeft(p, root);
+                }
+            }
+            x = p->parent_;
+            // a single rotation of a balanced [x] leaves the top a level higher
+            if (x->balFactor_ == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Join the trees [l] and [r] with the node [m] between them, return the root.
+    // The lower tree is linked in at the side of the higher one and
+    // retraced like an insertion, in O(|lh - rh|).
+    NodePtr _joinTrees(NodePtr l, int lh, NodePtr m, NodePtr r, int rh, int& h) {
+        if (lh - rh <= 1 && rh - lh <= 1) {
+            left(m) = l;
+            right(m) = r;
+            parent(m) = nullptr;
+            if (l != nullptr) parent(l) = m;
+            if (r != nullptr) parent(r) = m;
+            m->balFactor_ = rh - lh;
+            Sizes::update(m);
+            h = std::max(lh, rh) + 1;
+            return m;
+        }
+        NodePtr top = lh > rh ? l : r;
+        NodePtr p = nullptr;
+        NodePtr c = top;
+        int ch = lh > rh ? lh : rh;
+        const int target = lh > rh ? rh : lh;
+        // the node on the spine at most a level higher than the lower tree
+        while (ch > target + 1) {
+            p = c;
+            if (lh > rh) {
+                ch -= c->balFactor_ == -1 ? 2 : 1;
+                c = right(c);
+            } else {
+                ch -= c->balFactor_ == 1 ? 2 : 1;
+                c = left(c);
+            }
+        }
+        if (lh > rh) {
+            left(m) = c;
+            right(m) = r;
+            right(p) = m;
+            m->balFactor_ = target - ch;
+            if (r != nullptr) parent(r) = m;
+        } else {
+            left(m) = l;
+            right(m) = c;
+            left(p) = m;
+            m->balFactor_ = ch - target;
+            if (l != nullptr) parent(l) = m;
+        }
+        if (c != nullptr) parent(c) = m;
+        parent(m) = p;
+        Sizes::update(m);
+        Sizes::addToPath(p, NodePtr(nullptr), Sizes::size(m) - Sizes::size(c));
+        bool grew = _growRetrace(m, top);
+        h = (lh > rh ? lh : rh) + grew;
+        return top;
+    }
+
+    // join [l] and [r], the minimum of [r] becomes the node between them
+    NodePtr _join2(NodePtr l, int lh, NodePtr r, int rh, int& h) {
+        if (r == nullptr || l == nullptr) {
+            h = r == nullptr ? lh : rh;
+            return r == nullptr ? l : r;
+        }
+        NodePtr e, m;
+        int eh;
+        _splitTree(r, rh, key(Node::minimum(r)), e, eh, &m, r, rh);
+        return _joinTrees(l, lh, m, r, rh, h);
+    }
+
+    // Cut the tree [x] into [l] with the keys less than [k] and [r] with the others.
+    // If [mid] is given, the node with the key [k] is cut off as *mid,
+    // which needs unique keys.
+    void _splitTree(NodePtr x, int h, const Key& k, NodePtr& l, int& lh,
+                    NodePtr* mid, NodePtr& r, int& rh) {
+        if (mid != nullptr) {
+            *mid = nullptr;
+        }
+        if (x == nullptr) {
+            l = r = nullptr;
+            lh = rh = 0;
+            return;
+        }
+        NodePtr a, b;
+        int ah, bh;
+        _detachChildren(x, h, a, ah, b, bh);
+        if (keyComp_(key(x), k)) {
+            NodePtr bl;
+            int blh;
+            _splitTree(b, bh, k, bl, blh, mid, r, rh);
+            l = _joinTrees(a, ah, x, bl, blh, lh);
+        } else if (mid != nullptr && !keyComp_(k, key(x))) {
+            *mid = x;
+            l = a;
+            lh = ah;
+            r = b;
+            rh = bh;
+        } else {
+            NodePtr ar;
+            int arh;
+            _splitTree(a, ah, k, l, lh, mid, ar, arh);
+            r = _joinTrees(ar, arh, x, b, bh, rh);
+        }
+    }
+
+    NodePtr _select(size_type k) const {
+        static_assert(OrderStatistics, "select() needs the subtree sizes of OrderStatistics");
+        if (k >= nodeCount_) {
+            return header_;
+        }
+        NodePtr x = root();
+        for (;;) {
+            size_type n = Sizes::size(left(x));
+            if (k < n) {
+                x = left(x);
+            } else if (k == n) {
+                return x;
+            } else {
+                k -= n + 1;
+                x = right(x);
+            }
+        }
+    }
 
     // erase all node in postorder
     void _erase(NodePtr x) {
@@ -460,15 +1034,57 @@ private:
     //  always is nullptr passed from insertUnique() and insertEqual(),
     //  do not need to consider, in theory.
     // [p] is the parent of [x]
-    iterator _insert(NodePtr x, NodePtr p, const Val& v) {
+    template<class V>
+    iterator _insert(NodePtr x, NodePtr p, V&& v) {
+        return _insertNode(x, p, createNode(std::forward<V>(v)));
+    }
+
+    // link the new node [z] as a child of [p]
+    iterator _insertNode(NodePtr x, NodePtr p, NodePtr z) {
         bool insertLeft = (x != nullptr ||
-                           p == header_ || keyComp_(KeyOfValue()(v), key(p)));
-        NodePtr z = createNode(v);
+                           p == header_ || keyComp_(key(z), key(p)));
         _insertAndRebalance(insertLeft, z, p);
         ++nodeCount_;
         return iterator(z);
     }
 
+    // the parent of the node to insert with key [k], equal keys go right
+    NodePtr _insertEqualPos(const Key& k) {
+        NodePtr x = root();
+        NodePtr y = header_;
+        while (x != nullptr) {
+            y = x;
+            x = keyComp_(k, key(x)) ? left(x) : right(x);
+        }
+        return y;
+    }
+
+    // Find the parent [y] of the node to insert with key [k].
+    // Return the node holding k if it exists, else nullptr.
+    NodePtr _insertUniquePos(const Key& k, NodePtr& y) {
+        NodePtr x = root();
+        y = header_;
+        bool comp = true;
+        while (x != nullptr) {
+            y = x;
+            comp = keyComp_(k, key(x));
+            x = comp ? left(x) : right(x);
+        }
+        iterator j = iterator(y);
+        if (comp) { // left
+            if (j == begin()) { // leftmost
+                return nullptr;
+            } else {
+                --j;
+            }
+        }
+
+        if (keyComp_(key(j.node_), k)) {
+            return nullptr;
+        }
+        return j.node_;
+    }
+
     /*
      *       /                /
      *      x                y
@@ -527,6 +1143,8 @@ private:
             y->balFactor_ = -1;
             x->balFactor_ = 1;
         }
+        Sizes::update(x);
+        Sizes::update(y);
     }
 
     /*
@@ -566,6 +1184,8 @@ private:
             y->balFactor_ = 1;
             x->balFactor_ = -1;
         }
+        Sizes::update(x);
+        Sizes::update(y);
     }
 
     /*
@@ -646,6 +1266,9 @@ private:
                 assert(false);
         }
         c->balFactor_ = 0;
+        Sizes::update(a);
+        Sizes::update(b);
+        Sizes::update(c);
     }
 
     /*
@@ -721,6 +1344,9 @@ private:
                 assert(false);
         }
         c->balFactor_ = 0;
+        Sizes::update(a);
+        Sizes::update(b);
+        Sizes::update(c);
     }
 
     // [x] is the position to insert
@@ -732,6 +1358,7 @@ private:
         x->left_ = nullptr;
         x->right_ = nullptr;
         x->balFactor_ = 0;
+        Sizes::update(x);
 
         if (insertLeft) {
             p->left_ = x;
@@ -748,6 +1375,8 @@ private:
             }
         }
 
+        Sizes::addToPath(p, header_, 1);
+
         // rebalance
         while (x != root()) {
             switch (x->parent_->balFactor_) {
@@ -804,6 +1433,7 @@ private:
         NodePtr y = z;
         NodePtr x = nullptr;
         NodePtr xParent = nullptr;
+        bool isLeft = false; // whether x is the left child of xParent
 
         // x is the child of y
         if (y->left_ == nullptr) {
@@ -819,6 +1449,8 @@ private:
             }
             x = y->right_; //y has no left child, so x is the successor
         }
+        // y leaves its place, z leaves the tree
+        Sizes::addToPath(y->parent_, header_, -1);
 
         if (y != z) { // mean that z has two children
             // we make the successor y to replace z
@@ -828,6 +1460,7 @@ private:
             if (y != z->right_) {
                 // y will be moved, need to link its child to its parent
                 xParent = y->parent_;
+                isLeft = true;
                 if (x) {
                     x->parent_ = y->parent_;
                 }
@@ -837,6 +1470,7 @@ private:
             } else {
                 // y == z->right, mean y has no left child and x is the right of y
                 xParent = y;
+                isLeft = false;
             }
             // link z's parent to y
             if (root() == z) {
@@ -848,6 +1482,7 @@ private:
             }
             y->parent_ = z->parent_;
             y->balFactor_ = z->balFactor_;
+            Sizes::update(y);
 
         } else { // mean that z has one child or none and y == z
             // If z has one child, we just make its child as the successor
@@ -860,8 +1495,10 @@ private:
                 root() = x;
             } else if (z->parent_->left_ == z) {
                 z->parent_->left_ = x;
+                isLeft = true;
             } else {
                 z->parent_->right_ = x;
+                isLeft = false;
             }
             if (leftmost() == z) {
                 if (z->right_ == nullptr) {
@@ -880,55 +1517,65 @@ private:
         }
 
         // rebalance
+        // x may be null, so we remember which sub-tree of xParent became shorter
         while (x != root()) {
-            switch (xParent->balFactor_) {
-                case 0:
-                    xParent->balFactor_ = (x == xParent->right_) ? -1 : 1;
-                    return z;
-                case -1:
-                    // left sub-tree taller
-                    if (x == xParent->left_) { // erase the node in the left, balance just right
+            if (isLeft) {
+                switch (xParent->balFactor_) {
+                    case -1:
+                        // become same tall, but xParent become shorter
                         xParent->balFactor_ = 0;
                         x = xParent;
-                        xParent = xParent->parent_;
-                    } else { // erase the node in the right, need to shorten the left
-                        NodePtr a = xParent->left_;
-                        if (a->balFactor_ == 1) { // check whether need a double rotation
-                            _rotateLeftRight(a, root());
+                        break;
+                    case 0:
+                        // the right is taller now, the height of xParent is not changed
+                        xParent->balFactor_ = 1;
+                        return z;
+                    case 1: {
+                        // the right is 2 layers taller, shorten it
+                        NodePtr a = xParent->right_;
+                        if (a->balFactor_ == -1) {
+                            _rotateRightLeft(xParent, root());
                         } else {
-                            _rotateRight(xParent, root());
+                            _rotateLeft(xParent, root());
                         }
-                        // percolate up
-                        x = xParent->parent_;
-                        xParent = xParent->parent_->parent_;
-                        if (x->balFactor_ == 1) {
+                        x = xParent->parent_; // the new top of the sub-tree
+                        if (x->balFactor_ == -1) { // the height is not changed
                             return z;
                         }
+                        break;
                     }
-                    break;
-                case 1:
-                    // right sub-tree taller
-                    if (x == xParent->right_) {
+                    default:
+                        assert(false);
+                }
+            } else {    // same as above, with right <-> left.
+                switch (xParent->balFactor_) {
+                    case 1:
                         xParent->balFactor_ = 0;
                         x = xParent;
-                        xParent = xParent->parent_;
-                    } else {
-                        NodePtr a = xParent->right_;
-                        if (a->balFactor_ == -1) {
-                            _rotateRightLeft(xParent, root());
+                        break;
+                    case 0:
+                        xParent->balFactor_ = -1;
+                        return z;
+                    case -1: {
+                        NodePtr a = xParent->left_;
+                        if (a->balFactor_ == 1) {
+                            _rotateLeftRight(xParent, root());
                         } else {
-                            _rotateLeft(xParent, root());
+                            _rotateRight(xParent, root());
                         }
                         x = xParent->parent_;
-                        xParent = xParent->parent_->parent_;
-                        if (x->balFactor_ == -1) {
+                        if (x->balFactor_ == 1) {
                             return z;
                         }
+                        break;
                     }
-                    break;
-                default:
-                    assert(false);
+                    default:
+                        assert(false);
+                }
             }
+            // percolate up
+            xParent = x->parent_;
+            isLeft = (x == xParent->left_);
         }
         return z;
     }
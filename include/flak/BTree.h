@@ -0,0 +1,766 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// BTree is an ordered tree of unique keys that keeps many values in a node.
+// The values of a node are stored next to each other, so a search reads a
+// few cache lines per level, and there are only a parent pointer and one
+// child pointer per value in the internal nodes, instead of three pointers
+// and a color per value as in RBTree:
+//
+//            [ 20 | 40 ]                 internal node: values and children
+//           /     |     \                  children: one more than the values
+//   [5|10|15]  [25|30]  [45|50|55|60]    leaf nodes: values only
+//
+// NodeSize is the size of a node in bytes, the number of values of a node
+// (node_slots) is derived from it. Every node but the root has at least
+// min_slots values.
+//
+// Unlike RBTree, insert and erase move the values inside and between the
+// nodes, so they invalidate all iterators.
+
+#ifndef FLAK_BTREE_H
+#define FLAK_BTREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+using std::bidirectional_iterator_tag;
+using std::pair;
+
+namespace flak {
+
+// the number of values in a node of [NodeSize] bytes, at least 3
+template<class Val, size_t NodeSize>
+struct BTreeSlots {
+    static const size_t header_size = sizeof(void*) + 8;
+    static const size_t fit = NodeSize > header_size ? (NodeSize - header_size) / sizeof(Val) : 0;
+    static const size_t value = fit < 3 ? 3 : (fit > 65535 ? 65535 : fit);
+};
+
+template<class Val, size_t Slots>
+struct BTreeNode {
+    typedef BTreeNode<Val, Slots>* NodePtr;
+
+    NodePtr parent_;
+    unsigned short position_;  // the index in the children of the parent
+    unsigned short count_;     // the number of values
+    bool leaf_;
+    typename std::aligned_storage<sizeof(Val), alignof(Val)>::type values_[Slots];
+
+    Val* value(size_t i) { return reinterpret_cast<Val*>(&values_[i]); }
+
+    const Val* value(size_t i) const { return reinterpret_cast<const Val*>(&values_[i]); }
+};
+
+template<class Val, size_t Slots>
+struct BTreeInternalNode : public BTreeNode<Val, Slots> {
+    BTreeNode<Val, Slots>* children_[Slots + 1];
+};
+
+// points to the value [position_] of [node_],
+// end() is the position behind the last value of the rightmost leaf
+template<typename T, typename Ref, typename Ptr, size_t Slots>
+struct BTreeIterator {
+    typedef T value_type;
+    typedef Ptr pointer;
+    typedef Ref reference;
+    typedef ptrdiff_t difference_type;
+    typedef bidirectional_iterator_tag iterator_category;
+
+    typedef BTreeIterator<T, Ref, Ptr, Slots> Self;
+    typedef BTreeIterator<T, T&, T*, Slots> Iterator;
+    typedef BTreeNode<T, Slots>* NodePtr;
+    typedef BTreeInternalNode<T, Slots>* InternalPtr;
+
+    NodePtr node_;
+    size_t position_;
+
+    BTreeIterator() : node_(nullptr), position_(0) {}
+
+    BTreeIterator(NodePtr node, size_t position) : node_(node), position_(position) {}
+
+    BTreeIterator(const Self&) = default;
+
+    Self& operator=(const Self&) = default;
+
+    // iterator to const_iterator
+    template<class R, class P, class = typename std::enable_if<
+            std::is_same<BTreeIterator<T, R, P, Slots>, Iterator>::value>::type>
+    BTreeIterator(const BTreeIterator<T, R, P, Slots>& x) : node_(x.node_), position_(x.position_) {}
+
+    void increment() {
+        if (!node_->leaf_) {
+            // the leftmost value of the right subtree
+            node_ = static_cast<InternalPtr>(node_)->children_[position_ + 1];
+            while (!node_->leaf_) {
+                node_ = static_cast<InternalPtr>(node_)->children_[0];
+            }
+            position_ = 0;
+            return;
+        }
+        if (++position_ < node_->count_) {
+            return;
+        }
+        // the first ancestor that has a value on the right
+        NodePtr x = node_;
+        size_t pos = position_;
+        while (pos == x->count_ && x->parent_) {
+            pos = x->position_;
+            x = x->parent_;
+        }
+        if (pos < x->count_) {
+            node_ = x;
+            position_ = pos;
+        } // else it is end(), stay behind the last value
+    }
+
+    void decrement() {
+        if (!node_->leaf_) {
+            // the rightmost value of the left subtree
+            node_ = static_cast<InternalPtr>(node_)->children_[position_];
+            while (!node_->leaf_) {
+                node_ = static_cast<InternalPtr>(node_)->children_[node_->count_];
+            }
+            position_ = node_->count_ - 1;
+            return;
+        }
+        if (position_ > 0) {
+            --position_;
+            return;
+        }
+        NodePtr x = node_;
+        size_t pos = 0;
+        while (pos == 0 && x->parent_) {
+            pos = x->position_;
+            x = x->parent_;
+        }
+        if (pos > 0) {
+            node_ = x;
+            position_ = pos - 1;
+        }
+    }
+
+    reference operator*() const { return *node_->value(position_); }
+
+    pointer operator->() const { return &(operator*()); }
+
+    Self& operator++() {
+        increment();
+        return *this;
+    }
+
+    Self operator++(int) {
+        Self tmp = *this;
+        increment();
+        return tmp;
+    }
+
+    Self& operator--() {
+        decrement();
+        return *this;
+    }
+
+    Self operator--(int) {
+        Self tmp = *this;
+        decrement();
+        return tmp;
+    }
+
+    bool operator==(const Self& x) const { return node_ == x.node_ && position_ == x.position_; }
+
+    bool operator!=(const Self& x) const { return !(*this == x); }
+};
+
+template<typename Key, typename Val, typename KeyOfValue,
+        typename Compare, typename Alloc = std::allocator<Val>, size_t NodeSize = 256>
+class BTree {
+public:
+    typedef Key key_type;
+    typedef Val value_type;
+    typedef Val* pointer;
+    typedef const Val* const_pointer;
+    typedef Val& reference;
+    typedef const Val& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    static const size_type node_slots = BTreeSlots<Val, NodeSize>::value;
+    static const size_type min_slots = (node_slots - 1) / 2;
+
+protected:
+    typedef BTreeNode<Val, node_slots> Node;
+    typedef BTreeInternalNode<Val, node_slots> InternalNode;
+    typedef Node* NodePtr;
+    typedef InternalNode* InternalPtr;
+
+    typedef typename Alloc::template rebind<Val>::other ValueAlloc;
+    typedef std::allocator_traits<ValueAlloc> ValueAllocTraits;
+    typedef typename ValueAllocTraits::template rebind_alloc<Node> LeafAlloc;
+    typedef std::allocator_traits<LeafAlloc> LeafAllocTraits;
+    typedef typename ValueAllocTraits::template rebind_alloc<InternalNode> InternalAlloc;
+    typedef std::allocator_traits<InternalAlloc> InternalAllocTraits;
+
+    typedef BTree<Key, Val, KeyOfValue, Compare, Alloc, NodeSize> Self;
+
+public:
+    typedef BTreeIterator<value_type, reference, pointer, node_slots> iterator;
+    typedef BTreeIterator<value_type, const_reference, const_pointer, node_slots> const_iterator;
+
+protected:
+    NodePtr root_;
+    NodePtr leftmost_;
+    NodePtr rightmost_;
+    size_type size_;
+    Compare keyCompare_;
+    ValueAlloc valloc;
+    LeafAlloc lalloc;
+    InternalAlloc ialloc;
+
+public:
+    explicit BTree(const Compare& comp = Compare())
+            : root_(nullptr), leftmost_(nullptr), rightmost_(nullptr), size_(0), keyCompare_(comp) {}
+
+    BTree(const Self& x) : BTree(x.keyCompare_) {
+        if (x.root_) {
+            root_ = _clone(x.root_, nullptr);
+            size_ = x.size_;
+            _resetEnds();
+        }
+    }
+
+    Self& operator=(const Self& x) {
+        if (this != &x) {
+            clear();
+            keyCompare_ = x.keyCompare_;
+            if (x.root_) {
+                root_ = _clone(x.root_, nullptr);
+                size_ = x.size_;
+                _resetEnds();
+            }
+        }
+        return *this;
+    }
+
+    ~BTree() { clear(); }
+
+    Compare key_comp() const { return keyCompare_; }
+
+    iterator begin() { return iterator(leftmost_, 0); }
+
+    const_iterator begin() const { return const_iterator(leftmost_, 0); }
+
+    iterator end() { return iterator(rightmost_, rightmost_ ? rightmost_->count_ : 0); }
+
+    const_iterator end() const { return const_iterator(rightmost_, rightmost_ ? rightmost_->count_ : 0); }
+
+    bool empty() const { return size_ == 0; }
+
+    size_type size() const { return size_; }
+
+    size_type max_size() const { return size_type(-1); }
+
+    void clear() {
+        if (root_) {
+            _destroy(root_);
+            root_ = leftmost_ = rightmost_ = nullptr;
+            size_ = 0;
+        }
+    }
+
+    void swap(Self& x) {
+        std::swap(root_, x.root_);
+        std::swap(leftmost_, x.leftmost_);
+        std::swap(rightmost_, x.rightmost_);
+        std::swap(size_, x.size_);
+        std::swap(keyCompare_, x.keyCompare_);
+    }
+
+    // the number of levels, 0 if it is empty
+    size_type height() const {
+        size_type h = 0;
+        for (NodePtr x = root_; x; x = x->leaf_ ? nullptr : _child(x, 0)) {
+            h++;
+        }
+        return h;
+    }
+
+public:
+    pair<iterator, bool> insertUnique(const Val& v) { return _insertUnique(v); }
+
+    pair<iterator, bool> insertUnique(Val&& v) { return _insertUnique(std::move(v)); }
+
+    // the position depends on the key, so the value is built on the stack
+    template<class... Args>
+    pair<iterator, bool> emplaceUnique(Args&&... args) {
+        return _insertUnique(Val(std::forward<Args>(args)...));
+    }
+
+    template<class InputIterator>
+    void insertUnique(InputIterator first, InputIterator last) {
+        for (; first != last; ++first) {
+            insertUnique(*first);
+        }
+    }
+
+    iterator find(const Key& k) {
+        const_iterator it = static_cast<const Self*>(this)->find(k);
+        return iterator(it.node_, it.position_);
+    }
+
+    const_iterator find(const Key& k) const {
+        const_iterator it = lowerBound(k);
+        if (it == end() || keyCompare_(k, _key(it.node_, it.position_))) {
+            return end();
+        }
+        return it;
+    }
+
+    size_type count(const Key& k) const { return find(k) == end() ? 0 : 1; }
+
+    // the first value whose key is not less than [k]
+    const_iterator lowerBound(const Key& k) const {
+        const_iterator res = end();
+        NodePtr x = root_;
+        while (x) {
+            size_type i = _lowerBoundInNode(x, k);
+            if (i < x->count_) {
+                res = const_iterator(x, i);
+                if (!keyCompare_(k, _key(x, i))) { // equal, the keys are unique
+                    return res;
+                }
+            }
+            x = x->leaf_ ? nullptr : _child(x, i);
+        }
+        return res;
+    }
+
+    iterator lowerBound(const Key& k) {
+        const_iterator it = static_cast<const Self*>(this)->lowerBound(k);
+        return iterator(it.node_, it.position_);
+    }
+
+    // the first value whose key is greater than [k]
+    const_iterator upperBound(const Key& k) const {
+        const_iterator res = end();
+        NodePtr x = root_;
+        while (x) {
+            size_type i = _upperBoundInNode(x, k);
+            if (i < x->count_) {
+                res = const_iterator(x, i);
+            }
+            x = x->leaf_ ? nullptr : _child(x, i);
+        }
+        return res;
+    }
+
+    iterator upperBound(const Key& k) {
+        const_iterator it = static_cast<const Self*>(this)->upperBound(k);
+        return iterator(it.node_, it.position_);
+    }
+
+    pair<iterator, iterator> equalRange(const Key& k) {
+        return pair<iterator, iterator>(lowerBound(k), upperBound(k));
+    }
+
+    pair<const_iterator, const_iterator> equalRange(const Key& k) const {
+        return pair<const_iterator, const_iterator>(lowerBound(k), upperBound(k));
+    }
+
+    void erase(iterator pos) { _erase(pos.node_, pos.position_); }
+
+    size_type erase(const Key& k) {
+        iterator it = find(k);
+        if (it == end()) {
+            return 0;
+        }
+        erase(it);
+        return 1;
+    }
+
+    // The iterators are invalid after an erase,
+    // so the next value is found again by its key.
+    void erase(iterator first, iterator last) {
+        if (first == begin() && last == end()) {
+            clear();
+            return;
+        }
+        size_type n = 0;
+        for (iterator it = first; it != last; ++it) {
+            n++;
+        }
+        while (n-- > 0) {
+            iterator next = first;
+            ++next;
+            if (n == 0 || next == end()) {
+                erase(first);
+                return;
+            }
+            Key k = KeyOfValue()(*next);
+            erase(first);
+            first = lowerBound(k);
+        }
+    }
+
+    bool operator==(const Self& x) const {
+        return size() == x.size() && std::equal(begin(), end(), x.begin());
+    }
+
+    bool operator<(const Self& x) const {
+        return std::lexicographical_compare(begin(), end(), x.begin(), x.end());
+    }
+
+private:
+    static InternalPtr _internal(NodePtr x) { return static_cast<InternalPtr>(x); }
+
+    static NodePtr& _child(NodePtr x, size_type i) { return _internal(x)->children_[i]; }
+
+    static const Key& _key(NodePtr x, size_type i) { return KeyOfValue()(*x->value(i)); }
+
+    size_type _lowerBoundInNode(NodePtr x, const Key& k) const {
+        size_type lo = 0, hi = x->count_;
+        while (lo < hi) {
+            size_type mid = (lo + hi) / 2;
+            if (keyCompare_(_key(x, mid), k)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    size_type _upperBoundInNode(NodePtr x, const Key& k) const {
+        size_type lo = 0, hi = x->count_;
+        while (lo < hi) {
+            size_type mid = (lo + hi) / 2;
+            if (keyCompare_(k, _key(x, mid))) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    }
+
+    NodePtr _newLeaf() {
+        NodePtr x = LeafAllocTraits::allocate(lalloc, 1);
+        x->parent_ = nullptr;
+        x->position_ = 0;
+        x->count_ = 0;
+        x->leaf_ = true;
+        return x;
+    }
+
+    InternalPtr _newInternal() {
+        InternalPtr x = InternalAllocTraits::allocate(ialloc, 1);
+        x->parent_ = nullptr;
+        x->position_ = 0;
+        x->count_ = 0;
+        x->leaf_ = false;
+        return x;
+    }
+
+    // free a node whose values are destroyed or moved away
+    void _freeNode(NodePtr x) {
+        if (x->leaf_) {
+            LeafAllocTraits::deallocate(lalloc, x, 1);
+        } else {
+            InternalAllocTraits::deallocate(ialloc, _internal(x), 1);
+        }
+    }
+
+    void _destroyValue(NodePtr x, size_type i) {
+        ValueAllocTraits::destroy(valloc, x->value(i));
+    }
+
+    // move the value [i] of [src] to the empty slot [j] of [dst]
+    void _moveValue(NodePtr dst, size_type j, NodePtr src, size_type i) {
+        ValueAllocTraits::construct(valloc, dst->value(j), std::move(*src->value(i)));
+        _destroyValue(src, i);
+    }
+
+    void _setChild(NodePtr x, size_type i, NodePtr c) {
+        _child(x, i) = c;
+        c->parent_ = x;
+        c->position_ = (unsigned short) i;
+    }
+
+    void _destroy(NodePtr x) {
+        if (!x->leaf_) {
+            for (size_type i = 0; i <= x->count_; i++) {
+                _destroy(_child(x, i));
+            }
+        }
+        for (size_type i = 0; i < x->count_; i++) {
+            _destroyValue(x, i);
+        }
+        _freeNode(x);
+    }
+
+    NodePtr _clone(NodePtr x, NodePtr parent) {
+        NodePtr y = x->leaf_ ? _newLeaf() : _newInternal();
+        y->parent_ = parent;
+        y->position_ = x->position_;
+        try {
+            for (; y->count_ < x->count_; y->count_++) {
+                ValueAllocTraits::construct(valloc, y->value(y->count_), *x->value(y->count_));
+            }
+            if (!x->leaf_) {
+                for (size_type i = 0; i <= x->count_; i++) {
+                    _child(y, i) = nullptr;
+                }
+                for (size_type i = 0; i <= x->count_; i++) {
+                    _child(y, i) = _clone(_child(x, i), y);
+                }
+            }
+        } catch (...) {
+            if (!y->leaf_) {
+                for (size_type i = 0; i <= y->count_ && _child(y, i); i++) {
+                    _destroy(_child(y, i));
+                }
+            }
+            for (size_type i = 0; i < y->count_; i++) {
+                _destroyValue(y, i);
+            }
+            _freeNode(y);
+            throw;
+        }
+        return y;
+    }
+
+    void _resetEnds() {
+        leftmost_ = rightmost_ = root_;
+        while (!leftmost_->leaf_) {
+            leftmost_ = _child(leftmost_, 0);
+        }
+        while (!rightmost_->leaf_) {
+            rightmost_ = _child(rightmost_, rightmost_->count_);
+        }
+    }
+
+    template<class V>
+    pair<iterator, bool> _insertUnique(V&& v) {
+        const Key& k = KeyOfValue()(v);
+        if (!root_) {
+            root_ = leftmost_ = rightmost_ = _newLeaf();
+        }
+        NodePtr x = root_;
+        size_type i;
+        while (true) {
+            i = _lowerBoundInNode(x, k);
+            if (i < x->count_ && !keyCompare_(k, _key(x, i))) {
+                return pair<iterator, bool>(iterator(x, i), false);
+            }
+            if (x->leaf_) {
+                break;
+            }
+            x = _child(x, i);
+        }
+        return pair<iterator, bool>(_insertInLeaf(x, i, std::forward<V>(v)), true);
+    }
+
+    // insert [v] at [i] of the leaf [x], split it first if it is full
+    template<class V>
+    iterator _insertInLeaf(NodePtr x, size_type i, V&& v) {
+        if (x->count_ == node_slots) {
+            NodePtr s = _split(x);
+            if (i > x->count_) {
+                i -= x->count_ + 1;
+                x = s;
+            }
+        }
+        for (size_type j = x->count_; j > i; j--) {
+            _moveValue(x, j, x, j - 1);
+        }
+        try {
+            ValueAllocTraits::construct(valloc, x->value(i), std::forward<V>(v));
+        } catch (...) {
+            for (size_type j = i; j < x->count_; j++) {
+                _moveValue(x, j, x, j + 1);
+            }
+            throw;
+        }
+        x->count_++;
+        size_++;
+        return iterator(x, i);
+    }
+
+    // Split the full node [x]: the upper half of the values moves to a new
+    // right sibling, and the middle value moves up to the parent.
+    // A full parent is split first. Return the new sibling.
+    NodePtr _split(NodePtr x) {
+        if (x == root_) {
+            InternalPtr r = _newInternal();
+            _setChild(r, 0, x);
+            root_ = r;
+        }
+        if (x->parent_->count_ == node_slots) {
+            _split(x->parent_); // x may move to the new sibling of its parent
+        }
+        NodePtr p = x->parent_;
+        const size_type m = node_slots / 2;
+        NodePtr s = x->leaf_ ? _newLeaf() : _newInternal();
+        for (size_type j = m + 1; j < node_slots; j++) {
+            _moveValue(s, j - m - 1, x, j);
+        }
+        if (!x->leaf_) {
+            for (size_type j = m + 1; j <= node_slots; j++) {
+                _setChild(s, j - m - 1, _child(x, j));
+            }
+        }
+        s->count_ = (unsigned short) (node_slots - m - 1);
+
+        // make room for the middle value and s in the parent
+        const size_type pos = x->position_;
+        for (size_type j = p->count_; j > pos; j--) {
+            _moveValue(p, j, p, j - 1);
+            _setChild(p, j + 1, _child(p, j));
+        }
+        _moveValue(p, pos, x, m);
+        _setChild(p, pos + 1, s);
+        p->count_++;
+        x->count_ = (unsigned short) m;
+        if (x == rightmost_) {
+            rightmost_ = s;
+        }
+        return s;
+    }
+
+    void _erase(NodePtr x, size_type i) {
+        _destroyValue(x, i);
+        if (!x->leaf_) {
+            // replace it by the previous value, which is in a leaf
+            NodePtr l = _child(x, i);
+            while (!l->leaf_) {
+                l = _child(l, l->count_);
+            }
+            _moveValue(x, i, l, l->count_ - 1);
+            l->count_--;
+            x = l;
+        } else {
+            for (size_type j = i + 1; j < x->count_; j++) {
+                _moveValue(x, j - 1, x, j);
+            }
+            x->count_--;
+        }
+        size_--;
+        _rebalance(x);
+    }
+
+    // fill up the node [x] that may have less than min_slots values,
+    // by borrowing a value from a sibling or merging with it
+    void _rebalance(NodePtr x) {
+        while (x != root_ && x->count_ < min_slots) {
+            NodePtr p = x->parent_;
+            const size_type pos = x->position_;
+            NodePtr left = pos > 0 ? _child(p, pos - 1) : nullptr;
+            NodePtr right = pos < p->count_ ? _child(p, pos + 1) : nullptr;
+            if (left && left->count_ > min_slots) {
+                _borrowFromLeft(x, left, p, pos);
+                return;
+            }
+            if (right && right->count_ > min_slots) {
+                _borrowFromRight(x, right, p, pos);
+                return;
+            }
+            if (left) {
+                _merge(left, x, p, pos - 1);
+            } else {
+                _merge(x, right, p, pos);
+            }
+            x = p;
+        }
+        if (x == root_ && x->count_ == 0) {
+            if (x->leaf_) {
+                root_ = leftmost_ = rightmost_ = nullptr;
+            } else {
+                root_ = _child(x, 0);
+                root_->parent_ = nullptr;
+                root_->position_ = 0;
+            }
+            _freeNode(x);
+        }
+    }
+
+    //      p: [ a | b ]          [ a | e ]
+    //          /  |             /  |
+    //  [c|d|e]  [x..]   =>  [c|d]  [b|x..]
+    void _borrowFromLeft(NodePtr x, NodePtr left, NodePtr p, size_type pos) {
+        for (size_type j = x->count_; j > 0; j--) {
+            _moveValue(x, j, x, j - 1);
+        }
+        _moveValue(x, 0, p, pos - 1);
+        _moveValue(p, pos - 1, left, left->count_ - 1);
+        if (!x->leaf_) {
+            for (size_type j = x->count_ + 1; j > 0; j--) {
+                _setChild(x, j, _child(x, j - 1));
+            }
+            _setChild(x, 0, _child(left, left->count_));
+        }
+        left->count_--;
+        x->count_++;
+    }
+
+    void _borrowFromRight(NodePtr x, NodePtr right, NodePtr p, size_type pos) {
+        _moveValue(x, x->count_, p, pos);
+        _moveValue(p, pos, right, 0);
+        for (size_type j = 1; j < right->count_; j++) {
+            _moveValue(right, j - 1, right, j);
+        }
+        if (!x->leaf_) {
+            _setChild(x, x->count_ + 1, _child(right, 0));
+            for (size_type j = 1; j <= right->count_; j++) {
+                _setChild(right, j - 1, _child(right, j));
+            }
+        }
+        right->count_--;
+        x->count_++;
+    }
+
+    // move the separator [sep] of [p] and all of [right] into [left], free [right]
+    void _merge(NodePtr left, NodePtr right, NodePtr p, size_type sep) {
+        const size_type n = left->count_;
+        _moveValue(left, n, p, sep);
+        for (size_type j = 0; j < right->count_; j++) {
+            _moveValue(left, n + 1 + j, right, j);
+        }
+        if (!left->leaf_) {
+            for (size_type j = 0; j <= right->count_; j++) {
+                _setChild(left, n + 1 + j, _child(right, j));
+            }
+        }
+        left->count_ = (unsigned short) (n + 1 + right->count_);
+
+        for (size_type j = sep + 1; j < p->count_; j++) {
+            _moveValue(p, j - 1, p, j);
+            _setChild(p, j, _child(p, j + 1));
+        }
+        p->count_--;
+        if (right == rightmost_) {
+            rightmost_ = left;
+        }
+        _freeNode(right);
+    }
+};
+
+}
+
+#endif //FLAK_BTREE_H
@@ -0,0 +1,158 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef FLAK_BTREE_MAP_H
+#define FLAK_BTREE_MAP_H
+
+#include <functional>
+#include <tuple>
+#include "BTree.h"
+
+namespace flak {
+
+// A Map on a BTree, see BTree.h for NodeSize.
+// insert and erase invalidate all iterators.
+template<class Key, class T,
+        class Compare = std::less<Key>,
+        class Alloc = std::allocator<pair<const Key, T>>,
+        size_t NodeSize = 256>
+class BTreeMap {
+public:
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef pair<const Key, T> value_type;
+    typedef Compare key_compare;
+
+    typedef typename Alloc::template rebind<value_type>::other PairValueAlloc;
+
+private:
+    typedef BTree<key_type, value_type, std::_Select1st<value_type>,
+            key_compare, PairValueAlloc, NodeSize> rep_type;
+
+    rep_type t_;
+
+public:
+    typedef typename rep_type::pointer pointer;
+    typedef typename rep_type::reference reference;
+    typedef typename rep_type::const_pointer const_pointer;
+    typedef typename rep_type::const_reference const_reference;
+    typedef typename rep_type::iterator iterator;
+    typedef typename rep_type::const_iterator const_iterator;
+    typedef typename rep_type::size_type size_type;
+    typedef typename rep_type::difference_type difference_type;
+
+    typedef BTreeMap<Key, T, Compare, Alloc, NodeSize> Self;
+
+    static const size_type node_slots = rep_type::node_slots;
+
+    BTreeMap() : t_(Compare()) {}
+
+    explicit BTreeMap(const Compare& comp) : t_(comp) {}
+
+    template<class InputIterator>
+    BTreeMap(InputIterator first, InputIterator last) : t_(Compare()) {
+        t_.insertUnique(first, last);
+    }
+
+    key_compare key_comp() const { return t_.key_comp(); }
+
+    iterator begin() { return t_.begin(); }
+
+    const_iterator begin() const { return t_.begin(); }
+
+    iterator end() { return t_.end(); }
+
+    const_iterator end() const { return t_.end(); }
+
+    bool empty() const { return t_.empty(); }
+
+    size_type size() const { return t_.size(); }
+
+    size_type max_size() const { return t_.max_size(); }
+
+    size_type height() const { return t_.height(); }
+
+    T& operator[](const Key& k) {
+        return tryEmplace(k).first->second;
+    }
+
+    void swap(Self& x) { t_.swap(x.t_); }
+
+    pair<iterator, bool> insert(const value_type& x) {
+        return t_.insertUnique(x);
+    }
+
+    pair<iterator, bool> insert(value_type&& x) {
+        return t_.insertUnique(std::move(x));
+    }
+
+    template<class InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+        t_.insertUnique(first, last);
+    }
+
+    // construct the element in place
+    template<class... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        return t_.emplaceUnique(std::forward<Args>(args)...);
+    }
+
+    // construct the mapped value from [args] only if [k] does not exist
+    template<class... Args>
+    pair<iterator, bool> tryEmplace(const Key& k, Args&&... args) {
+        iterator it = find(k);
+        if (it != end()) {
+            return pair<iterator, bool>(it, false);
+        }
+        return t_.emplaceUnique(std::piecewise_construct, std::forward_as_tuple(k),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    void erase(iterator pos) { t_.erase(pos); }
+
+    size_type erase(const Key& k) { return t_.erase(k); }
+
+    void erase(iterator first, iterator last) { t_.erase(first, last); }
+
+    void clear() { t_.clear(); }
+
+    iterator find(const Key& k) { return t_.find(k); }
+
+    const_iterator find(const Key& k) const { return t_.find(k); }
+
+    size_type count(const Key& k) const { return t_.count(k); }
+
+    iterator lowerBound(const Key& k) { return t_.lowerBound(k); }
+
+    const_iterator lowerBound(const Key& k) const { return t_.lowerBound(k); }
+
+    iterator upperBound(const Key& k) { return t_.upperBound(k); }
+
+    const_iterator upperBound(const Key& k) const { return t_.upperBound(k); }
+
+    pair<iterator, iterator> equalRange(const Key& k) { return t_.equalRange(k); }
+
+    pair<const_iterator, const_iterator> equalRange(const Key& k) const { return t_.equalRange(k); }
+
+    bool operator==(const Self& x) const { return t_ == x.t_; }
+
+    bool operator<(const Self& x) const { return t_ < x.t_; }
+};
+
+}
+
+#endif //FLAK_BTREE_MAP_H
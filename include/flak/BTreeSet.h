@@ -0,0 +1,130 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef FLAK_BTREE_SET_H
+#define FLAK_BTREE_SET_H
+
+#include <functional>
+#include "BTree.h"
+
+namespace flak {
+
+// A Set on a BTree, see BTree.h for NodeSize.
+// insert and erase invalidate all iterators.
+template<class Key, class Compare = std::less<Key>, class Alloc = std::allocator<Key>, size_t NodeSize = 256>
+class BTreeSet {
+public:
+    typedef Key key_type;
+    typedef Key value_type;
+    typedef Compare key_compare;
+    typedef Compare value_compare;
+
+private:
+    typedef BTree<key_type, value_type, std::_Identity<value_type>,
+            key_compare, Alloc, NodeSize> rep_type;
+
+    rep_type t_;
+
+public:
+    // all types are const
+    typedef typename rep_type::const_pointer pointer;
+    typedef typename rep_type::const_pointer const_pointer;
+    typedef typename rep_type::const_reference reference;
+    typedef typename rep_type::const_reference const_reference;
+    typedef typename rep_type::const_iterator iterator;
+    typedef typename rep_type::const_iterator const_iterator;
+    typedef typename rep_type::size_type size_type;
+    typedef typename rep_type::difference_type difference_type;
+
+    typedef BTreeSet<Key, Compare, Alloc, NodeSize> Self;
+
+    static const size_type node_slots = rep_type::node_slots;
+
+    BTreeSet() : t_(Compare()) {}
+
+    explicit BTreeSet(const Compare& comp) : t_(comp) {}
+
+    template<class InputIterator>
+    BTreeSet(InputIterator first, InputIterator last) : t_(Compare()) {
+        t_.insertUnique(first, last);
+    }
+
+    key_compare key_comp() const { return t_.key_comp(); }
+
+    iterator begin() const { return t_.begin(); }
+
+    iterator end() const { return t_.end(); }
+
+    bool empty() const { return t_.empty(); }
+
+    size_type size() const { return t_.size(); }
+
+    size_type max_size() const { return t_.max_size(); }
+
+    size_type height() const { return t_.height(); }
+
+    void swap(Self& x) { t_.swap(x.t_); }
+
+    void clear() { t_.clear(); }
+
+    pair<iterator, bool> insert(const value_type& x) {
+        return t_.insertUnique(x);
+    }
+
+    pair<iterator, bool> insert(value_type&& x) {
+        return t_.insertUnique(std::move(x));
+    }
+
+    template<class InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+        t_.insertUnique(first, last);
+    }
+
+    template<class... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        return t_.emplaceUnique(std::forward<Args>(args)...);
+    }
+
+    void erase(iterator pos) { t_.erase(_mutable(pos)); }
+
+    size_type erase(const key_type& x) { return t_.erase(x); }
+
+    void erase(iterator first, iterator last) { t_.erase(_mutable(first), _mutable(last)); }
+
+    iterator find(const key_type& x) const { return t_.find(x); }
+
+    size_type count(const key_type& x) const { return t_.count(x); }
+
+    iterator lowerBound(const key_type& x) const { return t_.lowerBound(x); }
+
+    iterator upperBound(const key_type& x) const { return t_.upperBound(x); }
+
+    pair<iterator, iterator> equalRange(const key_type& x) const { return t_.equalRange(x); }
+
+    bool operator==(const Self& x) const { return t_ == x.t_; }
+
+    bool operator<(const Self& x) const { return t_ < x.t_; }
+
+private:
+    static typename rep_type::iterator _mutable(iterator it) {
+        return typename rep_type::iterator(it.node_, it.position_);
+    }
+};
+
+}
+
+#endif //FLAK_BTREE_SET_H
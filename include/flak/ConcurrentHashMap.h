@@ -0,0 +1,299 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// ConcurrentHashMap is a hash map that can be shared by threads.
+// The keys are split into shards, each one is a HashTable with its own
+// reader/writer lock, so threads working on different shards do not wait:
+//
+//  mix(hash(key)) -> high bits pick the shard
+//
+//  shards : [ lock | HashTable ] [ lock | HashTable ] ... [ lock | HashTable ]
+//
+// Lookups take the shared lock of one shard, updates take the exclusive one.
+// There are no iterators, because they could not hold the lock.
+// The values are copied out instead, and forEach() visits a shard at a time.
+//
+// size() is read from an atomic counter without locking,
+// so it is only an estimate while other threads are updating.
+
+#ifndef FLAK_CONCURRENT_HASH_MAP_H
+#define FLAK_CONCURRENT_HASH_MAP_H
+
+#include "HashTable.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace flak {
+
+template<class Key, class Val,
+        class HashFcn = std::hash<Key>,
+        class EqualKey = std::equal_to<Key>,
+        class Alloc = std::allocator<Val>,
+        class BucketPolicy = PrimeBucketPolicy>
+class ConcurrentHashMap {
+private:
+    typedef HashTable<pair<const Key, Val>, Key, HashFcn,
+            std::_Select1st<pair<const Key, Val>>, EqualKey, Alloc, BucketPolicy> ht;
+
+    typedef std::shared_timed_mutex Mutex;
+    typedef std::shared_lock<Mutex> ReadLock;
+    typedef std::unique_lock<Mutex> WriteLock;
+
+    // the padding keeps the locks of neighbour shards on different cache lines
+    struct Shard {
+        mutable Mutex mutex_;
+        ht table_;
+        char pad_[64];
+
+        Shard(size_t n, const HashFcn& hf, const EqualKey& eql) : table_(n, hf, eql) {}
+
+        // the nodes are not freed by HashTable itself
+        ~Shard() { table_.clear(); }
+    };
+
+public:
+    typedef Key key_type;
+    typedef Val mapped_type;
+    typedef pair<const Key, Val> value_type;
+    typedef HashFcn hasher;
+    typedef EqualKey key_equal;
+    typedef size_t size_type;
+
+    static const size_type default_shards = 64;
+
+private:
+    hasher hash_;
+    size_type num_shards_;   // a power of two
+    int shift_;              // 64 - log2(num_shards_)
+    Shard* shards_;
+    std::atomic<size_type> num_elements_;
+
+public:
+    ConcurrentHashMap() : ConcurrentHashMap(default_shards) {}
+
+    // [shards] is rounded up to a power of two,
+    // [n] is the expected number of elements of the whole map
+    explicit ConcurrentHashMap(size_type shards, size_type n = 0,
+                               const hasher& hf = hasher(), const key_equal& eql = key_equal())
+            : hash_(hf), num_shards_(1), shift_(64), num_elements_(0) {
+        while (num_shards_ < shards) {
+            num_shards_ <<= 1;
+            --shift_;
+        }
+        // Shard is not movable, so construct them in place
+        shards_ = static_cast<Shard*>(::operator new(sizeof(Shard) * num_shards_));
+        for (size_type i = 0; i < num_shards_; i++) {
+            new (shards_ + i) Shard(n / num_shards_ + 1, hf, eql);
+        }
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    ~ConcurrentHashMap() {
+        for (size_type i = 0; i < num_shards_; i++) {
+            shards_[i].~Shard();
+        }
+        ::operator delete(shards_);
+    }
+
+public:
+    // an estimate while other threads are updating
+    size_type size() const { return num_elements_.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+    size_type shardCount() const { return num_shards_; }
+
+    // the buckets of all the shards
+    size_type bucketCount() const {
+        size_type n = 0;
+        for (size_type i = 0; i < num_shards_; i++) {
+            ReadLock lock(shards_[i].mutex_);
+            n += shards_[i].table_.bucketCount();
+        }
+        return n;
+    }
+
+    // the buckets holding at least one element, to check how the keys spread
+    size_type usedBucketCount() const {
+        size_type used = 0;
+        for (size_type i = 0; i < num_shards_; i++) {
+            ReadLock lock(shards_[i].mutex_);
+            const ht& table = shards_[i].table_;
+            std::vector<bool> seen(table.bucketCount());
+            for (auto it = table.begin(); it != table.end(); ++it) {
+                size_type b = BucketPolicy::index(hash_(it->first), seen.size());
+                used += !seen[b];
+                seen[b] = true;
+            }
+        }
+        return used;
+    }
+
+    hasher hashFunc() const { return hash_; }
+
+    // insert if the key does not exist, return whether it is inserted
+    bool insert(const value_type& obj) {
+        Shard& s = _shard(obj.first);
+        WriteLock lock(s.mutex_);
+        if (s.table_.insertUnique(obj).second) {
+            num_elements_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // insert or overwrite the value, return whether it is inserted
+    bool insertOrAssign(const key_type& key, const mapped_type& val) {
+        Shard& s = _shard(key);
+        WriteLock lock(s.mutex_);
+        auto p = s.table_.insertUnique(value_type(key, val));
+        if (p.second) {
+            num_elements_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            p.first->second = val;
+        }
+        return p.second;
+    }
+
+    // Return the value of [key]. If it does not exist,
+    // insert the value returned by f(key) first.
+    // f is called at most once, while the shard is locked.
+    template<class Function>
+    mapped_type computeIfAbsent(const key_type& key, Function f) {
+        Shard& s = _shard(key);
+        {
+            ReadLock lock(s.mutex_);
+            const ht& table = s.table_;
+            auto it = table.find(key);
+            if (it != table.end()) {
+                return it->second;
+            }
+        }
+        WriteLock lock(s.mutex_);
+        // another thread may insert it between the locks
+        auto it = s.table_.find(key);
+        if (it != s.table_.end()) {
+            return it->second;
+        }
+        auto p = s.table_.insertUnique(value_type(key, f(key)));
+        num_elements_.fetch_add(1, std::memory_order_relaxed);
+        return p.first->second;
+    }
+
+    // Call f(value) with the value of [key] while the shard is locked,
+    // return false if the key does not exist.
+    template<class Function>
+    bool computeIfPresent(const key_type& key, Function f) {
+        Shard& s = _shard(key);
+        WriteLock lock(s.mutex_);
+        auto it = s.table_.find(key);
+        if (it == s.table_.end()) {
+            return false;
+        }
+        f(it->second);
+        return true;
+    }
+
+    // copy the value of [key] to [val], return false if it does not exist
+    bool find(const key_type& key, mapped_type& val) const {
+        const Shard& s = _shard(key);
+        ReadLock lock(s.mutex_);
+        const ht& table = s.table_;
+        auto it = table.find(key);
+        if (it == table.end()) {
+            return false;
+        }
+        val = it->second;
+        return true;
+    }
+
+    bool contains(const key_type& key) const { return count(key) != 0; }
+
+    size_type count(const key_type& key) const {
+        const Shard& s = _shard(key);
+        ReadLock lock(s.mutex_);
+        return s.table_.count(key);
+    }
+
+    size_type erase(const key_type& key) {
+        Shard& s = _shard(key);
+        WriteLock lock(s.mutex_);
+        size_type n = s.table_.erase(key);
+        num_elements_.fetch_sub(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    // clear the shards one by one
+    void clear() {
+        for (size_type i = 0; i < num_shards_; i++) {
+            WriteLock lock(shards_[i].mutex_);
+            num_elements_.fetch_sub(shards_[i].table_.size(), std::memory_order_relaxed);
+            shards_[i].table_.clear();
+        }
+    }
+
+    // Call f(value) for every element, a shard is locked while it is visited.
+    // f must not use this map.
+    template<class Function>
+    void forEach(Function f) const {
+        for (size_type i = 0; i < num_shards_; i++) {
+            ReadLock lock(shards_[i].mutex_);
+            const ht& table = shards_[i].table_;
+            for (auto it = table.begin(); it != table.end(); ++it) {
+                f(*it);
+            }
+        }
+    }
+
+private:
+    Shard& _shard(const key_type& key) {
+        return shards_[_shardIndex(key)];
+    }
+
+    const Shard& _shard(const key_type& key) const {
+        return shards_[_shardIndex(key)];
+    }
+
+    // PowerOfTwoBucketPolicy takes the bucket from the top bits of the hash times
+    // 2^64 / golden ratio. The shard must not use the same bits, or a shard would
+    // only reach 1 / num_shards_ of its buckets, so the hash is mixed differently
+    // first, with the finalizer of MurmurHash3, and its top bits are the shard.
+    size_type _shardIndex(const key_type& key) const {
+        if (num_shards_ == 1) {
+            return 0;
+        }
+        uint64_t h = (uint64_t) hash_(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return (size_type) (h >> shift_);
+    }
+};
+
+}
+
+#endif //FLAK_CONCURRENT_HASH_MAP_H
@@ -0,0 +1,370 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// ConcurrentMap is an ordered map on an RBTree for many readers and few writers.
+// The writers take one mutex. The readers take no lock: they walk the tree
+// while it may change, and check a sequence number (a seqlock) to see
+// whether a writer was at work meanwhile, if so they walk again:
+//
+//  writer:  lock, seq_ odd, link / rotate / unlink, seq_ even, unlock
+//  reader:  s = seq_ (even), walk the tree, copy the value, seq_ == s ?
+//
+// A reader that fails a few times takes the mutex, so it cannot starve.
+//
+// For the walk to be safe while it races with a writer:
+//  - the writer stores the child links and the root with release stores,
+//    on every path this map drives (RBTree::_storeLink), and the walk reads
+//    them with acquire loads, so a new node is complete when it is reached
+//    and the walk never races with a plain store. parent_ and color_ are
+//    only read by the writer, which holds the mutex,
+//  - the values in the tree are never changed, insertOrAssign() links a new
+//    node in place of the old one, so a reader copies a value that is intact,
+//  - an unlinked node is not freed until the readers that could reach it are
+//    gone. The readers count themselves in one of two epochs, a writer frees
+//    the nodes unlinked before the current epoch once nobody is left in the
+//    epoch before it, and begins a new one.
+// The walk gives up after more steps than the tree can be high,
+// in case a rotation led it into a loop of stale links.
+//
+// Like ConcurrentHashMap, there are no iterators, the values are copied out.
+
+#ifndef FLAK_CONCURRENT_MAP_H
+#define FLAK_CONCURRENT_MAP_H
+
+#include "RBTree.h"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace flak {
+
+template<class Key, class T,
+        class Compare = std::less<Key>,
+        class Alloc = std::allocator<pair<const Key, T>>>
+class ConcurrentMap {
+public:
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef pair<const Key, T> value_type;
+    typedef Compare key_compare;
+    typedef size_t size_type;
+
+    // optimistic walks before a reader takes the mutex
+    static const int max_attempts = 8;
+
+private:
+    typedef RBTree<Key, value_type, std::_Select1st<value_type>, Compare, Alloc> Tree;
+    typedef typename Tree::NodePtr NodePtr;
+
+    // a red-black tree of 2^64 nodes is at most 128 high
+    static const size_t max_depth = 128;
+
+    // the padding keeps the counters of the epochs on different cache lines
+    struct Readers {
+        std::atomic<size_type> n_;
+        char pad_[64];
+
+        Readers() : n_(0) {}
+    };
+
+    // the epoch a reader counts itself in, while it is alive
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const ConcurrentMap& m) {
+            for (;;) {
+                size_type e = m.epoch_.load();
+                readers_ = &m.readers_[e & 1].n_;
+                readers_->fetch_add(1);
+                // the writer may have checked the counter before it is added
+                if (m.epoch_.load() == e) {
+                    break;
+                }
+                readers_->fetch_sub(1);
+            }
+        }
+
+        ~ReadGuard() { readers_->fetch_sub(1, std::memory_order_release); }
+
+    private:
+        std::atomic<size_type>* readers_;
+    };
+
+    mutable std::mutex mutex_;
+    Tree tree_;
+    std::atomic<size_type> seq_;        // odd while a writer changes the tree
+    std::atomic<size_type> size_;
+    mutable Readers readers_[2];        // the readers in the even and the odd epochs
+    std::atomic<size_type> epoch_;
+    std::vector<NodePtr> retired_;      // unlinked in this epoch
+    std::vector<NodePtr> pending_;      // unlinked before this epoch
+
+public:
+    explicit ConcurrentMap(const Compare& comp = Compare())
+            : tree_(comp), seq_(0), size_(0), epoch_(0) {}
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    // no reader can be left
+    ~ConcurrentMap() {
+        _free(pending_);
+        _free(retired_);
+    }
+
+public:
+    // an estimate while other threads are updating
+    size_type size() const { return size_.load(std::memory_order_relaxed); }
+
+    bool empty() const { return size() == 0; }
+
+    // insert if the key does not exist, return whether it is inserted
+    bool insert(const value_type& v) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        NodePtr y;
+        if (tree_._insertUniquePos(v.first, y)) {
+            return false;
+        }
+        _link(y, tree_.createNode(v));
+        return true;
+    }
+
+    // insert or overwrite the value, return whether it is inserted
+    bool insertOrAssign(const key_type& k, const mapped_type& val) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        NodePtr y;
+        NodePtr j = tree_._insertUniquePos(k, y);
+        NodePtr z = tree_.createNode(k, val);
+        if (j == nullptr) {
+            _link(y, z);
+            return true;
+        }
+        _replace(j, z);
+        return false;
+    }
+
+    size_type erase(const key_type& k) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        typename Tree::iterator it = tree_.find(k);
+        if (it == tree_.end()) {
+            return 0;
+        }
+        _beginWrite();
+        NodePtr z = tree_._rebalanceForErase(it.node_);
+        --tree_.nodeCount_;
+        _endWrite();
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        _retire(z);
+        return 1;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int h;
+        _beginWrite();
+        NodePtr x = tree_._detach(h);
+        _endWrite();
+        size_.store(0, std::memory_order_relaxed);
+        // retire the nodes in preorder
+        std::vector<NodePtr> stack;
+        if (x != nullptr) {
+            stack.push_back(x);
+        }
+        while (!stack.empty()) {
+            x = stack.back();
+            stack.pop_back();
+            if (x->left_) {
+                stack.push_back(x->left_);
+            }
+            if (x->right_) {
+                stack.push_back(x->right_);
+            }
+            retired_.push_back(x);
+        }
+        _reclaim();
+    }
+
+    // copy the value of [k] to [val], return false if it does not exist
+    bool find(const key_type& k, mapped_type& val) const {
+        return _read(k, [&](NodePtr x) {
+            if (x == nullptr || tree_.keyCompare_(k, Tree::key(x))) {
+                return false;
+            }
+            val = x->value_.second;
+            return true;
+        });
+    }
+
+    bool contains(const key_type& k) const { return count(k) != 0; }
+
+    size_type count(const key_type& k) const {
+        return _read(k, [&](NodePtr x) {
+            return x != nullptr && !tree_.keyCompare_(k, Tree::key(x));
+        });
+    }
+
+    // copy the first key not less than [k] and its value, return false if there is none
+    bool lowerBound(const key_type& k, key_type& key, mapped_type& val) const {
+        return _read(k, [&](NodePtr x) {
+            if (x == nullptr) {
+                return false;
+            }
+            key = x->value_.first;
+            val = x->value_.second;
+            return true;
+        });
+    }
+
+    // Call f(value) for every element in order, the writers wait meanwhile.
+    // f must not update this map.
+    template<class Function>
+    void forEach(Function f) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = tree_.begin(); it != tree_.end(); ++it) {
+            f(*it);
+        }
+    }
+
+private:
+    static NodePtr _load(const NodePtr& p) { return __atomic_load_n(&p, __ATOMIC_ACQUIRE); }
+
+    // The lowest node not less than [k], nullptr if there is none.
+    // [ok] is false if the walk was too long to be right.
+    NodePtr _lowerBound(const key_type& k, bool& ok) const {
+        NodePtr y = nullptr;
+        NodePtr x = _load(tree_.root());
+        for (size_t steps = 0; x != nullptr; steps++) {
+            if (steps == max_depth) {
+                ok = false;
+                return nullptr;
+            }
+            if (!tree_.keyCompare_(Tree::key(x), k)) {
+                y = x;
+                x = _load(x->left_);
+            } else {
+                x = _load(x->right_);
+            }
+        }
+        ok = true;
+        return y;
+    }
+
+    // Call visit() with the lowest node not less than [k] and return its result,
+    // which must not be kept before the walk is validated.
+    template<class Visit>
+    bool _read(const key_type& k, Visit visit) const {
+        ReadGuard guard(*this);
+        for (int attempt = 0; attempt < max_attempts; attempt++) {
+            size_type s = seq_.load(std::memory_order_acquire);
+            if (s & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            bool ok;
+            NodePtr x = _lowerBound(k, ok);
+            bool result = ok && visit(x);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (ok && seq_.load(std::memory_order_relaxed) == s) {
+                return result;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool ok;
+        return visit(_lowerBound(k, ok));
+    }
+
+    void _beginWrite() {
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void _endWrite() {
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // link the new node [z] under [y]
+    void _link(NodePtr y, NodePtr z) {
+        _beginWrite();
+        tree_._insertNode(nullptr, y, z);
+        _endWrite();
+        size_.fetch_add(1, std::memory_order_relaxed);
+        _reclaim();
+    }
+
+    // put the new node [z] in the place of [x] with the same key
+    void _replace(NodePtr x, NodePtr z) {
+        z->color_ = x->color_;
+        z->parent_ = x->parent_;
+        z->left_ = x->left_;
+        z->right_ = x->right_;
+        _beginWrite();
+        if (x->left_) {
+            x->left_->parent_ = z;
+        }
+        if (x->right_) {
+            x->right_->parent_ = z;
+        }
+        if (x == tree_.root()) {
+            Tree::_storeLink(tree_.root(), z);
+        } else if (x->parent_->left_ == x) {
+            Tree::_storeLink(x->parent_->left_, z);
+        } else {
+            Tree::_storeLink(x->parent_->right_, z);
+        }
+        if (x == tree_.leftmost()) {
+            tree_.leftmost() = z;
+        }
+        if (x == tree_.rightmost()) {
+            tree_.rightmost() = z;
+        }
+        _endWrite();
+        _retire(x);
+    }
+
+    void _retire(NodePtr x) {
+        retired_.push_back(x);
+        _reclaim();
+    }
+
+    // If nobody is left in the epoch before this one, free the nodes
+    // unlinked before this epoch and begin a new one.
+    void _reclaim() {
+        size_type e = epoch_.load(std::memory_order_relaxed);
+        if (readers_[(e + 1) & 1].n_.load() != 0) {
+            return;
+        }
+        _free(pending_);
+        pending_.swap(retired_);
+        epoch_.store(e + 1);
+    }
+
+    void _free(std::vector<NodePtr>& nodes) {
+        for (NodePtr x : nodes) {
+            tree_.destroyNode(x);
+        }
+        nodes.clear();
+    }
+};
+
+}
+
+#endif //FLAK_CONCURRENT_MAP_H
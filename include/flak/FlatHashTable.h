@@ -0,0 +1,654 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// FlatHashTable.
+// An open addressing hash table with linear probing.
+// You can learn it at https://en.wikipedia.org/wiki/Open_addressing .
+// The elements are stored in one contiguous slot array,
+// and every slot has a control byte that is either empty or a 7-bit tag of the hash.
+// the structure model like the below:
+//
+// ctrl  : [E, 5, 17, E, E, 99, 3, E]   (one byte per slot, E is empty)
+// slots : [ , a,  b,  ,  ,  c, d,  ]   (values, constructed only if full)
+//
+// The capacity is a power of two, so the home slot is taken from
+// the high bits of a fibonacci hashing product instead of a modulo.
+// Erasing uses backward shift deletion, so there are no tombstones
+// and a probe can always stop at the first empty slot.
+//
+// The probing is chosen by a policy:
+//  LinearProbe checks one control byte at a time.
+//  GroupProbe compares a group of 16 (SSE2) or 32 (AVX2) control bytes
+//  with the tag at once, so a miss is rejected without touching any slot.
+//  Without SSE2 the group is compared by a scalar loop.
+// The control array has width - 1 extra bytes mirroring the first ones,
+// so a group can be loaded from any slot without wrapping around.
+
+#ifndef FLAK_FLATHASHTABLE_H
+#define FLAK_FLATHASHTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::pair;
+
+namespace flak {
+
+// control byte of an empty slot, a full slot has the high bit cleared
+static const signed char flat_ctrl_empty = -128;
+
+// probe one slot at a time
+struct LinearProbe {
+    static const size_t width = 1;
+};
+
+// probe a group of control bytes at a time.
+// match() returns a bit mask, the i-th bit is set if ctrl[i] == c.
+struct GroupProbe {
+#if defined(__AVX2__)
+    static const size_t width = 32;
+
+    static std::uint32_t match(const signed char* ctrl, signed char c) {
+        __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl));
+        return static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(c))));
+    }
+#elif defined(__SSE2__)
+    static const size_t width = 16;
+
+    static std::uint32_t match(const signed char* ctrl, signed char c) {
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<std::uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c))));
+    }
+#else
+    static const size_t width = 16;
+
+    static std::uint32_t match(const signed char* ctrl, signed char c) {
+        std::uint32_t mask = 0;
+        for (size_t i = 0; i < width; i++) {
+            mask |= static_cast<std::uint32_t>(ctrl[i] == c) << i;
+        }
+        return mask;
+    }
+#endif
+
+    // index of the lowest set bit, [mask] is not 0
+    static size_t lowest(std::uint32_t mask) {
+        return static_cast<size_t>(__builtin_ctz(mask));
+    }
+};
+
+template<class Value, class Key, class HashFcn,
+        class ExtractKey, class EqualKey, class Alloc = std::allocator<Value>,
+        class Probe = LinearProbe>
+class FlatHashTable;
+
+template<class Value, class Key, class HashFcn,
+        class ExtractKey, class EqualKey, class Alloc, class Probe, class Ref, class Ptr>
+struct FlatHashTableIterator {
+    typedef FlatHashTable<Value, Key, HashFcn,
+            ExtractKey, EqualKey, Alloc, Probe> hashtable;
+    typedef FlatHashTableIterator<Value, Key, HashFcn,
+            ExtractKey, EqualKey, Alloc, Probe, Ref, Ptr> Self;
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Value value_type;
+    typedef ptrdiff_t difference_type;
+    typedef size_t size_type;
+    typedef Ref reference;
+    typedef Ptr pointer;
+
+    size_type idx_;
+    const hashtable* ht_;
+
+    FlatHashTableIterator(size_type idx, const hashtable* tab) : idx_(idx), ht_(tab) {}
+
+    FlatHashTableIterator() = default;
+
+    // the const iterator can be made from a normal iterator
+    template<class R, class P>
+    FlatHashTableIterator(const FlatHashTableIterator<Value, Key, HashFcn,
+            ExtractKey, EqualKey, Alloc, Probe, R, P>& it) : idx_(it.idx_), ht_(it.ht_) {}
+
+    reference operator*() const { return ht_->slots_[idx_]; }
+
+    pointer operator->() const { return &(operator*()); }
+
+    // skip the empty slots until the next full one or the end
+    Self& operator++() {
+        idx_ = ht_->_nextFull(idx_ + 1);
+        return *this;
+    }
+
+    Self operator++(int) {
+        Self tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    bool operator==(const Self& it) const { return idx_ == it.idx_ && ht_ == it.ht_; }
+
+    bool operator!=(const Self& it) const { return !(operator==(it)); }
+};
+
+template<class Value, class Key, class HashFcn,
+        class ExtractKey, class EqualKey, class Alloc, class Probe>
+class FlatHashTable {
+public:
+    typedef HashFcn hasher;
+    typedef Value value_type;
+    typedef Key key_type;
+    typedef EqualKey key_equal;
+
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef value_type* pointer;
+    typedef const value_type* const_pointer;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    typedef FlatHashTableIterator<Value, Key, HashFcn,
+            ExtractKey, EqualKey, Alloc, Probe, Value&, Value*> iterator;
+    typedef FlatHashTableIterator<Value, Key, HashFcn,
+            ExtractKey, EqualKey, Alloc, Probe, const Value&, const Value*> const_iterator;
+
+    friend struct FlatHashTableIterator<Value, Key, HashFcn,
+            ExtractKey, EqualKey, Alloc, Probe, Value&, Value*>;
+    friend struct FlatHashTableIterator<Value, Key, HashFcn,
+            ExtractKey, EqualKey, Alloc, Probe, const Value&, const Value*>;
+
+private:
+    typedef typename Alloc::template rebind<Value>::other ValueAlloc;
+    typedef std::allocator_traits<ValueAlloc> ValueAllocTraits;
+    typedef typename ValueAllocTraits::template rebind_alloc<signed char> CtrlAlloc;
+    typedef std::allocator_traits<CtrlAlloc> CtrlAllocTraits;
+
+    // smallest capacity of a non-empty table
+    static const size_type min_capacity = 8;
+
+    // the number of control bytes that mirror the first ones
+    static const size_type num_cloned = Probe::width - 1;
+
+    hasher hash_;
+    EqualKey equals_;
+    ExtractKey getKey_;
+
+    ValueAlloc valloc;
+    CtrlAlloc calloc;
+
+    signed char* ctrl_;
+    Value* slots_;
+    size_type capacity_;    // always a power of two
+    size_type shift_;       // 64 - log2(capacity_)
+    size_type num_elements_;
+
+public:
+    FlatHashTable(size_type n, const HashFcn& hf, const EqualKey& eql)
+            : hash_(hf), equals_(eql), getKey_(ExtractKey()),
+              ctrl_(nullptr), slots_(nullptr), capacity_(0), shift_(64), num_elements_(0) {
+        _allocate(_capacityFor(n));
+    }
+
+    FlatHashTable(const FlatHashTable& ht)
+            : hash_(ht.hash_), equals_(ht.equals_), getKey_(ht.getKey_),
+              ctrl_(nullptr), slots_(nullptr), capacity_(0), shift_(64), num_elements_(0) {
+        copyFrom(ht);
+    }
+
+    FlatHashTable& operator=(const FlatHashTable& ht) {
+        if (this != &ht) {
+            copyFrom(ht);
+        }
+        return *this;
+    }
+
+    ~FlatHashTable() {
+        clear();
+        _deallocate();
+    }
+
+    size_type bucketCount() const { return capacity_; }
+
+    size_type maxBucketCount() const { return size_type(1) << (sizeof(size_type) * 8 - 1); }
+
+    hasher hashFunc() const { return hash_; }
+
+    key_equal keyEq() const { return equals_; }
+
+    size_type size() const { return num_elements_; }
+
+    size_type max_size() const { return size_type(-1); }
+
+    bool empty() const { return size() == 0; }
+
+    iterator begin() { return iterator(_nextFull(0), this); }
+
+    const_iterator begin() const { return const_iterator(_nextFull(0), this); }
+
+    iterator end() { return iterator(capacity_, this); }
+
+    const_iterator end() const { return const_iterator(capacity_, this); }
+
+    iterator find(const Key& key) {
+        return iterator(_findIndex(key), this);
+    }
+
+    const_iterator find(const Key& key) const {
+        return const_iterator(_findIndex(key), this);
+    }
+
+    // Find [n] keys and put the results to [out], same as find() one by one.
+    // The home slots of the following keys are prefetched
+    // so the cache misses of independent keys overlap.
+    void findBatch(const Key* keys, size_type n, iterator* out) {
+        _findBatch(keys, n, out);
+    }
+
+    void findBatch(const Key* keys, size_type n, const_iterator* out) const {
+        _findBatch(keys, n, out);
+    }
+
+    size_type count(const Key& key) const {
+        size_type res = 0;
+        const size_type mask = capacity_ - 1;
+        for (size_type i = _home(hash_(key)); ctrl_[i] != flat_ctrl_empty; i = (i + 1) & mask) {
+            if (equals_(getKey_(slots_[i]), key)) {
+                res++;
+            }
+        }
+        return res;
+    }
+
+public:
+    // insert unique with resize
+    pair<iterator, bool> insertUnique(const Value& obj) {
+        resize(num_elements_ + 1);
+        return _insertUniqueNoresize(obj);
+    }
+
+    pair<iterator, bool> insertUnique(Value&& obj) {
+        resize(num_elements_ + 1);
+        return _insertUniqueNoresize(std::move(obj));
+    }
+
+    // The slot can only be chosen by the key, so the value is built
+    // on the stack and moved into the slot.
+    template<class... Args>
+    pair<iterator, bool> emplaceUnique(Args&&... args) {
+        return insertUnique(Value(std::forward<Args>(args)...));
+    }
+
+    template<class InputIterator>
+    void insertUnique(InputIterator first, InputIterator last) {
+        for (; first != last; ++first) {
+            insertUnique(*first);
+        }
+    }
+
+    pair<iterator, bool> insertUniqueNoresize(const Value& obj) {
+        return _insertUniqueNoresize(obj);
+    }
+
+    pair<iterator, bool> insertUniqueNoresize(Value&& obj) {
+        return _insertUniqueNoresize(std::move(obj));
+    }
+
+private:
+    template<class V>
+    pair<iterator, bool> _insertUniqueNoresize(V&& obj) {
+        const size_type h = hash_(getKey_(obj));
+        const signed char tag = _tag(h);
+        size_type empty = capacity_;
+        size_type i = _probe(getKey_(obj), h, tag, &empty);
+        if (i != capacity_) {
+            return pair<iterator, bool>(iterator(i, this), false);
+        }
+        // the first empty slot of the probe sequence
+        _construct(empty, tag, std::forward<V>(obj));
+        return pair<iterator, bool>(iterator(empty, this), true);
+    }
+
+    template<class V>
+    iterator _insertEqual(V&& obj) {
+        resize(num_elements_ + 1);
+        const size_type h = hash_(getKey_(obj));
+        const size_type mask = capacity_ - 1;
+        size_type i = _home(h);
+        while (ctrl_[i] != flat_ctrl_empty) {
+            i = (i + 1) & mask;
+        }
+        _construct(i, _tag(h), std::forward<V>(obj));
+        return iterator(i, this);
+    }
+
+public:
+    // allow replaced key
+    iterator insertEqual(const Value& obj) { return _insertEqual(obj); }
+
+    iterator insertEqual(Value&& obj) { return _insertEqual(std::move(obj)); }
+
+    template<class... Args>
+    iterator emplaceEqual(Args&&... args) {
+        return _insertEqual(Value(std::forward<Args>(args)...));
+    }
+
+    template<class InputIterator>
+    void insertEqual(InputIterator first, InputIterator last) {
+        for (; first != last; ++first) {
+            insertEqual(*first);
+        }
+    }
+
+    // Return the number of erased elements
+    size_type erase(const Key& key) {
+        size_type erased = 0;
+        size_type i = _findIndex(key);
+        while (i != capacity_) {
+            _eraseIndex(i);
+            erased++;
+            i = _findIndex(key);
+        }
+        return erased;
+    }
+
+    // Notice that the element behind [it] will be shifted back to [it] probably.
+    void erase(const const_iterator& it) {
+        if (it.idx_ < capacity_) {
+            _eraseIndex(it.idx_);
+        }
+    }
+
+    // The backward shift will move elements across the range,
+    // so we destroy the range first and then put the others back in place.
+    void erase(const_iterator first, const_iterator last) {
+        if (first == last) {
+            return;
+        }
+        if (first == begin() && last == end()) {
+            clear();
+            return;
+        }
+        for (size_type i = first.idx_; i < last.idx_; ++i) {
+            if (ctrl_[i] != flat_ctrl_empty) {
+                ValueAllocTraits::destroy(valloc, slots_ + i);
+                _setCtrl(i, flat_ctrl_empty);
+                --num_elements_;
+            }
+        }
+        _rehash(capacity_);
+    }
+
+    // enlarge the table if [hint] elements exceed the max load factor (3/4)
+    void resize(size_type hint) {
+        if (hint > _maxLoad(capacity_)) {
+            _rehash(_capacityFor(hint));
+        }
+    }
+
+    void clear() {
+        for (size_type i = 0; i < capacity_; i++) {
+            if (ctrl_[i] != flat_ctrl_empty) {
+                ValueAllocTraits::destroy(valloc, slots_ + i);
+                _setCtrl(i, flat_ctrl_empty);
+            }
+        }
+        num_elements_ = 0;
+    }
+
+    // a deep copy function that copy data from other hashtable
+    void copyFrom(const FlatHashTable& ht) {
+        clear();
+        if (capacity_ != ht.capacity_) {
+            _deallocate();
+            _allocate(ht.capacity_);
+        }
+        for (size_type i = 0; i < ht.capacity_; i++) {
+            if (ht.ctrl_[i] != flat_ctrl_empty) {
+                ValueAllocTraits::construct(valloc, slots_ + i, ht.slots_[i]);
+                _setCtrl(i, ht.ctrl_[i]);
+            }
+        }
+        num_elements_ = ht.num_elements_;
+    }
+
+    // a slot holds one element at most
+    size_type elemsInBucket(size_type bucket) const {
+        return ctrl_[bucket] != flat_ctrl_empty ? 1 : 0;
+    }
+
+private:
+    // the smallest power of two capacity that holds [n] elements
+    size_type _capacityFor(size_type n) const {
+        size_type cap = min_capacity;
+        while (_maxLoad(cap) < n) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    static size_type _maxLoad(size_type cap) { return cap - cap / 4; }
+
+    // Fibonacci hashing, multiply by 2^64 / golden ratio.
+    // The high bits are well mixed even if the hasher is an identity.
+    static std::uint64_t _mix(size_type h) {
+        return static_cast<std::uint64_t>(h) * 11400714819323198485ull;
+    }
+
+    size_type _home(size_type h) const {
+        return static_cast<size_type>(_mix(h) >> shift_);
+    }
+
+    // the 7 bits just below the bits used by _home()
+    signed char _tag(size_type h) const {
+        return static_cast<signed char>((_mix(h) >> (shift_ - 7)) & 0x7f);
+    }
+
+    // keep the cloned bytes behind the end in step with the first ones
+    void _setCtrl(size_type i, signed char c) {
+        ctrl_[i] = c;
+        for (size_type k = i; k < num_cloned; k += capacity_) {
+            ctrl_[capacity_ + k] = c;
+        }
+    }
+
+    template<class V>
+    void _construct(size_type i, signed char tag, V&& obj) {
+        ValueAllocTraits::construct(valloc, slots_ + i, std::forward<V>(obj));
+        _setCtrl(i, tag);
+        ++num_elements_;
+    }
+
+    // findBatch prefetches the home slot of key i + d while it resolves key i
+    static const size_type batch_distance = 8;
+
+    template<class It>
+    void _findBatch(const Key* keys, size_type n, It* out) const {
+        const size_type d = batch_distance, ring = 2 * batch_distance;
+        size_type hashes[ring];
+        for (size_type i = 0; i < n + d; i++) {
+            if (i < n) {
+                const size_type h = hash_(keys[i]);
+                const size_type home = _home(h);
+                hashes[i % ring] = h;
+                __builtin_prefetch(ctrl_ + home);
+                __builtin_prefetch(slots_ + home);
+            }
+            if (i >= d) {
+                const size_type k = i - d;
+                const size_type h = hashes[k % ring];
+                out[k] = It(_probe(keys[k], h, _tag(h), nullptr), this);
+            }
+        }
+    }
+
+    size_type _findIndex(const Key& key) const {
+        const size_type h = hash_(key);
+        return _probe(key, h, _tag(h), nullptr);
+    }
+
+    // Find [key] with hash [h] and its [tag].
+    // Return capacity_ if not found,
+    // and put the first empty slot of the probe sequence to [empty].
+    size_type _probe(const Key& key, size_type h, signed char tag, size_type* empty) const {
+        size_type i = _probeWith(key, _home(h), tag, Probe());
+        if (ctrl_[i] != flat_ctrl_empty) {
+            return i;
+        }
+        if (empty) {
+            *empty = i;
+        }
+        return capacity_;
+    }
+
+    // return the index of key or the first empty slot from [i]
+    size_type _probeWith(const Key& key, size_type i, signed char tag, LinearProbe) const {
+        const size_type mask = capacity_ - 1;
+        for (; ctrl_[i] != flat_ctrl_empty; i = (i + 1) & mask) {
+            if (ctrl_[i] == tag && equals_(getKey_(slots_[i]), key)) {
+                return i;
+            }
+        }
+        return i;
+    }
+
+    template<class P>
+    size_type _probeWith(const Key& key, size_type i, signed char tag, P) const {
+        const size_type mask = capacity_ - 1;
+        for (;; i = (i + P::width) & mask) {
+            for (std::uint32_t m = P::match(ctrl_ + i, tag); m != 0; m &= m - 1) {
+                const size_type j = (i + P::lowest(m)) & mask;
+                if (equals_(getKey_(slots_[j]), key)) {
+                    return j;
+                }
+            }
+            // the key must be in front of the first empty slot
+            const std::uint32_t e = P::match(ctrl_ + i, flat_ctrl_empty);
+            if (e != 0) {
+                return (i + P::lowest(e)) & mask;
+            }
+        }
+    }
+
+    size_type _nextFull(size_type i) const {
+        while (i < capacity_ && ctrl_[i] == flat_ctrl_empty) {
+            ++i;
+        }
+        return i;
+    }
+
+    // Backward shift deletion.
+    // Move the following elements back to the hole
+    // unless the hole is in front of their home slot.
+    void _eraseIndex(size_type hole) {
+        const size_type mask = capacity_ - 1;
+        ValueAllocTraits::destroy(valloc, slots_ + hole);
+        --num_elements_;
+        for (size_type j = (hole + 1) & mask; ctrl_[j] != flat_ctrl_empty; j = (j + 1) & mask) {
+            const size_type home = _home(hash_(getKey_(slots_[j])));
+            // the distance from home to j must cover the hole to move j into it
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                ValueAllocTraits::construct(valloc, slots_ + hole, std::move(slots_[j]));
+                ValueAllocTraits::destroy(valloc, slots_ + j);
+                _setCtrl(hole, ctrl_[j]);
+                hole = j;
+            }
+        }
+        _setCtrl(hole, flat_ctrl_empty);
+    }
+
+    void _allocate(size_type cap) {
+        capacity_ = cap;
+        shift_ = 64;
+        for (size_type c = cap; c > 1; c >>= 1) {
+            --shift_;
+        }
+        ctrl_ = CtrlAllocTraits::allocate(calloc, capacity_ + num_cloned);
+        slots_ = ValueAllocTraits::allocate(valloc, capacity_);
+        for (size_type i = 0; i < capacity_ + num_cloned; i++) {
+            ctrl_[i] = flat_ctrl_empty;
+        }
+    }
+
+    void _deallocate() {
+        if (ctrl_) {
+            CtrlAllocTraits::deallocate(calloc, ctrl_, capacity_ + num_cloned);
+            ValueAllocTraits::deallocate(valloc, slots_, capacity_);
+        }
+        ctrl_ = nullptr;
+        slots_ = nullptr;
+        capacity_ = 0;
+    }
+
+    // move all elements to a new slot array of [cap] slots
+    void _rehash(size_type cap) {
+        signed char* oldCtrl = ctrl_;
+        Value* oldSlots = slots_;
+        const size_type oldCap = capacity_;
+
+        _allocate(cap);
+        const size_type mask = capacity_ - 1;
+        for (size_type i = 0; i < oldCap; i++) {
+            if (oldCtrl[i] != flat_ctrl_empty) {
+                const size_type h = hash_(getKey_(oldSlots[i]));
+                size_type j = _home(h);
+                while (ctrl_[j] != flat_ctrl_empty) {
+                    j = (j + 1) & mask;
+                }
+                ValueAllocTraits::construct(valloc, slots_ + j, std::move(oldSlots[i]));
+                ValueAllocTraits::destroy(valloc, oldSlots + i);
+                _setCtrl(j, _tag(h));
+            }
+        }
+        CtrlAllocTraits::deallocate(calloc, oldCtrl, oldCap + num_cloned);
+        ValueAllocTraits::deallocate(valloc, oldSlots, oldCap);
+    }
+};
+
+// Table engine selector for HashMap and HashSet.
+// It rebinds to the open addressing FlatHashTable.
+struct FlatHashing {
+    template<class Value, class Key, class HashFcn,
+            class ExtractKey, class EqualKey, class Alloc>
+    struct rebind {
+        typedef FlatHashTable<Value, Key, HashFcn, ExtractKey, EqualKey, Alloc> other;
+    };
+};
+
+// Table engine selector for HashMap and HashSet.
+// It rebinds to the FlatHashTable with group probing.
+struct GroupHashing {
+    template<class Value, class Key, class HashFcn,
+            class ExtractKey, class EqualKey, class Alloc>
+    struct rebind {
+        typedef FlatHashTable<Value, Key, HashFcn, ExtractKey, EqualKey, Alloc, GroupProbe> other;
+    };
+};
+
+}
+
+#endif //FLAK_FLATHASHTABLE_H
@@ -0,0 +1,619 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// FrozenKDTree is an immutable KD tree for read-only nearest neighbour search.
+// The points are split at the median of the dimension with the largest spread
+// until a part fits in a leaf bucket of bucket_size points. The tree is complete,
+// so like FrozenTree it is kept in arrays without pointers: the split of node k
+// is at index k, its children are 2k and 2k+1, and the leaves are the last level.
+//
+// A leaf keeps its coordinates as a structure of arrays, dimension by dimension:
+//
+//   leaf k:  x0 x1 ... x15 | y0 y1 ... y15 | z0 z1 ... z15
+//
+// so the distances from a query to the whole bucket are computed together,
+// 8 floats or 4 doubles at a time with AVX2, 4 floats or 2 doubles with SSE2.
+// The search keeps the k best in a heap and the far children waiting on a
+// small fixed stack, with the distance to their split as the bound.
+//
+// Every node keeps the bounding box of its points, so the radius and the box
+// queries skip the subtrees out of reach, and their counts take the subtrees
+// wholly in reach without visiting them.
+//
+// The distance is a metric of KDMetric.h, the squared euclidean one by default,
+// whose kernels are the vectorized ones. The points are addressed by their
+// position in the tree, 0 ... size() - 1. KDTree::freeze() builds one from a KDTree.
+
+#ifndef FLAK_FROZEN_KDTREE_H
+#define FLAK_FROZEN_KDTREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+#include <vector>
+#include "KDMetric.h"
+#include "SmallVector.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace flak {
+
+// the points in a leaf of FrozenKDTree
+static const size_t kd_bucket_size = 16;
+
+// The distances from [q] to the kd_bucket_size points of a leaf,
+// whose coordinates [c] are kept dimension by dimension.
+template<class Metric, class Coord, class Dist>
+struct KDBucketKernel {
+    static void distances(const Coord* c, const Coord* q, size_t dim, Dist* out) {
+        for (size_t j = 0; j < kd_bucket_size; j++) {
+            out[j] = Dist();
+        }
+        for (size_t d = 0; d < dim; d++, c += kd_bucket_size) {
+            for (size_t j = 0; j < kd_bucket_size; j++) {
+                out[j] = Metric::combine(out[j], Metric::term(_kdAbsDiff<Dist>(c[j], q[d])));
+            }
+        }
+        for (size_t j = 0; j < kd_bucket_size; j++) {
+            out[j] = Metric::finish(out[j]);
+        }
+    }
+};
+
+// half of the euclidean one, which may be vectorized
+template<class Coord, class Dist>
+struct KDBucketKernel<CosineMetric, Coord, Dist> {
+    static void distances(const Coord* c, const Coord* q, size_t dim, Dist* out) {
+        KDBucketKernel<EuclideanMetric, Coord, Dist>::distances(c, q, dim, out);
+        for (size_t j = 0; j < kd_bucket_size; j++) {
+            out[j] = CosineMetric::finish(out[j]);
+        }
+    }
+};
+
+#if defined(__AVX2__)
+template<>
+struct KDBucketKernel<EuclideanMetric, float, float> {
+    static void distances(const float* c, const float* q, size_t dim, float* out) {
+        __m256 acc[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+        for (size_t d = 0; d < dim; d++, c += kd_bucket_size) {
+            __m256 x = _mm256_set1_ps(q[d]);
+            for (int i = 0; i < 2; i++) {
+                __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(c + 8 * i), x);
+                acc[i] = _mm256_add_ps(acc[i], _mm256_mul_ps(diff, diff));
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            _mm256_storeu_ps(out + 8 * i, acc[i]);
+        }
+    }
+};
+
+template<>
+struct KDBucketKernel<EuclideanMetric, double, double> {
+    static void distances(const double* c, const double* q, size_t dim, double* out) {
+        __m256d acc[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(),
+                          _mm256_setzero_pd(), _mm256_setzero_pd()};
+        for (size_t d = 0; d < dim; d++, c += kd_bucket_size) {
+            __m256d x = _mm256_set1_pd(q[d]);
+            for (int i = 0; i < 4; i++) {
+                __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(c + 4 * i), x);
+                acc[i] = _mm256_add_pd(acc[i], _mm256_mul_pd(diff, diff));
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            _mm256_storeu_pd(out + 4 * i, acc[i]);
+        }
+    }
+};
+#elif defined(__SSE2__)
+template<>
+struct KDBucketKernel<EuclideanMetric, float, float> {
+    static void distances(const float* c, const float* q, size_t dim, float* out) {
+        __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+        for (size_t d = 0; d < dim; d++, c += kd_bucket_size) {
+            __m128 x = _mm_set1_ps(q[d]);
+            for (int i = 0; i < 4; i++) {
+                __m128 diff = _mm_sub_ps(_mm_loadu_ps(c + 4 * i), x);
+                acc[i] = _mm_add_ps(acc[i], _mm_mul_ps(diff, diff));
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            _mm_storeu_ps(out + 4 * i, acc[i]);
+        }
+    }
+};
+
+template<>
+struct KDBucketKernel<EuclideanMetric, double, double> {
+    static void distances(const double* c, const double* q, size_t dim, double* out) {
+        __m128d acc[8];
+        for (int i = 0; i < 8; i++) {
+            acc[i] = _mm_setzero_pd();
+        }
+        for (size_t d = 0; d < dim; d++, c += kd_bucket_size) {
+            __m128d x = _mm_set1_pd(q[d]);
+            for (int i = 0; i < 8; i++) {
+                __m128d diff = _mm_sub_pd(_mm_loadu_pd(c + 2 * i), x);
+                acc[i] = _mm_add_pd(acc[i], _mm_mul_pd(diff, diff));
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            _mm_storeu_pd(out + 2 * i, acc[i]);
+        }
+    }
+};
+#endif
+
+template<class Coord, class Val, class Metric = EuclideanMetric,
+        class Distance = typename KDDistance<Coord>::type>
+class FrozenKDTree {
+public:
+    typedef Coord coord_type;
+    typedef Val mapped_type;
+    typedef size_t size_type;
+    typedef size_t dim_type;
+    typedef Metric metric_type;
+    typedef Distance distance_type;
+    // pair of the distance and the position of a point
+    typedef std::pair<distance_type, size_type> result_type;
+
+    static const size_type bucket_size = kd_bucket_size;
+
+private:
+    struct Split {
+        Coord value_;
+        dim_type dim_;
+    };
+
+    // a far child to visit, [bound] is no more than the distance to its points
+    struct Pending {
+        size_type node_;
+        distance_type bound_;
+    };
+
+    std::vector<Split> splits_;         // the inner nodes 1 ... leaves_ - 1
+    std::vector<size_type> leafBegin_;  // the first position of each leaf, and size()
+    std::vector<Coord> coords_;         // a bucket of dimension_ * bucket_size for each leaf
+    std::vector<Val> values_;           // by position
+    std::vector<Coord> boxLow_;         // the bounding box of node k at k * dimension_,
+    std::vector<Coord> boxHigh_;        // of all the nodes 1 ... 2 * leaves_ - 1
+    size_type leaves_;                  // a power of two
+    dim_type dimension_;
+    int depth_;                         // of the leaves
+
+public:
+    explicit FrozenKDTree(dim_type dim = 0)
+            : splits_(1), leafBegin_(2, 0), coords_(dim * bucket_size),
+              boxLow_(2 * dim), boxHigh_(2 * dim), leaves_(1), dimension_(dim), depth_(0) {}
+
+    // build from the pairs of point and value in [first, last),
+    // a point is anything with the coordinates at [0] ... [dim - 1]
+    template<class InputIterator>
+    FrozenKDTree(InputIterator first, InputIterator last, dim_type dim)
+            : leaves_(1), dimension_(dim), depth_(0) {
+        std::vector<Coord> points;  // dimension_ coordinates in a row
+        std::vector<Val> values;
+        for (; first != last; ++first) {
+            for (dim_type d = 0; d < dimension_; d++) {
+                points.push_back((*first).first[d]);
+            }
+            values.push_back((*first).second);
+        }
+        const size_type n = values.size();
+        while (((n + leaves_ - 1) >> depth_) > bucket_size) {
+            leaves_ *= 2;
+            depth_++;
+        }
+        splits_.resize(leaves_);
+        leafBegin_.resize(leaves_ + 1);
+        std::vector<size_type> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        _build(1, order.data(), order.data(), order.data() + n, points);
+
+        coords_.assign(leaves_ * dimension_ * bucket_size, Coord());
+        values_.reserve(n);
+        for (size_type l = 0; l < leaves_; l++) {
+            Coord* c = &coords_[l * dimension_ * bucket_size];
+            for (size_type i = leafBegin_[l]; i < leafBegin_[l + 1]; i++) {
+                const size_type j = i - leafBegin_[l];
+                for (dim_type d = 0; d < dimension_; d++) {
+                    c[d * bucket_size + j] = points[order[i] * dimension_ + d];
+                }
+                values_.push_back(std::move(values[order[i]]));
+            }
+        }
+        _buildBoxes();
+    }
+
+    size_type size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+    dim_type dimension() const { return dimension_; }
+
+    const Val& value(size_type pos) const { return values_[pos]; }
+
+    Coord coord(size_type pos, dim_type d) const {
+        size_type l = std::upper_bound(leafBegin_.begin(), leafBegin_.end(), pos)
+                      - leafBegin_.begin() - 1;
+        return coords_[(l * dimension_ + d) * bucket_size + pos - leafBegin_[l]];
+    }
+
+    // Call [f](position, distance) for each point within the distance [r] of [p],
+    // in the distance of the metric, so the squared radius for EuclideanMetric.
+    template<class Point, class Function>
+    void forEachInRadius(const Point& p, distance_type r, Function f) const {
+        SmallVector<Coord, 16> q(dimension_);
+        _copy(p, q);
+        _forEachInRadius(1, &q[0], r, f);
+    }
+
+    // write the result_type of each point within [r] of [p] to [out]
+    template<class Point, class OutputIterator>
+    OutputIterator findInRadius(const Point& p, distance_type r, OutputIterator out) const {
+        forEachInRadius(p, r, [&](size_type pos, distance_type d) {
+            *out = result_type(d, pos);
+            ++out;
+        });
+        return out;
+    }
+
+    // the subtrees whose boxes are all within [r] are counted whole
+    template<class Point>
+    size_type countInRadius(const Point& p, distance_type r) const {
+        SmallVector<Coord, 16> q(dimension_);
+        _copy(p, q);
+        return _countInRadius(1, &q[0], r);
+    }
+
+    // call [f](position) for each point inside the box [lo, hi], the bounds included
+    template<class Point, class Function>
+    void forEachInBox(const Point& lo, const Point& hi, Function f) const {
+        SmallVector<Coord, 16> l(dimension_), h(dimension_);
+        _copy(lo, l);
+        _copy(hi, h);
+        _forEachInBox(1, &l[0], &h[0], f);
+    }
+
+    // write the position of each point inside the box [lo, hi] to [out]
+    template<class Point, class OutputIterator>
+    OutputIterator findInBox(const Point& lo, const Point& hi, OutputIterator out) const {
+        forEachInBox(lo, hi, [&](size_type pos) {
+            *out = pos;
+            ++out;
+        });
+        return out;
+    }
+
+    // the subtrees whose boxes are inside [lo, hi] are counted whole
+    template<class Point>
+    size_type countInBox(const Point& lo, const Point& hi) const {
+        SmallVector<Coord, 16> l(dimension_), h(dimension_);
+        _copy(lo, l);
+        _copy(hi, h);
+        return _countInBox(1, &l[0], &h[0]);
+    }
+
+    // The [k] nearest points of [p] with their distances, the nearest first.
+    // Unlike KDTree::findKNearest, a point at [p] itself is one of them.
+    template<class Point>
+    std::vector<result_type> findKNearest(const Point& p, size_type k) const {
+        std::vector<result_type> heap;
+        if (k == 0) {
+            return heap;
+        }
+        heap.reserve(std::min(k, size()));
+        SmallVector<Coord, 16> q(dimension_);
+        _copy(p, q);
+        _search(&q[0], k, heap);
+        std::sort_heap(heap.begin(), heap.end());
+        return heap;
+    }
+
+private:
+    template<class Point>
+    void _copy(const Point& p, SmallVector<Coord, 16>& q) const {
+        for (dim_type d = 0; d < dimension_; d++) {
+            q[d] = p[d];
+        }
+    }
+
+    // the points below [node] are at the positions [_begin(node), _end(node))
+    size_type _begin(size_type node) const {
+        return leafBegin_[(node << (depth_ - _level(node))) - leaves_];
+    }
+
+    size_type _end(size_type node) const {
+        return leafBegin_[((node + 1) << (depth_ - _level(node))) - leaves_];
+    }
+
+    static int _level(size_type node) {
+        return 63 - __builtin_clzll(node);
+    }
+
+    void _buildBoxes() {
+        boxLow_.assign(2 * leaves_ * dimension_, Coord());
+        boxHigh_.assign(2 * leaves_ * dimension_, Coord());
+        for (size_type l = 0; l < leaves_; l++) {
+            const Coord* c = &coords_[l * dimension_ * bucket_size];
+            const size_type count = leafBegin_[l + 1] - leafBegin_[l];
+            Coord* lo = &boxLow_[(leaves_ + l) * dimension_];
+            Coord* hi = &boxHigh_[(leaves_ + l) * dimension_];
+            for (dim_type d = 0; d < dimension_ && count > 0; d++, c += bucket_size) {
+                lo[d] = hi[d] = c[0];
+                for (size_type j = 1; j < count; j++) {
+                    lo[d] = std::min(lo[d], c[j]);
+                    hi[d] = std::max(hi[d], c[j]);
+                }
+            }
+        }
+        for (size_type k = leaves_ - 1; k >= 1; k--) {
+            const size_type a = 2 * k, b = 2 * k + 1;
+            const bool emptyA = _begin(a) == _end(a), emptyB = _begin(b) == _end(b);
+            for (dim_type d = 0; d < dimension_; d++) {
+                Coord& lo = boxLow_[k * dimension_ + d];
+                Coord& hi = boxHigh_[k * dimension_ + d];
+                if (emptyA || emptyB) {
+                    const size_type x = emptyA ? b : a;
+                    lo = boxLow_[x * dimension_ + d];
+                    hi = boxHigh_[x * dimension_ + d];
+                } else {
+                    lo = std::min(boxLow_[a * dimension_ + d], boxLow_[b * dimension_ + d]);
+                    hi = std::max(boxHigh_[a * dimension_ + d], boxHigh_[b * dimension_ + d]);
+                }
+            }
+        }
+    }
+
+    // no more than the distance from [q] to the points below [node]
+    distance_type _nearDistance(size_type node, const Coord* q) const {
+        const Coord* lo = &boxLow_[node * dimension_];
+        const Coord* hi = &boxHigh_[node * dimension_];
+        distance_type sum = distance_type();
+        for (dim_type d = 0; d < dimension_; d++) {
+            distance_type diff = distance_type();
+            if (q[d] < lo[d]) {
+                diff = _kdAbsDiff<distance_type>(q[d], lo[d]);
+            } else if (hi[d] < q[d]) {
+                diff = _kdAbsDiff<distance_type>(q[d], hi[d]);
+            }
+            sum = Metric::combine(sum, Metric::term(diff));
+        }
+        return Metric::finish(sum);
+    }
+
+    // no less than the distance from [q] to the points below [node]
+    distance_type _farDistance(size_type node, const Coord* q) const {
+        const Coord* lo = &boxLow_[node * dimension_];
+        const Coord* hi = &boxHigh_[node * dimension_];
+        distance_type sum = distance_type();
+        for (dim_type d = 0; d < dimension_; d++) {
+            distance_type diff = std::max(_kdAbsDiff<distance_type>(q[d], lo[d]),
+                                          _kdAbsDiff<distance_type>(q[d], hi[d]));
+            sum = Metric::combine(sum, Metric::term(diff));
+        }
+        return Metric::finish(sum);
+    }
+
+    // whether the box of [node] and [lo, hi] overlap, or the box is inside
+    bool _overlaps(size_type node, const Coord* lo, const Coord* hi) const {
+        for (dim_type d = 0; d < dimension_; d++) {
+            if (boxHigh_[node * dimension_ + d] < lo[d] || hi[d] < boxLow_[node * dimension_ + d]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _inside(size_type node, const Coord* lo, const Coord* hi) const {
+        for (dim_type d = 0; d < dimension_; d++) {
+            if (boxLow_[node * dimension_ + d] < lo[d] || hi[d] < boxHigh_[node * dimension_ + d]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<class Function>
+    void _forEachInRadius(size_type node, const Coord* q, distance_type r, Function& f) const {
+        if (_begin(node) == _end(node) || r < _nearDistance(node, q)) {
+            return;
+        }
+        if (node < leaves_) {
+            _forEachInRadius(2 * node, q, r, f);
+            _forEachInRadius(2 * node + 1, q, r, f);
+            return;
+        }
+        const size_type l = node - leaves_;
+        distance_type dist[bucket_size];
+        KDBucketKernel<Metric, Coord, distance_type>::distances(
+                &coords_[l * dimension_ * bucket_size], q, dimension_, dist);
+        for (size_type i = leafBegin_[l]; i < leafBegin_[l + 1]; i++) {
+            if (!(r < dist[i - leafBegin_[l]])) {
+                f(i, dist[i - leafBegin_[l]]);
+            }
+        }
+    }
+
+    size_type _countInRadius(size_type node, const Coord* q, distance_type r) const {
+        const size_type begin = _begin(node), end = _end(node);
+        if (begin == end || r < _nearDistance(node, q)) {
+            return 0;
+        }
+        if (!(r < _farDistance(node, q))) {
+            return end - begin;
+        }
+        if (node < leaves_) {
+            return _countInRadius(2 * node, q, r) + _countInRadius(2 * node + 1, q, r);
+        }
+        distance_type dist[bucket_size];
+        KDBucketKernel<Metric, Coord, distance_type>::distances(
+                &coords_[(node - leaves_) * dimension_ * bucket_size], q, dimension_, dist);
+        size_type count = 0;
+        for (size_type j = 0; j < end - begin; j++) {
+            count += !(r < dist[j]);
+        }
+        return count;
+    }
+
+    // whether the [j]-th point of the leaf [l] is inside [lo, hi]
+    bool _pointInside(size_type l, size_type j, const Coord* lo, const Coord* hi) const {
+        const Coord* c = &coords_[l * dimension_ * bucket_size + j];
+        for (dim_type d = 0; d < dimension_; d++, c += bucket_size) {
+            if (*c < lo[d] || hi[d] < *c) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<class Function>
+    void _forEachInBox(size_type node, const Coord* lo, const Coord* hi, Function& f) const {
+        const size_type begin = _begin(node), end = _end(node);
+        if (begin == end || !_overlaps(node, lo, hi)) {
+            return;
+        }
+        if (_inside(node, lo, hi)) {
+            for (size_type i = begin; i < end; i++) {
+                f(i);
+            }
+        } else if (node < leaves_) {
+            _forEachInBox(2 * node, lo, hi, f);
+            _forEachInBox(2 * node + 1, lo, hi, f);
+        } else {
+            for (size_type i = begin; i < end; i++) {
+                if (_pointInside(node - leaves_, i - begin, lo, hi)) {
+                    f(i);
+                }
+            }
+        }
+    }
+
+    size_type _countInBox(size_type node, const Coord* lo, const Coord* hi) const {
+        const size_type begin = _begin(node), end = _end(node);
+        if (begin == end || !_overlaps(node, lo, hi)) {
+            return 0;
+        }
+        if (_inside(node, lo, hi)) {
+            return end - begin;
+        }
+        if (node < leaves_) {
+            return _countInBox(2 * node, lo, hi) + _countInBox(2 * node + 1, lo, hi);
+        }
+        size_type count = 0;
+        for (size_type j = 0; j < end - begin; j++) {
+            count += _pointInside(node - leaves_, j, lo, hi);
+        }
+        return count;
+    }
+
+    // split the positions [first, last) of the points below [node]
+    void _build(size_type node, size_type* base, size_type* first, size_type* last,
+                const std::vector<Coord>& points) {
+        if (node >= leaves_) {
+            leafBegin_[node - leaves_] = first - base;
+            leafBegin_[node - leaves_ + 1] = last - base;
+            return;
+        }
+        size_type* mid = first + (last - first) / 2;
+        Split& s = splits_[node];
+        s.dim_ = 0;
+        s.value_ = Coord();
+        if (first != last) {
+            s.dim_ = _widestDim(first, last, points);
+            const Coord* x = points.data() + s.dim_;
+            const dim_type stride = dimension_;
+            std::nth_element(first, mid, last, [x, stride](size_type a, size_type b) {
+                return x[a * stride] < x[b * stride];
+            });
+            s.value_ = x[*mid * stride];
+        }
+        // the low child has the coordinates <= value_, the high one >= value_
+        _build(2 * node, base, first, mid, points);
+        _build(2 * node + 1, base, mid, last, points);
+    }
+
+    dim_type _widestDim(size_type* first, size_type* last, const std::vector<Coord>& points) const {
+        dim_type widest = 0;
+        Coord best = Coord();
+        for (dim_type d = 0; d < dimension_; d++) {
+            Coord lo = points[*first * dimension_ + d];
+            Coord hi = lo;
+            for (size_type* i = first + 1; i != last; ++i) {
+                Coord c = points[*i * dimension_ + d];
+                if (c < lo) {
+                    lo = c;
+                } else if (hi < c) {
+                    hi = c;
+                }
+            }
+            if (best < hi - lo) {
+                best = hi - lo;
+                widest = d;
+            }
+        }
+        return widest;
+    }
+
+    void _search(const Coord* q, size_type k, std::vector<result_type>& heap) const {
+        Pending stack[64];  // one far child for each level of the way down
+        int top = 0;
+        stack[top++] = Pending{1, distance_type()};
+        distance_type dist[bucket_size];
+        while (top > 0) {
+            Pending x = stack[--top];
+            if (heap.size() == k && !(x.bound_ < heap.front().first)) {
+                continue;
+            }
+            size_type node = x.node_;
+            while (node < leaves_) {
+                const Split& s = splits_[node];
+                size_type nearer = 2 * node + (q[s.dim_] < s.value_ ? 0 : 1);
+                distance_type bound = std::max(x.bound_, _kdAxisBound<Metric>(
+                        _kdAbsDiff<distance_type>(q[s.dim_], s.value_)));
+                if (heap.size() < k || bound < heap.front().first) {
+                    stack[top++] = Pending{nearer ^ 1, bound};
+                }
+                node = nearer;
+            }
+
+            const size_type l = node - leaves_;
+            const size_type begin = leafBegin_[l];
+            const size_type count = leafBegin_[l + 1] - begin;
+            KDBucketKernel<Metric, Coord, distance_type>::distances(
+                    &coords_[l * dimension_ * bucket_size], q, dimension_, dist);
+            for (size_type j = 0; j < count; j++) {
+                if (heap.size() < k) {
+                    heap.push_back(result_type(dist[j], begin + j));
+                    std::push_heap(heap.begin(), heap.end());
+                } else if (dist[j] < heap.front().first) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = result_type(dist[j], begin + j);
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+        }
+    }
+};
+
+}
+
+#endif //FLAK_FROZEN_KDTREE_H
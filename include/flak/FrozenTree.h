@@ -0,0 +1,357 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// FrozenTree is an immutable copy of an ordered container for read-mostly data.
+// The values are kept in one array in Eytzinger (breadth first) order:
+// the root is at index 1 and the children of k are at 2k and 2k+1,
+// so there are no pointers, and the top levels shared by all searches
+// stay together in the first cache lines:
+//
+//            4                 index:  1  2  3  4  5  6  7
+//          /   \               value:  4  2  6  1  3  5  7
+//         2     6
+//        / \   / \              level by level, left to right
+//       1   3 5   7
+//
+// A search computes the next index from the comparison instead of branching
+// on it, and prefetches the cache line holding the descendants a few levels
+// below, whose indices k * 2^d ... k * 2^d + 2^d - 1 are contiguous.
+//
+// freeze() of RBTree and AVLTree (and of the containers on them) builds it in O(n).
+// AtomicSnapshot publishes a rebuilt copy to the readers without locking them.
+
+#ifndef FLAK_FROZEN_TREE_H
+#define FLAK_FROZEN_TREE_H
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace flak {
+
+// the in-order walk of the implicit tree of [n] values, index 0 is end()
+struct Eytzinger {
+    // the leftmost index
+    static size_t first(size_t n) {
+        if (n == 0) {
+            return 0;
+        }
+        size_t k = 1;
+        while (2 * k <= n) {
+            k = 2 * k;
+        }
+        return k;
+    }
+
+    // the rightmost index
+    static size_t last(size_t n) {
+        if (n == 0) {
+            return 0;
+        }
+        size_t k = 1;
+        while (2 * k + 1 <= n) {
+            k = 2 * k + 1;
+        }
+        return k;
+    }
+
+    static size_t next(size_t k, size_t n) {
+        if (2 * k + 1 <= n) {
+            // the leftmost index of the right subtree
+            k = 2 * k + 1;
+            while (2 * k <= n) {
+                k = 2 * k;
+            }
+            return k;
+        }
+        // up past the ancestors whose right subtree k is in,
+        // the trailing ones of k, and one more to the first one it is on the left of
+        return k >> __builtin_ffsll(~k);
+    }
+
+    static size_t prev(size_t k, size_t n) {
+        if (k == 0) {
+            return last(n);
+        }
+        if (2 * k <= n) {
+            k = 2 * k;
+            while (2 * k + 1 <= n) {
+                k = 2 * k + 1;
+            }
+            return k;
+        }
+        return k >> __builtin_ffsll(k);
+    }
+};
+
+// how many levels below a node a cache line holds all of its descendants
+template<class Val, size_t Shift = 1>
+struct EytzingerPrefetch {
+    static const size_t shift = (sizeof(Val) << (Shift + 1)) <= 64 ?
+            EytzingerPrefetch<Val, Shift + 1>::shift : Shift;
+};
+
+template<class Val>
+struct EytzingerPrefetch<Val, 6> {
+    static const size_t shift = 6;
+};
+
+template<class T>
+struct FrozenTreeIterator {
+    typedef T value_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+    typedef ptrdiff_t difference_type;
+    typedef std::bidirectional_iterator_tag iterator_category;
+
+    typedef FrozenTreeIterator<T> Self;
+
+    const T* data_;
+    size_t size_;
+    size_t index_;  // 0 is end()
+
+    FrozenTreeIterator() : data_(nullptr), size_(0), index_(0) {}
+
+    FrozenTreeIterator(const T* data, size_t size, size_t index)
+            : data_(data), size_(size), index_(index) {}
+
+    reference operator*() const { return data_[index_]; }
+
+    pointer operator->() const { return &(operator*()); }
+
+    Self& operator++() {
+        index_ = Eytzinger::next(index_, size_);
+        return *this;
+    }
+
+    Self operator++(int) {
+        Self tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    Self& operator--() {
+        index_ = Eytzinger::prev(index_, size_);
+        return *this;
+    }
+
+    Self operator--(int) {
+        Self tmp = *this;
+        --*this;
+        return tmp;
+    }
+
+    bool operator==(const Self& x) const { return index_ == x.index_ && data_ == x.data_; }
+
+    bool operator!=(const Self& x) const { return !(*this == x); }
+};
+
+template<typename Key, typename Val, typename KeyOfValue,
+        typename Compare, typename Alloc = std::allocator<Val>>
+class FrozenTree {
+public:
+    typedef Key key_type;
+    typedef Val value_type;
+    typedef Compare key_compare;
+    typedef const value_type* pointer;
+    typedef const value_type* const_pointer;
+    typedef const value_type& reference;
+    typedef const value_type& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef FrozenTreeIterator<Val> iterator;
+    typedef FrozenTreeIterator<Val> const_iterator;
+
+private:
+    typedef typename Alloc::template rebind<Val>::other ValueAlloc;
+    typedef std::allocator_traits<ValueAlloc> AllocTraits;
+    typedef FrozenTree<Key, Val, KeyOfValue, Compare, Alloc> Self;
+
+    static const size_t prefetch_shift = EytzingerPrefetch<Val>::shift;
+
+    ValueAlloc valloc;
+    Compare keyCompare_;
+    Val* data_;        // data_[1 .. size_], data_[0] is not constructed
+    size_type size_;
+
+    static const Key& key(const Val& v) { return KeyOfValue()(v); }
+
+public:
+    explicit FrozenTree(const Compare& comp = Compare())
+            : keyCompare_(comp), data_(nullptr), size_(0) {}
+
+    // [first, last) must be sorted by key
+    template<class FI>
+    FrozenTree(FI first, FI last, const Compare& comp = Compare())
+            : FrozenTree(first, std::distance(first, last), comp) {}
+
+    // copy [n] values from [first], which must be sorted by key
+    template<class FI>
+    FrozenTree(FI first, size_type n, const Compare& comp = Compare())
+            : keyCompare_(comp), data_(nullptr), size_(0) {
+        _build(first, n);
+    }
+
+    FrozenTree(const Self& x) : valloc(x.valloc), keyCompare_(x.keyCompare_), data_(nullptr), size_(0) {
+        _build(x.begin(), x.size_);
+    }
+
+    FrozenTree(Self&& x) noexcept
+            : valloc(x.valloc), keyCompare_(x.keyCompare_), data_(x.data_), size_(x.size_) {
+        x.data_ = nullptr;
+        x.size_ = 0;
+    }
+
+    Self& operator=(Self x) {
+        swap(x);
+        return *this;
+    }
+
+    ~FrozenTree() { _destroy(size_); }
+
+    void swap(Self& x) {
+        std::swap(valloc, x.valloc);
+        std::swap(keyCompare_, x.keyCompare_);
+        std::swap(data_, x.data_);
+        std::swap(size_, x.size_);
+    }
+
+public:
+    Compare keyComp() const { return keyCompare_; }
+
+    size_type size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const { return const_iterator(data_, size_, Eytzinger::first(size_)); }
+
+    const_iterator end() const { return const_iterator(data_, size_, 0); }
+
+    // the first value whose key is not less than [k]
+    const_iterator lowerBound(const Key& k) const {
+        size_type i = 1;
+        while (i <= size_) {
+            __builtin_prefetch(data_ + (i << prefetch_shift));
+            i = 2 * i + keyCompare_(key(data_[i]), k);
+        }
+        return const_iterator(data_, size_, _found(i));
+    }
+
+    // the first value whose key is greater than [k]
+    const_iterator upperBound(const Key& k) const {
+        size_type i = 1;
+        while (i <= size_) {
+            __builtin_prefetch(data_ + (i << prefetch_shift));
+            i = 2 * i + !keyCompare_(k, key(data_[i]));
+        }
+        return const_iterator(data_, size_, _found(i));
+    }
+
+    const_iterator find(const Key& k) const {
+        const_iterator j = lowerBound(k);
+        return (j.index_ == 0 || keyCompare_(k, key(*j))) ? end() : j;
+    }
+
+    size_type count(const Key& k) const {
+        size_type n = 0;
+        for (const_iterator j = lowerBound(k); j.index_ != 0 && !keyCompare_(k, key(*j)); ++j) {
+            ++n;
+        }
+        return n;
+    }
+
+private:
+    // The search went left at the last node it passed that it did not go right at,
+    // which is the answer. The right turns after it are the trailing ones of [i],
+    // drop them and the left turn, 0 if it only turned right.
+    static size_type _found(size_type i) { return i >> __builtin_ffsll(~i); }
+
+    // fill the indices in order, so the values are read once from the front
+    template<class FI>
+    void _build(FI first, size_type n) {
+        if (n == 0) {
+            return;
+        }
+        data_ = AllocTraits::allocate(valloc, n + 1);
+        size_ = n;
+        size_type built = 0;
+        try {
+            for (size_type i = Eytzinger::first(n); i != 0; i = Eytzinger::next(i, n)) {
+                AllocTraits::construct(valloc, data_ + i, *first);
+                ++first;
+                ++built;
+            }
+        } catch (...) {
+            _destroy(built);
+            throw;
+        }
+    }
+
+    // destroy the first [n] values in order and free the array
+    void _destroy(size_type n) {
+        if (data_ == nullptr) {
+            return;
+        }
+        size_type i = Eytzinger::first(size_);
+        for (; n > 0; n--) {
+            AllocTraits::destroy(valloc, data_ + i);
+            i = Eytzinger::next(i, size_);
+        }
+        AllocTraits::deallocate(valloc, data_, size_ + 1);
+        data_ = nullptr;
+        size_ = 0;
+    }
+};
+
+// AtomicSnapshot holds the current version of a read-only object, such as a FrozenTree.
+// Readers load() it and keep their copy of the pointer as long as they use it,
+// a writer builds the next version aside and store()s it, the old one is
+// freed when its last reader drops it.
+template<class T>
+class AtomicSnapshot {
+private:
+    std::shared_ptr<const T> current_;
+
+public:
+    AtomicSnapshot() = default;
+
+    explicit AtomicSnapshot(std::shared_ptr<const T> x) : current_(std::move(x)) {}
+
+    AtomicSnapshot(const AtomicSnapshot&) = delete;
+    AtomicSnapshot& operator=(const AtomicSnapshot&) = delete;
+
+    std::shared_ptr<const T> load() const {
+        return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+    }
+
+    void store(std::shared_ptr<const T> x) {
+        std::atomic_store_explicit(&current_, std::move(x), std::memory_order_release);
+    }
+
+    void store(T&& x) { store(std::make_shared<const T>(std::move(x))); }
+
+    // store [x], return the version it replaces
+    std::shared_ptr<const T> exchange(std::shared_ptr<const T> x) {
+        return std::atomic_exchange_explicit(&current_, std::move(x), std::memory_order_acq_rel);
+    }
+};
+
+}
+
+#endif //FLAK_FROZEN_TREE_H
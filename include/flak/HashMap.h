@@ -19,18 +19,23 @@ limitations under the License.
 #ifndef FLAK_HASHMAP_H
 #define FLAK_HASHMAP_H
 #include "HashTable.h"
+#include "FlatHashTable.h"
 #include <functional>
+#include <tuple>
 #include <utility>
 namespace flak {
 
 template<class Key, class Val,
         class HashFcn = std::hash<Key>,
         class EqualKey = std::equal_to<Key>,
-        class Alloc = std::allocator<Val>>
+        class Alloc = std::allocator<Val>,
+        class Engine = ChainedHashing>
 class HashMap {
 private:
-    typedef HashTable<pair<const Key, Val>, Key, HashFcn,
-                     std::_Select1st<pair<const Key, Val>>, EqualKey, Alloc> ht;
+    // Engine is ChainedHashing, PowerOfTwoHashing (HashTable.h),
+    // FlatHashing or GroupHashing (FlatHashTable.h)
+    typedef typename Engine::template rebind<pair<const Key, Val>, Key, HashFcn,
+            std::_Select1st<pair<const Key, Val>>, EqualKey, Alloc>::other ht;
     ht rep;
 public:
     typedef typename ht::key_type key_type;
@@ -51,7 +56,7 @@ public:
     key_equal keyEq() const { return rep.keyEq(); }
 
 protected:
-    typedef HashMap<Val, HashFcn, EqualKey, Alloc> Self;
+    typedef HashMap<Key, Val, HashFcn, EqualKey, Alloc, Engine> Self;
 
 public:
     HashMap() : rep(100, hasher(), key_equal()) {}
@@ -95,6 +100,43 @@ public:
                 p.second);
     }
 
+    pair<iterator, bool> insert(value_type&& obj) {
+        auto p = rep.insertUnique(std::move(obj));
+        return pair<iterator, bool>(
+                (iterator&) p.first,
+                p.second);
+    }
+
+    // construct the element in place
+    template<class... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        auto p = rep.emplaceUnique(std::forward<Args>(args)...);
+        return pair<iterator, bool>(
+                (iterator&) p.first,
+                p.second);
+    }
+
+    // construct the mapped value from [args] only if [key] does not exist
+    template<class... Args>
+    pair<iterator, bool> tryEmplace(const key_type& key, Args&&... args) {
+        iterator it = find(key);
+        if (it != end()) {
+            return pair<iterator, bool>(it, false);
+        }
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    pair<iterator, bool> tryEmplace(key_type&& key, Args&&... args) {
+        iterator it = find(key);
+        if (it != end()) {
+            return pair<iterator, bool>(it, false);
+        }
+        return emplace(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
     template<class InputIterator>
     void insert(InputIterator first, InputIterator last) {
         rep.insertUnique(first, last);
@@ -111,20 +153,29 @@ public:
                 p.second);
     }
 
-    iterator find(const key_type& key) const { return rep.find(key); }
+    iterator find(const key_type& key) { return rep.find(key); }
+    const_iterator find(const key_type& key) const { return rep.find(key); }
     size_type count(const key_type& key) const { return rep.count(key); }
 
+    // find [n] keys at once, see HashTable::findBatch
+    void findBatch(const key_type* keys, size_type n, iterator* out) { rep.findBatch(keys, n, out); }
+    void findBatch(const key_type* keys, size_type n, const_iterator* out) const {
+        rep.findBatch(keys, n, out);
+    }
+
     size_type erase(const key_type& key) { return rep.erase(key); }
     void erase(iterator it) { rep.erase(it); }
     void erase(iterator first, iterator last) { rep.erase(first, last); }
     void clear() { rep.clear(); }
 
     Val& operator[](const key_type& key) {
-        return (*( insert(value_type(key, Val())).first )).second;
+        return tryEmplace(key).first->second;
     }
 
 public:
     void resize(size_type hint) { rep.resize(hint); }
+    // only for the chained engines, see HashTable::setRehashStep
+    void setRehashStep(size_type n) { rep.setRehashStep(n); }
     size_type bucketCount() const { return rep.bucketCount(); }
     size_type maxBucketCount() const { return rep.maxBucketCount(); }
     size_type elemsInBucket(size_type n) const { return rep.elemsInBucket(n); }
@@ -18,6 +18,7 @@ limitations under the License.
 #define FLAK_HASHSET_H
 
 #include "HashTable.h"
+#include "FlatHashTable.h"
 #include <functional>
 #include <utility>
 namespace flak {
@@ -25,10 +26,14 @@ namespace flak {
 template<class Val,
         class HashFcn = std::hash<Val>,
         class EqualKey = std::equal_to<Val>,
-        class Alloc = std::allocator<Val>>
+        class Alloc = std::allocator<Val>,
+        class Engine = ChainedHashing>
 class HashSet {
 private:
-    typedef HashTable<Val, Val, HashFcn, std::_Identity<Val>, EqualKey, Alloc> ht;
+    // Engine is ChainedHashing, PowerOfTwoHashing (HashTable.h),
+    // FlatHashing or GroupHashing (FlatHashTable.h)
+    typedef typename Engine::template rebind<Val, Val, HashFcn,
+            std::_Identity<Val>, EqualKey, Alloc>::other ht;
     ht rep;
 public:
     typedef typename ht::key_type key_type;
@@ -49,7 +54,7 @@ public:
     key_equal keyEq() const { return rep.keyEq(); }
 
 protected:
-    typedef HashSet<Val, HashFcn, EqualKey, Alloc> Self;
+    typedef HashSet<Val, HashFcn, EqualKey, Alloc, Engine> Self;
 
 public:
     HashSet() : rep(100, hasher(), key_equal()) {}
@@ -91,6 +96,22 @@ public:
                 p.second);
     }
 
+    pair<iterator, bool> insert(value_type&& obj) {
+        auto p = rep.insertUnique(std::move(obj));
+        return pair<iterator, bool>(
+                (iterator&) p.first,
+                p.second);
+    }
+
+    // construct the element in place
+    template<class... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        auto p = rep.emplaceUnique(std::forward<Args>(args)...);
+        return pair<iterator, bool>(
+                (iterator&) p.first,
+                p.second);
+    }
+
     template<class InputIterator>
     void insert(InputIterator first, InputIterator last) {
         rep.insertUnique(first, last);
@@ -110,6 +131,11 @@ public:
     iterator find(const key_type& key) const { return rep.find(key); }
     size_type count(const key_type& key) const { return rep.count(key); }
 
+    // find [n] keys at once, see HashTable::findBatch
+    void findBatch(const key_type* keys, size_type n, iterator* out) const {
+        rep.findBatch(keys, n, out);
+    }
+
     size_type erase(const key_type& key) { return rep.erase(key); }
     void erase(iterator it) { rep.erase(it); }
     void erase(iterator first, iterator last) { rep.erase(first, last); }
@@ -117,6 +143,8 @@ public:
 
 public:
     void resize(size_type hint) { rep.resize(hint); }
+    // only for the chained engines, see HashTable::setRehashStep
+    void setRehashStep(size_type n) { rep.setRehashStep(n); }
     size_type bucketCount() const { return rep.bucketCount(); }
     size_type maxBucketCount() const { return rep.maxBucketCount(); }
     size_type elemsInBucket(size_type n) const { return rep.elemsInBucket(n); }
@@ -23,6 +23,25 @@ limitations under the License.
 // buckets : [0, 1, 2, 3, 4, 5, 6, 7]   (vector)
 //            |              |
 //           |-> n1 -> n2   |-> n1 -> n2 -> n3 (list)
+//
+// The bucket of a hash is decided by a bucket policy:
+//  PrimeBucketPolicy uses prime bucket counts and hash % n (the default).
+//  PowerOfTwoBucketPolicy uses power of two bucket counts and
+//  fibonacci hashing, so there is no division when we look for a bucket.
+//
+// By default, resize() moves all nodes to the new buckets at once.
+// After setRehashStep(n) with n > 0, resize() keeps the old buckets
+// and every insert, erase and non-const find moves n old buckets to
+// the new buckets, so no single operation pays for the whole table:
+//
+// old buckets : [x, x, x, 3, 4]         (x are moved, 3 and 4 are not yet)
+//                         |
+//                        |-> n1 -> n2
+// new buckets : [0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10]
+//
+// A node is in the old buckets if and only if its old bucket is not moved.
+// Iterators walk the old buckets first, and they are invalidated
+// by the operations that move buckets.
 
 
 #ifndef ALG_HASHTABLE_H
@@ -31,6 +50,9 @@ limitations under the License.
 #include <iterator>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
 
 using std::vector;
 using std::lower_bound;
@@ -39,25 +61,43 @@ using std::pair;
 
 namespace flak {
 
-template<class T>
+template<class T, bool CacheHash = false>
 struct HashTableNode {
     HashTableNode* next_;
     T val_;
 };
 
+// the node keeps the full hash code of its key
+template<class T>
+struct HashTableNode<T, true> {
+    HashTableNode* next_;
+    size_t hash_;
+    T val_;
+};
+
+// Whether the nodes keep the hash codes of [Key] by default.
+// Scalar keys are cheap to hash, the others like strings are not.
+// Specialize it for your key type to change the default.
+template<class Key>
+struct CacheHashCode : std::integral_constant<bool, !std::is_scalar<Key>::value> {};
+
+struct PrimeBucketPolicy;
+
 template<class Value, class Key, class HashFcn,
-        class ExtractKey, class EqualKey, class Alloc = std::allocator<Value>>
+        class ExtractKey, class EqualKey, class Alloc = std::allocator<Value>,
+        class BucketPolicy = PrimeBucketPolicy,
+        bool CacheHash = CacheHashCode<Key>::value>
 class HashTable;
 
 template<class Value, class Key, class HashFcn,
-        class ExtractKey, class EqualKey, class Alloc>
+        class ExtractKey, class EqualKey, class Alloc, class BucketPolicy, bool CacheHash>
 struct HashTableIterator {
     typedef HashTable<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc> HashTable;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash> hashtable;
     typedef HashTableIterator<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc> iterator;
-    typedef HashTableNode<Value> Node;
-    typedef HashTableNode<Value>* NodePtr;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash> iterator;
+    typedef HashTableNode<Value, CacheHash> Node;
+    typedef HashTableNode<Value, CacheHash>* NodePtr;
 
     typedef std::forward_iterator_tag iterator_category;
     typedef Value value_type;
@@ -67,9 +107,9 @@ struct HashTableIterator {
     typedef Value* pointer;
 
     NodePtr cur_;
-    HashTable* ht_;
+    hashtable* ht_;
 
-    HashTableIterator(NodePtr n, HashTable* tab) : cur_(n), ht_(tab) {}
+    HashTableIterator(NodePtr n, hashtable* tab) : cur_(n), ht_(tab) {}
 
     HashTableIterator() = default;
 
@@ -81,10 +121,7 @@ struct HashTableIterator {
         const NodePtr old = cur_;
         cur_ = cur_->next_;
         if (!cur_) {
-            size_type bucket = ht_->bkt_num(old->val_);
-            while (!cur_ && ++bucket < ht_->buckets_.size()) {
-                cur_ = ht_->buckets_[bucket];
-            }
+            cur_ = ht_->_nextBucketHead(old);
         }
         return *this;
     }
@@ -101,14 +138,14 @@ struct HashTableIterator {
 };
 
 template<class Value, class Key, class HashFcn,
-        class ExtractKey, class EqualKey, class Alloc>
+        class ExtractKey, class EqualKey, class Alloc, class BucketPolicy, bool CacheHash>
 struct HashTableConstIterator {
     typedef HashTable<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc> HashTable;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash> hashtable;
     typedef HashTableConstIterator<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc> const_iterator;
-    typedef HashTableNode<Value> Node;
-    typedef HashTableNode<Value>* NodePtr;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash> const_iterator;
+    typedef HashTableNode<Value, CacheHash> Node;
+    typedef HashTableNode<Value, CacheHash>* NodePtr;
 
     typedef std::forward_iterator_tag iterator_category;
     typedef Value value_type;
@@ -118,9 +155,9 @@ struct HashTableConstIterator {
     typedef const Value* pointer;
 
     const Node* cur_; // not equal to "const NodePtr"
-    const HashTable* ht_;
+    const hashtable* ht_;
 
-    HashTableConstIterator(const Node* n, const HashTable* tab) : cur_(n), ht_(tab) {}
+    HashTableConstIterator(const Node* n, const hashtable* tab) : cur_(n), ht_(tab) {}
 
     HashTableConstIterator() = default;
 
@@ -132,10 +169,7 @@ struct HashTableConstIterator {
         const Node* old = cur_;
         cur_ = cur_->next_;
         if (!cur_) {
-            size_type bucket = ht_->bkt_num(old->val_);
-            while (!cur_ && ++bucket < ht_->buckets_.size()) {
-                cur_ = ht_->buckets_[bucket];
-            }
+            cur_ = ht_->_nextBucketHead(old);
         }
         return *this;
     }
@@ -171,8 +205,39 @@ inline unsigned long next_prime(unsigned long n) {
     return pos == last ? *(last - 1) : *pos;
 }
 
+// prime bucket counts, the bucket is hash % n
+struct PrimeBucketPolicy {
+    static size_t nextSize(size_t n) { return next_prime(n); }
+
+    static size_t maxSize() { return prime_list[num_primes - 1]; }
+
+    static size_t index(size_t hash, size_t n) { return hash % n; }
+};
+
+// Power of two bucket counts with fibonacci hashing.
+// The hash multiplied by 2^64 / golden ratio spreads to the high bits,
+// and the top log2(n) bits are the bucket, so there is no division.
+// You can learn it at https://en.wikipedia.org/wiki/Hash_function#Fibonacci_hashing .
+struct PowerOfTwoBucketPolicy {
+    static size_t nextSize(size_t n) {
+        size_t size = 8;
+        while (size < n && size < maxSize()) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static size_t maxSize() { return size_t(1) << (sizeof(size_t) * 8 - 1); }
+
+    static size_t index(size_t hash, size_t n) {
+        const std::uint64_t h = static_cast<std::uint64_t>(hash) * 11400714819323198485ull;
+        // n is a power of two, so ctz(n) is log2(n)
+        return static_cast<size_t>(h >> (64 - __builtin_ctzll(n)));
+    }
+};
+
 template<class Value, class Key, class HashFcn,
-        class ExtractKey, class EqualKey, class Alloc>
+        class ExtractKey, class EqualKey, class Alloc, class BucketPolicy, bool CacheHash>
 class HashTable {
 public:
     typedef HashFcn hasher;
@@ -192,8 +257,8 @@ private:
     EqualKey equals_;
     ExtractKey getKey_;
 
-    typedef HashTableNode<Value> Node;
-    typedef HashTableNode<Value>* NodePtr;
+    typedef HashTableNode<Value, CacheHash> Node;
+    typedef HashTableNode<Value, CacheHash>* NodePtr;
 
     typedef typename Alloc::template rebind<Value>::other ValueAlloc;
     typedef std::allocator_traits<ValueAlloc> ValueAllocTraits;
@@ -205,25 +270,30 @@ private:
     vector<NodePtr, NodePtrAlloc> buckets_;
     size_type num_elements_;
 
+    // the buckets being moved by incremental rehashing, empty if not rehashing
+    vector<NodePtr, NodePtrAlloc> old_buckets_;
+    size_type rehash_pos_;   // the old buckets before it have been moved
+    size_type rehash_step_;  // 0 means rehashing all at once
+
 public:
 
     typedef HashTableIterator<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc> iterator;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash> iterator;
 
     typedef HashTableConstIterator<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc> const_iterator;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash> const_iterator;
 
     // iterator will access the private variable bucket
     friend struct HashTableIterator<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc>;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash>;
     friend struct HashTableConstIterator<Value, Key, HashFcn,
-            ExtractKey, EqualKey, Alloc>;
+            ExtractKey, EqualKey, Alloc, BucketPolicy, CacheHash>;
 
 public:
     size_type bucketCount() const { return buckets_.size(); }
 
     size_type maxBucketCount() const {
-        return prime_list[num_primes - 1];
+        return BucketPolicy::maxSize();
     }
 
     hasher hashFunc() const { return hash_; }
@@ -233,10 +303,17 @@ public:
 protected:
     NodeAlloc nalloc;
 
-    NodePtr newNode(const Value& obj) {
+    // construct the value of a new node from [args]
+    template<class... Args>
+    NodePtr newNode(Args&&... args) {
         NodePtr n = NodePtrAllocTraits::allocate(nalloc, 1);
         n->next_ = nullptr;
-        NodePtrAllocTraits::construct(nalloc, &n->val_, obj);
+        try {
+            NodePtrAllocTraits::construct(nalloc, &n->val_, std::forward<Args>(args)...);
+        } catch (...) {
+            NodePtrAllocTraits::deallocate(nalloc, n, 1);
+            throw;
+        }
         return n;
     }
 
@@ -247,19 +324,34 @@ protected:
 
 public:
     HashTable(size_type n, const HashFcn& hf, const EqualKey& eql)
-            : hash_(hf), equals_(eql), getKey_(ExtractKey()), num_elements_(0) {
+            : hash_(hf), equals_(eql), getKey_(ExtractKey()), num_elements_(0),
+              rehash_pos_(0), rehash_step_(0) {
         initialize_buckets(n);
     }
 
+    // Move [n] old buckets per insert, erase and non-const find when resizing.
+    // 0 moves all buckets at once in resize(), which is the default.
+    void setRehashStep(size_type n) {
+        rehash_step_ = n;
+        if (n == 0) {
+            _finishRehash();
+        }
+    }
+
+    size_type rehashStep() const { return rehash_step_; }
+
+    // whether some nodes are still in the old buckets
+    bool rehashing() const { return !old_buckets_.empty(); }
+
     void initialize_buckets(size_type n) {
-        // get the prime that last to n
+        // get the bucket count that last to n
         const size_type n_buckets = next_size(n);
         buckets_.reserve(n_buckets); // init size
         buckets_.insert(buckets_.end(), n_buckets, (NodePtr) nullptr);
         num_elements_ = 0;
     }
 
-    size_type next_size(size_type n) const { return next_prime(n); }
+    size_type next_size(size_type n) const { return BucketPolicy::nextSize(n); }
 
     size_type size() const { return num_elements_; }
 
@@ -276,56 +368,61 @@ public:
 
     iterator begin() {  // no const
         // the first element with node from left to right
-        for (size_type i = 0; i < buckets_.size(); i++) {
-            if (buckets_[i]) {
-                return iterator(buckets_[i], this);
-            }
-        }
-        return end();
+        return iterator(_firstBucketHead(), this);
     }
 
     const_iterator begin() const {
-        for (size_type i = 0; i < buckets_.size(); i++) {
-            if (buckets_[i]) {
-                return const_iterator(buckets_[i], this);
-            }
-        }
-        return end();
+        return const_iterator(_firstBucketHead(), this);
     }
 
     // find the element of specific key
     iterator find(const Key& key) {
-        size_type n = bkt_num_key(key);
-        NodePtr first = buckets_[n];
-        while (first != nullptr && !equals_(getKey_(first->val_), key)) {
+        _rehashStep();
+        const size_type h = hash_(key);
+        NodePtr first = _bucketHead(h);
+        while (first != nullptr && !_matches(first, h, key)) {
             first = first->next_;
         }
         return iterator(first, this);
     }
 
     const_iterator find(const Key& key) const {
-        size_type n = bkt_num_key(key);
-        NodePtr first = buckets_[n];
-        while (first != nullptr && !equals_(getKey_(first->val_), key)) {
+        const size_type h = hash_(key);
+        NodePtr first = _bucketHead(h);
+        while (first != nullptr && !_matches(first, h, key)) {
             first = first->next_;
         }
         return const_iterator(first, this);
     }
 
+    // Find [n] keys and put the results to [out], same as find() one by one.
+    // The buckets and nodes of the following keys are prefetched
+    // so the cache misses of independent keys overlap.
+    void findBatch(const Key* keys, size_type n, iterator* out) {
+        _rehashStep();
+        _findBatch(keys, n, out);
+    }
+
+    void findBatch(const Key* keys, size_type n, const_iterator* out) const {
+        _findBatch(keys, n, out);
+    }
+
     // erase elements.
     // Two different operation:
     //  1. consider the second node to the last node of bucket
     //  2. consider the first node
     // Return the number of erased node
     size_type erase(const Key& key) {
-        size_type n = bkt_num_key(key);
-        NodePtr first = buckets_[n];
+        _rehashStep();
+        const size_type h = hash_(key);
+        NodePtr& head = _bucketHead(h);
+        NodePtr first = head;
         size_type erased = 0;
         if (first) {
             NodePtr cur = first;
             NodePtr next = cur->next_;
             while (next) {
-                if (equals_(getKey_(next->val_), key)) {
+                if (_matches(next, h, key)) {
                     cur->next_ = next->next_;
                     deleteNode(next);
                     next = cur->next_;
@@ -336,8 +433,8 @@ public:
                     next = cur->next_;
                 }
             }
-            if (equals_(getKey_(first->val_), key)) {
-                buckets_[n] = first->next_;
+            if (_matches(first, h, key)) {
+                head = first->next_;
                 deleteNode(first);
                 erased++;
                 num_elements_--;
@@ -346,13 +443,14 @@ public:
         return erased;
     }
 
+    // It does not move buckets, so you can erase while iterating.
     void erase(const iterator& it) {
         NodePtr p = it.cur_;
         if (p) {
-            const size_type n = bkt_num(p->val_);
-            NodePtr cur = buckets_[n];
+            NodePtr& head = _bucketHead(_hashOf(p));
+            NodePtr cur = head;
             if (cur == p) {
-                buckets_[n] = cur->next_;
+                head = cur->next_;
                 deleteNode(cur);
                 --num_elements_;
             } else {
@@ -373,8 +471,17 @@ public:
     }
 
     void erase(iterator first, iterator last) {
-        size_type fbucket = first.cur_ ? bkt_num(first.cur_->val_) : buckets_.size();
-        size_type lbucket = last.cur_ ? bkt_num(last.cur_->val_) : buckets_.size();
+        if (rehashing()) { // the nodes are in two bucket arrays, erase one by one
+            while (first != last) {
+                iterator next = first;
+                ++next;
+                erase(first);
+                first = next;
+            }
+            return;
+        }
+        size_type fbucket = first.cur_ ? _bucketOf(first.cur_) : buckets_.size();
+        size_type lbucket = last.cur_ ? _bucketOf(last.cur_) : buckets_.size();
         if (first.cur_ == last.cur_) {
             return;
         } else if (fbucket == lbucket) { // first and last in the same bucket
@@ -399,12 +506,12 @@ public:
     }
 
     size_type count(const Key& key) const {
-        const size_type n = bkt_num_key(key);
-        NodePtr first = buckets_[n];
+        const size_type h = hash_(key);
+        NodePtr first = _bucketHead(h);
         size_type res = 0;
 
         while (first) {
-            if (equals_(getKey_(first->val_), key)) {
+            if (_matches(first, h, key)) {
                 res++;
             }
             first = first->next_;
@@ -416,7 +523,37 @@ public:
     // insert unique with resize
     pair<iterator, bool> insertUnique(const Value& obj) {
         resize(num_elements_ + 1);
-        return insertUniqueNoresize(obj);
+        _rehashStep();
+        return _insertUniqueNoresize(obj);
+    }
+
+    pair<iterator, bool> insertUnique(Value&& obj) {
+        resize(num_elements_ + 1);
+        _rehashStep();
+        return _insertUniqueNoresize(std::move(obj));
+    }
+
+    // Construct the value in a new node, and insert it if the key does not exist.
+    // The key is only known after the construction,
+    // so the node is destroyed again when the key exists.
+    template<class... Args>
+    pair<iterator, bool> emplaceUnique(Args&&... args) {
+        resize(num_elements_ + 1);
+        _rehashStep();
+        NodePtr tmp = newNode(std::forward<Args>(args)...);
+        const size_type h = hash_(getKey_(tmp->val_));
+        NodePtr& head = _bucketHead(h);
+        for (NodePtr cur = head; cur; cur = cur->next_) {
+            if (_matches(cur, h, getKey_(tmp->val_))) {
+                deleteNode(tmp);
+                return pair<iterator, bool>(iterator(cur, this), false);
+            }
+        }
+        _setHash(tmp, h);
+        tmp->next_ = head;
+        head = tmp;
+        ++num_elements_;
+        return pair<iterator, bool>(iterator(tmp, this), true);
     }
 
     template <class InputIterator>
@@ -432,12 +569,21 @@ public:
         if (hint > old_size) {
             const size_type new_size = next_size(hint);
             if (new_size > old_size) {
+                // a former rehashing must be finished before the next one
+                _finishRehash();
                 vector<NodePtr, NodePtrAlloc> tmp(new_size, (NodePtr) nullptr); // new vector
+                if (rehash_step_ != 0) {
+                    // keep the old buckets, they are moved by the following operations
+                    old_buckets_.swap(buckets_);
+                    buckets_.swap(tmp);
+                    return;
+                }
                 for (size_type bucket = 0; bucket < old_size; ++bucket) {
                     NodePtr first = buckets_[bucket];
                     while (first) {
                         // get the new position
-                        size_type new_bucket = bkt_num(first->val_, new_size);
+                        // the cached hash code saves hashing the key again
+                        size_type new_bucket = BucketPolicy::index(_hashOf(first), new_size);
                         // move the children node to first position of current position
                         buckets_[bucket] = first->next_;
                         // the children pointer links to the first node of new bucket.
@@ -456,26 +602,54 @@ public:
     }
 
     pair<iterator, bool> insertUniqueNoresize(const Value& obj) {
-        const size_type n = bkt_num(obj);
-        NodePtr first = buckets_[n];
+        return _insertUniqueNoresize(obj);
+    }
+
+    pair<iterator, bool> insertUniqueNoresize(Value&& obj) {
+        return _insertUniqueNoresize(std::move(obj));
+    }
+
+private:
+    // [obj] is only copied or moved when it is inserted
+    template<class V>
+    pair<iterator, bool> _insertUniqueNoresize(V&& obj) {
+        const size_type h = hash_(getKey_(obj));
+        NodePtr& head = _bucketHead(h);
+        NodePtr first = head;
         // check whether the same node existed or not.
         for (NodePtr cur = first; cur; cur = cur->next_) {
-            if (equals_(getKey_(cur->val_), getKey_(obj))) {
+            if (_matches(cur, h, getKey_(obj))) {
                 return pair<iterator, bool>(iterator(cur, this), false);
             }
         }
         // first point to first position
-        NodePtr tmp = newNode(obj);
+        NodePtr tmp = newNode(std::forward<V>(obj));
+        _setHash(tmp, h);
         tmp->next_ = first;
-        buckets_[n] = tmp; // become the new first node.
+        head = tmp; // become the new first node.
         ++num_elements_;
         return pair<iterator, bool>(iterator(tmp, this), true);
     }
 
+public:
     // allow replaced key
     iterator insertEqual(const Value& obj) {
         resize(num_elements_ + 1);
-        return insert_equal_noresize(obj);
+        _rehashStep();
+        return _insertEqualNode(newNode(obj));
+    }
+
+    iterator insertEqual(Value&& obj) {
+        resize(num_elements_ + 1);
+        _rehashStep();
+        return _insertEqualNode(newNode(std::move(obj)));
+    }
+
+    template<class... Args>
+    iterator emplaceEqual(Args&&... args) {
+        resize(num_elements_ + 1);
+        _rehashStep();
+        return _insertEqualNode(newNode(std::forward<Args>(args)...));
     }
 
     template <class InputIterator>
@@ -486,11 +660,18 @@ public:
     }
 
     iterator insert_equal_noresize(const Value& obj) {
-        const size_type n = bkt_num(obj);
-        NodePtr first = buckets_[n];
+        return _insertEqualNode(newNode(obj));
+    }
+
+private:
+    // link the new node [tmp], it always succeeds
+    iterator _insertEqualNode(NodePtr tmp) {
+        const size_type h = hash_(getKey_(tmp->val_));
+        _setHash(tmp, h);
+        NodePtr& head = _bucketHead(h);
+        NodePtr first = head;
         for (NodePtr cur = first; cur; cur = cur->next_) {
-            if (equals_(getKey_(cur->val_), getKey_(obj))) {
-                NodePtr tmp = newNode(obj);
+            if (_matches(cur, h, getKey_(tmp->val_))) {
                 tmp->next_ = cur->next_;  // insert to the back of same element
                 cur->next_ = tmp;
                 ++num_elements_;
@@ -498,13 +679,14 @@ public:
             }
         }
         // no same key
-        NodePtr tmp = newNode(obj);
         tmp->next_ = first;
-        buckets_[n] = tmp;
+        head = tmp;
         ++num_elements_;
         return iterator(tmp, this);
     }
 
+public:
+
     size_type bkt_num(const Value& obj, size_type n) const {
         return bkt_num_key(getKey_(obj), n);
     }
@@ -518,11 +700,12 @@ public:
     }
 
     size_type bkt_num_key(const Key& key, size_type n) const {
-        return hash_(key) % n;
+        return BucketPolicy::index(hash_(key), n);
     }
 
 public:
     void clear() {
+        _finishRehash();
         for (size_type i = 0; i < buckets_.size(); i++) {
             NodePtr cur = buckets_[i];
             while (cur != 0) {
@@ -539,18 +722,30 @@ public:
 
     // a deep copy function that copy data from other hashtable
     void copyFrom(const HashTable& ht) {
+        old_buckets_.clear();
+        rehash_pos_ = 0;
+        if (ht.rehashing()) { // copy node by node into one bucket array
+            buckets_.assign(ht.buckets_.size(), (NodePtr) nullptr);
+            num_elements_ = 0;
+            for (const_iterator it = ht.begin(); it != ht.end(); ++it) {
+                insert_equal_noresize(*it);
+            }
+            return;
+        }
         buckets_.clear();
         buckets_.reserve(ht.buckets_.size());
         // After clear, end() is equal to begin()
         buckets_.insert(buckets_.end(), ht.buckets_.size(), (NodePtr) nullptr);
         for (size_type i = 0; i < ht.buckets_.size(); i++) {
-            if (const NodePtr cur = ht.buckets_[i]) {
+            if (NodePtr cur = ht.buckets_[i]) {
                 // copy the first node
                 NodePtr copy = newNode(cur->val_);
+                _setHash(copy, ht._hashOf(cur));
                 buckets_[i] = copy;
                 // copy the following node.
                 for (NodePtr next = cur->next_; next; cur = next, next = cur->next_) {
                     copy->next_ = newNode(next->val_);
+                    _setHash(copy->next_, ht._hashOf(next));
                     copy = copy->next_;
                 }
             }
@@ -558,6 +753,7 @@ public:
         num_elements_ = ht.num_elements_;
     }
 
+    // the bucket of the new buckets if rehashing
     size_type elemsInBucket(size_type bucket) const {
         size_type res = 0;
         for (NodePtr n = buckets_[bucket]; n; n = n->next_) {
@@ -567,6 +763,172 @@ public:
     }
 
 private:
+    // findBatch works on key i + 2 * d, i + d and i at the same time:
+    // prefetch the bucket, prefetch the first node, resolve the key.
+    static const size_type batch_distance = 8;
+
+    template<class It>
+    void _findBatch(const Key* keys, size_type n, It* out) const {
+        const size_type d = batch_distance, ring = 4 * batch_distance;
+        NodePtr* slots[ring];
+        size_type hashes[ring];
+        HashTable* self = const_cast<HashTable*>(this);
+        for (size_type i = 0; i < n + 2 * d; i++) {
+            if (i < n) {
+                hashes[i % ring] = hash_(keys[i]);
+                slots[i % ring] = &self->_bucketHead(hashes[i % ring]);
+                __builtin_prefetch(slots[i % ring]);
+            }
+            if (i >= d && i - d < n) {
+                if (NodePtr first = *slots[(i - d) % ring]) {
+                    __builtin_prefetch(first);
+                }
+            }
+            if (i >= 2 * d && i - 2 * d < n) {
+                const size_type k = i - 2 * d;
+                NodePtr first = *slots[k % ring];
+                while (first != nullptr && !_matches(first, hashes[k % ring], keys[k])) {
+                    first = first->next_;
+                }
+                out[k] = It(first, self);
+            }
+        }
+    }
+
+    // the hash code of the key of [n]
+    size_type _hashOf(const Node* n) const {
+        return _hashOf(n, std::integral_constant<bool, CacheHash>());
+    }
+
+    size_type _hashOf(const Node* n, std::true_type) const { return n->hash_; }
+
+    size_type _hashOf(const Node* n, std::false_type) const { return hash_(getKey_(n->val_)); }
+
+    // remember the hash code [h] of the key of [n]
+    static void _setHash(NodePtr n, size_type h) {
+        _setHash(n, h, std::integral_constant<bool, CacheHash>());
+    }
+
+    static void _setHash(NodePtr n, size_type h, std::true_type) { n->hash_ = h; }
+
+    static void _setHash(NodePtr, size_type, std::false_type) {}
+
+    // whether [n] holds [key] with the hash code [h]
+    bool _matches(const Node* n, size_type h, const Key& key) const {
+        return _matches(n, h, key, std::integral_constant<bool, CacheHash>());
+    }
+
+    // compare the hash codes first, EqualKey is called only if they are equal
+    bool _matches(const Node* n, size_type h, const Key& key, std::true_type) const {
+        return n->hash_ == h && equals_(getKey_(n->val_), key);
+    }
+
+    bool _matches(const Node* n, size_type, const Key& key, std::false_type) const {
+        return equals_(getKey_(n->val_), key);
+    }
+
+    // the bucket of [n], in the new buckets if rehashing
+    size_type _bucketOf(const Node* n) const {
+        return BucketPolicy::index(_hashOf(n), buckets_.size());
+    }
+
+    // the head of the bucket holding [hash]
+    NodePtr& _bucketHead(size_type hash) {
+        if (!old_buckets_.empty()) {
+            const size_type n = BucketPolicy::index(hash, old_buckets_.size());
+            if (n >= rehash_pos_) {
+                return old_buckets_[n];
+            }
+        }
+        return buckets_[BucketPolicy::index(hash, buckets_.size())];
+    }
+
+    NodePtr _bucketHead(size_type hash) const {
+        return const_cast<HashTable*>(this)->_bucketHead(hash);
+    }
+
+    NodePtr _firstBucketHead() const {
+        for (size_type i = rehash_pos_; i < old_buckets_.size(); i++) {
+            if (old_buckets_[i]) {
+                return old_buckets_[i];
+            }
+        }
+        for (size_type i = 0; i < buckets_.size(); i++) {
+            if (buckets_[i]) {
+                return buckets_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // the first node of the buckets behind the bucket of [old]
+    NodePtr _nextBucketHead(const Node* old) const {
+        const size_type hash = _hashOf(old);
+        size_type bucket;
+        if (!old_buckets_.empty()) {
+            bucket = BucketPolicy::index(hash, old_buckets_.size());
+            if (bucket >= rehash_pos_) { // old is in the old buckets
+                while (++bucket < old_buckets_.size()) {
+                    if (old_buckets_[bucket]) {
+                        return old_buckets_[bucket];
+                    }
+                }
+                // go on with the new buckets
+                for (bucket = 0; bucket < buckets_.size(); ++bucket) {
+                    if (buckets_[bucket]) {
+                        return buckets_[bucket];
+                    }
+                }
+                return nullptr;
+            }
+        }
+        bucket = BucketPolicy::index(hash, buckets_.size());
+        while (++bucket < buckets_.size()) {
+            if (buckets_[bucket]) {
+                return buckets_[bucket];
+            }
+        }
+        return nullptr;
+    }
+
+    // move the nodes of the old bucket [n] to the new buckets
+    void _moveOldBucket(size_type n) {
+        NodePtr first = old_buckets_[n];
+        while (first) {
+            NodePtr next = first->next_;
+            size_type new_bucket = BucketPolicy::index(_hashOf(first), buckets_.size());
+            first->next_ = buckets_[new_bucket];
+            buckets_[new_bucket] = first;
+            first = next;
+        }
+        old_buckets_[n] = nullptr;
+    }
+
+    // move [rehash_step_] old buckets
+    void _rehashStep() {
+        if (!old_buckets_.empty()) {
+            const size_type last = std::min(rehash_pos_ + rehash_step_, old_buckets_.size());
+            for (; rehash_pos_ < last; ++rehash_pos_) {
+                _moveOldBucket(rehash_pos_);
+            }
+            if (rehash_pos_ == old_buckets_.size()) {
+                vector<NodePtr, NodePtrAlloc>().swap(old_buckets_); // free the old buckets
+                rehash_pos_ = 0;
+            }
+        }
+    }
+
+    // move all the remaining old buckets
+    void _finishRehash() {
+        if (!old_buckets_.empty()) {
+            for (; rehash_pos_ < old_buckets_.size(); ++rehash_pos_) {
+                _moveOldBucket(rehash_pos_);
+            }
+            vector<NodePtr, NodePtrAlloc>().swap(old_buckets_);
+            rehash_pos_ = 0;
+        }
+    }
+
     void _eraseBucket(const size_type n, NodePtr last) {
         NodePtr cur = buckets_[n];
         while (cur != last) {
@@ -595,6 +957,27 @@ private:
     }
 };
 
+// Table engine selector for HashMap and HashSet.
+// It rebinds to the separate chaining HashTable, which is the default.
+struct ChainedHashing {
+    template<class Value, class Key, class HashFcn,
+            class ExtractKey, class EqualKey, class Alloc>
+    struct rebind {
+        typedef HashTable<Value, Key, HashFcn, ExtractKey, EqualKey, Alloc> other;
+    };
+};
+
+// Table engine selector for HashMap and HashSet.
+// It rebinds to the separate chaining HashTable with power of two buckets.
+struct PowerOfTwoHashing {
+    template<class Value, class Key, class HashFcn,
+            class ExtractKey, class EqualKey, class Alloc>
+    struct rebind {
+        typedef HashTable<Value, Key, HashFcn, ExtractKey, EqualKey, Alloc,
+                PowerOfTwoBucketPolicy> other;
+    };
+};
+
 }
 
 #endif //ALG_HASHTABLE_H
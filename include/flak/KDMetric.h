@@ -0,0 +1,97 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// The distances of KDTree and FrozenKDTree. A metric folds the absolute
+// differences of the coordinates axis by axis:
+//
+//   distance = finish(combine(... combine(term(d0), term(d1)) ..., term(dn)))
+//
+// and finish(term(d)) of a single axis is never more than the distance,
+// so it bounds the points on the far side of a split d away from the query.
+// The distance grows with each difference, so the nearest and the farthest
+// points of a box are the ones nearest and farthest on every axis.
+// The distance type is a template parameter of the trees, by default the
+// coordinate type for floating point and size_t for the integers.
+
+#ifndef FLAK_KDMETRIC_H
+#define FLAK_KDMETRIC_H
+
+#include <cstddef>
+#include <type_traits>
+
+namespace flak {
+
+// squared euclidean distance, the default
+struct EuclideanMetric {
+    template<class Dist> static Dist term(Dist d) { return d * d; }
+    template<class Dist> static Dist combine(Dist sum, Dist t) { return sum + t; }
+    template<class Dist> static Dist finish(Dist sum) { return sum; }
+};
+
+// L1, the sum of the differences
+struct ManhattanMetric {
+    template<class Dist> static Dist term(Dist d) { return d; }
+    template<class Dist> static Dist combine(Dist sum, Dist t) { return sum + t; }
+    template<class Dist> static Dist finish(Dist sum) { return sum; }
+};
+
+// L-infinity, the largest difference
+struct ChebyshevMetric {
+    template<class Dist> static Dist term(Dist d) { return d; }
+    template<class Dist> static Dist combine(Dist sum, Dist t) { return sum < t ? t : sum; }
+    template<class Dist> static Dist finish(Dist sum) { return sum; }
+};
+
+// 1 - cos(a, b) of unit vectors, which is |a - b|^2 / 2 for them,
+// so the points must be normalized and the distance floating point
+struct CosineMetric {
+    template<class Dist> static Dist term(Dist d) { return d * d; }
+    template<class Dist> static Dist combine(Dist sum, Dist t) { return sum + t; }
+    template<class Dist> static Dist finish(Dist sum) { return sum / 2; }
+};
+
+template<class Coord>
+struct KDDistance {
+    typedef typename std::conditional<std::is_floating_point<Coord>::value,
+            Coord, size_t>::type type;
+};
+
+// |a - b| in the distance type, which may be unsigned
+template<class Dist, class CoordA, class CoordB>
+inline Dist _kdAbsDiff(const CoordA& a, const CoordB& b) {
+    return a < b ? Dist(b) - Dist(a) : Dist(a) - Dist(b);
+}
+
+// the distance of the points [a] and [b] of [dim] dimensions
+template<class Metric, class Dist, class PointA, class PointB, class DimType>
+inline Dist _kdDistance(const PointA& a, const PointB& b, DimType dim) {
+    Dist sum = Dist();
+    for (DimType i = 0; i < dim; i++) {
+        sum = Metric::combine(sum, Metric::term(_kdAbsDiff<Dist>(a[i], b[i])));
+    }
+    return Metric::finish(sum);
+}
+
+// no more than the distance to the points [d] away on one axis
+template<class Metric, class Dist>
+inline Dist _kdAxisBound(Dist d) {
+    return Metric::finish(Metric::term(d));
+}
+
+}
+
+#endif //FLAK_KDMETRIC_H
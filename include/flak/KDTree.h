@@ -41,17 +41,37 @@ limitations under the License.
  *
  * ...
  *
+ *
+ *  Inserting the points one by one in a sorted or clustered order makes a
+ *  deep tree. The bulk constructor builds a balanced one instead: it takes
+ *  the median point of the split dimension as the root, the smaller points
+ *  go low, the others go high, and the two halves are built the same way,
+ *  on their own threads near the top. The split dimension cycles by depth
+ *  like insert, or is the dimension with the largest spread of the points.
+ *
+ *  The distance of the queries is a policy of KDMetric.h, the squared
+ *  euclidean one by default, in floating point for floating point points.
+ *  A far side is searched only if its split is nearer than the k-th point,
+ *  and by the radius and box queries only if its split is within reach.
+ *  findKNearestBatch runs many queries on several threads.
  */
 
 #ifndef FLAK_KDTREE_H
 #define FLAK_KDTREE_H
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <iterator>
 #include <stack>
+#include <thread>
 #include <queue>
 #include <utility>
 #include <vector>
 #include <limits>
+#include <type_traits>
+#include "FrozenKDTree.h"
+#include "KDMetric.h"
 #include "PriorityQueue.h"
 using std::array;
 using std::pair;
@@ -62,9 +82,14 @@ using std::priority_queue;
 
 namespace flak {
 
-template<typename Point, typename Val, typename DimType>
+template<typename Point, typename Val, typename DimType, typename Metric, typename Distance>
 class _KDQuery;
 
+template<typename Point>
+struct KDCoord {
+    typedef typename std::decay<decltype(std::declval<const Point&>()[0])>::type type;
+};
+
 template<typename Val, typename DimType>
 struct KDNode {
     typedef KDNode<Val, DimType> Self;
@@ -119,7 +144,10 @@ public:
     }
 };
 
-template<typename Point, typename Val, typename DimType = size_t>
+// [Metric] is one of KDMetric.h, [Distance] the type of the distances
+template<typename Point, typename Val, typename DimType = size_t,
+        typename Metric = EuclideanMetric,
+        typename Distance = typename KDDistance<typename KDCoord<Point>::type>::type>
 class KDTree {
 public:
     typedef Point key_type;
@@ -133,17 +161,69 @@ public:
     typedef KDNode<value_type, DimType> Node;
     typedef KDNode<value_type, DimType>* NodePtr;
     typedef KDNodeIterator<value_type, DimType> iterator;
-    typedef _KDQuery<Point, Val, DimType> Query;
+    typedef Metric metric_type;
+    typedef Distance distance_type;
+    typedef _KDQuery<Point, Val, DimType, Metric, Distance> Query;
+
+    // how the bulk constructor chooses the split dimension of a node
+    enum SplitRule {
+        split_cycle,    // the next dimension of the parent, as insert does
+        split_spread    // the dimension with the largest spread of the points below
+    };
+
+    // the subtrees smaller than this are not worth a thread
+    static const size_type parallel_grain = 1 << 14;
+    // the queries of findKNearestBatch a thread takes at a time
+    static const size_type batch_grain = 64;
+
+    typedef typename KDCoord<Point>::type coord_type;
+    typedef FrozenKDTree<coord_type, mapped_type, Metric, Distance> frozen_type;
 
 private:
     NodePtr root_;
     size_type size_;
     DimType dimension_;
-    static const key_type pointOf(NodePtr n) { return n->value_.first; };
+    static const key_type& pointOf(NodePtr n) { return n->value_.first; };
     static mapped_type& valueOf(NodePtr n) { return n->value_.second; };
 
 public:
     explicit KDTree(DimType dim): root_(nullptr), size_(0), dimension_(dim) {}
+
+    // Build a balanced tree from the pairs of point and value in [first, last).
+    // Of the repeated points the last value is kept, as insert would.
+    // [threads] is the number of threads to use, 0 for all the cores.
+    // The comparison of the coordinates must not throw.
+    template<class InputIterator>
+    KDTree(InputIterator first, InputIterator last, DimType dim,
+           SplitRule rule = split_cycle, unsigned threads = 0)
+            : root_(nullptr), size_(0), dimension_(dim) {
+        vector<NodePtr> nodes;
+        try {
+            for (; first != last; ++first) {
+                nodes.push_back(nullptr);
+                nodes.back() = new Node(*first, 0);
+            }
+            _unique(nodes);
+        } catch (...) {
+            for (NodePtr n : nodes) {
+                delete n;
+            }
+            throw;
+        }
+        if (nodes.empty()) {
+            return;
+        }
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        int levels = 0;   // the levels of the recursion that fork
+        while ((1u << levels) < threads) {
+            levels++;
+        }
+        root_ = _build(nodes.data(), nodes.data() + nodes.size(), 0, rule, levels);
+        size_ = nodes.size();
+    }
+
     size_type max_size() const { return std::numeric_limits<size_type>::max(); }
     size_type size() { return size_; }
     bool empty() { return size_ == 0; }
@@ -167,13 +247,13 @@ public:
     }
 
     // find the [k] nearest points of [p].
-    // return a array with value of pair<size_type, iterator>.
+    // return a array with value of pair<distance_type, iterator>.
     // the pair.first is the distance between two point.
-    vector<pair<size_type, iterator>> findKNearest(Point& p, size_type k) const {
+    vector<pair<distance_type, iterator>> findKNearest(Point& p, size_type k) const {
         Query q(root_, p, dimension_, k);
         typename Query::QueryValue qres = q.find(false);
 
-        vector<pair<size_type, iterator>> res;
+        vector<pair<distance_type, iterator>> res;
         res.reserve(qres.size());
         while(!qres.empty()) {
             res.push_back(qres.top());
@@ -182,6 +262,129 @@ public:
         return res;
     }
 
+    // Find the [k] nearest points of each of [queries] into [out], out[i] as
+    // findKNearest(queries[i], k) returns them. The queries are spread over
+    // [threads] threads, 0 for all the cores, and each thread keeps one heap
+    // for all its queries. With [curveOrder] the queries are
+    // taken in the Z-order of their points, so that the queries near in space
+    // run one after another and find the same nodes in the cache.
+    // [out] is resized to the queries, its vectors keep their capacity.
+    void findKNearestBatch(const vector<Point>& queries, size_type k,
+                           vector<vector<pair<distance_type, iterator>>>& out,
+                           unsigned threads = 0, bool curveOrder = false) const {
+        const size_type n = queries.size();
+        out.resize(n);
+        vector<size_type> order;
+        if (curveOrder) {
+            order = _curveOrder(queries);
+        }
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        threads = unsigned(std::max<size_type>(1, std::min<size_type>(threads, n / batch_grain)));
+
+        std::atomic<size_type> next(0);
+        auto work = [&] {
+            vector<pair<distance_type, iterator>> heap;
+            heap.reserve(std::min(k, size_));
+            for (;;) {
+                const size_type begin = next.fetch_add(batch_grain);
+                if (begin >= n) {
+                    break;
+                }
+                const size_type end = std::min(n, begin + batch_grain);
+                for (size_type j = begin; j < end; j++) {
+                    const size_type i = curveOrder ? order[j] : j;
+                    heap.clear();
+                    if (root_ != nullptr && k > 0) {
+                        _nearest(root_, queries[i], k, distance_type(), heap);
+                    }
+                    // the farthest first, as findKNearest
+                    std::sort_heap(heap.begin(), heap.end(), _farther);
+                    out[i].assign(heap.rbegin(), heap.rend());
+                }
+            }
+        };
+        vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) {
+            workers.push_back(std::thread(work));
+        }
+        work();
+        for (std::thread& t : workers) {
+            t.join();
+        }
+    }
+
+    // Call [f](iterator, distance) for each point within the distance [r] of [p],
+    // [r] is in the distance of the metric, so the squared radius for EuclideanMetric.
+    template<class Function>
+    void forEachInRadius(const Point& p, distance_type r, Function f) const {
+        _forEachInRadius(p, r, [&](NodePtr n, distance_type d) { f(iterator(n), d); });
+    }
+
+    // write the pair<distance_type, iterator> of each point within [r] of [p] to [out]
+    template<class OutputIterator>
+    OutputIterator findInRadius(const Point& p, distance_type r, OutputIterator out) const {
+        _forEachInRadius(p, r, [&](NodePtr n, distance_type d) {
+            *out = pair<distance_type, iterator>(d, iterator(n));
+            ++out;
+        });
+        return out;
+    }
+
+    size_type countInRadius(const Point& p, distance_type r) const {
+        size_type count = 0;
+        _forEachInRadius(p, r, [&](NodePtr, distance_type) { ++count; });
+        return count;
+    }
+
+    // call [f](iterator) for each point inside the box [lo, hi], the bounds included
+    template<class Function>
+    void forEachInBox(const Point& lo, const Point& hi, Function f) const {
+        _forEachInBox(lo, hi, [&](NodePtr n) { f(iterator(n)); });
+    }
+
+    // write the iterator of each point inside the box [lo, hi] to [out]
+    template<class OutputIterator>
+    OutputIterator findInBox(const Point& lo, const Point& hi, OutputIterator out) const {
+        _forEachInBox(lo, hi, [&](NodePtr n) {
+            *out = iterator(n);
+            ++out;
+        });
+        return out;
+    }
+
+    // The nodes keep no bounding box, so this visits every point it counts,
+    // FrozenKDTree::countInBox skips the subtrees inside the box.
+    size_type countInBox(const Point& lo, const Point& hi) const {
+        size_type count = 0;
+        _forEachInBox(lo, hi, [&](NodePtr) { ++count; });
+        return count;
+    }
+
+    // an immutable copy for nearest neighbour search, see FrozenKDTree
+    frozen_type freeze() const {
+        vector<NodePtr> nodes;
+        nodes.reserve(size_);
+        vector<NodePtr> todo;
+        if (root_ != nullptr) {
+            todo.push_back(root_);
+        }
+        while (!todo.empty()) {
+            NodePtr x = todo.back();
+            todo.pop_back();
+            nodes.push_back(x);
+            if (x->low_ != nullptr) {
+                todo.push_back(x->low_);
+            }
+            if (x->high_ != nullptr) {
+                todo.push_back(x->high_);
+            }
+        }
+        return frozen_type(_ValueIterator(nodes.data()),
+                           _ValueIterator(nodes.data() + nodes.size()), dimension_);
+    }
+
     // insert the [point] as key with [value]
     bool insert(const key_type& point, const mapped_type& value) {
         NodePtr parent;
@@ -204,6 +407,258 @@ public:
     }
 
 private:
+    // A subtree waiting to be searched, [bound] is no more than the distance
+    // to its points: the largest of the axis bounds of the splits above.
+    // An explicit stack, the tree may be deep after the inserts.
+    template<class Function>
+    void _forEachInRadius(const Point& p, distance_type r, Function f) const {
+        vector<pair<NodePtr, distance_type>> todo;
+        if (root_ != nullptr) {
+            todo.push_back(make_pair(root_, distance_type()));
+        }
+        while (!todo.empty()) {
+            NodePtr n = todo.back().first;
+            distance_type bound = todo.back().second;
+            todo.pop_back();
+            const key_type& x = pointOf(n);
+            distance_type d = _kdDistance<Metric, Distance>(p, x, dimension_);
+            if (!(r < d)) {
+                f(n, d);
+            }
+            // the low side has the smaller coordinates, the high side the others
+            const DimType dim = n->dim_;
+            distance_type far = std::max(bound, _kdAxisBound<Metric>(_kdAbsDiff<Distance>(p[dim], x[dim])));
+            const bool low = p[dim] < x[dim];
+            if (n->low_ != nullptr && !(r < (low ? bound : far))) {
+                todo.push_back(make_pair(n->low_, low ? bound : far));
+            }
+            if (n->high_ != nullptr && !(r < (low ? far : bound))) {
+                todo.push_back(make_pair(n->high_, low ? far : bound));
+            }
+        }
+    }
+
+    template<class Function>
+    void _forEachInBox(const Point& lo, const Point& hi, Function f) const {
+        vector<NodePtr> todo;
+        if (root_ != nullptr) {
+            todo.push_back(root_);
+        }
+        while (!todo.empty()) {
+            NodePtr n = todo.back();
+            todo.pop_back();
+            const key_type& x = pointOf(n);
+            DimType d = 0;
+            while (d < dimension_ && !(x[d] < lo[d]) && !(hi[d] < x[d])) {
+                d++;
+            }
+            if (d == dimension_) {
+                f(n);
+            }
+            const DimType dim = n->dim_;
+            if (n->low_ != nullptr && lo[dim] < x[dim]) {
+                todo.push_back(n->low_);
+            }
+            if (n->high_ != nullptr && !(hi[dim] < x[dim])) {
+                todo.push_back(n->high_);
+            }
+        }
+    }
+
+    static bool _farther(const pair<distance_type, iterator>& x, const pair<distance_type, iterator>& y) {
+        return x.first < y.first;
+    }
+
+    // Add the nearest other points of [p] below [n] to the heap [heap] of at
+    // most [k], the farthest on top, as findKNearest does. [bound] is no more
+    // than the distance to the points below [n], see _forEachInRadius.
+    void _nearest(NodePtr n, const Point& p, size_type k, distance_type bound,
+                  vector<pair<distance_type, iterator>>& heap) const {
+        if (heap.size() == k && !(bound < heap.front().first)) {
+            return;
+        }
+        const key_type& x = pointOf(n);
+        const DimType dim = n->dim_;
+        const bool low = p[dim] < x[dim];
+        NodePtr nearer = low ? n->low_ : n->high_;
+        NodePtr farther = low ? n->high_ : n->low_;
+        distance_type d = _kdDistance<Metric, Distance>(p, x, dimension_);
+        if (nearer != nullptr) {
+            _nearest(nearer, p, k, bound, heap);
+        }
+        if (d != 0 && (heap.size() < k || d < heap.front().first)) {
+            if (heap.size() == k) {
+                std::pop_heap(heap.begin(), heap.end(), _farther);
+                heap.pop_back();
+            }
+            heap.push_back(make_pair(d, iterator(n)));
+            std::push_heap(heap.begin(), heap.end(), _farther);
+        }
+        if (farther != nullptr) {
+            _nearest(farther, p, k, std::max(bound, _kdAxisBound<Metric>(
+                    _kdAbsDiff<Distance>(p[dim], x[dim]))), heap);
+        }
+    }
+
+    // the positions of [queries] sorted by the Z-order curve, which interleaves
+    // the bits of their coordinates scaled to the box around them
+    vector<size_type> _curveOrder(const vector<Point>& queries) const {
+        const size_type n = queries.size();
+        const DimType dims = std::min<DimType>(dimension_, 64);
+        const int bits = dims == 0 ? 0 : std::min(32, int(64 / dims));
+        vector<double> lo(dims), scale(dims, 0);
+        for (DimType d = 0; d < dims && n > 0; d++) {
+            double low = double(queries[0][d]), high = low;
+            for (size_type i = 1; i < n; i++) {
+                low = std::min(low, double(queries[i][d]));
+                high = std::max(high, double(queries[i][d]));
+            }
+            lo[d] = low;
+            if (low < high) {
+                scale[d] = double((std::uint64_t(1) << bits) - 1) / (high - low);
+            }
+        }
+        vector<pair<std::uint64_t, size_type>> keys(n);
+        vector<std::uint64_t> cell(dims);
+        for (size_type i = 0; i < n; i++) {
+            for (DimType d = 0; d < dims; d++) {
+                cell[d] = std::uint64_t((double(queries[i][d]) - lo[d]) * scale[d]);
+            }
+            std::uint64_t code = 0;
+            for (int b = bits - 1; b >= 0; b--) {
+                for (DimType d = 0; d < dims; d++) {
+                    code = (code << 1) | ((cell[d] >> b) & 1);
+                }
+            }
+            keys[i] = make_pair(code, i);
+        }
+        std::sort(keys.begin(), keys.end());
+        vector<size_type> order(n);
+        for (size_type i = 0; i < n; i++) {
+            order[i] = keys[i].second;
+        }
+        return order;
+    }
+
+    // walks the values of an array of nodes
+    struct _ValueIterator {
+        const NodePtr* p_;
+        explicit _ValueIterator(const NodePtr* p) : p_(p) {}
+        const value_type& operator*() const { return (*p_)->value_; }
+        _ValueIterator& operator++() {
+            ++p_;
+            return *this;
+        }
+        bool operator!=(const _ValueIterator& x) const { return p_ != x.p_; }
+    };
+
+    // orders the nodes by the coordinate of one dimension
+    struct _CoordLess {
+        DimType dim_;
+        explicit _CoordLess(DimType dim) : dim_(dim) {}
+        bool operator()(NodePtr x, NodePtr y) const {
+            return x->value_.first[dim_] < y->value_.first[dim_];
+        }
+    };
+
+    // orders the nodes by their points, the first dimension first
+    struct _PointLess {
+        DimType dimension_;
+        explicit _PointLess(DimType dimension) : dimension_(dimension) {}
+        bool operator()(NodePtr x, NodePtr y) const {
+            for (DimType d = 0; d < dimension_; d++) {
+                if (x->value_.first[d] < y->value_.first[d]) {
+                    return true;
+                }
+                if (y->value_.first[d] < x->value_.first[d]) {
+                    return false;
+                }
+            }
+            return false;
+        }
+    };
+
+    // drop the repeated points of [nodes] but the last one of each
+    void _unique(vector<NodePtr>& nodes) {
+        _PointLess less(dimension_);
+        std::stable_sort(nodes.begin(), nodes.end(), less);
+        size_type m = 0;
+        for (size_type i = 0; i < nodes.size(); i++) {
+            if (i + 1 < nodes.size() && !less(nodes[i], nodes[i + 1])) {
+                delete nodes[i];
+            } else {
+                nodes[m++] = nodes[i];
+            }
+        }
+        nodes.resize(m);
+    }
+
+    // the largest minus the smallest coordinate in [dim] of [first, last)
+    static auto _spread(NodePtr* first, NodePtr* last, DimType dim)
+            -> decltype(first[0]->value_.first[dim] - first[0]->value_.first[dim]) {
+        auto lo = first[0]->value_.first[dim];
+        auto hi = lo;
+        for (NodePtr* p = first + 1; p != last; ++p) {
+            const auto& c = (*p)->value_.first[dim];
+            if (c < lo) {
+                lo = c;
+            } else if (hi < c) {
+                hi = c;
+            }
+        }
+        return hi - lo;
+    }
+
+    // the dimension in which the points of [first, last) spread the most
+    DimType _widestDim(NodePtr* first, NodePtr* last) const {
+        DimType widest = 0;
+        auto best = _spread(first, last, 0);
+        for (DimType d = 1; d < dimension_; d++) {
+            auto s = _spread(first, last, d);
+            if (best < s) {
+                best = s;
+                widest = d;
+            }
+        }
+        return widest;
+    }
+
+    // Link the nodes of [first, last) to a balanced tree and return its root.
+    // The median in [dim] is the root, the points smaller in [dim] go low and
+    // the others go high, which keeps _getNode going the same way.
+    NodePtr _build(NodePtr* first, NodePtr* last, DimType dim, SplitRule rule, int levels) {
+        if (first == last) {
+            return nullptr;
+        }
+        if (rule == split_spread) {
+            dim = _widestDim(first, last);
+        }
+        _CoordLess less(dim);
+        NodePtr* mid = first + (last - first) / 2;
+        std::nth_element(first, mid, last, less);
+        // the points equal to the median in [dim] must not stay low
+        NodePtr median = *mid;
+        NodePtr* pivot = std::partition(first, mid, [&](NodePtr n) { return less(n, median); });
+        std::iter_swap(pivot, mid);
+
+        NodePtr node = *pivot;
+        node->dim_ = dim;
+        DimType next = dim + 1;
+        if (next >= dimension_) {
+            next = 0;
+        }
+        if (levels > 0 && size_type(last - first) >= parallel_grain) {
+            std::thread high([&] {
+                node->high_ = _build(pivot + 1, last, next, rule, levels - 1);
+            });
+            node->low_ = _build(first, pivot, next, rule, levels - 1);
+            high.join();
+        } else {
+            node->low_ = _build(first, pivot, next, rule, 0);
+            node->high_ = _build(pivot + 1, last, next, rule, 0);
+        }
+        return node;
+    }
 
     // Get the position to insert, and get its [parent].
     // If have the same point, returning that point.
@@ -341,7 +796,7 @@ private:
                 nlow = _getMinimumNode(node->low_, node, dim, &plow);
             }
             if(node->high_ != nullptr) {
-                nhigh = _getMinimumNode(node->high_, node, dim, &plow);
+                nhigh = _getMinimumNode(node->high_, node, dim, &phigh);
             }
             if(nlow != nullptr && nhigh != nullptr) {
                 if(pointOf(nlow)[dim] < pointOf(nhigh)[dim]) {
@@ -373,7 +828,7 @@ private:
     }
 };
 
-template<typename Point, typename Val, typename DimType>
+template<typename Point, typename Val, typename DimType, typename Metric, typename Distance>
 class _KDQuery {
 public:
     typedef Point key_type;
@@ -387,7 +842,7 @@ public:
     typedef KDNode<value_type, DimType>* NodePtr;
     typedef KDNodeIterator<value_type, DimType> iterator;
 
-    typedef pair<size_type, iterator> QDistanceValue;
+    typedef pair<Distance, iterator> QDistanceValue;
 
 private:
     struct _less {
@@ -398,21 +853,16 @@ private:
     // use priority_queue to store the [k_] nearest  elements
     priority_queue<QDistanceValue, vector<QDistanceValue>, _less> Q;
     NodePtr root_;
-    key_type query_;    // the key to query
+    const key_type& query_;    // the key to query
     size_type k_;       // query the k nearest elements
     DimType dimension_; // the dimension of the key
     bool findItself_;
 
-    // euclidean distance
-    size_type _distance(const Point& p1, const Point& p2) {
-        size_type sqsum = 0;
-        for (int i = 0; i < dimension_; i++) {
-            sqsum += (p2[i] - p1[i]) * (p2[i] - p1[i]);
-        }
-        return sqsum;
+    Distance _distance(const Point& p1, const Point& p2) {
+        return _kdDistance<Metric, Distance>(p1, p2, dimension_);
     }
 
-    static const key_type pointOf(NodePtr n) { return n->value_.first; };
+    static const key_type& pointOf(NodePtr n) { return n->value_.first; };
 
 public:
     typedef priority_queue<QDistanceValue, vector<QDistanceValue>, _less> QueryValue;
@@ -440,8 +890,8 @@ private:
         NodePtr x = node->low_;
         NodePtr y = node->high_;
 
-        size_type d = _distance(query_, pointOf(node));
-        QDistanceValue value = pair<size_type, iterator>(d, iterator(node));
+        Distance d = _distance(query_, pointOf(node));
+        QDistanceValue value = QDistanceValue(d, iterator(node));
         if (query_[dim] >= pointOf(node)[dim]) {
             std::swap(x, y); // find the right side
         }
@@ -453,11 +903,12 @@ private:
         if (Q.size() < k_) {
             if(findItself_ && d == 0){
                 Q.push(value);
-                flag = true;
             } else if(!findItself_ && d != 0) {
                 Q.push(value);
-                flag = true;
             }
+            // not k points yet, another side may have some,
+            // but the point itself can only be on the way down
+            flag = !findItself_;
         } else {
             if(findItself_ && d == 0) {
                 if (value.first < Q.top().first) {
@@ -473,7 +924,7 @@ private:
 
             // If the query node is quite near to the bound of this dim,
             // we need to find in another side too.
-            if ((query_[dim] - pointOf(node)[dim]) * (query_[dim] - pointOf(node)[dim])
+            if (_kdAxisBound<Metric>(_kdAbsDiff<Distance>(query_[dim], pointOf(node)[dim]))
                 < Q.top().first) {
                 flag = true;
             }
@@ -22,6 +22,8 @@ limitations under the License.
 #include <cstddef>
 #include <memory>
 #include <iterator>
+#include <utility>
+#include <vector>
 using std::bidirectional_iterator_tag;
 using std::ostream;
 
@@ -111,10 +113,16 @@ protected:
         return NodeAllocTraits::allocate(nalloc, 1);
     }
 
-    // construct
-    Node *createNode(const T &x) {
+    // construct the element from [args]
+    template<class... Args>
+    Node *createNode(Args &&... args) {
         Node *p = getNode();
-        NodeAllocTraits::construct(nalloc, &(p->data_), x);
+        try {
+            NodeAllocTraits::construct(nalloc, &(p->data_), std::forward<Args>(args)...);
+        } catch (...) {
+            putNode(p);
+            throw;
+        }
         return p;
     }
 
@@ -126,11 +134,12 @@ protected:
     // destroy
     void destroyNode(Node *p) {
         NodeAllocTraits::destroy(nalloc, &(p->data_));
-        NodeAllocTraits::destroy(nalloc, p);
     }
 
 public:
-    List() {
+    List() : List(Alloc()) {}
+
+    explicit List(const Alloc &alloc) : nalloc(alloc) {
         node_ = getNode();
         size_ = 0;
         node_->prev_ = node_;   // link to itself
@@ -143,6 +152,8 @@ public:
         }
     }
 
+    Alloc get_allocator() const { return Alloc(nalloc); }
+
     iterator begin() { return iterator(node_->next_); }
 
     iterator end() { return iterator(node_); }
@@ -169,7 +180,17 @@ public:
 
 public:
     iterator insert(iterator pos, const T &x) {
-        Node *newNode = createNode(x);
+        return emplace(pos, x);
+    }
+
+    iterator insert(iterator pos, T &&x) {
+        return emplace(pos, std::move(x));
+    }
+
+    // construct the element in place before [pos]
+    template<class... Args>
+    iterator emplace(iterator pos, Args &&... args) {
+        Node *newNode = createNode(std::forward<Args>(args)...);
         newNode->next_ = pos.node_;
         newNode->prev_ = pos.node_->prev_;
         pos.node_->prev_->next_ = newNode;
@@ -194,6 +215,24 @@ public:
         insert(begin(), x);
     }
 
+    void push_back(T &&x) {
+        insert(end(), std::move(x));
+    }
+
+    void push_front(T &&x) {
+        insert(begin(), std::move(x));
+    }
+
+    template<class... Args>
+    void emplace_back(Args &&... args) {
+        emplace(end(), std::forward<Args>(args)...);
+    }
+
+    template<class... Args>
+    void emplace_front(Args &&... args) {
+        emplace(begin(), std::forward<Args>(args)...);
+    }
+
     // erase the element in [pos]
     iterator erase(iterator pos) {
         Node *next = pos.node_->next_;
@@ -241,16 +280,17 @@ public:
         }
         node_->next_ = node_;
         node_->prev_ = node_;
+        size_ = 0;
     }
 
 public:
+    // The splices and merge() relink the nodes of [_list], which needs
+    // get_allocator() == _list.get_allocator() as for std::list. Else the
+    // elements are moved to new nodes of this list and erased from [_list].
+
     // connect [_list] to the previous of [pos]
     void splice(iterator pos, List &_list) {
-        if (!_list.empty()) {
-            transfer(pos, _list.begin(), _list.end());
-            inc_size(_list.size_);
-            _list.dec_size(_list.size_);
-        }
+        splice(pos, _list, _list.begin(), _list.end());
     }
 
     // connect the [posOflist] of [_list] to the previous of [pos]
@@ -260,7 +300,7 @@ public:
         if(pos == posOflist || pos == j) {
             return;
         }
-        transfer(pos, posOflist, j);
+        splice(pos, _list, posOflist, j);
     }
 
     // connect  [first, last) of [_list] to the previous of [pos]
@@ -271,6 +311,11 @@ public:
         if (this == &_list) {
             transfer(pos, first, last);
             return;
+        } else if (!(nalloc == _list.nalloc)) {
+            while (first != last) {
+                emplace(pos, std::move(*first));
+                first = _list.erase(first);
+            }
         } else {
             int n = std::distance(first, last);
             inc_size(n);
@@ -296,6 +341,15 @@ public:
 
     // merge [x] to *this. Ascending order is required for [x] and *this.
     void merge(Self& x) {
+        if (this == &x) {
+            return;
+        }
+        if (!(nalloc == x.nalloc)) {
+            Self tmp(get_allocator());
+            tmp.splice(tmp.end(), x);
+            merge(tmp);
+            return;
+        }
         iterator first1 = begin();
         iterator last1 = end();
         iterator first2 = x.begin();
@@ -312,39 +366,45 @@ public:
         if(first2 != last2) {
             transfer(last1, first2, last2);
         }
+        inc_size(x.size_);
+        x.dec_size(x.size_);
     }
 
-    // swap two header nodes.
+    // swap two header nodes, the nodes go with their allocators.
     void swap(Self& x) {
         std::swap(node_, x.node_);
+        std::swap(size_, x.size_);
+        std::swap(nalloc, x.nalloc);
     }
 
     // non-recursion merge sort.
     // counter is the buffer to save elements. The i-th coutner contains 2^i element.
+    // The buffers share the allocator of this list, so the nodes are only relinked.
     void sort() {
         // empty or size of 1
         if(node_->next_ == node_ || node_->next_->next_ == node_) {
             return;
         }
-        Self carry;
-        Self counter[64];
+        Self carry(get_allocator());
+        std::vector<std::unique_ptr<Self>> counter;
         int fill = 0;
         while (!empty()) {
             carry.splice(carry.begin(), *this, begin());
             int i = 0;
-            while (i < fill && !counter[i].empty()) {
-                counter[i].merge(carry);
-                carry.swap(counter[i++]);
+            while (i < fill && !counter[i]->empty()) {
+                counter[i]->merge(carry);
+                carry.swap(*counter[i++]);
             }
-            carry.swap(counter[i]);
             if(i == fill) {
+                counter.emplace_back(new Self(get_allocator()));
                 ++fill;
             }
+            carry.swap(*counter[i]);
         }
         for(int i = 1; i < fill; ++i) {
-            counter[i].merge(counter[i-1]);
+            counter[i]->merge(*counter[i-1]);
         }
-        swap(counter[fill-1]);
+        swap(*counter[fill-1]);
     }
 
 public:
@@ -0,0 +1,292 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// MappedVector is a vector of trivially copyable records that lives in a
+// file mapped into memory. The file is the plain array of records, without
+// a header, so a file written by any program can be opened:
+//
+//     typedef flak::MappedVector<Record> Records;
+//     Records w("records.bin", Records::readWrite);
+//     flak::Sort(w.begin(), w.end());
+//     w.close();
+//
+//     Records v("records.bin", Records::readOnly);
+//     flak::binarySearch(v.begin(), v.end(), key);
+//
+// Opening maps the file, nothing is read or copied until the pages are used,
+// and the kernel pages them in and out, so the file may be larger than RAM.
+//
+// The file grows like a Vector: when the capacity is full, it is extended
+// by ftruncate and mapped again (by mremap on Linux). While it is open,
+// the file may be longer than size() records. close() and the destructor
+// cut it back to size().
+//
+// The iterators are pointers into the mapping. They are invalid after the
+// vector grows. Writing through a vector opened readOnly crashes.
+// Only POSIX systems are supported. The errors are thrown as std::system_error.
+
+#ifndef FLAK_MAPPED_VECTOR_H
+#define FLAK_MAPPED_VECTOR_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flak {
+
+template<class T>
+class MappedVector {
+    static_assert(std::is_trivially_copyable<T>::value, "MappedVector holds trivially copyable types only");
+
+public:
+    typedef T value_type;
+    typedef value_type* pointer;
+    typedef value_type* iterator;
+    typedef const value_type* const_iterator;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    enum OpenMode {
+        create,     // an empty vector, the file is created or truncated
+        readWrite,  // the records of the file, the file is created if it does not exist
+        readOnly    // the records of an existing file, they can not be changed
+    };
+
+private:
+    int fd_;
+    bool readOnly_;
+    T* data_;
+    size_type size_;
+    size_type capacity_;
+
+public:
+    MappedVector() : fd_(-1), readOnly_(false), data_(nullptr), size_(0), capacity_(0) {}
+
+    MappedVector(const std::string& path, OpenMode mode) : MappedVector() { open(path, mode); }
+
+    MappedVector(const MappedVector&) = delete;
+    MappedVector& operator=(const MappedVector&) = delete;
+
+    MappedVector(MappedVector&& x) noexcept
+            : fd_(x.fd_), readOnly_(x.readOnly_), data_(x.data_), size_(x.size_), capacity_(x.capacity_) {
+        x.fd_ = -1;
+        x.data_ = nullptr;
+        x.size_ = x.capacity_ = 0;
+    }
+
+    ~MappedVector() {
+        try {
+            close();
+        } catch (...) {
+            // the file is closed anyway, a destructor can not report it
+        }
+    }
+
+    void open(const std::string& path, OpenMode mode) {
+        close();
+        int flags = mode == readOnly ? O_RDONLY : O_RDWR | O_CREAT;
+        if (mode == create) {
+            flags |= O_TRUNC;
+        }
+        fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0) {
+            _throwError("open " + path);
+        }
+        readOnly_ = mode == readOnly;
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            _closeOnError("fstat " + path);
+        }
+        if ((size_type) st.st_size % sizeof(T) != 0) {
+            ::close(fd_);
+            fd_ = -1;
+            throw std::system_error(EINVAL, std::generic_category(), "the size of " + path + " is not a multiple of the record");
+        }
+        size_ = capacity_ = (size_type) st.st_size / sizeof(T);
+        if (capacity_ != 0) {
+            data_ = static_cast<T*>(_map(capacity_));
+            if (!data_) {
+                _closeOnError("mmap " + path);
+            }
+        }
+    }
+
+    // cut the file to size() and unmap it
+    void close() {
+        if (fd_ < 0) {
+            return;
+        }
+        if (data_) {
+            munmap(data_, capacity_ * sizeof(T));
+        }
+        int err = 0;
+        if (!readOnly_ && capacity_ != size_ && ftruncate(fd_, (off_t) (size_ * sizeof(T))) != 0) {
+            err = errno;
+        }
+        ::close(fd_);
+        fd_ = -1;
+        data_ = nullptr;
+        size_ = capacity_ = 0;
+        if (err) {
+            throw std::system_error(err, std::generic_category(), "ftruncate");
+        }
+    }
+
+    // write the changed pages back to the file
+    void sync() {
+        if (data_ && !readOnly_ && msync(data_, capacity_ * sizeof(T), MS_SYNC) != 0) {
+            _throwError("msync");
+        }
+    }
+
+    bool isOpen() const { return fd_ >= 0; }
+
+    bool isReadOnly() const { return readOnly_; }
+
+public:
+    iterator begin() { return data_; }
+
+    iterator end() { return data_ + size_; }
+
+    const_iterator begin() const { return data_; }
+
+    const_iterator end() const { return data_ + size_; }
+
+    size_type size() const { return size_; }
+
+    size_type capacity() const { return capacity_; }
+
+    bool empty() const { return size_ == 0; }
+
+    reference operator[](size_type n) { return data_[n]; }
+
+    const_reference operator[](size_type n) const { return data_[n]; }
+
+    reference front() { return *begin(); }
+
+    reference back() { return *(end() - 1); }
+
+    void push_back(const T& x) {
+        if (size_ == capacity_) {
+            // x may be in the mapping
+            T copy = x;
+            reserve(capacity_ != 0 ? 2 * capacity_ : 16);
+            data_[size_++] = copy;
+        } else {
+            data_[size_++] = x;
+        }
+    }
+
+    void pop_back() { --size_; }
+
+    // the new records are zero
+    void resize(size_type n) {
+        if (n > capacity_) {
+            reserve(n);
+        }
+        if (n > size_) {
+            // the pages past the old end of the file are zero already,
+            // but the records erased before are not
+            std::fill(data_ + size_, data_ + n, T());
+        }
+        size_ = n;
+    }
+
+    void clear() { size_ = 0; }
+
+    // erase the elements in [first, last)
+    iterator erase(iterator first, iterator last) {
+        std::copy(last, end(), first);
+        size_ -= last - first;
+        return first;
+    }
+
+    iterator erase(iterator pos) { return erase(pos, pos + 1); }
+
+    // extend the file to [n] records
+    void reserve(size_type n) {
+        if (n <= capacity_) {
+            return;
+        }
+        if (fd_ < 0 || readOnly_) {
+            throw std::system_error(EBADF, std::generic_category(), "MappedVector is not open for writing");
+        }
+        if (ftruncate(fd_, (off_t) (n * sizeof(T))) != 0) {
+            _throwError("ftruncate");
+        }
+        void* p;
+        if (!data_) {
+            p = _map(n);
+        } else {
+#ifdef __linux__
+            p = mremap(data_, capacity_ * sizeof(T), n * sizeof(T), MREMAP_MAYMOVE);
+            if (p == MAP_FAILED) {
+                p = nullptr;
+            }
+#else
+            p = _map(n);
+            if (p) {
+                munmap(data_, capacity_ * sizeof(T));
+            }
+#endif
+        }
+        if (!p) {
+            _throwError("mmap");
+        }
+        data_ = static_cast<T*>(p);
+        capacity_ = n;
+    }
+
+    // Tell the kernel how the records will be used, it is a hint of madvise,
+    // such as MADV_SEQUENTIAL before a scan or MADV_RANDOM before searching.
+    void advise(int advice) {
+        if (data_) {
+            madvise(data_, capacity_ * sizeof(T), advice);
+        }
+    }
+
+private:
+    void* _map(size_type n) {
+        const int prot = readOnly_ ? PROT_READ : PROT_READ | PROT_WRITE;
+        void* p = mmap(nullptr, n * sizeof(T), prot, MAP_SHARED, fd_, 0);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    static void _throwError(const std::string& what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void _closeOnError(const std::string& what) {
+        const int err = errno;
+        ::close(fd_);
+        fd_ = -1;
+        throw std::system_error(err, std::generic_category(), what);
+    }
+};
+
+}
+
+#endif //FLAK_MAPPED_VECTOR_H
@@ -0,0 +1,171 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// NodeBlocks lets a node based tree allocate many nodes in one block,
+// as the bulk builds of RBTree and AVLTree do, and still free them one
+// by one like the other nodes. It remembers the blocks and the number of
+// nodes in use in each of them, a block is freed with its last node.
+//
+// The tree asks deallocate() first for every node it frees, which is a
+// single test while no block exists.
+//
+// split() and join() move nodes between trees, so the trees merge their
+// blocks with merge(). The blocks of both are then found from either of
+// them, and from any tree sharing them before:
+//
+//  tree A -> registry a --(merged into)--> registry b <- tree B
+//
+// The registries are locked, because the trees sharing them may be
+// changed by different threads.
+
+#ifndef FLAK_NODE_BLOCKS_H
+#define FLAK_NODE_BLOCKS_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace flak {
+
+template<class Node, class NodeAlloc>
+class NodeBlocks {
+private:
+    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
+
+    struct Block {
+        Node* first_;
+        size_t count_;
+        size_t live_;
+        Block* next_;
+    };
+
+    struct Registry {
+        std::mutex mutex_;
+        Block* head_ = nullptr;
+        std::shared_ptr<Registry> next_;   // the registry it is merged into
+    };
+
+    std::shared_ptr<Registry> reg_;
+
+public:
+    NodeBlocks() {}
+
+    NodeBlocks(const NodeBlocks&) = delete;
+    NodeBlocks& operator=(const NodeBlocks&) = delete;
+
+    bool empty() const { return !reg_; }
+
+    // [n] nodes in one block, the values are not constructed
+    Node* allocate(NodeAlloc& alloc, size_t n) {
+        if (!reg_) {
+            reg_ = std::make_shared<Registry>();
+        }
+        Block* b = new Block;
+        try {
+            b->first_ = NodeAllocTraits::allocate(alloc, n);
+        } catch (...) {
+            delete b;
+            throw;
+        }
+        b->count_ = n;
+        b->live_ = n;
+        std::shared_ptr<Registry> r = _last(reg_);
+        std::lock_guard<std::mutex> lock(r->mutex_);
+        b->next_ = r->head_;
+        r->head_ = b;
+        return b->first_;
+    }
+
+    // Return false if [p] is not in a block,
+    // the caller frees it as a single node then.
+    bool deallocate(NodeAlloc& alloc, Node* p) {
+        std::less<const Node*> less;
+        bool blocks = false;
+        for (Registry* r = reg_.get(); r; ) {
+            std::lock_guard<std::mutex> lock(r->mutex_);
+            blocks = blocks || r->head_;
+            for (Block** b = &r->head_; *b; b = &(*b)->next_) {
+                Block* cur = *b;
+                if (!less(p, cur->first_) && less(p, cur->first_ + cur->count_)) {
+                    if (--cur->live_ == 0) {
+                        *b = cur->next_;
+                        NodeAllocTraits::deallocate(alloc, cur->first_, cur->count_);
+                        delete cur;
+                    }
+                    return true;
+                }
+            }
+            r = r->next_.get();
+        }
+        if (!blocks) {
+            // none of the nodes of this tree are in a block any more
+            reg_.reset();
+        }
+        return false;
+    }
+
+    // share the blocks of both
+    void merge(NodeBlocks& other) {
+        if (!other.reg_ || other.reg_ == reg_) {
+            return;
+        }
+        if (!reg_) {
+            reg_ = other.reg_;
+            return;
+        }
+        for (;;) {
+            std::shared_ptr<Registry> a = _last(reg_);
+            std::shared_ptr<Registry> b = _last(other.reg_);
+            if (a == b) {
+                return;
+            }
+            std::lock(a->mutex_, b->mutex_);
+            std::lock_guard<std::mutex> la(a->mutex_, std::adopt_lock);
+            std::lock_guard<std::mutex> lb(b->mutex_, std::adopt_lock);
+            if (a->next_ || b->next_) {
+                continue; // merged by another thread meanwhile
+            }
+            while (b->head_) {
+                Block* x = b->head_;
+                b->head_ = x->next_;
+                x->next_ = a->head_;
+                a->head_ = x;
+            }
+            b->next_ = a;
+            other.reg_ = reg_;
+            return;
+        }
+    }
+
+private:
+    // the registry that is not merged into another
+    static std::shared_ptr<Registry> _last(std::shared_ptr<Registry> r) {
+        for (;;) {
+            std::lock_guard<std::mutex> lock(r->mutex_);
+            if (!r->next_) {
+                return r;
+            }
+            std::shared_ptr<Registry> next = r->next_;
+            r = next;
+        }
+    }
+};
+
+}
+
+#endif //FLAK_NODE_BLOCKS_H
@@ -0,0 +1,103 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef FLAK_PERSISTENT_AVL_MAP_H
+#define FLAK_PERSISTENT_AVL_MAP_H
+
+#include "PersistentAVLTree.h"
+#include <functional>
+#include <memory>
+#include <utility>
+using std::pair;
+
+namespace flak {
+
+// An AVLMap whose copies, see snapshot(), take O(1) and share the nodes,
+// an update copies the O(log n) nodes on its path, see PersistentAVLTree.
+// The values are const, insertOrAssign() replaces them.
+template<class Key, class T,
+        class Compare = std::less<Key>,
+        class Alloc = std::allocator<pair<const Key, T>>>
+class PersistentAVLMap {
+public:
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef pair<const Key, T> value_type;
+    typedef Compare key_compare;
+
+    typedef typename Alloc::template rebind<value_type>::other PairValueAlloc;
+    typedef PersistentAVLMap<Key, T, Compare, PairValueAlloc> Self;
+
+private:
+    typedef PersistentAVLTree<key_type, value_type, std::_Select1st<value_type>,
+            key_compare, PairValueAlloc> rep_type;
+    rep_type t_;
+
+public:
+    typedef typename rep_type::pointer pointer;
+    typedef typename rep_type::const_pointer const_pointer;
+    typedef typename rep_type::reference reference;
+    typedef typename rep_type::const_reference const_reference;
+    typedef typename rep_type::iterator iterator;
+    typedef typename rep_type::const_iterator const_iterator;
+    typedef typename rep_type::size_type size_type;
+    typedef typename rep_type::difference_type difference_type;
+
+    PersistentAVLMap() : t_(Compare()) {}
+
+    explicit PersistentAVLMap(const Compare& comp) : t_(comp) {}
+
+    // the version of the map now, later updates of this map do not change it
+    Self snapshot() const { return *this; }
+
+    key_compare keyComp() const { return t_.keyComp(); }
+
+    const_iterator begin() const { return t_.begin(); }
+
+    const_iterator end() const { return t_.end(); }
+
+    bool empty() const { return t_.empty(); }
+
+    size_type size() const { return t_.size(); }
+
+    void swap(Self& x) { t_.swap(x.t_); }
+
+    void clear() { t_.clear(); }
+
+    // insert if the key does not exist, return whether it is inserted
+    bool insert(const value_type& x) { return t_.insertUnique(x); }
+
+    bool insert(value_type&& x) { return t_.insertUnique(std::move(x)); }
+
+    // insert or replace the value of [k], return whether it is inserted
+    bool insertOrAssign(const Key& k, const T& val) { return t_.insertOrAssign(value_type(k, val)); }
+
+    size_type erase(const Key& k) { return t_.erase(k); }
+
+    const_iterator find(const Key& k) const { return t_.find(k); }
+
+    size_type count(const Key& k) const { return t_.count(k); }
+
+    const_iterator lowerBound(const Key& k) const { return t_.lowerBound(k); }
+
+    const_iterator upperBound(const Key& k) const { return t_.upperBound(k); }
+};
+
+}
+
+#endif //FLAK_PERSISTENT_AVL_MAP_H
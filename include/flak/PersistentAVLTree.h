@@ -0,0 +1,533 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// PersistentAVLTree is an AVL tree whose versions share their nodes.
+// A copy of the tree, see snapshot(), takes O(1): it only adds a reference
+// to the root. An update copies the nodes it changes that another version
+// still holds, which are the nodes on the path from the root, and links
+// the copies into its own version:
+//
+//      before            after inserting 5 into v2 = v1.snapshot()
+//
+//   v1    4             v1    4       4'   v2
+//        / \                 / \     / \     4' and 6' are the copies
+//       2   6               2   6 <-/-- 6'
+//      / \                 / \         /
+//     1   3               1   3       5
+//
+// Every node counts the versions and the parents that point to it.
+// A node only this version reaches, with a count of 1, is changed in place,
+// so a tree without snapshots is updated like AVLTree.
+// The counts are atomic: a snapshot can be read and dropped in another
+// thread while the tree is updated, but only one thread may update or
+// snapshot() a tree at a time.
+//
+// There are no parent pointers, because a node may have many parents,
+// so the iterators keep the path from the root, and the values are const.
+// An iterator is valid as long as the version it comes from.
+
+#ifndef FLAK_PERSISTENT_AVL_TREE_H
+#define FLAK_PERSISTENT_AVL_TREE_H
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+using std::pair;
+
+namespace flak {
+
+template<typename T>
+struct PersistentAVLNode {
+    typedef PersistentAVLNode<T>* NodePtr;
+
+    std::atomic<size_t> refs_;
+    NodePtr left_;
+    NodePtr right_;
+    int height_;
+    T value_;
+};
+
+// the path from the root to the node, end() has an empty path
+template<typename T>
+struct PersistentAVLIterator {
+    typedef T value_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+    typedef ptrdiff_t difference_type;
+    typedef std::bidirectional_iterator_tag iterator_category;
+
+    typedef PersistentAVLIterator<T> Self;
+    typedef PersistentAVLNode<T>* NodePtr;
+
+    // an AVL tree of 2^64 nodes is less than 94 high
+    static const int max_height = 96;
+
+    NodePtr root_;
+    int depth_;
+    NodePtr path_[max_height];
+
+    PersistentAVLIterator() : root_(nullptr), depth_(0) {}
+
+    explicit PersistentAVLIterator(NodePtr root) : root_(root), depth_(0) {}
+
+    reference operator*() const { return path_[depth_ - 1]->value_; }
+
+    pointer operator->() const { return &(operator*()); }
+
+    // go down from the current node, or the root for end()
+    void _descend(NodePtr x, bool left) {
+        while (x != nullptr) {
+            path_[depth_++] = x;
+            x = left ? x->left_ : x->right_;
+        }
+    }
+
+    void increment() {
+        NodePtr x = path_[depth_ - 1];
+        if (x->right_ != nullptr) {
+            _descend(x->right_, true);
+            return;
+        }
+        // up to the first ancestor whose left subtree we are in
+        while (--depth_ > 0 && path_[depth_ - 1]->right_ == x) {
+            x = path_[depth_ - 1];
+        }
+    }
+
+    void decrement() {
+        if (depth_ == 0) {
+            _descend(root_, false);
+            return;
+        }
+        NodePtr x = path_[depth_ - 1];
+        if (x->left_ != nullptr) {
+            _descend(x->left_, false);
+            return;
+        }
+        while (--depth_ > 0 && path_[depth_ - 1]->left_ == x) {
+            x = path_[depth_ - 1];
+        }
+    }
+
+    Self& operator++() {
+        increment();
+        return *this;
+    }
+
+    Self operator++(int) {
+        Self tmp = *this;
+        increment();
+        return tmp;
+    }
+
+    Self& operator--() {
+        decrement();
+        return *this;
+    }
+
+    Self operator--(int) {
+        Self tmp = *this;
+        decrement();
+        return tmp;
+    }
+
+    bool operator==(const Self& x) const {
+        return depth_ == x.depth_ && (depth_ == 0 || path_[depth_ - 1] == x.path_[depth_ - 1]);
+    }
+
+    bool operator!=(const Self& x) const { return !(*this == x); }
+};
+
+template<typename Key, typename Val, typename KeyOfValue,
+        typename Compare,
+        typename Alloc = std::allocator<Val>>
+class PersistentAVLTree {
+public:
+    typedef Key key_type;
+    typedef Val value_type;
+    typedef Compare key_compare;
+    typedef const Val* pointer;
+    typedef const Val* const_pointer;
+    typedef const Val& reference;
+    typedef const Val& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef PersistentAVLIterator<Val> iterator;
+    typedef PersistentAVLIterator<Val> const_iterator;
+
+private:
+    typedef PersistentAVLNode<Val> Node;
+    typedef Node* NodePtr;
+    typedef PersistentAVLTree<Key, Val, KeyOfValue, Compare, Alloc> Self;
+
+    typedef typename Alloc::template rebind<Val>::other ValueAlloc;
+    typedef std::allocator_traits<ValueAlloc> ValueAllocTraits;
+    typedef typename ValueAllocTraits::template rebind_alloc<Node> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
+
+    static const int max_height = iterator::max_height;
+
+    NodeAlloc nodeAlloc;
+    Compare keyComp_;
+    NodePtr root_;
+    size_type nodeCount_;
+
+public:
+    explicit PersistentAVLTree(const Compare& comp = Compare())
+            : keyComp_(comp), root_(nullptr), nodeCount_(0) {}
+
+    // O(1), the nodes are shared
+    PersistentAVLTree(const Self& x)
+            : nodeAlloc(x.nodeAlloc), keyComp_(x.keyComp_), root_(_retain(x.root_)), nodeCount_(x.nodeCount_) {}
+
+    PersistentAVLTree(Self&& x) noexcept
+            : nodeAlloc(x.nodeAlloc), keyComp_(x.keyComp_), root_(x.root_), nodeCount_(x.nodeCount_) {
+        x.root_ = nullptr;
+        x.nodeCount_ = 0;
+    }
+
+    Self& operator=(Self x) {
+        swap(x);
+        return *this;
+    }
+
+    ~PersistentAVLTree() { _release(root_); }
+
+    void swap(Self& x) {
+        std::swap(nodeAlloc, x.nodeAlloc);
+        std::swap(keyComp_, x.keyComp_);
+        std::swap(root_, x.root_);
+        std::swap(nodeCount_, x.nodeCount_);
+    }
+
+    // a version that later updates of this tree do not change, in O(1)
+    Self snapshot() const { return *this; }
+
+public:
+    Compare keyComp() const { return keyComp_; }
+
+    size_type size() const { return nodeCount_; }
+
+    bool empty() const { return nodeCount_ == 0; }
+
+    const_iterator begin() const {
+        const_iterator it(root_);
+        it._descend(root_, true);
+        return it;
+    }
+
+    const_iterator end() const { return const_iterator(root_); }
+
+    // the first value whose key is not less than [k]
+    const_iterator lowerBound(const Key& k) const {
+        const_iterator it(root_);
+        int found = 0;
+        for (NodePtr x = root_; x != nullptr;) {
+            it.path_[it.depth_++] = x;
+            if (!keyComp_(key(x), k)) {
+                found = it.depth_;
+                x = x->left_;
+            } else {
+                x = x->right_;
+            }
+        }
+        it.depth_ = found;
+        return it;
+    }
+
+    // the first value whose key is greater than [k]
+    const_iterator upperBound(const Key& k) const {
+        const_iterator it(root_);
+        int found = 0;
+        for (NodePtr x = root_; x != nullptr;) {
+            it.path_[it.depth_++] = x;
+            if (keyComp_(k, key(x))) {
+                found = it.depth_;
+                x = x->left_;
+            } else {
+                x = x->right_;
+            }
+        }
+        it.depth_ = found;
+        return it;
+    }
+
+    const_iterator find(const Key& k) const {
+        const_iterator j = lowerBound(k);
+        return (j.depth_ == 0 || keyComp_(k, KeyOfValue()(*j))) ? end() : j;
+    }
+
+    size_type count(const Key& k) const { return _findNode(k) != nullptr; }
+
+    // insert [v] if its key does not exist, return whether it is inserted
+    bool insertUnique(const Val& v) { return _insertUnique(v); }
+
+    bool insertUnique(Val&& v) { return _insertUnique(std::move(v)); }
+
+    // insert [v] or replace the value with the same key, return whether it is inserted
+    bool insertOrAssign(const Val& v) { return _insertOrAssign(v); }
+
+    bool insertOrAssign(Val&& v) { return _insertOrAssign(std::move(v)); }
+
+    // Return the number of the values erased, 0 or 1.
+    // If copying a value that another version holds throws while the tree is
+    // rebalanced, the key is erased but the tree may stay out of balance.
+    size_type erase(const Key& k) {
+        if (_findNode(k) == nullptr) {
+            return 0;
+        }
+        NodePtr* path[max_height];
+        int depth = 0;
+        NodePtr* slot = _ownPath(k, path, depth);
+        NodePtr z = *slot;
+        if (z->left_ == nullptr || z->right_ == nullptr) {
+            // the child takes the place of z, which other versions may keep
+            *slot = _retain(z->left_ != nullptr ? z->left_ : z->right_);
+        } else {
+            // the minimum of the right subtree takes the place of z
+            z = *slot = _own(z);
+            int top = depth;
+            path[depth++] = slot;
+            NodePtr* mslot = &z->right_;
+            for (;;) {
+                *mslot = _own(*mslot);
+                if ((*mslot)->left_ == nullptr) {
+                    break;
+                }
+                path[depth++] = mslot;
+                mslot = &(*mslot)->left_;
+            }
+            NodePtr m = *mslot;
+            *mslot = m->right_;
+            m->left_ = z->left_;
+            m->right_ = z->right_;
+            *slot = m;
+            // the path went through the right link of z
+            if (depth > top + 1) {
+                path[top + 1] = &m->right_;
+            }
+            z->left_ = nullptr;
+            z->right_ = nullptr;
+        }
+        _release(z);
+        --nodeCount_;
+        while (depth > 0) {
+            NodePtr* s = path[--depth];
+            *s = _balance(*s);
+        }
+        return 1;
+    }
+
+    void clear() {
+        _release(root_);
+        root_ = nullptr;
+        nodeCount_ = 0;
+    }
+
+private:
+    static const Key& key(NodePtr x) { return KeyOfValue()(x->value_); }
+
+    static int height(NodePtr x) { return x == nullptr ? 0 : x->height_; }
+
+    static void _update(NodePtr x) {
+        int l = height(x->left_), r = height(x->right_);
+        x->height_ = (l > r ? l : r) + 1;
+    }
+
+    NodePtr _findNode(const Key& k) const {
+        NodePtr x = root_;
+        while (x != nullptr) {
+            if (keyComp_(k, key(x))) {
+                x = x->left_;
+            } else if (keyComp_(key(x), k)) {
+                x = x->right_;
+            } else {
+                return x;
+            }
+        }
+        return nullptr;
+    }
+
+    template<class... Args>
+    NodePtr createNode(Args&&... args) {
+        NodePtr x = NodeAllocTraits::allocate(nodeAlloc, 1);
+        try {
+            NodeAllocTraits::construct(nodeAlloc, &x->value_, std::forward<Args>(args)...);
+        } catch (...) {
+            NodeAllocTraits::deallocate(nodeAlloc, x, 1);
+            throw;
+        }
+        new (&x->refs_) std::atomic<size_t>(1);
+        x->left_ = nullptr;
+        x->right_ = nullptr;
+        x->height_ = 1;
+        return x;
+    }
+
+    static NodePtr _retain(NodePtr x) {
+        if (x != nullptr) {
+            x->refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // drop a reference, free the node and drop its references if it was the last one
+    void _release(NodePtr x) {
+        if (x == nullptr || x->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        _release(x->left_);
+        _release(x->right_);
+        NodeAllocTraits::destroy(nodeAlloc, &x->value_);
+        NodeAllocTraits::deallocate(nodeAlloc, x, 1);
+    }
+
+    // Return [x] if only this version reaches it, else a copy of it for this version.
+    // The copy takes the reference of the caller to x.
+    NodePtr _own(NodePtr x) {
+        if (x->refs_.load(std::memory_order_acquire) == 1) {
+            return x;
+        }
+        NodePtr y = createNode(x->value_);
+        y->left_ = _retain(x->left_);
+        y->right_ = _retain(x->right_);
+        y->height_ = x->height_;
+        _release(x);
+        return y;
+    }
+
+    // Own the nodes above the key [k] or the empty link where it belongs,
+    // record the links to them in [path], return the link to k or the empty one.
+    // The contents stay the same if a copy throws.
+    NodePtr* _ownPath(const Key& k, NodePtr** path, int& depth) {
+        NodePtr* slot = &root_;
+        while (*slot != nullptr) {
+            bool less = keyComp_(k, key(*slot));
+            if (!less && !keyComp_(key(*slot), k)) {
+                break;
+            }
+            NodePtr x = *slot = _own(*slot);
+            path[depth++] = slot;
+            slot = less ? &x->left_ : &x->right_;
+        }
+        return slot;
+    }
+
+    /*
+     *        x              y
+     *       / \            / \
+     *      a   y    =>    x   c
+     *         / \        / \
+     *        b   c      a   b
+     */
+    NodePtr _rotateLeft(NodePtr x) {
+        NodePtr y = x->right_ = _own(x->right_);
+        x->right_ = y->left_;
+        y->left_ = x;
+        _update(x);
+        _update(y);
+        return y;
+    }
+
+    NodePtr _rotateRight(NodePtr x) {
+        NodePtr y = x->left_ = _own(x->left_);
+        x->left_ = y->right_;
+        y->right_ = x;
+        _update(x);
+        _update(y);
+        return y;
+    }
+
+    // Rebalance the owned node [x] whose subtrees differ in height by 2 at most,
+    // return the root of the subtree. The rotations own the children they move,
+    // after an insert they are on the path and owned already.
+    NodePtr _balance(NodePtr x) {
+        int bf = height(x->right_) - height(x->left_);
+        if (bf > 1) {
+            NodePtr r = x->right_ = _own(x->right_);
+            if (height(r->left_) > height(r->right_)) {
+                x->right_ = _rotateRight(r);
+            }
+            return _rotateLeft(x);
+        }
+        if (bf < -1) {
+            NodePtr l = x->left_ = _own(x->left_);
+            if (height(l->right_) > height(l->left_)) {
+                x->left_ = _rotateLeft(l);
+            }
+            return _rotateRight(x);
+        }
+        _update(x);
+        return x;
+    }
+
+    // link the new node [z] at [slot] and rebalance the [path] above it
+    void _link(NodePtr* slot, NodePtr z, NodePtr** path, int depth) {
+        *slot = z;
+        ++nodeCount_;
+        while (depth > 0) {
+            NodePtr* s = path[--depth];
+            int h = (*s)->height_;
+            *s = _balance(*s);
+            if ((*s)->height_ == h) {
+                break;
+            }
+        }
+    }
+
+    template<class V>
+    bool _insertUnique(V&& v) {
+        const Key& k = KeyOfValue()(v);
+        if (_findNode(k) != nullptr) {
+            return false;
+        }
+        NodePtr* path[max_height];
+        int depth = 0;
+        NodePtr* slot = _ownPath(k, path, depth);
+        _link(slot, createNode(std::forward<V>(v)), path, depth);
+        return true;
+    }
+
+    template<class V>
+    bool _insertOrAssign(V&& v) {
+        NodePtr* path[max_height];
+        int depth = 0;
+        NodePtr* slot = _ownPath(KeyOfValue()(v), path, depth);
+        NodePtr z = createNode(std::forward<V>(v));
+        if (*slot == nullptr) {
+            _link(slot, z, path, depth);
+            return true;
+        }
+        // the new node takes the place of the old one, which other versions may keep
+        NodePtr x = *slot;
+        z->left_ = _retain(x->left_);
+        z->right_ = _retain(x->right_);
+        z->height_ = x->height_;
+        *slot = z;
+        _release(x);
+        return false;
+    }
+};
+
+}
+
+#endif //FLAK_PERSISTENT_AVL_TREE_H
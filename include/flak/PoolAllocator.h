@@ -0,0 +1,303 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// PoolAllocator hands out single objects from slabs instead of calling
+// operator new for every node, so it fits the node based containers:
+//
+//     flak::Set<int, std::less<int>, flak::PoolAllocator<int>> s;
+//     flak::List<int, flak::PoolAllocator<int>> ls;
+//
+// The memory is managed by a NodePool. Objects are rounded up to a size
+// class of 16 bytes, and every slab serves one size class:
+//
+// slab (64KB, aligned to 64KB)
+// [header | chunk | chunk | chunk | ... ]
+//    |
+//    |-> free list of the chunks given back, live count
+//
+// A freed chunk goes back to the free list of its slab, which is found by
+// masking the address. Every size class keeps one empty slab as a spare,
+// a slab that becomes empty while there is a spare already is released.
+// So clear() and destruction of a container give the memory back in bulk,
+// while a size that goes back and forth over the end of a slab does not
+// free and allocate a slab every time.
+//
+// Arrays (n > 1) and large objects go to operator new directly.
+// The copies and rebinds of a PoolAllocator share the same pool.
+// Like the containers, it is not thread safe.
+
+#ifndef FLAK_POOL_ALLOCATOR_H
+#define FLAK_POOL_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+namespace flak {
+
+class NodePool {
+public:
+    static const size_t slab_size = 64 * 1024;
+    static const size_t granularity = 16;   // the size step and alignment of chunks
+    static const size_t num_classes = 32;   // chunks up to 512 bytes
+
+private:
+    struct Chunk {
+        Chunk* next_;
+    };
+
+    struct Slab {
+        Slab* prev_;      // in the partial list of its size class
+        Slab* next_;
+        Slab* allPrev_;   // in the list of all slabs
+        Slab* allNext_;
+        Chunk* free_;
+        char* bump_;      // the space never handed out starts here
+        size_t live_;
+        size_t cls_;
+    };
+
+    // the chunks start behind the header
+    static const size_t header_size = (sizeof(Slab) + 63) / 64 * 64;
+
+    Slab* partial_[num_classes];   // slabs that have free chunks
+    size_t slabs_[num_classes];    // number of slabs of each class
+    size_t empty_[num_classes];    // number of slabs of each class without live chunks
+    Slab* all_;
+    size_t live_;
+
+public:
+    NodePool() : all_(nullptr), live_(0) {
+        for (size_t i = 0; i < num_classes; i++) {
+            partial_[i] = nullptr;
+            slabs_[i] = 0;
+            empty_[i] = 0;
+        }
+    }
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool() {
+        while (all_) {
+            Slab* next = all_->allNext_;
+            _freeSlab(all_);
+            all_ = next;
+        }
+    }
+
+    static bool pooled(size_t bytes, size_t align) {
+        return bytes != 0 && bytes <= granularity * num_classes && align <= granularity;
+    }
+
+    // [bytes] must be pooled
+    void* allocate(size_t bytes) {
+        const size_t cls = (bytes - 1) / granularity;
+        Slab* s = partial_[cls];
+        if (!s) {
+            s = _newSlab(cls);
+        }
+        void* p;
+        if (s->free_) {
+            p = s->free_;
+            s->free_ = s->free_->next_;
+        } else {
+            p = s->bump_;
+            s->bump_ += chunkSize(cls);
+        }
+        if (s->live_ == 0) {
+            --empty_[cls];
+        }
+        ++s->live_;
+        ++live_;
+        if (s->live_ == capacity(cls)) { // full
+            _unlinkPartial(s);
+        }
+        return p;
+    }
+
+    void deallocate(void* p, size_t bytes) {
+        const size_t cls = (bytes - 1) / granularity;
+        Slab* s = _slabOf(p);
+        if (s->live_ == capacity(cls)) { // it was full
+            _linkPartial(s);
+        }
+        Chunk* c = static_cast<Chunk*>(p);
+        c->next_ = s->free_;
+        s->free_ = c;
+        --s->live_;
+        --live_;
+        if (s->live_ == 0) {
+            if (empty_[cls] == 0) { // keep it as the spare
+                ++empty_[cls];
+                return;
+            }
+            _unlinkPartial(s);
+            _unlinkAll(s);
+            --slabs_[cls];
+            _freeSlab(s);
+        }
+    }
+
+    // the number of chunks in use
+    size_t liveCount() const { return live_; }
+
+    size_t slabCount() const {
+        size_t n = 0;
+        for (size_t i = 0; i < num_classes; i++) {
+            n += slabs_[i];
+        }
+        return n;
+    }
+
+    static size_t chunkSize(size_t cls) { return (cls + 1) * granularity; }
+
+    static size_t capacity(size_t cls) { return (slab_size - header_size) / chunkSize(cls); }
+
+private:
+    static Slab* _slabOf(void* p) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t) (slab_size - 1));
+    }
+
+    Slab* _newSlab(size_t cls) {
+        void* mem = nullptr;
+#ifdef _WIN32
+        mem = _aligned_malloc(slab_size, slab_size);
+#else
+        if (posix_memalign(&mem, slab_size, slab_size) != 0) {
+            mem = nullptr;
+        }
+#endif
+        if (!mem) {
+            throw std::bad_alloc();
+        }
+        Slab* s = static_cast<Slab*>(mem);
+        s->free_ = nullptr;
+        s->bump_ = static_cast<char*>(mem) + header_size;
+        s->live_ = 0;
+        s->cls_ = cls;
+        s->prev_ = s->next_ = nullptr;
+        _linkPartial(s);
+        s->allPrev_ = nullptr;
+        s->allNext_ = all_;
+        if (all_) {
+            all_->allPrev_ = s;
+        }
+        all_ = s;
+        ++slabs_[cls];
+        ++empty_[cls];
+        return s;
+    }
+
+    static void _freeSlab(Slab* s) {
+#ifdef _WIN32
+        _aligned_free(s);
+#else
+        free(s);
+#endif
+    }
+
+    void _linkPartial(Slab* s) {
+        Slab*& head = partial_[s->cls_];
+        s->prev_ = nullptr;
+        s->next_ = head;
+        if (head) {
+            head->prev_ = s;
+        }
+        head = s;
+    }
+
+    void _unlinkPartial(Slab* s) {
+        if (s->prev_) {
+            s->prev_->next_ = s->next_;
+        } else {
+            partial_[s->cls_] = s->next_;
+        }
+        if (s->next_) {
+            s->next_->prev_ = s->prev_;
+        }
+        s->prev_ = s->next_ = nullptr;
+    }
+
+    void _unlinkAll(Slab* s) {
+        if (s->allPrev_) {
+            s->allPrev_->allNext_ = s->allNext_;
+        } else {
+            all_ = s->allNext_;
+        }
+        if (s->allNext_) {
+            s->allNext_->allPrev_ = s->allPrev_;
+        }
+    }
+};
+
+template<class T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind {
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator() : pool_(std::make_shared<NodePool>()) {}
+
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>& x) : pool_(x.pool_) {}
+
+    T* allocate(size_type n) {
+        if (n == 1 && NodePool::pooled(sizeof(T), alignof(T))) {
+            return static_cast<T*>(pool_->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_type n) {
+        if (n == 1 && NodePool::pooled(sizeof(T), alignof(T))) {
+            pool_->deallocate(p, sizeof(T));
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    const NodePool& pool() const { return *pool_; }
+
+    template<class U>
+    bool operator==(const PoolAllocator<U>& x) const { return pool_ == x.pool_; }
+
+    template<class U>
+    bool operator!=(const PoolAllocator<U>& x) const { return pool_ != x.pool_; }
+
+private:
+    template<class U> friend class PoolAllocator;
+
+    std::shared_ptr<NodePool> pool_;
+};
+
+}
+
+#endif //FLAK_POOL_ALLOCATOR_H
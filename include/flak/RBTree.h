@@ -22,6 +22,11 @@ limitations under the License.
 #include <cstddef>
 #include <iterator>
 #include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "FrozenTree.h"
+#include "NodeBlocks.h"
+#include "SubtreeSize.h"
 using std::bidirectional_iterator_tag;
 using std::pair;
 
@@ -31,10 +36,11 @@ enum RbTreeColor {
     rb_red = false, rb_black = true
 };
 
-template<typename T>
-struct RBNode {
-    typedef RBNode<T> *SelfPtr;
-    typedef const RBNode<T> *ConstSelfPtr;
+// [Sized] adds the subtree size, see SubtreeSize.h
+template<typename T, bool Sized = false>
+struct RBNode : SubtreeSize<Sized> {
+    typedef RBNode<T, Sized> *SelfPtr;
+    typedef const RBNode<T, Sized> *ConstSelfPtr;
 
     RbTreeColor color_;
     SelfPtr parent_;
@@ -65,7 +71,7 @@ struct RBNode {
     }
 };
 
-template<typename T, typename Ref, typename Ptr>
+template<typename T, typename Ref, typename Ptr, bool Sized = false>
 struct RBTreeIterator {
     typedef T value_type;
     typedef Ptr pointer;
@@ -73,8 +79,8 @@ struct RBTreeIterator {
     typedef ptrdiff_t difference_type;
     typedef bidirectional_iterator_tag iterator_category;
 
-    typedef RBTreeIterator<T, Ref, Ptr> Self;
-    typedef RBNode<T> *NodePtr;
+    typedef RBTreeIterator<T, Ref, Ptr, Sized> Self;
+    typedef RBNode<T, Sized> *NodePtr;
 
     NodePtr node_;
 
@@ -154,10 +160,16 @@ struct RBTreeIterator {
     }
 };
 
+// With [OrderStatistics] every node keeps the size of its subtree,
+// which select(), rank() and countRange() need.
 template<typename Key, typename Val, typename KeyOfValue,
         typename Compare,
-        typename Alloc = std::allocator<Val> >
+        typename Alloc = std::allocator<Val>,
+        bool OrderStatistics = false>
 class RBTree {
+    template<class Tree> friend struct TreeSetOps;
+    template<class K, class T, class C, class A> friend class ConcurrentMap;
+
 public:
     typedef Val value_type;
     typedef Val *pointer;
@@ -170,35 +182,47 @@ public:
     typedef typename Alloc::template rebind<Val>::other ValueAlloc;
     typedef std::allocator_traits<ValueAlloc> ValueAllocTraits;
 
-    typedef typename ValueAllocTraits::template rebind_alloc<RBNode<Val>> NodeAlloc;
-    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
-
-    typedef RBNode<Val> *NodePtr;
-    typedef RBNode<Val> Node;
+    typedef RBNode<Val, OrderStatistics> Node;
+    typedef Node *NodePtr;
     typedef const NodePtr ConstNodePtr;
     typedef RbTreeColor ColorType;
-    typedef RBTree<Key, Val, KeyOfValue, Compare, Alloc> Self;
+    typedef RBTree<Key, Val, KeyOfValue, Compare, Alloc, OrderStatistics> Self;
+
+    typedef typename ValueAllocTraits::template rebind_alloc<Node> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
+
+private:
+    typedef SubtreeSize<OrderStatistics> Sizes;
 
 protected:
     NodeAlloc nalloc;
+    NodeBlocks<Node, NodeAlloc> blocks_;   // the nodes of the bulk builds
 
     NodePtr getNode() {
         return NodeAllocTraits::allocate(nalloc, 1);
     }
 
     void putNode(NodePtr p) {
-        NodeAllocTraits::deallocate(nalloc, p, 1);
+        if (blocks_.empty() || !blocks_.deallocate(nalloc, p)) {
+            NodeAllocTraits::deallocate(nalloc, p, 1);
+        }
     }
 
-    NodePtr createNode(const Val &x) {
+    // construct the value in place from [args]
+    template<class... Args>
+    NodePtr createNode(Args&&... args) {
         NodePtr tmp = getNode();
-        NodeAllocTraits::construct(nalloc, &(tmp->value_), x);
+        try {
+            NodeAllocTraits::construct(nalloc, &(tmp->value_), std::forward<Args>(args)...);
+        } catch (...) {
+            putNode(tmp);
+            throw;
+        }
         return tmp;
     }
 
     void destroyNode(NodePtr p) {
         NodeAllocTraits::destroy(nalloc, &(p->value_));
-        NodeAllocTraits::destroy(nalloc, p);
         putNode(p);
     }
 
@@ -234,6 +258,14 @@ protected:
         return x->parent_;
     }
 
+    // Store a child link or the root with a release store. The readers of
+    // ConcurrentMap walk down left_ and right_ from the root without a lock
+    // while the writer relinks, with acquire loads, see ConcurrentMap.h.
+    // Only the writer reads parent_ and color_, they are stored plainly.
+    static void _storeLink(NodePtr &link, NodePtr x) {
+        __atomic_store_n(&link, x, __ATOMIC_RELEASE);
+    }
+
     static reference &value(NodePtr x) {
         return x->value_;
     }
@@ -247,16 +279,17 @@ protected:
     }
 
     static NodePtr minimum(NodePtr x) {
-        return RBNode<Val>::minimum(x);
+        return Node::minimum(x);
     }
 
     static NodePtr maximum(NodePtr x) {
-        return RBNode<Val>::minimum(x);
+        return Node::maximum(x);
     }
 
 public:
-    typedef RBTreeIterator<value_type, reference, pointer> iterator;
-    typedef RBTreeIterator<value_type, const_reference, const_pointer> const_iterator;
+    typedef RBTreeIterator<value_type, reference, pointer, OrderStatistics> iterator;
+    typedef RBTreeIterator<value_type, const_reference, const_pointer, OrderStatistics> const_iterator;
+    typedef FrozenTree<Key, Val, KeyOfValue, Compare, Alloc> frozen_type;
 
 private:
     void init() {
@@ -278,6 +311,8 @@ public:
 
     Compare key_comp() const { return keyCompare_; }
 
+    Alloc get_allocator() const { return Alloc(nalloc); }
+
     iterator begin() { return iterator(leftmost()); } // leftmost is begin()
     const_iterator begin() const { return const_iterator(leftmost()); }
 
@@ -318,21 +353,23 @@ private:
     // rotate left
     inline void _rotate_left(NodePtr x, NodePtr &root) {
         NodePtr y = x->right_;
-        x->right_ = y->left_;
+        _storeLink(x->right_, y->left_);
         if (y->left_ != 0) {
             y->left_->parent_ = x;
         }
         y->parent_ = x->parent_;
 
         if (x == root) {
-            root = y;
+            _storeLink(root, y);
         } else if (x->parent_->right_ == x) {
-            x->parent_->right_ = y;
+            _storeLink(x->parent_->right_, y);
         } else {
-            x->parent_->left_ = y;
+            _storeLink(x->parent_->left_, y);
         }
-        y->left_ = x;
+        _storeLink(y->left_, x);
         x->parent_ = y;
+        Sizes::update(x);
+        Sizes::update(y);
     }
 
     /*
@@ -345,21 +382,23 @@ private:
     // rotate right
     inline void _rotate_right(NodePtr x, NodePtr &root) {
         NodePtr y = x->left_;
-        x->left_ = y->right_;
+        _storeLink(x->left_, y->right_);
         if (y->right_ != 0) {
             y->right_->parent_ = x;
         }
         y->parent_ = x->parent_;
 
         if (x == root) {
-            root = y;
+            _storeLink(root, y);
         } else if (x->parent_->right_ == x) {
-            x->parent_->right_ = y;
+            _storeLink(x->parent_->right_, y);
         } else {
-            x->parent_->left_ = y;
+            _storeLink(x->parent_->left_, y);
         }
-        y->right_ = x;
+        _storeLink(y->right_, x);
         x->parent_ = y;
+        Sizes::update(x);
+        Sizes::update(y);
     }
 
     /*
@@ -375,8 +414,9 @@ private:
      *         / \       a is a right node
      *        c   b      b is outside, c is inside
      */
-    // Rebalance the tree
-    inline void _rebalance(NodePtr x, NodePtr &root) {
+    // Rebalance the tree,
+    // return whether the root turned black, so the black height grew.
+    inline bool _rebalance(NodePtr x, NodePtr &root) {
         x->color_ = rb_red;
         while (x != root && x->parent_->color_ == rb_red) {  // rebalance only when parent is red
             if (x->parent_ == x->parent_->parent_->left_) {  // father is a left node
@@ -405,6 +445,7 @@ private:
                     x->parent_->color_ = rb_black;
                     y->color_ = rb_black;
                     x->parent_->parent_->color_ = rb_red;
+                    x = x->parent_->parent_; // percolate up
                 } else {    // // uncle is black or is null
                     if (x == x->parent_->left_) {   // x is inside
                         x = x->parent_;
@@ -417,36 +458,93 @@ private:
             }
         }
         // ensure root is black
+        bool grew = root->color_ == rb_red;
         root->color_ = rb_black;
+        return grew;
+    }
+
+    // the parent of the node to insert with key [k], equal keys go right
+    NodePtr _insertEqualPos(const Key &k) {
+        NodePtr y = header_;
+        NodePtr x = root();
+        while (x != nullptr) {
+            y = x;
+            // if k is smaller than x, go left
+            x = keyCompare_(k, key(x)) ? left(x) : right(x);
+        }
+        return y;
+    }
+
+    // Find the parent [y] of the node to insert with key [k].
+    // Return the node holding k if it exists, else nullptr.
+    // three considerations:
+    //  1. insert to the left of leftmost
+    //  2. insert to the right of y if bigger than y
+    //  3. insert to the left of y if bigger than decrement(y)
+    NodePtr _insertUniquePos(const Key &k, NodePtr &y) {
+        y = header_;
+        NodePtr x = root();
+        bool comp = true;
+        while (x != nullptr) {
+            y = x;
+            comp = keyCompare_(k, key(x));
+            x = comp ? left(x) : right(x);
+        }
+        // while end, y will be the parent of the node to insert
+
+        iterator j = iterator(y);
+        if (comp) { // comp is true, insert to left
+            if (j == begin()) {
+                return nullptr;
+            } else { // if j is not the leftmost
+                --j;
+                // need to --j, because k probably equal to --j,
+                // it need to be bigger than --j as the following comparsion.
+            }
+        }
+
+        // if k's node need to be inserted to y's right,
+        // k need to bigger than y.
+        // if k's node need to be inserted to y's left,
+        // k need to bigger than decrement(y).
+        if (keyCompare_(key(j.node_), k)) {
+            return nullptr;
+        }
+        return j.node_;
     }
 
     // x is the position need to be inserted
     // y is the father of x
     // v is the new value
-    iterator _insert(NodePtr x, NodePtr y, const Val &v) {
-        NodePtr z;
+    template<class V>
+    iterator _insert(NodePtr x, NodePtr y, V &&v) {
+        return _insertNode(x, y, createNode(std::forward<V>(v)));
+    }
 
+    // link the new node [z] as a child of [y]
+    iterator _insertNode(NodePtr x, NodePtr y, NodePtr z) {
+        // z is complete before it is linked
+        parent(z) = y;
+        left(z) = nullptr;
+        right(z) = nullptr;
         if (y == header_
             || x != nullptr
-            || keyCompare_(KeyOfValue()(v), key(y))) { // insert to left of y
-            z = createNode(v);
-            left(y) = z;
+            || keyCompare_(key(z), key(y))) { // insert to left of y
+            _storeLink(left(y), z);
             if (y == header_) {
-                root() = z;
+                _storeLink(root(), z);
                 rightmost() = z;
             } else if (y == leftmost()) {
                 leftmost() = z;
             }
         } else {
-            z = createNode(v);
-            right(y) = z;
+            _storeLink(right(y), z);
             if (y == rightmost()) {
                 rightmost() = z;
             }
         }
-        parent(z) = y;
-        left(z) = nullptr;
-        right(z) = nullptr;
+        Sizes::update(z);
+        Sizes::addToPath(y, header_, 1);
 
         // rebalance the tree
         _rebalance(z, root());
@@ -468,111 +566,291 @@ private:
 public:
     // allow replaced key
     iterator insertEqual(const Val &v) {
-        NodePtr y = header_;
-        NodePtr x = root();
-        while (x != nullptr) {
-            y = x;
-            // if v is smaller than x->right_, return true
-            x = keyCompare_(KeyOfValue()(v), key(x)) ? left(x) : right(x);
-        }
-        return _insert(x, y, v);
+        NodePtr y = _insertEqualPos(KeyOfValue()(v));
+        return _insert(nullptr, y, v);
+    }
+
+    iterator insertEqual(Val &&v) {
+        NodePtr y = _insertEqualPos(KeyOfValue()(v));
+        return _insert(nullptr, y, std::move(v));
+    }
+
+    // construct the value from [args] and insert it
+    template<class... Args>
+    iterator emplaceEqual(Args&&... args) {
+        NodePtr z = createNode(std::forward<Args>(args)...);
+        return _insertNode(nullptr, _insertEqualPos(key(z)), z);
     }
 
     // not allow replaced key
-    // three considerations:
-    //  1. insert to the left of leftmost
-    //  2. insert to the right of y if bigger than y
-    //  3. insert to the left of y if bigger than decrement(y)
     pair<iterator, bool> insertUnique(const Val &v) {
-        NodePtr y = header_;
-        NodePtr x = root();
-        bool comp = true;
-        while (x != nullptr) {
-            y = x;
-            comp = keyCompare_(KeyOfValue()(v), key(x));
-            x = comp ? left(x) : right(x);
+        NodePtr y;
+        if (NodePtr j = _insertUniquePos(KeyOfValue()(v), y)) {
+            return pair<iterator, bool>(iterator(j), false);
         }
-        // while end, y will be the parent of the node to insert
+        return pair<iterator, bool>(_insert(nullptr, y, v), true);
+    }
 
-        iterator j = iterator(y);
-        if (comp) { // comp is true, insert to left
-            if (j == begin()) {
-                return pair<iterator, bool>(_insert(x, y, v), true);
-            } else { // if j is not the leftmost
-                --j;
-                // need to --j, because KeyOfValue(v) probably equal to --j,
-                // it need to be bigger than --j as the following comparsion.
-            }
+    pair<iterator, bool> insertUnique(Val &&v) {
+        NodePtr y;
+        if (NodePtr j = _insertUniquePos(KeyOfValue()(v), y)) {
+            return pair<iterator, bool>(iterator(j), false);
         }
+        return pair<iterator, bool>(_insert(nullptr, y, std::move(v)), true);
+    }
 
-        // if v's node need to be inserted to y's right,
-        // KeyofValue(v) need to bigger than y.
-        // if v's node need to be inserted to y's left,
-        // KeyofValue(v) need to bigger than decrement(y).
-        if (keyCompare_(key(j.node_), KeyOfValue()(v))) {
-            return pair<iterator, bool>(_insert(x, y, v), true);
+    // Construct the value from [args] and insert it if the key does not exist.
+    // The key is known after the construction, so the node is
+    // destroyed again if the key exists.
+    template<class... Args>
+    pair<iterator, bool> emplaceUnique(Args&&... args) {
+        NodePtr z = createNode(std::forward<Args>(args)...);
+        NodePtr y;
+        if (NodePtr j = _insertUniquePos(key(z), y)) {
+            destroyNode(z);
+            return pair<iterator, bool>(iterator(j), false);
         }
-        return pair<iterator, bool>(j, false);
+        return pair<iterator, bool>(_insertNode(nullptr, y, z), true);
     }
 
+    // An empty tree is built in O(n) if the values are sorted, see assignUniqueSorted().
     template<class II>
     void insertUnique(II first, II last) {
-        for (; first != last; ++first) {
-            insertUnique(*first);
+        _insertUnique(first, last, typename std::iterator_traits<II>::iterator_category());
+    }
+
+    // Replace the values by [first, last), which is sorted by the keys,
+    // the later values of equal keys are dropped.
+    // The tree is built balanced in O(n), its nodes are allocated in one block
+    // and lie in key order. If the values are not sorted, they are inserted one by one.
+    template<class FI>
+    void assignUniqueSorted(FI first, FI last) {
+        clear();
+        if (!_buildUnique(first, last)) {
+            for (; first != last; ++first) {
+                insertUnique(*first);
+            }
         }
     }
 
-    void insertUnique(iterator first, iterator last) {
+private:
+    template<class II>
+    void _insertUnique(II first, II last, std::input_iterator_tag) {
         for (; first != last; ++first) {
             insertUnique(*first);
         }
     }
 
-    void insertUnique(const_iterator first, const_iterator last) {
-        for (; first != last; ++first) {
-            insertUnique(*first);
+    template<class FI>
+    void _insertUnique(FI first, FI last, std::forward_iterator_tag) {
+        if (nodeCount_ == 0 && _buildUnique(first, last)) {
+            return;
         }
+        _insertUnique(first, last, std::input_iterator_tag());
     }
 
-    // input pointer
-    void insertUnique(pointer first, pointer last) {
-        for (; first != last; ++first) {
-            insertUnique(*first);
+    // build the empty tree from the sorted values, return false if they are not sorted
+    template<class FI>
+    bool _buildUnique(FI first, FI last) {
+        size_type n = 0;
+        for (FI prev = first, cur = first; cur != last; prev = cur, ++cur) {
+            if (cur != first) {
+                if (keyCompare_(KeyOfValue()(*cur), KeyOfValue()(*prev))) {
+                    return false;
+                }
+                if (!keyCompare_(KeyOfValue()(*prev), KeyOfValue()(*cur))) {
+                    continue; // equal key
+                }
+            }
+            n++;
+        }
+        if (n == 0) {
+            return true;
+        }
+
+        NodePtr nodes = blocks_.allocate(nalloc, n);
+        size_type i = 0;
+        try {
+            for (FI prev = first, cur = first; cur != last; prev = cur, ++cur) {
+                if (cur == first || keyCompare_(KeyOfValue()(*prev), KeyOfValue()(*cur))) {
+                    NodeAllocTraits::construct(nalloc, &(nodes[i].value_), *cur);
+                    i++;
+                }
+            }
+        } catch (...) {
+            // the block is freed with the last of its nodes
+            for (size_type j = i; j < n; j++) {
+                putNode(nodes + j);
+            }
+            while (i > 0) {
+                destroyNode(nodes + --i);
+            }
+            throw;
         }
+
+        // A balanced tree of h levels is black except its last level,
+        // which is red if it is not full, so every path has h - 1 black nodes.
+        size_type h = 0;
+        while ((size_type(1) << h) - 1 < n) {
+            h++;
+        }
+        const size_type redDepth = ((size_type(1) << h) - 1 == n) ? h : h - 1;
+        root() = _link(nodes, 0, n, header_, 0, redDepth);
+        leftmost() = nodes;
+        rightmost() = nodes + n - 1;
+        nodeCount_ = n;
+        return true;
     }
 
-    // Insert value to specific pos.
-    // Actually, you can always use insertUnique(), because the pos is not to be trust.
-    // You can do some improvement in a few scenes.
-    iterator insertUnique(iterator pos, const Val &x) {
-        if (pos.node_ == begin()) {  // begin()
-            if (size() > 0 && keyCompare_(KeyOfValue(x), key(pos.node_))) {
-                return _insert(pos.node_, pos.node_, x);
-            } else {
-                return insertUnique(x).first;
+    // link nodes[lo, hi) as a balanced subtree, the middle one is the root
+    NodePtr _link(NodePtr nodes, size_type lo, size_type hi, NodePtr p, size_type depth, size_type redDepth) {
+        if (lo >= hi) {
+            return nullptr;
+        }
+        const size_type mid = lo + (hi - lo) / 2;
+        NodePtr x = nodes + mid;
+        x->parent_ = p;
+        x->color_ = depth == redDepth ? rb_red : rb_black;
+        x->left_ = _link(nodes, lo, mid, x, depth + 1, redDepth);
+        x->right_ = _link(nodes, mid + 1, hi, x, depth + 1, redDepth);
+        Sizes::update(x);
+        return x;
+    }
+
+public:
+    // Insert [v] if its key does not exist, return the node with the key.
+    // The position right before or after [pos] is tried first, and the
+    // descent from the root is skipped if [v] belongs there. Passing end()
+    // for increasing keys appends them at the rightmost node in O(1) amortized.
+    iterator insertUnique(const_iterator pos, const Val &v) { return _insertUniqueHint(pos.node_, v); }
+
+    iterator insertUnique(const_iterator pos, Val &&v) { return _insertUniqueHint(pos.node_, std::move(v)); }
+
+    iterator insertUnique(iterator pos, const Val &v) { return _insertUniqueHint(pos.node_, v); }
+
+    iterator insertUnique(iterator pos, Val &&v) { return _insertUniqueHint(pos.node_, std::move(v)); }
+
+    // insert [v] right before or after [pos] if it belongs there, else as insertEqual(v)
+    iterator insertEqual(const_iterator pos, const Val &v) { return _insertEqualHint(pos.node_, v); }
+
+    iterator insertEqual(const_iterator pos, Val &&v) { return _insertEqualHint(pos.node_, std::move(v)); }
+
+    iterator insertEqual(iterator pos, const Val &v) { return _insertEqualHint(pos.node_, v); }
+
+    iterator insertEqual(iterator pos, Val &&v) { return _insertEqualHint(pos.node_, std::move(v)); }
+
+private:
+    template<class V>
+    iterator _insertUniqueHint(NodePtr pos, V &&v) {
+        NodePtr x, y;
+        if (NodePtr j = _hintUniquePos(pos, KeyOfValue()(v), x, y)) {
+            return iterator(j);
+        }
+        return _insert(x, y, std::forward<V>(v));
+    }
+
+    template<class V>
+    iterator _insertEqualHint(NodePtr pos, V &&v) {
+        NodePtr x, y;
+        _hintEqualPos(pos, KeyOfValue()(v), x, y);
+        return _insert(x, y, std::forward<V>(v));
+    }
+
+    // Find where to insert the key [k] next to [pos] as _insertNode(x, y) takes it,
+    // a non-null [x] puts the node at the left of [y].
+    // Return the node holding k if it exists, else nullptr.
+    NodePtr _hintUniquePos(NodePtr pos, const Key &k, NodePtr &x, NodePtr &y) {
+        x = nullptr;
+        if (pos == header_) {
+            if (nodeCount_ > 0 && keyCompare_(key(rightmost()), k)) {
+                y = rightmost();
+                return nullptr;
             }
-        } else if (pos.node_ == end()) { // end()
-            if (keyCompare_(key(rightmost()), KeyOfValue(x))) {
-                return _insert(nullptr, pos.node_, x);  // insert to right
-            } else {
-                return insertUnique(x).first;
+            return _insertUniquePos(k, y);
+        }
+        if (keyCompare_(k, key(pos))) {
+            if (pos == leftmost()) {
+                x = y = pos;
+                return nullptr;
             }
-        } else {
-            iterator before = pos;
+            iterator before(pos);
             --before;
-            if (keyCompare_(key(before.node_), KeyOfValue(x))
-                && keyCompare_(KeyOfValue(x), key(pos.node_))) {
+            if (keyCompare_(key(before.node_), k)) {
                 if (right(before.node_) == nullptr) {
-                    return _insert(nullptr, pos.node_, x);
+                    y = before.node_;
                 } else {
-                    return _insert(pos.node_, pos.node_, x);
+                    x = y = pos;
                 }
+                return nullptr;
+            }
+            return _insertUniquePos(k, y);
+        }
+        if (keyCompare_(key(pos), k)) {
+            if (pos == rightmost()) {
+                y = pos;
+                return nullptr;
+            }
+            iterator after(pos);
+            ++after;
+            if (keyCompare_(k, key(after.node_))) {
+                if (right(pos) == nullptr) {
+                    y = pos;
+                } else {
+                    x = y = after.node_;
+                }
+                return nullptr;
+            }
+            return _insertUniquePos(k, y);
+        }
+        return pos; // equal key
+    }
+
+    // as _hintUniquePos(), the equal keys stay in the order of insertion
+    void _hintEqualPos(NodePtr pos, const Key &k, NodePtr &x, NodePtr &y) {
+        x = nullptr;
+        if (pos == header_) {
+            if (nodeCount_ > 0 && !keyCompare_(k, key(rightmost()))) {
+                y = rightmost();
             } else {
-                return insertUnique(x).first;
+                y = _insertEqualPos(k);
+            }
+            return;
+        }
+        if (!keyCompare_(key(pos), k)) {
+            if (pos == leftmost()) {
+                x = y = pos;
+                return;
+            }
+            iterator before(pos);
+            --before;
+            if (!keyCompare_(k, key(before.node_))) {
+                if (right(before.node_) == nullptr) {
+                    y = before.node_;
+                } else {
+                    x = y = pos;
+                }
+                return;
+            }
+        } else {
+            if (pos == rightmost()) {
+                y = pos;
+                return;
+            }
+            iterator after(pos);
+            ++after;
+            if (!keyCompare_(key(after.node_), k)) {
+                if (right(pos) == nullptr) {
+                    y = pos;
+                } else {
+                    x = y = after.node_;
+                }
+                return;
             }
         }
+        y = _insertEqualPos(k);
     }
 
+public:
     // find key.
     // If key(x) < k, go right,
     // else if key(x) >= k, go left.
@@ -710,6 +988,291 @@ public:
         return pair<const_iterator, const_iterator>(lowerBound(k), upperBound(k));
     }
 
+    // The k-th smallest value counting from 0, end() if k >= size().
+    // select(), rank() and countRange() need OrderStatistics.
+    iterator select(size_type k) { return iterator(_select(k)); }
+
+    const_iterator select(size_type k) const { return const_iterator(_select(k)); }
+
+    // the number of the values whose keys are less than [k], the index of lowerBound(k)
+    size_type rank(const Key &k) const {
+        static_assert(OrderStatistics, "rank() needs the subtree sizes of OrderStatistics");
+        size_type n = 0;
+        NodePtr x = root();
+        while (x != nullptr) {
+            if (keyCompare_(key(x), k)) {
+                n += Sizes::size(left(x)) + 1;
+                x = right(x);
+            } else {
+                x = left(x);
+            }
+        }
+        return n;
+    }
+
+    // the number of the values whose keys are in [lo, hi)
+    size_type countRange(const Key &lo, const Key &hi) const {
+        return keyCompare_(lo, hi) ? rank(hi) - rank(lo) : 0;
+    }
+
+    // copy the values in O(n) to an immutable array that is faster to search, see FrozenTree
+    frozen_type freeze() const { return frozen_type(begin(), nodeCount_, keyCompare_); }
+
+    // Move the values whose keys are not less than [k] to [other], which is cleared first.
+    // The nodes are relinked in O(log n) without allocation. Without OrderStatistics
+    // the sizes of the trees are counted from the cut, in O(min(size(), other.size())).
+    // Like std::list::splice, relinking needs get_allocator() == other.get_allocator(),
+    // else the values are copied to nodes of [other] one by one in O(m log m).
+    void split(const Key &k, Self &other) {
+        if (&other == this) {
+            return;
+        }
+        other.clear();
+        if (!(nalloc == other.nalloc)) {
+            iterator first = lowerBound(k);
+            for (iterator i = first; i != end(); ++i) {
+                other.insertEqual(other.end(), *i);
+            }
+            erase(first, end());
+            return;
+        }
+        other.blocks_.merge(blocks_);
+        const size_type n = nodeCount_;
+        int h;
+        NodePtr x = _detach(h);
+        NodePtr l, r;
+        int lh, rh;
+        _splitTree(x, h, k, l, lh, nullptr, r, rh);
+        _attach(l, 0);
+        other._attach(r, 0);
+        size_type m = Sizes::enabled ? Sizes::size(r) : _countFromCut(other, n);
+        nodeCount_ = n - m;
+        other.nodeCount_ = m;
+    }
+
+    // Move all the values of [other] to this tree in O(log n) without allocation.
+    // The keys of one tree must all be less than the keys of the other,
+    // else std::invalid_argument is thrown and both trees are left as they were.
+    // As for split(), the nodes are relinked only if the allocators compare equal,
+    // else the values of [other] are copied one by one in O(m) and [other] is cleared.
+    void join(Self &other) {
+        if (&other == this || other.nodeCount_ == 0) {
+            return;
+        }
+        if (nodeCount_ != 0 && !keyCompare_(key(rightmost()), key(other.leftmost()))
+            && !keyCompare_(key(other.rightmost()), key(leftmost()))) {
+            throw std::invalid_argument("RBTree::join: the keys of the trees overlap");
+        }
+        bool after = nodeCount_ != 0 && keyCompare_(key(other.rightmost()), key(leftmost()));
+        if (!(nalloc == other.nalloc)) {
+            // the values of [other] go right before begin() or end(), the hint always holds
+            iterator pos = after ? begin() : end();
+            for (iterator i = other.begin(); i != other.end(); ++i) {
+                insertEqual(pos, *i);
+            }
+            other.clear();
+            return;
+        }
+        blocks_.merge(other.blocks_);
+        const size_type n = nodeCount_ + other.nodeCount_;
+        int lh, rh, h;
+        NodePtr l = _detach(lh);
+        NodePtr r = other._detach(rh);
+        if (after) {
+            std::swap(l, r);
+            std::swap(lh, rh);
+        }
+        _attach(_join2(l, lh, r, rh, h), n);
+    }
+
+private:
+    // The node trees of split() and join() are detached from the header,
+    // the parent of their root is nullptr. The roots are black and their
+    // height is the black height, the number of black nodes down to a leaf.
+
+    // detach the nodes from the header, the tree becomes empty
+    NodePtr _detach(int &h) {
+        NodePtr x = root();
+        h = 0;
+        if (x != nullptr) {
+            x->parent_ = nullptr;
+            for (NodePtr y = x; y != nullptr; y = left(y)) {
+                h += y->color_ == rb_black;
+            }
+        }
+        _storeLink(root(), nullptr);
+        leftmost() = header_;
+        rightmost() = header_;
+        nodeCount_ = 0;
+        return x;
+    }
+
+    // the nodes of [x] become the tree
+    void _attach(NodePtr x, size_type n) {
+        root() = x;
+        if (x != nullptr) {
+            x->parent_ = header_;
+            leftmost() = minimum(x);
+            rightmost() = maximum(x);
+        } else {
+            leftmost() = header_;
+            rightmost() = header_;
+        }
+        nodeCount_ = n;
+    }
+
+    // the size of [other], counted together with this tree from the cut between them
+    size_type _countFromCut(Self &other, size_type n) {
+        iterator i = end();
+        iterator j = other.begin();
+        for (size_type m = 0; ; m++) {
+            if (i == begin()) {
+                return n - m;
+            }
+            if (j == other.end()) {
+                return m;
+            }
+            --i;
+            ++j;
+        }
+    }
+
+    // cut the children of [x] of height [h] off as two trees
+    void _detachChildren(NodePtr x, int h, NodePtr &l, int &lh, NodePtr &r, int &rh) {
+        const int ch = h - (x->color_ == rb_black);
+        l = left(x);
+        r = right(x);
+        lh = rh = ch;
+        if (l != nullptr) {
+            l->parent_ = nullptr;
+            if (l->color_ == rb_red) {
+                l->color_ = rb_black;
+                lh++;
+            }
+        }
+        if (r != nullptr) {
+            r->parent_ = nullptr;
+            if (r->color_ == rb_red) {
+                r->color_ = rb_black;
+                rh++;
+            }
+        }
+        left(x) = nullptr;
+        right(x) = nullptr;
+    }
+
+    // Join the trees [l] and [r] with the node [m] between them, return the root.
+    // The lower tree is linked in at the side of the higher one and
+    // rebalanced like an insertion, in O(|lh - rh|).
+    NodePtr _joinTrees(NodePtr l, int lh, NodePtr m, NodePtr r, int rh, int &h) {
+        if (lh == rh) {
+            left(m) = l;
+            right(m) = r;
+            parent(m) = nullptr;
+            if (l != nullptr) parent(l) = m;
+            if (r != nullptr) parent(r) = m;
+            m->color_ = rb_black;
+            Sizes::update(m);
+            h = lh + 1;
+            return m;
+        }
+        NodePtr top = lh > rh ? l : r;
+        NodePtr p = nullptr;
+        NodePtr c = top;
+        int ch = lh > rh ? lh : rh;
+        const int target = lh > rh ? rh : lh;
+        // the black node on the spine with the black height of the lower tree
+        while (c != nullptr && !(ch == target && c->color_ == rb_black)) {
+            ch -= c->color_ == rb_black;
+            p = c;
+            c = lh > rh ? right(c) : left(c);
+        }
+        if (lh > rh) {
+            left(m) = c;
+            right(m) = r;
+            right(p) = m;
+            if (r != nullptr) parent(r) = m;
+        } else {
+            left(m) = l;
+            right(m) = c;
+            left(p) = m;
+            if (l != nullptr) parent(l) = m;
+        }
+        if (c != nullptr) parent(c) = m;
+        parent(m) = p;
+        Sizes::update(m);
+        Sizes::addToPath(p, NodePtr(nullptr), Sizes::size(m) - Sizes::size(c));
+        bool grew = _rebalance(m, top);
+        h = (lh > rh ? lh : rh) + grew;
+        return top;
+    }
+
+    // join [l] and [r], the minimum of [r] becomes the node between them
+    NodePtr _join2(NodePtr l, int lh, NodePtr r, int rh, int &h) {
+        if (r == nullptr || l == nullptr) {
+            h = r == nullptr ? lh : rh;
+            return r == nullptr ? l : r;
+        }
+        NodePtr e, m;
+        int eh;
+        _splitTree(r, rh, key(minimum(r)), e, eh, &m, r, rh);
+        return _joinTrees(l, lh, m, r, rh, h);
+    }
+
+    // Cut the tree [x] into [l] with the keys less than [k] and [r] with the others.
+    // If [mid] is given, the node with the key [k] is cut off as *mid,
+    // which needs unique keys.
+    void _splitTree(NodePtr x, int h, const Key &k, NodePtr &l, int &lh,
+                    NodePtr *mid, NodePtr &r, int &rh) {
+        if (mid != nullptr) {
+            *mid = nullptr;
+        }
+        if (x == nullptr) {
+            l = r = nullptr;
+            lh = rh = 0;
+            return;
+        }
+        NodePtr a, b;
+        int ah, bh;
+        _detachChildren(x, h, a, ah, b, bh);
+        if (keyCompare_(key(x), k)) {
+            NodePtr bl;
+            int blh;
+            _splitTree(b, bh, k, bl, blh, mid, r, rh);
+            l = _joinTrees(a, ah, x, bl, blh, lh);
+        } else if (mid != nullptr && !keyCompare_(k, key(x))) {
+            *mid = x;
+            l = a;
+            lh = ah;
+            r = b;
+            rh = bh;
+        } else {
+            NodePtr ar;
+            int arh;
+            _splitTree(a, ah, k, l, lh, mid, ar, arh);
+            r = _joinTrees(ar, arh, x, b, bh, rh);
+        }
+    }
+
+    NodePtr _select(size_type k) const {
+        static_assert(OrderStatistics, "select() needs the subtree sizes of OrderStatistics");
+        if (k >= nodeCount_) {
+            return header_;
+        }
+        NodePtr x = root();
+        for (;;) {
+            size_type n = Sizes::size(left(x));
+            if (k < n) {
+                x = left(x);
+            } else if (k == n) {
+                return x;
+            } else {
+                k -= n + 1;
+                x = right(x);
+            }
+        }
+    }
+
 public:
     bool operator==(const Self &x) {
         return size() == x.size() && std::equal(begin(), end(), x.begin());
@@ -738,28 +1301,31 @@ private:
                 y = y->left_;
             x = y->right_;
         }
+        // y leaves its place, z leaves the tree
+        Sizes::addToPath(y->parent_, header_, -1);
 
         if (y != z) {  // mean that z has two children
             z->left_->parent_ = y;
-            y->left_ = z->left_;
+            _storeLink(y->left_, z->left_);
             if (y != z->right_) {
                 xParent = y->parent_;
                 if (x) x->parent_ = y->parent_;
-                y->parent_->left_ = x;      // y must be a child of left
-                y->right_ = z->right_;
+                _storeLink(y->parent_->left_, x);      // y must be a child of left
+                _storeLink(y->right_, z->right_);
                 z->right_->parent_ = y;
             } else {
                 xParent = y;
             }
 
             if (root() == z)
-                root() = y;
+                _storeLink(root(), y);
             else if (z->parent_->left_ == z)
-                z->parent_->left_ = y;
+                _storeLink(z->parent_->left_, y);
             else
-                z->parent_->right_ = y;
+                _storeLink(z->parent_->right_, y);
 
             y->parent_ = z->parent_;
+            Sizes::update(y);
             std::swap(y->color_, z->color_);
 //            y->color_ = z->color_; // copy the color
             y = z;
@@ -768,11 +1334,11 @@ private:
             xParent = y->parent_;
             if (x) x->parent_ = y->parent_;
             if (root() == z)
-                root() = x;
+                _storeLink(root(), x);
             else if (z->parent_->left_ == z)
-                z->parent_->left_ = x;
+                _storeLink(z->parent_->left_, x);
             else
-                z->parent_->right_ = x;
+                _storeLink(z->parent_->right_, x);
             if (leftmost() == z)
                 if (z->right_ == nullptr)        // z->left must be null also
                     leftmost() = z->parent_;
@@ -851,8 +1417,8 @@ private:
                         break;
                     }
                 }
-                if (x) x->color_ = rb_black;
             }
+            if (x) x->color_ = rb_black;
         }
         return z;
     }
@@ -152,7 +152,6 @@ protected:
 
     void destroyNode(NodePtr p) {
         NodeAllocTraits::destroy(nalloc, &(p->data_));
-        NodeAllocTraits::destroy(nalloc, p);
         NodeAllocTraits::deallocate(nalloc, p, 1);
     }
 
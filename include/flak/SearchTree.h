@@ -174,7 +174,6 @@ protected:
 
     void destroyNode(NodePtr p) {
         NodeAllocTraits::destroy(nodeAlloc, &(p->value_));
-        NodeAllocTraits::destroy(nodeAlloc, p);
         putNode(p);
     }
 
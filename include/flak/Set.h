@@ -22,11 +22,14 @@ limitations under the License.
 
 #include <functional>
 #include "RBTree.h"
+#include "TreeSetOps.h"
 using std::pair;
 
 namespace flak {
 
-template<class Key, class Compare = std::less<Key>, class Alloc = std::allocator<Key>>
+// [OrderStatistics] keeps the subtree sizes for select() and rank()
+template<class Key, class Compare = std::less<Key>, class Alloc = std::allocator<Key>,
+        bool OrderStatistics = false>
 class Set {
     typedef Key key_type;
     typedef Key value_type;
@@ -35,7 +38,7 @@ class Set {
 private:
 
     typedef RBTree<key_type, value_type,
-            std::_Identity<value_type>, key_compare, Alloc> rep_type;
+            std::_Identity<value_type>, key_compare, Alloc, OrderStatistics> rep_type;
 
     // define a rbtree object
     rep_type t_;
@@ -47,10 +50,11 @@ public:
     typedef typename rep_type::const_reference const_reference;
     typedef typename rep_type::const_iterator iterator;
     typedef typename rep_type::const_iterator const_iterator;
+    typedef typename rep_type::frozen_type frozen_type;
     typedef typename rep_type::size_type size_type;
     typedef typename rep_type::difference_type difference_type;
 
-    typedef Set<Key, Compare, Alloc> Self;
+    typedef Set<Key, Compare, Alloc, OrderStatistics> Self;
 
     Set() : t_(Compare()) {}
 
@@ -91,8 +95,27 @@ public:
         return pair<iterator, bool>((iterator &) p.first, p.second);
     }
 
+    pair<iterator, bool> insert(value_type &&x) {
+        pair<typename rep_type::iterator, bool> p = t_.insertUnique(std::move(x));
+        return pair<iterator, bool>((iterator &) p.first, p.second);
+    }
+
+    // construct the element in place
+    template<class... Args>
+    pair<iterator, bool> emplace(Args &&... args) {
+        pair<typename rep_type::iterator, bool> p = t_.emplaceUnique(std::forward<Args>(args)...);
+        return pair<iterator, bool>((iterator &) p.first, p.second);
+    }
+
+    // [pos] is a hint, inserting right before it or at end() for increasing keys skips the search
     iterator insert(iterator pos, const value_type &x) {
-        return t_.insertUnique(pos, x);
+        typename rep_type::iterator it = t_.insertUnique(pos, x);
+        return (iterator &) it;
+    }
+
+    iterator insert(iterator pos, value_type &&x) {
+        typename rep_type::iterator it = t_.insertUnique(pos, std::move(x));
+        return (iterator &) it;
     }
 
     void insert(const_iterator first, const_iterator last) {
@@ -125,6 +148,39 @@ public:
         return t_.find(x) == t_.end() ? 0 : 1;
     }
 
+    // select(), rank() and countRange() need OrderStatistics, see RBTree
+    iterator select(size_type k) const { return t_.select(k); }
+
+    size_type rank(const key_type &x) const { return t_.rank(x); }
+
+    size_type countRange(const key_type &lo, const key_type &hi) const {
+        return t_.countRange(lo, hi);
+    }
+
+    // an immutable copy that is faster to search, see FrozenTree
+    frozen_type freeze() const { return t_.freeze(); }
+
+    // move the keys not less than [k] to [x], see RBTree::split
+    void split(const key_type &k, Self &x) { t_.split(k, x.t_); }
+
+    // move all the keys of [x] here, see RBTree::join
+    void join(Self &x) { t_.join(x.t_); }
+
+    // This set becomes the union, intersection or difference with [x],
+    // which is left empty. [threads] is the number of threads to use,
+    // 0 for all the cores. See TreeSetOps.h.
+    void setUnion(Self &x, unsigned threads = 0) {
+        TreeSetOps<rep_type>::unite(t_, x.t_, threads);
+    }
+
+    void setIntersection(Self &x, unsigned threads = 0) {
+        TreeSetOps<rep_type>::intersect(t_, x.t_, threads);
+    }
+
+    void setDifference(Self &x, unsigned threads = 0) {
+        TreeSetOps<rep_type>::subtract(t_, x.t_, threads);
+    }
+
     iterator lowerBound(const key_type &x) const {
         return t_.lowerBound(x);
     }
@@ -0,0 +1,157 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// SmallVector is a Vector that keeps up to N elements inside the object,
+// so a short vector does not allocate at all:
+//
+//     flak::SmallVector<int, 8> v;   // v.push_back() allocates from the 9th element
+//
+// It is a Vector with an InlineAllocator. The allocator holds the space of
+// N elements, and the vector reserves it when it is constructed. When the
+// vector grows past N, Vector moves the elements to the heap as usual and
+// gives the inline space back. Iterators, erase() and reserve() are the
+// ones of Vector.
+//
+// The elements may live in the object, so a SmallVector is copied element
+// by element, and its iterators are invalid after it is copied.
+
+#ifndef FLAK_SMALL_VECTOR_H
+#define FLAK_SMALL_VECTOR_H
+
+#include "Vector.h"
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+
+namespace flak {
+
+// Hands out its inline space of N objects once at a time,
+// the other requests go to Alloc.
+template<class T, size_t N, class Alloc = std::allocator<T>>
+class InlineAllocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind {
+        typedef InlineAllocator<U, N, typename std::allocator_traits<Alloc>::template rebind_alloc<U>> other;
+    };
+
+private:
+    typedef std::allocator_traits<Alloc> AllocTraits;
+
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type buffer_;
+    bool used_;
+    Alloc alloc_;
+
+public:
+    InlineAllocator() : used_(false) {}
+
+    // the inline space is never shared, a copy has its own
+    InlineAllocator(const InlineAllocator& x) : used_(false), alloc_(x.alloc_) {}
+
+    template<class U, class Alloc2>
+    InlineAllocator(const InlineAllocator<U, N, Alloc2>& x) : used_(false), alloc_(x.alloc_) {}
+
+    InlineAllocator& operator=(const InlineAllocator&) { return *this; }
+
+    T* allocate(size_type n) {
+        if (!used_ && n <= N) {
+            used_ = true;
+            return inlineData();
+        }
+        return AllocTraits::allocate(alloc_, n);
+    }
+
+    void deallocate(T* p, size_type n) {
+        if (p == inlineData()) {
+            used_ = false;
+        } else {
+            AllocTraits::deallocate(alloc_, p, n);
+        }
+    }
+
+    T* inlineData() { return reinterpret_cast<T*>(&buffer_); }
+
+    const T* inlineData() const { return reinterpret_cast<const T*>(&buffer_); }
+
+    // the memory of two allocators can only be freed by the one that gave it
+    bool operator==(const InlineAllocator& x) const { return this == &x; }
+
+    bool operator!=(const InlineAllocator& x) const { return this != &x; }
+
+private:
+    template<class U, size_t M, class Alloc2> friend class InlineAllocator;
+};
+
+template<class T, size_t N, class Alloc = std::allocator<T>, class Growth = std::ratio<2>>
+class SmallVector : public Vector<T, InlineAllocator<T, N, Alloc>, Growth> {
+private:
+    typedef Vector<T, InlineAllocator<T, N, Alloc>, Growth> Base;
+
+public:
+    typedef typename Base::value_type value_type;
+    typedef typename Base::pointer pointer;
+    typedef typename Base::iterator iterator;
+    typedef typename Base::reference reference;
+    typedef typename Base::size_type size_type;
+    typedef typename Base::difference_type difference_type;
+
+    static const size_type inline_capacity = N;
+
+    SmallVector() { this->reserve(N); }
+
+    SmallVector(size_type n, const T& value) : SmallVector() {
+        this->reserve(n);
+        for (size_type i = 0; i < n; i++) {
+            this->push_back(value);
+        }
+    }
+
+    explicit SmallVector(size_type n) : SmallVector(n, T()) {}
+
+    template<class InputIterator, class = typename std::enable_if<
+            !std::is_integral<InputIterator>::value>::type>
+    SmallVector(InputIterator first, InputIterator last) : SmallVector() {
+        for (; first != last; ++first) {
+            this->push_back(*first);
+        }
+    }
+
+    SmallVector(std::initializer_list<T> ils) : SmallVector(ils.begin(), ils.end()) {}
+
+    SmallVector(const SmallVector& x) : SmallVector(x.begin(), x.end()) {}
+
+    SmallVector& operator=(const SmallVector& x) {
+        Base::operator=(x);
+        return *this;
+    }
+
+    // whether the elements are still inside the object
+    bool isInline() const { return this->start_ == this->valloc.inlineData(); }
+};
+
+}
+
+#endif //FLAK_SMALL_VECTOR_H
@@ -0,0 +1,74 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// SubtreeSize is the optional order statistic of RBTree and AVLTree.
+// With SubtreeSize<true> as its base, a node keeps the number of nodes
+// in its subtree, which lets the tree find the k-th value and the rank
+// of a key in O(log n). The trees keep it up to date when they link,
+// unlink and rotate nodes.
+//
+// SubtreeSize<false> is empty, and its updates do nothing, so the trees
+// without order statistics keep their node size and speed.
+
+#ifndef FLAK_SUBTREE_SIZE_H
+#define FLAK_SUBTREE_SIZE_H
+
+#include <cstddef>
+
+namespace flak {
+
+template<bool Enable>
+struct SubtreeSize {
+    static const bool enabled = false;
+
+    template<class NodePtr>
+    static size_t size(NodePtr) { return 0; }
+
+    template<class NodePtr>
+    static void update(NodePtr) {}
+
+    template<class NodePtr>
+    static void addToPath(NodePtr, NodePtr, ptrdiff_t) {}
+};
+
+template<>
+struct SubtreeSize<true> {
+    static const bool enabled = true;
+
+    size_t size_;
+
+    template<class NodePtr>
+    static size_t size(NodePtr x) { return x ? x->size_ : 0; }
+
+    // recount [x] from its children
+    template<class NodePtr>
+    static void update(NodePtr x) {
+        x->size_ = size(x->left_) + size(x->right_) + 1;
+    }
+
+    // add [d] to the sizes of [x] and its ancestors below [header]
+    template<class NodePtr>
+    static void addToPath(NodePtr x, NodePtr header, ptrdiff_t d) {
+        for (; x != header; x = x->parent_) {
+            x->size_ += d;
+        }
+    }
+};
+
+}
+
+#endif //FLAK_SUBTREE_SIZE_H
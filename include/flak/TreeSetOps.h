@@ -0,0 +1,191 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// TreeSetOps is the union, intersection and difference of two RBTree or
+// AVLTree with unique keys, built on their split and join. The root of
+// one tree cuts the other at its key, the two halves are combined the
+// same way, and joined again with the root between them:
+//
+//  op(a, b):  (bl, dup, br) = split(b, key(a.root))
+//             join(op(a.left, bl), a.root, op(a.right, br))
+//
+// which takes O(m log(n / m + 1)) for the sizes m <= n. The two halves
+// are independent, so the upper levels of the recursion run on their
+// own threads. The nodes are relinked, the result is left in the first
+// tree and the second one is left empty. The dropped nodes are freed at
+// the end on the calling thread, the allocator is not shared by threads.
+//
+// The nodes are relinked only if a.get_allocator() == b.get_allocator(),
+// as for std::list::splice. Else the values of the second tree are
+// inserted to or erased from the first one by one, in O(m log n).
+//
+// The comparison must not throw, a thread would terminate then.
+
+#ifndef FLAK_TREE_SET_OPS_H
+#define FLAK_TREE_SET_OPS_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace flak {
+
+template<class Tree>
+struct TreeSetOps {
+    typedef typename Tree::NodePtr NodePtr;
+    typedef typename Tree::size_type size_type;
+
+    enum Op {
+        op_union, op_intersection, op_difference
+    };
+
+    // the subtrees smaller than this are not worth a thread
+    static const size_type parallel_grain = 1 << 14;
+
+    // [threads] is the number of threads to use, 0 for all the cores
+    static void unite(Tree& a, Tree& b, unsigned threads = 0) { apply(a, b, op_union, threads); }
+
+    static void intersect(Tree& a, Tree& b, unsigned threads = 0) { apply(a, b, op_intersection, threads); }
+
+    static void subtract(Tree& a, Tree& b, unsigned threads = 0) { apply(a, b, op_difference, threads); }
+
+    static void apply(Tree& a, Tree& b, Op op, unsigned threads) {
+        if (&a == &b) {
+            if (op == op_difference) {
+                a.clear();
+            }
+            return;
+        }
+        if (!(a.get_allocator() == b.get_allocator())) {
+            _applyByValue(a, b, op);
+            return;
+        }
+        a.blocks_.merge(b.blocks_);
+        const size_type n = a.nodeCount_ + b.nodeCount_;
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        int levels = 0;   // the levels of the recursion that fork
+        while ((1u << levels) < threads) {
+            levels++;
+        }
+        Sub x, y;
+        x.root = a._detach(x.height);
+        y.root = b._detach(y.height);
+        std::vector<NodePtr> dropped;
+        Sub z = _apply(a, x, y, op, dropped, levels, n);
+        size_type freed = 0;
+        for (NodePtr d : dropped) {
+            freed += _destroy(a, d);
+        }
+        a._attach(z.root, n - freed);
+    }
+
+private:
+    // the nodes of [b] cannot move to [a], the values are copied instead
+    static void _applyByValue(Tree& a, Tree& b, Op op) {
+        typedef typename Tree::iterator iterator;
+        if (op == op_intersection) {
+            for (iterator i = a.begin(); i != a.end();) {
+                iterator j = i++;
+                if (b.find(Tree::key(j.node_)) == b.end()) {
+                    a.erase(j);
+                }
+            }
+        } else {
+            for (iterator i = b.begin(); i != b.end(); ++i) {
+                if (op == op_union) {
+                    a.insertUnique(*i);
+                } else {
+                    a.erase(Tree::key(i.node_));
+                }
+            }
+        }
+        b.clear();
+    }
+
+    // a tree detached from its header, its height as the tree defines it
+    struct Sub {
+        NodePtr root = nullptr;
+        int height = 0;
+    };
+
+    // [dropped] collects the roots of the trees to free,
+    // [work] is about the number of nodes below
+    static Sub _apply(Tree& t, Sub a, Sub b, Op op, std::vector<NodePtr>& dropped,
+                      int levels, size_type work) {
+        if (a.root == nullptr || b.root == nullptr) {
+            const bool keepA = op != op_intersection;
+            const bool keepB = op == op_union;
+            Sub none;
+            if (a.root != nullptr && !keepA) {
+                dropped.push_back(a.root);
+            }
+            if (b.root != nullptr && !keepB) {
+                dropped.push_back(b.root);
+            }
+            return a.root != nullptr ? (keepA ? a : none) : (keepB ? b : none);
+        }
+        NodePtr m = a.root;
+        Sub al, ar, bl, br;
+        NodePtr dup;
+        t._detachChildren(m, a.height, al.root, al.height, ar.root, ar.height);
+        t._splitTree(b.root, b.height, Tree::key(m), bl.root, bl.height, &dup, br.root, br.height);
+
+        Sub l, r;
+        if (levels > 0 && work >= parallel_grain) {
+            std::vector<NodePtr> rightDropped;
+            std::thread right([&] {
+                r = _apply(t, ar, br, op, rightDropped, levels - 1, work / 2);
+            });
+            l = _apply(t, al, bl, op, dropped, levels - 1, work / 2);
+            right.join();
+            dropped.insert(dropped.end(), rightDropped.begin(), rightDropped.end());
+        } else {
+            l = _apply(t, al, bl, op, dropped, 0, work / 2);
+            r = _apply(t, ar, br, op, dropped, 0, work / 2);
+        }
+
+        if (dup != nullptr) {
+            dropped.push_back(dup);
+        }
+        Sub z;
+        if (op == op_union || (op == op_intersection) == (dup != nullptr)) {
+            z.root = t._joinTrees(l.root, l.height, m, r.root, r.height, z.height);
+        } else {
+            dropped.push_back(m);
+            z.root = t._join2(l.root, l.height, r.root, r.height, z.height);
+        }
+        return z;
+    }
+
+    // free the tree [x], return the number of its nodes
+    static size_type _destroy(Tree& t, NodePtr x) {
+        size_type n = 0;
+        while (x != nullptr) {
+            n += _destroy(t, x->right_) + 1;
+            NodePtr y = x->left_;
+            t.destroyNode(x);
+            x = y;
+        }
+        return n;
+    }
+};
+
+}
+
+#endif //FLAK_TREE_SET_OPS_H
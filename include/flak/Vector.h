@@ -20,11 +20,21 @@ limitations under the License.
 #define ALG_VECTOR_H
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <memory>
+#include <ratio>
+#include <type_traits>
+#include <utility>
 
 namespace flak {
-template<class T, class Alloc = std::allocator<T>>
+
+// Growth is a std::ratio, the capacity is multiplied by it when the vector is full.
+// When the vector grows, the elements are relocated to the new space:
+//  trivially copyable types are copied by memcpy,
+//  the others are moved if the move constructor does not throw (or they can not be copied),
+//  otherwise they are copied, so a throwing constructor leaves the vector unchanged.
+template<class T, class Alloc = std::allocator<T>, class Growth = std::ratio<2>>
 class Vector {
 public:
     typedef T value_type;
@@ -39,6 +49,9 @@ public:
 protected:
     typedef typename Alloc::template rebind<T>::other ValueAlloc;
     typedef std::allocator_traits<Alloc> AllocTraits;
+    typedef Vector<T, Alloc, Growth> Self;
+
+    static_assert(Growth::num > Growth::den, "the growth factor must be greater than 1");
 
     iterator start_;
     iterator finish_;
@@ -109,8 +122,8 @@ public:
         }
     }
 
-    template<class Alloc2>
-    explicit Vector(Vector<T, Alloc2> &x) {
+    template<class Alloc2, class Growth2>
+    explicit Vector(Vector<T, Alloc2, Growth2> &x) {
         start_ = allocate(x.size());
         finish_ = std::uninitialized_copy(x.begin(), x.end(), start_);
         end_of_storage_ = start_ + x.size();
@@ -142,6 +155,21 @@ public:
         }
     }
 
+    void push_back(T &&x) {
+        emplace_back(std::move(x));
+    }
+
+    // construct the element in place at the end
+    template<class... Args>
+    void emplace_back(Args &&... args) {
+        if (finish_ != end_of_storage_) {
+            std::_Construct(finish_, std::forward<Args>(args)...);
+            ++finish_;
+        } else {
+            _insertAux(end(), std::forward<Args>(args)...);
+        }
+    }
+
     void pop_back() {
         --finish_;
         std::_Destroy(finish_);
@@ -151,7 +179,7 @@ public:
     iterator erase(iterator first, iterator last) {
         // [last, finish) override to [first, finish - last)
         // return iterator that points to first + (finish - last)
-        iterator i = std::copy(last, finish_, first);
+        iterator i = std::move(last, finish_, first);
         // first + (finish - last) and back of it are not needed.
         std::_Destroy(i, finish_);
         finish_ = finish_ - (last - first);
@@ -161,7 +189,7 @@ public:
     // erase the element on [pos]
     iterator erase(iterator pos) {
         if (pos + 1 != end()) {
-            std::copy(pos + 1, finish_, pos);
+            std::move(pos + 1, finish_, pos);
         }
         --finish_;
         std::_Destroy(finish_);
@@ -172,24 +200,30 @@ public:
         return *(begin() + n);
     }
 
-    template<class U, class Alloc2>
-    bool operator==(const Vector<U, Alloc2> &x) {
+    template<class U, class Alloc2, class Growth2>
+    bool operator==(const Vector<U, Alloc2, Growth2> &x) {
         return size() == x.size() && std::equal(begin(), end(), x.begin());
     }
 
-    template<class U, class Alloc2>
-    bool operator<(const Vector<U, Alloc2> &x) {
+    template<class U, class Alloc2, class Growth2>
+    bool operator<(const Vector<U, Alloc2, Growth2> &x) {
         return std::lexicographical_compare(begin(), end(), x.begin(), x.end());
     }
 
-    Vector<T, Alloc> &operator=(const Vector<T, Alloc> &x) {
+    Self &operator=(const Self &x) {
         if (&x == this) {
             return *this;
         }
         const size_type xlen = x.size();
         if (xlen > capacity()) {
             iterator newStart = allocate(xlen);
-            iterator newFinish = std::copy(x.begin(), x.end(), newStart);
+            iterator newFinish;
+            try {
+                newFinish = std::uninitialized_copy(x.begin(), x.end(), newStart);
+            } catch (...) {
+                deallocate(newStart, xlen);
+                throw;
+            }
             std::_Destroy(start_, finish_);
             deallocate_all();
 
@@ -214,51 +248,110 @@ public:
     // reserve a exact size
     void reserve(size_type n) {
         if (capacity() < n) {
-            const size_type oldSize = size();
             iterator newStart = allocate(n);
-            iterator newFinish = std::copy(start_, finish_, newStart);
-            std::_Destroy(start_, finish_);
+            iterator newFinish;
+            try {
+                newFinish = _relocate(start_, finish_, newStart);
+            } catch (...) {
+                deallocate(newStart, n);
+                throw;
+            }
+            _destroyRelocated(start_, finish_);
             deallocate_all();
             start_ = newStart;
-            finish_ = start_ + oldSize;
+            finish_ = newFinish;
             end_of_storage_ = start_ + n;
         }
     }
 
+    // the capacity after growing from [n] elements
+    static size_type growCapacity(size_type n) {
+        const size_type len = n / Growth::den * Growth::num + n % Growth::den * Growth::num / Growth::den;
+        return len > n ? len : n + 1;
+    }
+
 private:
-    // Insert [x] to [pos].
-    // Original [pos, finish-1] move back a position and place a copy of x to [pos]
+    // Insert an element constructed from [args] to [pos].
+    // Original [pos, finish-1] move back a position and place the new element to [pos]
     // If over the capacity, allocate a new len space,
-    //  we firstly copy [start, pos) to new space, then place a copy to the finish of new space,
+    //  we firstly copy [start, pos) to new space, then construct the element at the finish of new space,
     //  then copy [pos, finish) to new space. At last, free the original space.
-    void _insertAux(iterator pos, const value_type &x) {
+    // copy by memcpy, move or copy by constructor, see the top
+    typedef std::integral_constant<bool, std::is_trivially_copyable<T>::value> memcpy_relocate;
+    typedef std::integral_constant<bool, std::is_nothrow_move_constructible<T>::value
+                                         || !std::is_copy_constructible<T>::value> move_relocate;
+
+    // construct the elements of [first, last) at [dest], return the end of dest
+    static iterator _relocate(iterator first, iterator last, iterator dest) {
+        return _relocate(first, last, dest, memcpy_relocate());
+    }
+
+    static iterator _relocate(iterator first, iterator last, iterator dest, std::true_type) {
+        const size_type n = last - first;
+        if (n != 0) {
+            std::memcpy(static_cast<void *>(dest), static_cast<const void *>(first), n * sizeof(T));
+        }
+        return dest + n;
+    }
+
+    static iterator _relocate(iterator first, iterator last, iterator dest, std::false_type) {
+        return _relocate(first, last, dest, memcpy_relocate(), move_relocate());
+    }
+
+    static iterator _relocate(iterator first, iterator last, iterator dest, std::false_type, std::true_type) {
+        return std::uninitialized_copy(std::make_move_iterator(first), std::make_move_iterator(last), dest);
+    }
+
+    static iterator _relocate(iterator first, iterator last, iterator dest, std::false_type, std::false_type) {
+        return std::uninitialized_copy(first, last, dest);
+    }
+
+    // destroy the old elements after _relocate, memcpy has taken them over
+    static void _destroyRelocated(iterator first, iterator last) {
+        if (!memcpy_relocate::value) {
+            std::_Destroy(first, last);
+        }
+    }
+
+    template<class... Args>
+    void _insertAux(iterator pos, Args &&... args) {
         if (finish_ != end_of_storage_) {
-            std::_Construct(finish_, *(finish_ - 1));
+            // args may refer to an element, so build it before moving the elements
+            T xcopy(std::forward<Args>(args)...);
+            std::_Construct(finish_, std::move(*(finish_ - 1)));
             ++finish_;
-            T xcopy = x;
             // [pos, finish - 2] to [pos + 1, finish - 1] move back a position
-            std::copy_backward(pos, finish_ - 2, finish_ - 1);
-            *pos = xcopy;
+            std::move_backward(pos, finish_ - 2, finish_ - 1);
+            *pos = std::move(xcopy);
         } else {
-            const size_type oldSize = size();
-            // If old size is 0, new size is 1
-            const size_type newLen = oldSize != 0 ? 2 * oldSize : 1;
+            const size_type newLen = growCapacity(size());
 
             // allocate a new len space
             iterator newStart = allocate(newLen);
+            iterator newPos = newStart + (pos - start_);
             iterator newFinish = newStart;
+            // args may refer to an element, so construct it before the relocation
+            try {
+                std::_Construct(newPos, std::forward<Args>(args)...);
+            } catch (...) {
+                deallocate(newStart, newLen);
+                throw;
+            }
             try {
-                newFinish = std::uninitialized_copy(start_, pos, newStart);
-                std::_Construct(newFinish, x);
-                newFinish = std::uninitialized_copy(pos, finish_, newFinish + 1);
+                newFinish = _relocate(start_, pos, newStart);
+                newFinish = _relocate(pos, finish_, newPos + 1);
             } catch (...) {
-                std::_Destroy(newStart, newFinish);
+                // only the copy can throw, the part done is destroyed by uninitialized_copy
+                if (newFinish == newPos) {
+                    std::_Destroy(newStart, newPos);
+                }
+                std::_Destroy(newPos);
                 deallocate(newStart, newLen);
                 throw;
             }
 
             // destroy original vector
-            std::_Destroy(begin(), end());
+            _destroyRelocated(start_, finish_);
             deallocate_all();
 
             start_ = newStart;
@@ -3,6 +3,10 @@
 #include <map>
 #include <iostream>
 #include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 using namespace std;
 using namespace flak;
 
@@ -110,9 +114,125 @@ void test3() {
     cout << "test 3 end" << endl;
 }
 
+void test4() {
+    // the mapped values are constructed in place
+    AVLMap<int, unique_ptr<string>> umap;
+    for (int i = 0; i < 100; i++) {
+        assert((umap.tryEmplace(i, new string(to_string(i))).second));
+    }
+    assert((!umap.tryEmplace(3, new string("x")).second));
+    unique_ptr<string> v(new string("y"));
+    assert((umap.emplace(200, std::move(v)).second && !v));
+    assert((!umap.emplace(200, unique_ptr<string>()).second));
+    umap[300].reset(new string("z"));
+    assert((umap.size() == 102 && *umap[3] == "3" && *umap[200] == "y" && *umap[300] == "z"));
+
+    cout << "test 4 end" << endl;
+}
+
+struct ThrowOnCopy {
+    static int copies;  // throw on the copy that makes it zero
+    int v;
+    explicit ThrowOnCopy(int v) : v(v) {}
+    ThrowOnCopy(const ThrowOnCopy& x) : v(x.v) {
+        if (--copies == 0) {
+            throw runtime_error("copy");
+        }
+    }
+};
+
+int ThrowOnCopy::copies = 0;
+
+void test5() {
+    // sorted input is built in bulk, the nodes are freed one by one
+    vector<pair<int, string>> v;
+    for (int i = 0; i < 1000; i++) {
+        v.push_back(make_pair(i * 2, to_string(i)));
+    }
+    AVLMap<int, string> smap(v.begin(), v.end());
+    assert((smap.size() == 1000 && smap[998] == "499" && smap.find(999) == smap.end()));
+    smap.insert(pair<const int, string>(999, "x"));
+    for (int i = 0; i < 1000; i++) {
+        assert((smap.erase(i * 2) == 1));
+    }
+    assert((smap.size() == 1 && smap.begin()->first == 999));
+
+    // the values built before the exception are destroyed
+    vector<pair<int, ThrowOnCopy>> t;
+    for (int i = 0; i < 1000; i++) {
+        t.push_back(make_pair(i, ThrowOnCopy(i)));
+    }
+    ThrowOnCopy::copies = 500;
+    bool thrown = false;
+    try {
+        AVLMap<int, ThrowOnCopy> tmap(t.begin(), t.end());
+    } catch (runtime_error&) {
+        thrown = true;
+    }
+    assert((thrown));
+
+    cout << "test 5 end" << endl;
+}
+
+void test6() {
+    // the percentiles of a live map
+    AVLMap<int, int, less<int>, allocator<pair<const int, int>>, true> omap;
+    for (int i = 999; i >= 0; i--) {
+        omap[i] = i * 10;
+    }
+    assert((omap.select(500)->second == 5000 && omap.select(999)->first == 999));
+    for (int i = 0; i < 1000; i += 4) {
+        omap.erase(i);
+    }
+    // 1 2 3 5 6 7 9 ...
+    assert((omap.size() == 750 && omap.select(3)->first == 5 && omap.select(750) == omap.end()));
+    assert((omap.rank(4) == 3 && omap.rank(5) == 3 && omap.rank(1000) == 750));
+    assert((omap.countRange(0, 100) == 75 && omap.countRange(100, 100) == 0));
+
+    cout << "test 6 end" << endl;
+}
+
+void test7() {
+    // sorted appends at end() and a nearly sorted stream with the last position as hint
+    AVLMap<int, int> hmap;
+    for (int i = 0; i < 1000; i += 2) {
+        hmap.insert(hmap.end(), pair<const int, int>(i, i));
+    }
+    AVLMap<int, int>::iterator hit = hmap.begin();
+    for (int i = 1; i < 1000; i += 2) {
+        hit = hmap.insert(hit, pair<const int, int>(i ^ 2, i));
+    }
+    assert((hmap.size() == 1000));
+    hit = hmap.insert(hmap.find(10), pair<const int, int>(300, 0));
+    assert((hit->second == 300 && hmap.size() == 1000));
+    int i = 0;
+    for (hit = hmap.begin(); hit != hmap.end(); ++hit) {
+        assert((hit->first == i++));
+    }
+
+    // equal keys stay in the order of insertion
+    AVLTree<int, pair<int, int>, std::_Select1st<pair<int, int>>, less<int>> mtree;
+    for (int j = 0; j < 100; j++) {
+        mtree.insertEqual(mtree.end(), pair<int, int>(j / 10, j));
+    }
+    mtree.insertEqual(mtree.begin(), pair<int, int>(5, 100));
+    i = 0;
+    for (auto it = mtree.lowerBound(5); it != mtree.upperBound(5); ++it) {
+        assert((it->second == (i == 10 ? 100 : 50 + i)));
+        i++;
+    }
+    assert((i == 11 && mtree.size() == 101));
+
+    cout << "test 7 end" << endl;
+}
+
 int main() {
     test1();
     test2();
     test3();
+    test4();
+    test5();
+    test6();
+    test7();
 }
 
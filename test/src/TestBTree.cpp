@@ -0,0 +1,176 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <flak/BTree.h>
+#include <flak/BTreeSet.h>
+#include <flak/BTreeMap.h>
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace flak;
+
+// compare every value and the bounds with std::set
+template<class Tree>
+void check(const Tree& t, const set<int>& ref) {
+    assert((t.size() == ref.size()));
+    auto it = t.begin();
+    for (int v : ref) {
+        assert((it != t.end() && *it == v));
+        ++it;
+    }
+    assert((it == t.end()));
+    // backwards
+    auto rit = ref.rbegin();
+    for (auto i = t.end(); i != t.begin();) {
+        --i;
+        assert((*i == *rit));
+        ++rit;
+    }
+    assert((rit == ref.rend()));
+}
+
+template<class Tree>
+void checkBounds(const Tree& t, const set<int>& ref, int k) {
+    auto lb = ref.lower_bound(k);
+    auto tlb = t.lowerBound(k);
+    assert(((lb == ref.end()) == (tlb == t.end())));
+    assert((lb == ref.end() || *lb == *tlb));
+    auto ub = ref.upper_bound(k);
+    auto tub = t.upperBound(k);
+    assert(((ub == ref.end()) == (tub == t.end())));
+    assert((ub == ref.end() || *ub == *tub));
+    assert((t.count(k) == ref.count(k)));
+}
+
+// random inserts and erases, [NodeSize] 0 gives the smallest nodes of 3 values
+template<size_t NodeSize>
+void test1() {
+    typedef BTreeSet<int, less<int>, allocator<int>, NodeSize> Tree;
+    Tree t;
+    set<int> ref;
+    mt19937 rng(NodeSize + 1);
+    for (int round = 0; round < 20000; round++) {
+        int k = (int) (rng() % 2000);
+        if (rng() % 3 != 0) {
+            assert((t.insert(k).second == ref.insert(k).second));
+            assert((*t.find(k) == k));
+        } else {
+            assert((t.erase(k) == ref.erase(k)));
+            assert((t.find(k) == t.end()));
+        }
+        if (round % 1000 == 0) {
+            check(t, ref);
+        }
+    }
+    check(t, ref);
+    for (int k = -5; k < 2005; k++) {
+        checkBounds(t, ref, k);
+    }
+
+    // erase everything in a random order
+    vector<int> keys(ref.begin(), ref.end());
+    shuffle(keys.begin(), keys.end(), rng);
+    for (size_t i = 0; i < keys.size(); i++) {
+        assert((t.erase(keys[i]) == 1));
+        ref.erase(keys[i]);
+        if (i % 97 == 0) {
+            check(t, ref);
+        }
+    }
+    assert((t.empty() && t.begin() == t.end() && t.height() == 0));
+    cout << "test 1 end, " << Tree::node_slots << " slots" << endl;
+}
+
+void test2() {
+    // sequential inserts fill the nodes from the right
+    BTreeSet<int> t;
+    set<int> ref;
+    for (int i = 0; i < 100000; i++) {
+        t.insert(i);
+        ref.insert(i);
+    }
+    check(t, ref);
+    // 60 values per node
+    assert((t.height() <= 4));
+
+    // erase ranges
+    t.erase(t.lowerBound(100), t.lowerBound(60000));
+    ref.erase(ref.lower_bound(100), ref.lower_bound(60000));
+    check(t, ref);
+    t.erase(t.lowerBound(99000), t.end());
+    ref.erase(ref.lower_bound(99000), ref.end());
+    check(t, ref);
+    t.erase(t.begin(), t.end());
+    assert((t.empty()));
+    cout << "test 2 end" << endl;
+}
+
+void test3() {
+    BTreeMap<string, int> m;
+    m["jjhou"] = 1;
+    m["jerry"] = 2;
+    m["jason"] = 3;
+    m["jimmy"] = 4;
+    assert((m.size() == 4 && m["jerry"] == 2));
+    assert((!m.insert(pair<const string, int>("jason", 9)).second && m["jason"] == 3));
+    m.erase("jason");
+    assert((m.find("jason") == m.end() && m.size() == 3));
+    string ans[] = {"jerry", "jimmy", "jjhou"};
+    int i = 0;
+    for (auto it = m.begin(); it != m.end(); ++it) {
+        assert((it->first == ans[i++]));
+    }
+    auto r = m.equalRange("jimmy");
+    assert((r.first->second == 4 && r.second->first == "jjhou"));
+
+    // values that own memory, moved between the nodes
+    BTreeMap<int, unique_ptr<string>, less<int>, allocator<pair<const int, unique_ptr<string>>>, 0> um;
+    for (int k = 0; k < 1000; k++) {
+        assert((um.tryEmplace(k * 7 % 1000, new string(to_string(k * 7 % 1000))).second));
+    }
+    for (int k = 0; k < 1000; k += 2) {
+        assert((um.erase(k) == 1));
+    }
+    assert((um.size() == 500));
+    for (auto it = um.begin(); it != um.end(); ++it) {
+        assert((it->first % 2 == 1 && *it->second == to_string(it->first)));
+    }
+
+    // copies are deep
+    BTreeMap<string, int> c(m.begin(), m.end());
+    BTreeMap<string, int> d;
+    d = c;
+    c["jerry"] = 7;
+    assert((d["jerry"] == 2 && d.size() == 3 && c == c && !(c == d)));
+    cout << "test 3 end" << endl;
+}
+
+int main() {
+    test1<0>();
+    test1<64>();
+    test1<256>();
+    test2();
+    test3();
+}
@@ -0,0 +1,120 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <flak/ConcurrentHashMap.h>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+using namespace flak;
+
+void test1() {
+    ConcurrentHashMap<string, int> m(5);
+    assert((m.shardCount() == 8));
+    assert((m.empty()));
+
+    assert((m.insert(make_pair(string("a"), 1))));
+    assert((!m.insert(make_pair(string("a"), 2))));
+    assert((m.insertOrAssign("b", 2)));
+    assert((!m.insertOrAssign("a", 3)));
+    assert((m.size() == 2));
+
+    int v = 0;
+    assert((m.find("a", v) && v == 3));
+    assert((!m.find("c", v)));
+    assert((m.contains("b") && m.count("c") == 0));
+
+    assert((m.computeIfAbsent("c", [](const string& k) { return (int) k.size() + 10; }) == 11));
+    assert((m.computeIfAbsent("c", [](const string&) { assert((false)); return 0; }) == 11));
+    assert((m.computeIfPresent("c", [](int& x) { x++; })));
+    assert((!m.computeIfPresent("d", [](int& x) { x++; })));
+    assert((m.find("c", v) && v == 12));
+
+    int sum = 0;
+    m.forEach([&](const pair<const string, int>& p) { sum += p.second; });
+    assert((sum == 3 + 2 + 12));
+
+    assert((m.erase("a") == 1 && m.erase("a") == 0));
+    assert((m.size() == 2));
+    m.clear();
+    assert((m.empty() && !m.contains("b")));
+    cout << "test 1 end" << endl;
+}
+
+void test2() {
+    ConcurrentHashMap<int, int> m;
+    const int threads = 8, n = 20000;
+    vector<thread> ts;
+    atomic<int> created(0);
+    for (int t = 0; t < threads; t++) {
+        ts.emplace_back([&, t]() {
+            for (int i = 0; i < n; i++) {
+                // every thread counts the same keys
+                m.computeIfAbsent(i, [&](int) { created++; return 0; });
+                m.computeIfPresent(i, [](int& x) { x++; });
+                // and owns some keys of its own
+                int own = n + t * n + i;
+                m.insertOrAssign(own, i);
+                if (i % 2) {
+                    m.erase(own);
+                }
+                int v;
+                assert((!m.find(-1, v)));
+            }
+        });
+    }
+    for (auto& t : ts) {
+        t.join();
+    }
+    assert((created == n));
+    assert((m.size() == (size_t) (n + threads * n / 2)));
+    for (int i = 0; i < n; i++) {
+        int v = 0;
+        assert((m.find(i, v) && v == threads));
+    }
+    cout << "test 2 end" << endl;
+}
+
+// the shard and the bucket in it must come from different bits of the hash
+void test3() {
+    ConcurrentHashMap<int, int, hash<int>, equal_to<int>, allocator<pair<const int, int>>,
+            PowerOfTwoBucketPolicy> m(64, 100000);
+    for (int i = 0; i < 100000; i++) {
+        m.insertOrAssign(i, i);
+    }
+    assert((m.bucketCount() == 64 * 2048));
+    // 100000 random keys fill about 53% of the buckets
+    assert((m.usedBucketCount() * 5 > m.bucketCount() * 2));
+
+    // PrimeBucketPolicy makes about twice as many buckets, about 40% are filled
+    ConcurrentHashMap<int, int> p(64, 100000);
+    for (int i = 0; i < 100000; i++) {
+        p.insertOrAssign(i * 64, i);
+    }
+    assert((p.usedBucketCount() * 3 > p.bucketCount()));
+    cout << "test 3 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+    test3();
+}
@@ -0,0 +1,125 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <flak/ConcurrentMap.h>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+using namespace flak;
+
+void test1() {
+    ConcurrentMap<string, int> m;
+    assert((m.empty()));
+
+    assert((m.insert(make_pair(string("b"), 1))));
+    assert((!m.insert(make_pair(string("b"), 2))));
+    assert((m.insertOrAssign("d", 2)));
+    assert((!m.insertOrAssign("b", 3)));
+    assert((m.size() == 2));
+
+    int v = 0;
+    assert((m.find("b", v) && v == 3));
+    assert((!m.find("c", v)));
+    assert((m.contains("d") && m.count("c") == 0));
+
+    string k;
+    assert((m.lowerBound("c", k, v) && k == "d" && v == 2));
+    assert((m.lowerBound("a", k, v) && k == "b" && v == 3));
+    assert((!m.lowerBound("e", k, v)));
+
+    string keys;
+    m.forEach([&](const pair<const string, int>& p) { keys += p.first; });
+    assert((keys == "bd"));
+
+    assert((m.erase("b") == 1 && m.erase("b") == 0));
+    assert((m.size() == 1));
+    m.clear();
+    assert((m.empty() && !m.contains("d")));
+    assert((m.insertOrAssign("d", 4) && m.find("d", v) && v == 4));
+    cout << "test 1 end" << endl;
+}
+
+void test2() {
+    // The even keys are always there, the odd ones come and go.
+    // The value of a key is key * 10 + 0 or 1, so a torn value would show.
+    ConcurrentMap<int, long> m;
+    const int n = 2000;
+    for (int i = 0; i < n; i += 2) {
+        m.insert(make_pair(i, (long) i * 10));
+    }
+    atomic<bool> done(false);
+    atomic<int> bad(0);
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+            unsigned r = t + 1;
+            while (!done.load()) {
+                r = r * 1103515245 + 12345;
+                int k = (int) ((r >> 8) % n);
+                long v;
+                bool found = m.find(k, v);
+                if ((k % 2 == 0 && !found) || (found && v / 10 != k)) {
+                    bad++;
+                }
+                int key;
+                if (m.lowerBound(k, key, v) && (key < k || key > k + 1 || v / 10 != key)) {
+                    bad++;
+                }
+            }
+        });
+    }
+    vector<thread> writers;
+    for (int t = 0; t < 2; t++) {
+        writers.emplace_back([&, t]() {
+            for (int round = 0; round < 20; round++) {
+                for (int i = 1 + 2 * t; i < n; i += 4) {
+                    m.insertOrAssign(i, (long) i * 10 + round % 2);
+                    m.insertOrAssign(i - 1, (long) (i - 1) * 10 + round % 2);
+                }
+                for (int i = 1 + 2 * t; i < n; i += 4) {
+                    if (round % 3 == 0) {
+                        m.erase(i);
+                    }
+                }
+            }
+        });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    done = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+    assert((bad == 0));
+    int count = 0;
+    m.forEach([&](const pair<const int, long>& p) {
+        assert((p.second / 10 == p.first));
+        count++;
+    });
+    assert((count == (int) m.size() && m.size() == (size_t) n));
+    cout << "test 2 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+}
@@ -0,0 +1,149 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <flak/FlatHashTable.h>
+#include <functional>
+#include <unordered_set>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+using namespace std;
+using namespace flak;
+
+typedef FlatHashTable<int, int, hash<int>, _Identity<int>, equal_to<int>> IntTable;
+typedef FlatHashTable<int, int, hash<int>, _Identity<int>, equal_to<int>,
+        allocator<int>, GroupProbe> GroupIntTable;
+
+void test1() {
+    IntTable ht(50, hash<int>(), equal_to<int>());
+    assert((ht.empty()));
+    assert((ht.bucketCount() == 128)); // 3/4 of 64 can not hold 50
+
+    ht.insertUnique(59);
+    ht.insertUnique(63);
+    ht.insertUnique(108);
+    ht.insertUnique(2);
+    ht.insertUnique(53);
+    assert((!ht.insertUnique(53).second));
+    assert((ht.size() == 5));
+
+    assert((*ht.find(108) == 108));
+    assert((ht.find(7) == ht.end()));
+    assert((ht.count(2) == 1));
+
+    int sum = 0;
+    for (auto it = ht.begin(); it != ht.end(); ++it) {
+        sum += *it;
+    }
+    assert((sum == 59 + 63 + 108 + 2 + 53));
+
+    assert((ht.erase(63) == 1));
+    assert((ht.erase(63) == 0));
+    assert((ht.size() == 4));
+    assert((ht.find(63) == ht.end()));
+
+    ht.insertEqual(2);
+    assert((ht.count(2) == 2));
+    assert((ht.erase(2) == 2));
+    assert((ht.size() == 3));
+    cout << "test 1 end" << endl;
+}
+
+// erasing must keep every remaining key reachable.
+template<class Table>
+void test2() {
+    Table ht(0, hash<int>(), equal_to<int>());
+    unordered_set<int> ref;
+    srand(7);
+    for (int i = 0; i < 20000; i++) {
+        int k = rand() % 4000;
+        if (rand() % 3 == 0) {
+            assert((ht.erase(k) == ref.erase(k)));
+        } else {
+            assert((ht.insertUnique(k).second == ref.insert(k).second));
+        }
+    }
+    assert((ht.size() == ref.size()));
+    for (int k = 0; k < 4000; k++) {
+        assert((ht.count(k) == ref.count(k)));
+    }
+    cout << "test 2 end" << endl;
+}
+
+template<class Probe>
+void test3() {
+    typedef FlatHashTable<pair<const string, int>, string, hash<string>,
+            _Select1st<pair<const string, int>>, equal_to<string>,
+            allocator<string>, Probe> StrTable;
+    StrTable ht(0, hash<string>(), equal_to<string>());
+    for (int i = 0; i < 100; i++) {
+        ht.insertUnique(pair<const string, int>(to_string(i), i));
+    }
+    assert((ht.size() == 100));
+
+    // erase a range that is not the whole table
+    auto it = ht.begin();
+    for (int i = 0; i < 40; i++) {
+        ++it;
+    }
+    ht.erase(ht.begin(), it);
+    assert((ht.size() == 60));
+    int cnt = 0;
+    for (int i = 0; i < 100; i++) {
+        auto f = ht.find(to_string(i));
+        if (f != ht.end()) {
+            assert((f->second == i));
+            cnt++;
+        }
+    }
+    assert((cnt == 60));
+
+    StrTable copy(ht);
+    ht.clear();
+    assert((ht.empty() && ht.begin() == ht.end()));
+    assert((copy.size() == 60));
+    cout << "test 3 end" << endl;
+}
+
+// a small table, the group is longer than the table
+void test4() {
+    GroupIntTable ht(0, hash<int>(), equal_to<int>());
+    assert((ht.bucketCount() == 8));
+    for (int i = 0; i < 6; i++) {
+        ht.insertUnique(i * 8);
+    }
+    assert((ht.bucketCount() == 8));
+    for (int i = 0; i < 6; i++) {
+        assert((*ht.find(i * 8) == i * 8));
+        assert((ht.find(i * 8 + 1) == ht.end()));
+    }
+    ht.erase(0);
+    ht.erase(16);
+    assert((ht.size() == 4 && ht.count(40) == 1));
+    cout << "test 4 end" << endl;
+}
+
+int main() {
+    test1();
+    test2<IntTable>();
+    test2<GroupIntTable>();
+    test3<LinearProbe>();
+    test3<GroupProbe>();
+    test4();
+}
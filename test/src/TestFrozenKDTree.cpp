@@ -0,0 +1,232 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <flak/FrozenKDTree.h>
+#include <flak/KDTree.h>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+using namespace flak;
+
+// the sorted distances of the [k] nearest points by brute force
+template<class Coord, class Dist>
+vector<Dist> bruteKNearest(const vector<pair<vector<Coord>, int>>& points,
+                           const vector<Coord>& q, size_t k) {
+    vector<Dist> ds;
+    for (auto& x : points) {
+        Dist d = 0;
+        for (size_t i = 0; i < q.size(); i++) {
+            Dist diff = Dist(x.first[i]) - Dist(q[i]);
+            d += diff * diff;
+        }
+        ds.push_back(d);
+    }
+    sort(ds.begin(), ds.end());
+    ds.resize(min(k, ds.size()));
+    return ds;
+}
+
+// random points of every size up to a few levels, of 1 to 5 dimensions,
+// whose coordinates are small integers so that the distances are exact
+template<class Coord>
+void checkRandom() {
+    typedef FrozenKDTree<Coord, int> Tree;
+    typedef typename Tree::distance_type Dist;
+    mt19937 rng(1);
+    uniform_int_distribution<int> coord(-20, 20);
+    for (size_t dim = 1; dim <= 5; dim++) {
+        for (int n = 0; n < 150; n += 1 + n / 10) {
+            vector<pair<vector<Coord>, int>> points;
+            for (int i = 0; i < n; i++) {
+                vector<Coord> p;
+                for (size_t d = 0; d < dim; d++) p.push_back(Coord(coord(rng)));
+                points.push_back({p, i});
+            }
+            Tree t(points.begin(), points.end(), dim);
+            assert((t.size() == size_t(n)));
+
+            // every point is at its position
+            vector<bool> seen(n, false);
+            for (size_t pos = 0; pos < t.size(); pos++) {
+                int i = t.value(pos);
+                assert((!seen[i]));
+                seen[i] = true;
+                for (size_t d = 0; d < dim; d++) {
+                    assert((t.coord(pos, d) == points[i].first[d]));
+                }
+            }
+
+            for (int r = 0; r < 20; r++) {
+                vector<Coord> q;
+                for (size_t d = 0; d < dim; d++) q.push_back(Coord(coord(rng)));
+                size_t k = 1 + rng() % 20;
+                auto res = t.findKNearest(q, k);
+                vector<Dist> ds;
+                for (auto& x : res) {
+                    ds.push_back(x.first);
+                    // the distance is of the point at the position
+                    Dist d = 0;
+                    for (size_t i = 0; i < dim; i++) {
+                        Dist diff = Dist(t.coord(x.second, i)) - Dist(q[i]);
+                        d += diff * diff;
+                    }
+                    assert((d == x.first));
+                }
+                assert((ds == (bruteKNearest<Coord, Dist>(points, q, k))));
+            }
+        }
+    }
+}
+
+void test1() {
+    checkRandom<float>();
+    checkRandom<double>();
+    checkRandom<int>();
+    cout << "test 1 end" << endl;
+}
+
+// the empty tree and k = 0
+void test2() {
+    FrozenKDTree<float, int> e(3);
+    vector<float> q{1, 2, 3};
+    assert((e.empty() && e.findKNearest(q, 4).empty()));
+
+    vector<pair<vector<float>, int>> none;
+    FrozenKDTree<float, int> f(none.begin(), none.end(), 2);
+    assert((f.empty() && f.findKNearest(q, 4).empty()));
+
+    vector<pair<vector<float>, int>> one{{{1, 1}, 7}};
+    FrozenKDTree<float, int> g(one.begin(), one.end(), 2);
+    assert((g.findKNearest(q, 0).empty()));
+    vector<float> q2{3, 1};
+    auto res = g.findKNearest(q2, 3);
+    assert((res.size() == 1 && res[0].first == 4 && g.value(res[0].second) == 7));
+    cout << "test 2 end" << endl;
+}
+
+// freeze a KDTree, whose queries skip the point itself
+void test3() {
+    typedef KDTree<vector<int>, int> Tree;
+    mt19937 rng(3);
+    uniform_int_distribution<int> coord(0, 100);
+    vector<pair<vector<int>, int>> points;
+    for (int i = 0; i < 5000; i++) {
+        points.push_back({{coord(rng), coord(rng), coord(rng)}, i});
+    }
+    Tree t(points.begin(), points.end(), 3);
+    Tree::frozen_type f = t.freeze();
+    assert((f.size() == t.size() && f.dimension() == 3));
+    for (int r = 0; r < 200; r++) {
+        vector<int> q{coord(rng), coord(rng), coord(rng)};
+        auto a = t.findKNearest(q, 6);
+        vector<long long> da;
+        for (auto& x : a) da.push_back(x.first);
+        sort(da.begin(), da.end());
+
+        auto b = f.findKNearest(q, 7);
+        vector<long long> db;
+        for (auto& x : b) {
+            if (x.first != 0) db.push_back(x.first);
+            // the value is the one of the point in the KDTree
+            vector<int> p{f.coord(x.second, 0), f.coord(x.second, 1), f.coord(x.second, 2)};
+            auto found = t.find(p);
+            assert((found.first && found.second->second == f.value(x.second)));
+        }
+        db.resize(min(db.size(), size_t(6)));
+        if (db.size() == 6) {
+            assert((da == db));
+        }
+    }
+    cout << "test 3 end" << endl;
+}
+
+// radius and box queries against brute force, with the metrics
+template<class Metric, class Coord>
+void checkRanges() {
+    typedef FrozenKDTree<Coord, int, Metric> Tree;
+    typedef typename Tree::distance_type Dist;
+    mt19937 rng(4);
+    uniform_int_distribution<int> coord(0, 100);
+    for (size_t dim = 1; dim <= 4; dim++) {
+        for (int n : {0, 1, 15, 17, 100, 3000}) {
+            vector<pair<vector<Coord>, int>> points;
+            for (int i = 0; i < n; i++) {
+                vector<Coord> p;
+                for (size_t d = 0; d < dim; d++) p.push_back(Coord(coord(rng)));
+                points.push_back({p, i});
+            }
+            Tree t(points.begin(), points.end(), dim);
+            for (int i = 0; i < 50; i++) {
+                vector<Coord> q, lo, hi;
+                for (size_t d = 0; d < dim; d++) {
+                    q.push_back(Coord(coord(rng)));
+                    int a = coord(rng) - 5, b = coord(rng) + 5;
+                    lo.push_back(Coord(min(a, b)));
+                    hi.push_back(Coord(max(a, b)));
+                }
+                Dist r = Dist(rng() % (i < 25 ? 300 : 8000));
+                vector<int> inRadius, inBox;
+                for (auto& x : points) {
+                    if (_kdDistance<Metric, Dist>(x.first, q, dim) <= r) inRadius.push_back(x.second);
+                    bool inside = true;
+                    for (size_t k = 0; k < dim; k++) inside &= lo[k] <= x.first[k] && x.first[k] <= hi[k];
+                    if (inside) inBox.push_back(x.second);
+                }
+
+                vector<int> got;
+                t.forEachInRadius(q, r, [&](size_t pos, Dist d) {
+                    assert((d <= r));
+                    got.push_back(t.value(pos));
+                });
+                sort(got.begin(), got.end());
+                assert((got == inRadius));
+                vector<typename Tree::result_type> found;
+                t.findInRadius(q, r, back_inserter(found));
+                assert((found.size() == inRadius.size()));
+                assert((t.countInRadius(q, r) == inRadius.size()));
+
+                vector<size_t> box;
+                t.findInBox(lo, hi, back_inserter(box));
+                got.clear();
+                for (size_t pos : box) got.push_back(t.value(pos));
+                sort(got.begin(), got.end());
+                assert((got == inBox));
+                assert((t.countInBox(lo, hi) == inBox.size()));
+            }
+        }
+    }
+}
+
+void test4() {
+    checkRanges<EuclideanMetric, float>();
+    checkRanges<EuclideanMetric, int>();
+    checkRanges<ManhattanMetric, double>();
+    checkRanges<ChebyshevMetric, int>();
+    cout << "test 4 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+    test3();
+    test4();
+}
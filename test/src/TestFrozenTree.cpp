@@ -0,0 +1,195 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <flak/FrozenTree.h>
+#include <flak/AVLMap.h>
+#include <flak/AVLSet.h>
+#include <flak/Map.h>
+#include <flak/Set.h>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+using namespace flak;
+
+// the searches of every size up to a few levels against std::set
+void test1() {
+    for (int n = 0; n < 70; n++) {
+        Set<int> s;
+        set<int> ref;
+        for (int i = 0; i < n; i++) {
+            s.insert(i * 2);
+            ref.insert(i * 2);
+        }
+        Set<int>::frozen_type f = s.freeze();
+        assert((f.size() == (size_t) n && f.empty() == (n == 0)));
+        auto r = ref.begin();
+        for (auto it = f.begin(); it != f.end(); ++it, ++r) {
+            assert((*it == *r));
+        }
+        assert((r == ref.end()));
+        auto rr = ref.rbegin();
+        for (auto it = f.end(); it != f.begin(); ++rr) {
+            assert((*--it == *rr));
+        }
+        for (int k = -1; k <= 2 * n; k++) {
+            auto lb = f.lowerBound(k), ub = f.upperBound(k);
+            assert((lb == f.end() ? ref.lower_bound(k) == ref.end() : *lb == *ref.lower_bound(k)));
+            assert((ub == f.end() ? ref.upper_bound(k) == ref.end() : *ub == *ref.upper_bound(k)));
+            assert(((f.find(k) != f.end()) == (k >= 0 && k % 2 == 0 && k < 2 * n)));
+            assert((f.count(k) == ref.count(k)));
+        }
+    }
+    cout << "test 1 end" << endl;
+}
+
+void test2() {
+    // the values are copied, the map can change afterwards
+    Map<string, int> m;
+    m["jjhou"] = 1;
+    m["jerry"] = 2;
+    m["jason"] = 3;
+    Map<string, int>::frozen_type f = m.freeze();
+    m.erase("jerry");
+    m["jimmy"] = 4;
+    assert((f.size() == 3 && f.find("jerry")->second == 2 && f.find("jimmy") == f.end()));
+    assert((f.lowerBound("jb")->first == "jerry" && f.upperBound("jjhou") == f.end()));
+
+    // copy, move and the comparator of the tree
+    AVLSet<int, greater<int>> g;
+    for (int i = 0; i < 10; i++) {
+        g.insert(i);
+    }
+    AVLSet<int, greater<int>>::frozen_type fg = g.freeze();
+    AVLSet<int, greater<int>>::frozen_type fc(fg);
+    AVLSet<int, greater<int>>::frozen_type fm(std::move(fg));
+    assert((fg.empty() && *fc.begin() == 9 && *fm.lowerBound(20) == 9 && *fm.upperBound(5) == 4));
+    fg = fc;
+    assert((fg.size() == 10 && *fg.find(3) == 3));
+
+    // equal keys from a sorted range
+    vector<pair<int, int>> v;
+    for (int i = 0; i < 30; i++) {
+        v.push_back(make_pair(i / 3, i));
+    }
+    FrozenTree<int, pair<int, int>, std::_Select1st<pair<int, int>>, less<int>> fe(v.begin(), v.end());
+    assert((fe.count(4) == 3 && fe.lowerBound(4)->second == 12 && fe.upperBound(4)->second == 15));
+
+    AVLMap<int, int> am;
+    for (int i = 0; i < 1000; i++) {
+        am[i * 3] = i;
+    }
+    AVLMap<int, int>::frozen_type fa = am.freeze();
+    assert((fa.find(300)->second == 100 && fa.find(301) == fa.end() && fa.lowerBound(301)->first == 303));
+
+    cout << "test 2 end" << endl;
+}
+
+struct ThrowOnCopy {
+    static int copies;
+    static int alive;
+    int x;
+
+    explicit ThrowOnCopy(int v) : x(v) { ++alive; }
+
+    ThrowOnCopy(const ThrowOnCopy& o) : x(o.x) {
+        if (--copies == 0) {
+            throw runtime_error("copy");
+        }
+        ++alive;
+    }
+
+    ~ThrowOnCopy() { --alive; }
+
+    bool operator<(const ThrowOnCopy& o) const { return x < o.x; }
+};
+
+int ThrowOnCopy::copies = 0;
+int ThrowOnCopy::alive = 0;
+
+void test3() {
+    // the values copied before a throw are destroyed
+    {
+        vector<ThrowOnCopy> v;
+        v.reserve(100);
+        for (int i = 0; i < 100; i++) {
+            v.emplace_back(i);
+        }
+        ThrowOnCopy::copies = 40;
+        bool thrown = false;
+        try {
+            FrozenTree<ThrowOnCopy, ThrowOnCopy, std::_Identity<ThrowOnCopy>, less<ThrowOnCopy>> f(v.begin(), v.end());
+        } catch (runtime_error&) {
+            thrown = true;
+        }
+        assert((thrown && ThrowOnCopy::alive == 100));
+    }
+    assert((ThrowOnCopy::alive == 0));
+    cout << "test 3 end" << endl;
+}
+
+void test4() {
+    // readers keep searching while the snapshot is replaced
+    typedef Set<int>::frozen_type Frozen;
+    Set<int> s;
+    for (int i = 0; i < 1000; i++) {
+        s.insert(i);
+    }
+    AtomicSnapshot<Frozen> snap(make_shared<const Frozen>(s.freeze()));
+    atomic<bool> done(false);
+    atomic<int> bad(0);
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                shared_ptr<const Frozen> f = snap.load();
+                // every version holds [0, size)
+                int n = (int) f->size();
+                if (f->find(n - 1) == f->end() || f->find(n) != f->end()) {
+                    bad++;
+                }
+            }
+        });
+    }
+    for (int i = 1000; i < 1100; i++) {
+        s.insert(i);
+        snap.store(s.freeze());
+    }
+    done = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+    assert((bad == 0 && snap.load()->size() == 1100));
+    shared_ptr<const Frozen> old = snap.exchange(make_shared<const Frozen>());
+    assert((old->size() == 1100 && snap.load()->empty()));
+    cout << "test 4 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+    test3();
+    test4();
+}
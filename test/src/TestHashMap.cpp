@@ -21,7 +21,9 @@ limitations under the License.
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace flak;
@@ -66,7 +68,95 @@ void test1() {
     cout << "test 1 end";
 }
 
+template<class Engine>
+void test2() {
+    HashMap<string, int, hash<string>, equal_to<string>,
+            allocator<int>, Engine> hm;
+
+    hm["Mary"] = 1;
+    hm["John"] = 2;
+    hm["Mike"] = 3;
+    assert((hm.size() == 3));
+    assert((hm.find("John")->second == 2));
+    assert((hm.find("Jack") == hm.end()));
+
+    hm.insert(pair<string, int>("Liam", 33));
+    assert((hm.erase("Mary") == 1));
+    assert((hm.count("Mary") == 0));
+    assert((hm.count("Liam") == 1));
+
+    int sum = 0;
+    for (auto it = hm.begin(); it != hm.end(); it++) {
+        sum += it->second;
+    }
+    assert((sum == 2 + 3 + 33));
+    cout << "test 2 end" << endl;
+}
+
+template<class Engine>
+void test3() {
+    typedef HashMap<int, int, hash<int>, equal_to<int>, allocator<int>, Engine> Map;
+    Map hm;
+    for (int i = 0; i < 1000; i++) {
+        hm[i * 2] = i;
+    }
+
+    vector<int> keys;
+    for (int i = 0; i < 100; i++) {
+        keys.push_back(i * 7);
+    }
+    vector<typename Map::iterator> out(keys.size());
+    hm.findBatch(keys.data(), keys.size(), out.data());
+    for (size_t i = 0; i < keys.size(); i++) {
+        assert((out[i] == hm.find(keys[i])));
+    }
+
+    const Map& chm = hm;
+    vector<typename Map::const_iterator> res(keys.size());
+    chm.findBatch(keys.data(), keys.size(), res.data());
+    for (size_t i = 0; i < keys.size(); i++) {
+        assert((res[i] == chm.find(keys[i])));
+        assert((keys[i] % 2 == 1 || res[i]->second == keys[i] / 2));
+    }
+    cout << "test 3 end" << endl;
+}
+
+template<class Engine>
+void test4() {
+    // the values can only be moved
+    typedef HashMap<int, unique_ptr<string>, hash<int>, equal_to<int>,
+            allocator<unique_ptr<string>>, Engine> Map;
+    Map hm;
+    for (int i = 0; i < 200; i++) {
+        auto p = hm.tryEmplace(i, new string(to_string(i)));
+        assert((p.second));
+    }
+    auto p = hm.tryEmplace(5, new string("x"));
+    assert((!p.second && *p.first->second == "5"));
+
+    unique_ptr<string> v(new string("y"));
+    assert((hm.emplace(300, std::move(v)).second && !v));
+    assert((!hm.emplace(300, unique_ptr<string>(new string("z"))).second));
+    assert((*hm.find(300)->second == "y"));
+    assert((hm.insert(pair<const int, unique_ptr<string>>(301, nullptr)).second));
+
+    hm[400].reset(new string("w"));
+    assert((hm.size() == 203 && *hm[400] == "w"));
+    for (int i = 0; i < 200; i++) {
+        assert((*hm.find(i)->second == to_string(i)));
+    }
+    hm.clear();
+    cout << "test 4 end" << endl;
+}
+
 int main() {
     test1();
+    test2<PowerOfTwoHashing>();
+    test2<FlatHashing>();
+    test2<GroupHashing>();
+    test3<ChainedHashing>();
+    test3<GroupHashing>();
+    test4<ChainedHashing>();
+    test4<FlatHashing>();
 }
 
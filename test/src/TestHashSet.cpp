@@ -84,7 +84,27 @@ void test1() {
     cout << "test 1 end" << endl;
 }
 
+void test2() {
+    HashSet<int, std::hash<int>, std::equal_to<int>,
+            std::allocator<int>, FlatHashing> iset;
+    for (int i = 0; i < 1000; i++) {
+        iset.insert(i * 7);
+    }
+    assert((iset.size() == 1000));
+    assert((!iset.insert(14).second));
+    assert((iset.count(14) == 1 && iset.count(15) == 0));
+    assert((*iset.find(21) == 21));
+
+    iset.erase(iset.find(21));
+    assert((iset.count(21) == 0));
+    assert((iset.size() == 999));
+    iset.clear();
+    assert((iset.empty()));
+    cout << "test 2 end" << endl;
+}
+
 int main() {
     test1();
+    test2();
 }
 
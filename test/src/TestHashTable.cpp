@@ -4,6 +4,8 @@
 #include <cassert>
 #include <hashtable.h>
 #include <iostream>
+#include <set>
+#include <string>
 using namespace std;
 using namespace flak;
 using __gnu_cxx::hashtable;
@@ -61,7 +63,7 @@ void test1() {
     }
 
     for(int i = 0; i <= 47; i++){
-        ht.insert_equal(i);
+        ht.insertEqual(i);
         ht2.insert_equal(i);
     }
     assert((ht.size() == 54));
@@ -167,8 +169,196 @@ void test4() {
     cout << "test4 end" << endl;
 }
 
+void test5() {
+    typedef HashTable<int,
+            int,
+            hash<int>,
+            _Identity<int>,
+            equal_to<int>,
+            std::allocator<int>,
+            PowerOfTwoBucketPolicy> MyHashTable;
+
+    MyHashTable ht(50, hash<int>(), equal_to<int>());
+    assert((ht.bucketCount() == 64));
+    assert((ht.maxBucketCount() == (size_t(1) << 63)));
+
+    for (int i = 0; i < 1000; i++) {
+        ht.insertUnique(i * 3);
+    }
+    assert((ht.size() == 1000));
+    assert((ht.bucketCount() == 1024));
+
+    int total = 0;
+    for (int i = 0; i < ht.bucketCount(); i++) {
+        total += ht.elemsInBucket(i);
+    }
+    assert((total == 1000));
+
+    int cnt = 0;
+    for (auto it = ht.begin(); it != ht.end(); ++it) {
+        assert((*it % 3 == 0));
+        cnt++;
+    }
+    assert((cnt == 1000));
+
+    assert((*ht.find(300) == 300));
+    assert((ht.find(301) == ht.end()));
+    ht.erase(300);
+    assert((ht.count(300) == 0 && ht.size() == 999));
+    cout << "test5 end" << endl;
+}
+
+void test6() {
+    typedef HashTable<int,
+            int,
+            hash<int>,
+            _Identity<int>,
+            equal_to<int>> MyHashTable;
+
+    MyHashTable ht(50, hash<int>(), equal_to<int>());
+    ht.setRehashStep(1);
+    bool rehashed = false;
+    for (int i = 0; i < 5000; i++) {
+        ht.insertUnique(i);
+        if (ht.rehashing()) {
+            rehashed = true;
+            // every node can be found during rehashing
+            assert((ht.count(i) == 1 && ht.count(i / 2) == 1));
+            assert((ht.count(-1) == 0));
+        }
+    }
+    assert((rehashed));
+    assert((ht.size() == 5000));
+
+    // continue with a rehashing table
+    while (!ht.rehashing()) {
+        ht.insertUnique((int) ht.size());
+    }
+    const int n = (int) ht.size();
+
+    int keys[64];
+    MyHashTable::const_iterator res[64];
+    for (int i = 0; i < 64; i++) {
+        keys[i] = i * 97 - 5;
+    }
+    const MyHashTable& cht = ht;
+    cht.findBatch(keys, 64, res);
+    for (int i = 0; i < 64; i++) {
+        assert((res[i] == cht.find(keys[i])));
+    }
+
+    set<int> seen;
+    for (auto it = ht.begin(); it != ht.end(); ++it) {
+        assert((seen.insert(*it).second));
+    }
+    assert((seen.size() == ht.size()));
+
+    MyHashTable copy(50, hash<int>(), equal_to<int>());
+    copy.copyFrom(ht);
+    assert((!copy.rehashing() && copy.size() == ht.size()));
+    for (int i = 0; i < n; i++) {
+        assert((copy.count(i) == 1));
+    }
+
+    for (int i = 0; i < n; i += 2) {
+        assert((ht.erase(i) == 1));
+    }
+    assert((ht.size() == (size_t) n / 2));
+    ht.insertEqual(1);
+    assert((ht.count(1) == 2));
+
+    // erase while iterating
+    for (auto it = ht.begin(); it != ht.end();) {
+        auto cur = it++;
+        if (*cur % 3 == 0) {
+            ht.erase(cur);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        assert((ht.count(i) == (size_t) (i == 1 ? 2 : (i % 2 == 1 && i % 3 != 0))));
+    }
+
+    ht.erase(ht.begin(), ht.end());
+    assert((ht.size() == 0 && ht.begin() == ht.end()));
+
+    copy.setRehashStep(4);
+    for (int i = n; i < 4 * n; i++) {
+        copy.insertUnique(i);
+    }
+    copy.setRehashStep(0);
+    assert((!copy.rehashing()));
+    int total = 0;
+    for (int i = 0; i < copy.bucketCount(); i++) {
+        total += copy.elemsInBucket(i);
+    }
+    assert((total == 4 * n));
+    copy.clear();
+    assert((copy.size() == 0));
+    cout << "test6 end" << endl;
+}
+
+static int hash_calls = 0;
+
+struct CountingHash {
+    size_t operator()(const string& s) const {
+        hash_calls++;
+        return hash<string>()(s);
+    }
+};
+
+// every key has the same hash code
+struct CollidingHash {
+    size_t operator()(int) const { return 42; }
+};
+
+void test7() {
+    // strings keep their hash codes by default
+    typedef HashTable<string, string, CountingHash, _Identity<string>,
+            equal_to<string>> StringTable;
+    assert((CacheHashCode<string>::value && !CacheHashCode<int>::value));
+
+    StringTable ht(10, CountingHash(), equal_to<string>());
+    const int n = 5000;
+    for (int i = 0; i < n; i++) {
+        ht.insertUnique(to_string(i));
+    }
+    // one hash per insert, resize does not hash again
+    assert((hash_calls == n));
+    assert((ht.bucketCount() > 10));
+
+    hash_calls = 0;
+    StringTable copy(10, CountingHash(), equal_to<string>());
+    copy.copyFrom(ht);
+    for (auto it = copy.begin(); it != copy.end(); ++it) {}
+    assert((hash_calls == 0));
+
+    for (int i = 0; i < n; i++) {
+        assert((copy.count(to_string(i)) == 1));
+    }
+    assert((copy.find("x") == copy.end()));
+    copy.erase(copy.find("7"), copy.end());
+    assert((copy.count("7") == 0));
+    copy.clear();
+    ht.clear();
+
+    // the hash codes can be cached for scalar keys too
+    typedef HashTable<int, int, CollidingHash, _Identity<int>, equal_to<int>,
+            allocator<int>, PowerOfTwoBucketPolicy, true> IntTable;
+    IntTable it(10, CollidingHash(), equal_to<int>());
+    for (int i = 0; i < 100; i++) {
+        it.insertEqual(i % 50);
+    }
+    assert((it.size() == 100 && it.count(3) == 2 && it.erase(3) == 2));
+    assert((it.count(3) == 0 && it.size() == 98));
+    it.clear();
+    cout << "test7 end" << endl;
+}
+
 int main() {
 //    test1();
 //    test2();
     test4();
+    test5();
+    test6();
+    test7();
 }
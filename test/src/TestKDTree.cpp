@@ -22,6 +22,11 @@ limitations under the License.
 #include <vector>
 #include <string>
 #include <flak/KDTree.h>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
 using namespace std;
 using namespace flak;
 
@@ -163,12 +168,13 @@ void test3() {
     cout << endl;
 
 
-    int ans3[2][2] = {{5, 5}, {5, 1}};
+    // (4, 4) itself is skipped, (3, 1) and (5, 6) are the nearest, the farther first
+    int ans3[2][2] = {{10, 5}, {5, 3}};
     int cnt3 = 0;
     ks2 = kd.findKNearest(vec1, 2);
     for(auto d : ks2) {
-        assert((d.first == ans2[cnt3][0]));
-        assert((d.second->second == ans2[cnt3++][1]));
+        assert((d.first == ans3[cnt3][0]));
+        assert((d.second->second == ans3[cnt3++][1]));
 //        cout << "distance: " << d.first << " ";
 //        cout << "value: " << d.second->second << endl;
     }
@@ -176,8 +182,406 @@ void test3() {
     cout << "test 3 end" << endl;
 }
 
+typedef KDTree<vector<int>, int> IntKDTree;
+
+// the height of the tree holding [points]
+size_t heightOf(IntKDTree& kd, vector<vector<int>>& points) {
+    typedef IntKDTree::NodePtr NodePtr;
+    set<NodePtr> nodes, children;
+    for (auto& p : points) {
+        auto res = kd.find(p);
+        assert((res.first));
+        NodePtr n = res.second.node_;
+        nodes.insert(n);
+        if (n->low_) children.insert(n->low_);
+        if (n->high_) children.insert(n->high_);
+    }
+    NodePtr root = nullptr;
+    for (NodePtr n : nodes) {
+        if (!children.count(n)) {
+            assert((root == nullptr));
+            root = n;
+        }
+    }
+    // depth first with the depths
+    size_t height = 0;
+    vector<pair<NodePtr, size_t>> todo{{root, 1}};
+    while (!todo.empty()) {
+        auto x = todo.back();
+        todo.pop_back();
+        height = max(height, x.second);
+        if (x.first->low_) todo.push_back({x.first->low_, x.second + 1});
+        if (x.first->high_) todo.push_back({x.first->high_, x.second + 1});
+    }
+    return height;
+}
+
+// the sorted distances of the [k] nearest other points by brute force
+vector<size_t> bruteKNearest(const map<vector<int>, int>& all, const vector<int>& q, size_t k) {
+    vector<size_t> ds;
+    for (auto& x : all) {
+        size_t d = 0;
+        for (size_t i = 0; i < q.size(); i++) {
+            d += (x.first[i] - q[i]) * (x.first[i] - q[i]);
+        }
+        if (d != 0) ds.push_back(d);
+    }
+    sort(ds.begin(), ds.end());
+    ds.resize(min(k, ds.size()));
+    return ds;
+}
+
+vector<size_t> distancesOf(const vector<pair<size_t, IntKDTree::iterator>>& res) {
+    vector<size_t> ds;
+    for (auto& r : res) ds.push_back(r.first);
+    sort(ds.begin(), ds.end());
+    return ds;
+}
+
+// bulk construction with both split rules, repeated points and queries
+void test4() {
+    mt19937 rng(4);
+    uniform_int_distribution<int> coord(0, 50);
+    vector<pair<vector<int>, int>> input;
+    map<vector<int>, int> all;  // the last value of each point
+    for (int i = 0; i < 2000; i++) {
+        vector<int> p{coord(rng), coord(rng), coord(rng) / 10};
+        input.push_back({p, i});
+        all[p] = i;
+    }
+    vector<vector<int>> points;
+    for (auto& x : all) points.push_back(x.first);
+
+    for (auto rule : {IntKDTree::split_cycle, IntKDTree::split_spread}) {
+        IntKDTree kd(input.begin(), input.end(), 3, rule);
+        assert((kd.size() == all.size()));
+        size_t balanced = 0;
+        while ((size_t(1) << balanced) <= all.size()) balanced++;
+        // the points equal to a median in its dimension go high
+        assert((heightOf(kd, points) < 2 * balanced));
+        for (auto& x : all) {
+            vector<int> p = x.first;
+            auto res = kd.find(p);
+            assert((res.first && res.second->second == x.second));
+        }
+        for (int i = 0; i < 100; i++) {
+            vector<int> q{coord(rng), coord(rng), coord(rng) / 10};
+            assert((distancesOf(kd.findKNearest(q, 5)) == bruteKNearest(all, q, 5)));
+        }
+
+        // still a usual tree
+        vector<int> p = points[7];
+        int erased;
+        assert((kd.erase(p, &erased) && erased == all[p]));
+        assert((!kd.find(p).first));
+        assert((!kd.insert(p, -1)));
+        assert((kd.find(p).second->second == -1));
+        assert((kd.size() == all.size()));
+    }
+
+    vector<pair<vector<int>, int>> none;
+    IntKDTree empty(none.begin(), none.end(), 3);
+    assert((empty.empty()));
+    vector<int> q{1, 2, 3};
+    assert((!empty.find(q).first));
+    cout << "test 4 end" << endl;
+}
+
+// sorted input, which inserting one by one turns into a list,
+// built on several threads
+void test5() {
+    vector<pair<vector<int>, int>> input;
+    map<vector<int>, int> all;
+    for (int i = 0; i < 30000; i++) {
+        vector<int> p{i, i * 7919 % 30000};
+        input.push_back({p, i});
+        all[p] = i;
+    }
+    vector<vector<int>> points;
+    for (auto& x : all) points.push_back(x.first);
+
+    for (auto rule : {IntKDTree::split_cycle, IntKDTree::split_spread}) {
+        IntKDTree kd(input.begin(), input.end(), 2, rule, 4);
+        assert((kd.size() == input.size()));
+        assert((heightOf(kd, points) == 15));
+        mt19937 rng(5);
+        uniform_int_distribution<int> coord(-10, 30010);
+        for (int i = 0; i < 200; i++) {
+            vector<int> q{coord(rng), coord(rng)};
+            assert((distancesOf(kd.findKNearest(q, 8)) == bruteKNearest(all, q, 8)));
+        }
+    }
+    cout << "test 5 end" << endl;
+}
+
+// the sorted distances of the [k] nearest other points of [q] by brute force
+template<class Metric, class Dist, class Point>
+vector<Dist> bruteKNearestBy(const vector<pair<Point, int>>& points, const Point& q, size_t k) {
+    vector<Dist> ds;
+    for (auto& x : points) {
+        Dist d = _kdDistance<Metric, Dist>(x.first, q, q.size());
+        if (d != 0) ds.push_back(d);
+    }
+    sort(ds.begin(), ds.end());
+    ds.resize(min(k, ds.size()));
+    return ds;
+}
+
+template<class Tree>
+vector<typename Tree::distance_type> distancesBy(Tree& t, typename Tree::key_type& q, size_t k) {
+    vector<typename Tree::distance_type> ds;
+    for (auto& r : t.findKNearest(q, k)) ds.push_back(r.first);
+    sort(ds.begin(), ds.end());
+    return ds;
+}
+
+template<class Metric, class Point>
+void checkMetric(const vector<pair<Point, int>>& points, const vector<Point>& qs, size_t dim) {
+    typedef KDTree<Point, int, size_t, Metric> Tree;
+    typedef typename Tree::distance_type Dist;
+    Tree bulk(points.begin(), points.end(), dim);
+    Tree inserted(dim);
+    for (auto& p : points) inserted.insert(p.first, p.second);
+    auto frozen = bulk.freeze();
+    for (Point q : qs) {
+        vector<Dist> expect = bruteKNearestBy<Metric, Dist>(points, q, 6);
+        assert((distancesBy(bulk, q, 6) == expect));
+        assert((distancesBy(inserted, q, 6) == expect));
+        vector<Dist> ds;
+        for (auto& r : frozen.findKNearest(q, 7)) {
+            if (r.first != 0) ds.push_back(r.first);
+        }
+        ds.resize(min(ds.size(), size_t(6)));
+        assert((ds == expect));
+    }
+}
+
+// the metrics, floating point coordinates and integers whose squares overflow int
+void test6() {
+    mt19937 rng(6);
+    {
+        uniform_int_distribution<int> coord(-1000000, 1000000);
+        vector<pair<vector<int>, int>> points;
+        vector<vector<int>> qs;
+        for (int i = 0; i < 3000; i++) {
+            points.push_back({{coord(rng), coord(rng), coord(rng)}, i});
+        }
+        for (int i = 0; i < 100; i++) {
+            qs.push_back({coord(rng), coord(rng), coord(rng)});
+        }
+        checkMetric<EuclideanMetric>(points, qs, 3);
+        checkMetric<ManhattanMetric>(points, qs, 3);
+        checkMetric<ChebyshevMetric>(points, qs, 3);
+    }
+    {
+        // fractions, which a size_t distance would truncate
+        uniform_real_distribution<double> coord(0, 1);
+        vector<pair<vector<double>, int>> points;
+        vector<vector<double>> qs;
+        for (int i = 0; i < 3000; i++) {
+            points.push_back({{coord(rng), coord(rng)}, i});
+        }
+        for (int i = 0; i < 100; i++) {
+            qs.push_back({coord(rng), coord(rng)});
+        }
+        checkMetric<EuclideanMetric>(points, qs, 2);
+        checkMetric<ManhattanMetric>(points, qs, 2);
+        checkMetric<ChebyshevMetric>(points, qs, 2);
+
+        KDTree<vector<double>, int> t(points.begin(), points.end(), 2);
+        vector<double> q{0.5, 0.5};
+        auto res = t.findKNearest(q, 1);
+        assert((res.size() == 1 && res[0].first > 0 && res[0].first < 0.01));
+    }
+    {
+        // unit vectors of 4 dimensions
+        normal_distribution<float> coord(0, 1);
+        auto unit = [&] {
+            vector<float> v(4);
+            float norm = 0;
+            for (float& x : v) {
+                x = coord(rng);
+                norm += x * x;
+            }
+            for (float& x : v) x /= sqrt(norm);
+            return v;
+        };
+        vector<pair<vector<float>, int>> points;
+        vector<vector<float>> qs;
+        for (int i = 0; i < 3000; i++) {
+            points.push_back({unit(), i});
+        }
+        for (int i = 0; i < 100; i++) {
+            qs.push_back(unit());
+        }
+        checkMetric<CosineMetric>(points, qs, 4);
+
+        // 1 - cos of the nearest, by the dot product
+        KDTree<vector<float>, int, size_t, CosineMetric> t(points.begin(), points.end(), 4);
+        auto res = t.findKNearest(qs[0], 1);
+        const vector<float>& p = res[0].second->first;
+        float dot = 0;
+        for (int i = 0; i < 4; i++) dot += p[i] * qs[0][i];
+        assert((fabs(res[0].first - (1 - dot)) < 1e-5));
+    }
+    cout << "test 6 end" << endl;
+}
+
+template<class Metric>
+void checkRanges(const map<vector<int>, int>& all, size_t dim, mt19937& rng) {
+    typedef KDTree<vector<int>, int, size_t, Metric> Tree;
+    typedef typename Tree::distance_type Dist;
+    typedef typename Tree::iterator Iter;
+    vector<pair<vector<int>, int>> points(all.begin(), all.end());
+    Tree bulk(points.begin(), points.end(), dim);
+    Tree inserted(dim);
+    for (auto& p : points) inserted.insert(p.first, p.second);
+    uniform_int_distribution<int> coord(-5, 105);
+    for (int i = 0; i < 100; i++) {
+        vector<int> q, lo, hi;
+        for (size_t d = 0; d < dim; d++) {
+            q.push_back(coord(rng));
+            int a = coord(rng), b = coord(rng);
+            lo.push_back(min(a, b));
+            hi.push_back(max(a, b));
+        }
+        Dist r = rng() % (i < 50 ? 200 : 5000);
+        vector<pair<Dist, int>> inRadius;
+        vector<int> inBox;
+        for (auto& x : all) {
+            Dist d = _kdDistance<Metric, Dist>(x.first, q, dim);
+            if (d <= r) inRadius.push_back({d, x.second});
+            bool inside = true;
+            for (size_t k = 0; k < dim; k++) inside &= lo[k] <= x.first[k] && x.first[k] <= hi[k];
+            if (inside) inBox.push_back(x.second);
+        }
+        sort(inRadius.begin(), inRadius.end());
+        sort(inBox.begin(), inBox.end());
+
+        for (Tree* t : {&bulk, &inserted}) {
+            vector<pair<Dist, int>> got;
+            t->forEachInRadius(q, r, [&](Iter it, Dist d) {
+                assert((_kdDistance<Metric, Dist>(it->first, q, dim) == d));
+                got.push_back({d, it->second});
+            });
+            sort(got.begin(), got.end());
+            assert((got == inRadius));
+
+            vector<pair<Dist, Iter>> found;
+            t->findInRadius(q, r, back_inserter(found));
+            assert((found.size() == inRadius.size()));
+            assert((t->countInRadius(q, r) == inRadius.size()));
+
+            vector<int> box;
+            t->forEachInBox(lo, hi, [&](Iter it) { box.push_back(it->second); });
+            sort(box.begin(), box.end());
+            assert((box == inBox));
+
+            vector<Iter> boxIters;
+            t->findInBox(lo, hi, back_inserter(boxIters));
+            assert((boxIters.size() == inBox.size()));
+            assert((t->countInBox(lo, hi) == inBox.size()));
+        }
+    }
+}
+
+// radius and box queries against brute force
+void test7() {
+    mt19937 rng(7);
+    uniform_int_distribution<int> coord(0, 100);
+    for (size_t dim : {1, 2, 3}) {
+        map<vector<int>, int> all;
+        for (int i = 0; i < 2000; i++) {
+            vector<int> p;
+            for (size_t d = 0; d < dim; d++) p.push_back(coord(rng));
+            all[p] = i;
+        }
+        checkRanges<EuclideanMetric>(all, dim, rng);
+        checkRanges<ManhattanMetric>(all, dim, rng);
+        checkRanges<ChebyshevMetric>(all, dim, rng);
+    }
+
+    KDTree<vector<int>, int> empty(2);
+    vector<int> q{1, 1};
+    assert((empty.countInRadius(q, 100) == 0 && empty.countInBox(q, q) == 0));
+    cout << "test 7 end" << endl;
+}
+
+// findKNearestBatch against findKNearest, with every thread count and order
+template<class Point>
+void checkBatch(KDTree<Point, int>& t, const vector<Point>& qs, size_t k) {
+    typedef KDTree<Point, int> Tree;
+    vector<vector<pair<typename Tree::distance_type, typename Tree::iterator>>> out;
+    for (unsigned threads : {1, 3, 0}) {
+        for (bool curve : {false, true}) {
+            t.findKNearestBatch(qs, k, out, threads, curve);
+            assert((out.size() == qs.size()));
+            for (size_t i = 0; i < qs.size(); i++) {
+                Point q = qs[i];
+                auto expect = t.findKNearest(q, k);
+                assert((out[i].size() == expect.size()));
+                for (size_t j = 0; j < expect.size(); j++) {
+                    // the farthest first, the equal distances in any order
+                    assert((out[i][j].first == expect[j].first));
+                    assert((_kdDistance<EuclideanMetric, typename Tree::distance_type>(
+                            out[i][j].second->first, q, q.size()) == out[i][j].first));
+                }
+            }
+        }
+    }
+}
+
+void test8() {
+    mt19937 rng(8);
+    {
+        uniform_int_distribution<int> coord(0, 1000);
+        vector<pair<vector<int>, int>> points;
+        for (int i = 0; i < 20000; i++) {
+            points.push_back({{coord(rng), coord(rng), coord(rng)}, i});
+        }
+        KDTree<vector<int>, int> t(points.begin(), points.end(), 3);
+        vector<vector<int>> qs;
+        for (int i = 0; i < 1000; i++) {
+            qs.push_back({coord(rng), coord(rng), coord(rng)});
+        }
+        // some of the points themselves, which are skipped
+        for (int i = 0; i < 100; i++) {
+            qs.push_back(points[i].first);
+        }
+        checkBatch(t, qs, 1);
+        checkBatch(t, qs, 10);
+    }
+    {
+        uniform_real_distribution<double> coord(-1, 1);
+        KDTree<vector<double>, int> t(2);
+        for (int i = 0; i < 5000; i++) {
+            t.insert({coord(rng), coord(rng)}, i);
+        }
+        vector<vector<double>> qs;
+        for (int i = 0; i < 500; i++) {
+            qs.push_back({coord(rng), coord(rng)});
+        }
+        checkBatch(t, qs, 7);
+        checkBatch(t, qs, 6000);
+    }
+    {
+        KDTree<vector<int>, int> empty(2);
+        vector<vector<pair<size_t, KDTree<vector<int>, int>::iterator>>> out(5);
+        empty.findKNearestBatch({{1, 2}, {3, 4}}, 3, out);
+        assert((out.size() == 2 && out[0].empty() && out[1].empty()));
+        empty.findKNearestBatch({}, 3, out, 0, true);
+        assert((out.empty()));
+    }
+    cout << "test 8 end" << endl;
+}
+
 int main() {
     test1();
 //    test2();
     test3();
+    test4();
+    test5();
+    test6();
+    test7();
+    test8();
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <cassert>
 #include <sstream>
 #include <algorithm>
+#include <memory>
+#include <string>
 using namespace std;
 using namespace flak;
 
@@ -125,6 +127,29 @@ void test4() {
     cout << "test 4 end" << endl;
 }
 
+void test5() {
+    // the elements can only be moved
+    List<unique_ptr<int>> ls;
+    ls.push_back(unique_ptr<int>(new int(2)));
+    ls.push_front(unique_ptr<int>(new int(1)));
+    ls.emplace_back(new int(4));
+    auto it = ls.end();
+    --it;
+    ls.emplace(it, new int(3));
+    ls.emplace_front(new int(0));
+    assert((ls.size() == 5));
+    int cnt = 0;
+    for (auto p = ls.begin(); p != ls.end(); p++) {
+        assert((**p == cnt++));
+    }
+
+    List<string> ss;
+    string s(100, 'x');
+    ss.push_back(std::move(s));
+    ss.emplace_back(3, 'y');
+    assert((ss.front() == string(100, 'x') && ss.back() == "yyy"));
+    cout << "test 5 end" << endl;
+}
 
 void testTime() {
     clock_t tStart = clock();
@@ -143,4 +168,5 @@ void testTime() {
 int main() {
 //    testTime();
     test4();
+    test5();
 }
\ No newline at end of file
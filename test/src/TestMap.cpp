@@ -2,6 +2,7 @@
 #include <map>
 #include <iostream>
 #include <cassert>
+#include <memory>
 using namespace std;
 using namespace flak;
 
@@ -41,5 +42,35 @@ int main() {
     it1->second = 9;
     // it1->first = "ss"; // cannot update the key
     assert((smap["jerry"] == 9));
+
+    // the mapped values are constructed in place
+    Map<int, unique_ptr<string>> umap;
+    for (int i = 0; i < 100; i++) {
+        assert((umap.tryEmplace(i, new string(to_string(i))).second));
+    }
+    assert((!umap.tryEmplace(3, new string("x")).second));
+    unique_ptr<string> v(new string("y"));
+    assert((umap.emplace(200, std::move(v)).second && !v));
+    assert((umap.insert(pair<const int, unique_ptr<string>>(201, nullptr)).second));
+    umap[300].reset(new string("z"));
+    assert((umap.size() == 103 && *umap[3] == "3" && *umap[200] == "y" && *umap[300] == "z"));
+
+    // the hint is used when the key belongs next to it, else it is ignored
+    Map<int, int> hmap;
+    for (int i = 0; i < 1000; i += 2) {
+        hmap.insert(hmap.end(), pair<const int, int>(i, i));
+    }
+    Map<int, int>::iterator hit = hmap.find(500);
+    assert((hmap.insert(hit, pair<const int, int>(499, 1))->first == 499));
+    assert((hmap.insert(hit, pair<const int, int>(501, 1))->first == 501));
+    assert((hmap.insert(hit, pair<const int, int>(7, 1))->first == 7));
+    assert((hmap.insert(hmap.begin(), pair<const int, int>(-1, 1))->first == -1));
+    hit = hmap.insert(hmap.end(), pair<const int, int>(500, 1));
+    assert((hit->second == 500 && hmap.size() == 504));
+    int prev = -2;
+    for (hit = hmap.begin(); hit != hmap.end(); ++hit) {
+        assert((prev < hit->first));
+        prev = hit->first;
+    }
     cout << "end" << endl;
 }
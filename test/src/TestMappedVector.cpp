@@ -0,0 +1,132 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <flak/MappedVector.h>
+#include <flak/alg/Sort.h>
+#include <flak/alg/Search.h>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <system_error>
+using namespace std;
+using namespace flak;
+
+struct Record {
+    long key;
+    double value;
+
+    bool operator<(const Record& x) const { return key < x.key; }
+};
+
+const string path = "TestMappedVector.bin";
+
+void test1() {
+    typedef MappedVector<Record> Records;
+    const long n = 100000;
+    {
+        Records v(path, Records::create);
+        assert((v.isOpen() && v.empty()));
+        mt19937_64 rng(1);
+        for (long i = 0; i < n; i++) {
+            v.push_back(Record{(long) (rng() % 1000000) * 2, (double) i});
+        }
+        assert((v.size() == n && v.capacity() >= n));
+        Sort(v.begin(), v.end());
+        for (long i = 1; i < n; i++) {
+            assert((v[i - 1].key <= v[i].key));
+        }
+    } // the file is cut to the size
+
+    FILE* f = fopen(path.c_str(), "rb");
+    fseek(f, 0, SEEK_END);
+    assert((ftell(f) == (long) (n * sizeof(Record))));
+    fclose(f);
+
+    Records r(path, Records::readOnly);
+    assert((r.isReadOnly() && r.size() == n));
+    const Records& cr = r;
+    Record k{cr[n / 2].key, 0};
+    assert((binarySearch(cr.begin(), cr.end(), k)));
+    assert((lowerBound(cr.begin(), cr.end(), k)->key == k.key));
+    Record odd{k.key + 1, 0};
+    assert((!binarySearch(cr.begin(), cr.end(), odd)));
+
+    bool thrown = false;
+    try {
+        r.reserve(2 * n);
+    } catch (const system_error&) {
+        thrown = true;
+    }
+    assert((thrown && r.size() == n));
+    r.close();
+    assert((!r.isOpen()));
+    cout << "test 1 end" << endl;
+}
+
+void test2() {
+    typedef MappedVector<int> Ints;
+    {
+        Ints v(path, Ints::create);
+        for (int i = 0; i < 10; i++) {
+            v.push_back(i);
+        }
+    }
+    {
+        // append to the existing records
+        Ints v(path, Ints::readWrite);
+        assert((v.size() == 10 && v[9] == 9));
+        for (int i = 10; i < 5000; i++) {
+            v.push_back(v[i - 10] + 10);
+        }
+        v.erase(v.begin(), v.begin() + 5);
+        v.pop_back();
+        v.resize(v.size() + 3);
+        assert((v.size() == 4997 && v[0] == 5 && v[4993] == 4998 && v[4994] == 0 && v[4996] == 0));
+        v.sync();
+    }
+    Ints v(path, Ints::readOnly);
+    assert((v.size() == 4997 && v.front() == 5 && v.back() == 0));
+
+    // the size of the file must be a multiple of the record
+    bool thrown = false;
+    try {
+        MappedVector<Record> bad(path, MappedVector<Record>::readOnly);
+    } catch (const system_error&) {
+        thrown = true;
+    }
+    assert((thrown));
+
+    thrown = false;
+    try {
+        Ints missing("no/such/dir/file.bin", Ints::readOnly);
+    } catch (const system_error&) {
+        thrown = true;
+    }
+    assert((thrown));
+
+    Ints empty(path, Ints::create);
+    assert((empty.empty() && empty.begin() == empty.end()));
+    remove(path.c_str());
+    cout << "test 2 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+}
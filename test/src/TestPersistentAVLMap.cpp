@@ -0,0 +1,204 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <flak/PersistentAVLMap.h>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+using namespace flak;
+
+template<class M1, class M2>
+bool same(const M1& m, const M2& ref) {
+    if (m.size() != ref.size()) {
+        return false;
+    }
+    auto r = ref.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++r) {
+        if (it->first != r->first || it->second != r->second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test1() {
+    PersistentAVLMap<string, int> m;
+    assert((m.insert(make_pair(string("jjhou"), 1)) && m.insert(make_pair(string("jerry"), 2))));
+    assert((!m.insert(make_pair(string("jerry"), 5))));
+    assert((m.insertOrAssign("jason", 3) && !m.insertOrAssign("jerry", 4)));
+
+    PersistentAVLMap<string, int> s = m.snapshot();
+    m.erase("jjhou");
+    m.insertOrAssign("jason", 30);
+    m.insertOrAssign("david", 5);
+
+    assert((s.size() == 3 && s.find("jjhou")->second == 1 && s.find("jason")->second == 3));
+    assert((s.find("david") == s.end() && s.lowerBound("jb")->first == "jerry"));
+    assert((m.size() == 3 && m.find("jjhou") == m.end() && m.find("jason")->second == 30));
+    assert((m.begin()->first == "david" && (--m.end())->first == "jerry"));
+    assert((m.upperBound("jerry") == m.end() && m.count("david") == 1 && m.count("x") == 0));
+    cout << "test 1 end" << endl;
+}
+
+void test2() {
+    // every snapshot keeps its contents while the map changes
+    PersistentAVLMap<int, int> m;
+    map<int, int> ref;
+    vector<pair<PersistentAVLMap<int, int>, map<int, int>>> versions;
+    mt19937 rng(1);
+    for (int i = 0; i < 20000; i++) {
+        int k = rng() % 1000;
+        switch (rng() % 3) {
+            case 0:
+                assert((m.insert(make_pair(k, i)) == ref.insert(make_pair(k, i)).second));
+                break;
+            case 1:
+                assert((m.insertOrAssign(k, i) == (ref.count(k) == 0)));
+                ref[k] = i;
+                break;
+            default:
+                assert((m.erase(k) == ref.erase(k)));
+        }
+        if (i % 500 == 0) {
+            versions.push_back(make_pair(m.snapshot(), ref));
+        }
+        if (i % 2000 == 0) {
+            // some versions are dropped
+            versions.erase(versions.begin() + rng() % versions.size());
+        }
+    }
+    assert((same(m, ref)));
+    for (auto& v : versions) {
+        assert((same(v.first, v.second)));
+    }
+    // backwards, and the bounds
+    auto r = ref.rbegin();
+    for (auto it = m.end(); it != m.begin(); ++r) {
+        assert((*--it == *r));
+    }
+    for (int k = -1; k <= 1000; k++) {
+        auto lb = m.lowerBound(k);
+        auto ub = m.upperBound(k);
+        assert((lb == m.end() ? ref.lower_bound(k) == ref.end() : *lb == *ref.lower_bound(k)));
+        assert((ub == m.end() ? ref.upper_bound(k) == ref.end() : *ub == *ref.upper_bound(k)));
+    }
+    cout << "test 2 end" << endl;
+}
+
+struct Counted {
+    static int alive;
+    static int copies;   // throw at the copy that brings it to 0
+    int x;
+
+    explicit Counted(int v) : x(v) { ++alive; }
+
+    Counted(const Counted& o) : x(o.x) {
+        if (--copies == 0) {
+            throw runtime_error("copy");
+        }
+        ++alive;
+    }
+
+    ~Counted() { --alive; }
+
+    bool operator!=(const Counted& o) const { return x != o.x; }
+};
+
+int Counted::alive = 0;
+int Counted::copies = 0;
+
+void test3() {
+    {
+        PersistentAVLMap<int, Counted> m;
+        for (int i = 0; i < 1000; i++) {
+            m.insert(make_pair(i, Counted(i)));
+        }
+        PersistentAVLMap<int, Counted> s = m.snapshot();
+        // the nodes of the updates are copied from the snapshot
+        for (int i = 0; i < 1000; i += 3) {
+            m.erase(i);
+        }
+        for (int i = 1000; i < 1100; i++) {
+            m.insert(make_pair(i, Counted(i)));
+        }
+        assert((m.size() == 766 && s.size() == 1000));
+
+        // a copy on the path throws, nothing changes
+        PersistentAVLMap<int, Counted> t = m.snapshot();
+        Counted::copies = 3;
+        bool thrown = false;
+        try {
+            m.insert(make_pair(5000, Counted(5000)));
+        } catch (runtime_error&) {
+            thrown = true;
+        }
+        Counted::copies = 0;
+        assert((thrown && m.size() == 766 && m.find(5000) == m.end() && same(m, t)));
+
+        s = PersistentAVLMap<int, Counted>();
+        t.clear();
+        assert((Counted::alive == 766));
+    }
+    assert((Counted::alive == 0));
+    cout << "test 3 end" << endl;
+}
+
+void test4() {
+    // readers scan their snapshots in other threads while the map changes
+    PersistentAVLMap<int, int> m;
+    for (int i = 0; i < 2000; i++) {
+        m.insert(make_pair(i, 0));
+    }
+    atomic<int> bad(0);
+    vector<thread> readers;
+    for (int round = 1; round <= 20; round++) {
+        PersistentAVLMap<int, int> s = m.snapshot();
+        readers.emplace_back([s, round, &bad]() {
+            // every value of a version is the round before it
+            long sum = 0;
+            for (auto it = s.begin(); it != s.end(); ++it) {
+                sum += it->second != round - 1;
+            }
+            if (sum != 0 || s.size() != 2000) {
+                bad++;
+            }
+        });
+        for (int i = 0; i < 2000; i++) {
+            m.insertOrAssign(i, round);
+        }
+    }
+    for (auto& t : readers) {
+        t.join();
+    }
+    assert((bad == 0));
+    cout << "test 4 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+    test3();
+    test4();
+}
@@ -0,0 +1,203 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <flak/PoolAllocator.h>
+#include <flak/Set.h>
+#include <flak/AVLSet.h>
+#include <flak/List.h>
+#include <flak/HashSet.h>
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace flak;
+
+void test1() {
+    PoolAllocator<int> alloc;
+    const NodePool& pool = alloc.pool();
+    assert((pool.slabCount() == 0));
+
+    vector<int*> ps;
+    const size_t n = NodePool::capacity(0) * 3 + 5;
+    for (size_t i = 0; i < n; i++) {
+        int* p = alloc.allocate(1);
+        *p = (int) i;
+        ps.push_back(p);
+    }
+    assert((pool.liveCount() == n && pool.slabCount() == 4));
+    for (size_t i = 0; i < n; i++) {
+        assert((*ps[i] == (int) i));
+    }
+
+    // the freed chunks are reused
+    alloc.deallocate(ps[7], 1);
+    int* p = alloc.allocate(1);
+    assert((p == ps[7]));
+
+    // a rebound copy shares the pool, arrays do not use it
+    PoolAllocator<double> dalloc(alloc);
+    assert((dalloc == alloc));
+    double* d = dalloc.allocate(1);
+    double* arr = dalloc.allocate(100);
+    assert((pool.liveCount() == n + 1));
+    dalloc.deallocate(arr, 100);
+    dalloc.deallocate(d, 1);
+    assert((PoolAllocator<int>() != alloc));
+
+    // the empty slabs are released, the last one of a class is kept
+    for (size_t i = 0; i < n; i++) {
+        alloc.deallocate(ps[i], 1);
+    }
+    assert((pool.liveCount() == 0 && pool.slabCount() == 1));
+    cout << "test 1 end" << endl;
+}
+
+template<class Container>
+void checkSet(Container& s) {
+    std::set<int> ref;
+    unsigned seed = 7;
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245 + 12345;
+        int v = (seed >> 8) % 3000;
+        if (seed & 1) {
+            s.insert(v);
+            ref.insert(v);
+        } else {
+            s.erase(v);
+            ref.erase(v);
+        }
+    }
+    assert((s.size() == ref.size()));
+    for (int v : ref) {
+        assert((s.find(v) != s.end()));
+    }
+}
+
+void test2() {
+    Set<int, less<int>, PoolAllocator<int>> s;
+    checkSet(s);
+    AVLSet<int, less<int>, PoolAllocator<int>> as;
+    checkSet(as);
+    HashSet<int, hash<int>, equal_to<int>, PoolAllocator<int>> hs;
+    checkSet(hs);
+
+    List<string, PoolAllocator<string>> ls;
+    for (int i = 0; i < 1000; i++) {
+        ls.push_back(to_string(i));
+    }
+    int i = 0;
+    for (auto it = ls.begin(); it != ls.end(); ++it) {
+        assert((*it == to_string(i++)));
+    }
+    ls.clear();
+    assert((ls.empty()));
+    cout << "test 2 end" << endl;
+}
+
+// a size going back and forth over the end of a slab keeps the spare slab
+void test3() {
+    PoolAllocator<int> alloc;
+    const NodePool& pool = alloc.pool();
+    vector<int*> ps;
+    const size_t n = NodePool::capacity(0);
+    for (size_t i = 0; i < n; i++) {
+        ps.push_back(alloc.allocate(1));
+    }
+    assert((pool.slabCount() == 1));
+    for (int i = 0; i < 100000; i++) {
+        int* p = alloc.allocate(1);
+        assert((pool.slabCount() == 2));
+        alloc.deallocate(p, 1);
+        assert((pool.slabCount() == 2 && pool.liveCount() == n));
+    }
+
+    // the first slab to empty becomes the spare, the second one is released
+    int* extra = alloc.allocate(1);
+    for (int* p : ps) {
+        alloc.deallocate(p, 1);
+    }
+    assert((pool.slabCount() == 2 && pool.liveCount() == 1));
+    alloc.deallocate(extra, 1);
+    assert((pool.slabCount() == 1 && pool.liveCount() == 0));
+    cout << "test 3 end" << endl;
+}
+
+// every list has its own pool, sort() and swap() keep the nodes with their allocator
+void test4() {
+    typedef List<int, PoolAllocator<int>> PoolList;
+    PoolList l;
+    unsigned seed = 11;
+    for (int i = 0; i < 5000; i++) {
+        seed = seed * 1103515245 + 12345;
+        l.push_back((int) ((seed >> 8) % 1000));
+    }
+    l.sort();
+    assert((l.size() == 5000));
+    int prev = -1;
+    for (int v : l) {
+        assert((prev <= v));
+        prev = v;
+    }
+
+    PoolList a, b;
+    assert((!(a.get_allocator() == b.get_allocator())));
+    for (int i = 0; i < 100; i++) {
+        a.push_back(i);
+    }
+    b.push_back(-1);
+    PoolAllocator<int> aAlloc = a.get_allocator();
+    a.swap(b);
+    assert((b.get_allocator() == aAlloc && a.size() == 1 && b.size() == 100 && *a.begin() == -1));
+    {
+        PoolList c;
+        c.swap(b);
+        assert((c.size() == 100 && b.empty()));
+    }
+
+    // the splices between pools move the elements to new nodes
+    PoolList x, y;
+    for (int i = 0; i < 10; i++) {
+        x.push_back(i);
+        y.push_back(10 + i);
+    }
+    x.splice(x.end(), y, y.begin());
+    assert((x.size() == 11 && y.size() == 9 && *--x.end() == 10));
+    x.splice(x.end(), y);
+    assert((x.size() == 20 && y.empty()));
+    {
+        PoolList z;
+        z.push_back(5);
+        x.merge(z);
+        assert((x.size() == 21 && z.empty()));
+    }
+    int expect[21] = {0, 1, 2, 3, 4, 5, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+    int k = 0;
+    for (int v : x) {
+        assert((v == expect[k++]));
+    }
+    cout << "test 4 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+    test3();
+    test4();
+}
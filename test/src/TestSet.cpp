@@ -1,8 +1,12 @@
 #include <flak/Set.h>
+#include <flak/PoolAllocator.h>
 #include <iostream>
 #include <cassert>
 #include <algorithm>
 #include <iterator>
+#include <stdexcept>
+#include <vector>
+#include <string>
 using namespace std;
 using namespace flak;
 int main() {
@@ -35,6 +39,125 @@ int main() {
     it1 = iset.find(3);
     assert((it1 != iset.end() && *it1 == 3));
 
+    // moved and constructed in place
+    Set<string> sset;
+    string s(100, 'a');
+    assert((sset.insert(std::move(s)).second && s.empty()));
+    assert((sset.emplace(100, 'a').second == false));
+    assert((sset.emplace(3, 'b').second && sset.size() == 2));
+    assert((*sset.begin() == string(100, 'a')));
+
+    // sorted input is built in bulk, with the duplicates dropped
+    int sorted[7] = {1, 1, 2, 3, 5, 5, 8};
+    Set<int> bset(sorted, sorted + 7);
+    int bans[5] = {1, 2, 3, 5, 8};
+    assert((bset.size() == 5 && equal(bset.begin(), bset.end(), bans)));
+    bset.insert(4);
+    bset.erase(1);
+    bset.erase(8);
+    int bans2[4] = {2, 3, 4, 5};
+    assert((bset.size() == 4 && equal(bset.begin(), bset.end(), bans2)));
+    int unsorted[5] = {5, 3, 1, 3, 2};
+    Set<int> uset(unsorted, unsorted + 5);
+    int uans[4] = {1, 2, 3, 5};
+    assert((uset.size() == 4 && equal(uset.begin(), uset.end(), uans)));
+
+    // order statistics
+    Set<int, less<int>, allocator<int>, true> oset;
+    for (int i = 0; i < 100; i++) {
+        oset.insert((i * 37) % 100);
+    }
+    for (int i = 0; i < 100; i += 2) {
+        oset.erase(i);
+    }
+    assert((*oset.select(0) == 1 && *oset.select(10) == 21 && oset.select(50) == oset.end()));
+    assert((oset.rank(1) == 0 && oset.rank(21) == 10 && oset.rank(22) == 11 && oset.rank(1000) == 50));
+    assert((oset.countRange(10, 20) == 5 && oset.countRange(20, 10) == 0));
+
+    // split and join relink the nodes
+    Set<int> left, right;
+    for (int i = 0; i < 1000; i++) {
+        left.insert(i);
+    }
+    left.split(600, right);
+    assert((left.size() == 600 && right.size() == 400));
+    assert((left.count(599) == 1 && left.count(600) == 0 && *right.begin() == 600));
+    right.erase(700);
+    left.join(right);
+    assert((left.size() == 999 && right.size() == 0 && left.count(700) == 0 && left.count(999) == 1));
+    Set<int> overlap;
+    overlap.insert(5);
+    bool thrown = false;
+    try {
+        left.join(overlap);
+    } catch (invalid_argument&) {
+        thrown = true;
+    }
+    assert((thrown && overlap.size() == 1));
+
+    // the set operations, forked on 4 threads
+    vector<int> evens, threes;
+    for (int i = 0; i < 100000; i += 2) {
+        evens.push_back(i);
+    }
+    for (int i = 0; i < 100000; i += 3) {
+        threes.push_back(i);
+    }
+    Set<int> u(evens.begin(), evens.end()), x(threes.begin(), threes.end());
+    u.setUnion(x, 4);
+    assert((u.size() == 66667 && x.size() == 0 && u.count(9) == 1 && u.count(7) == 0));
+    Set<int> i6(evens.begin(), evens.end()), y(threes.begin(), threes.end());
+    i6.setIntersection(y, 4);
+    assert((i6.size() == 16667 && *i6.begin() == 0 && *++i6.begin() == 6));
+    Set<int> d(evens.begin(), evens.end()), z(threes.begin(), threes.end());
+    d.setDifference(z, 4);
+    assert((d.size() == 33333 && d.count(6) == 0 && d.count(4) == 1));
+
+    // every PoolAllocator has its own pool, the values are copied instead of relinked
+    typedef Set<int, less<int>, PoolAllocator<int>> PoolSet;
+    PoolSet pa, pb;
+    for (int i = 0; i < 10000; i++) {
+        pa.insert(i);
+    }
+    assert((!(pa.get_allocator() == pb.get_allocator())));
+    pa.split(5000, pb);
+    assert((pa.size() == 5000 && pb.size() == 5000 && *pb.begin() == 5000));
+    {
+        PoolSet pc;
+        pc.insert(-1);
+        pa.join(pc);
+        assert((pc.size() == 0 && *pa.begin() == -1 && pa.size() == 5001));
+    }
+    pa.join(pb);
+    assert((pb.size() == 0 && pa.size() == 10001 && *--pa.end() == 9999));
+    {
+        PoolSet tail;
+        pa.split(9000, tail);
+        pa.clear();
+        int next = 9000;
+        for (auto it = tail.begin(); it != tail.end(); ++it) {
+            assert((*it == next++));
+        }
+        assert((next == 10000));
+    }
+    PoolSet pu(evens.begin(), evens.end()), px(threes.begin(), threes.end());
+    pu.setUnion(px, 4);
+    assert((pu.size() == 66667 && px.size() == 0 && pu.count(9) == 1 && pu.count(7) == 0));
+    PoolSet pi(evens.begin(), evens.end()), py(threes.begin(), threes.end());
+    pi.setIntersection(py, 4);
+    assert((pi.size() == 16667 && py.size() == 0 && *++pi.begin() == 6));
+    PoolSet pd(evens.begin(), evens.end()), pz(threes.begin(), threes.end());
+    pd.setDifference(pz, 4);
+    assert((pd.size() == 33333 && pd.count(6) == 0 && pd.count(4) == 1));
+
+    // appending at end() with the hint
+    Set<int> h;
+    for (int i = 0; i < 100; i++) {
+        assert((*h.insert(h.end(), i) == i));
+    }
+    assert((*h.insert(h.begin(), 50) == 50 && h.size() == 100 && *h.insert(h.find(50), -1) == -1));
+    assert((*h.begin() == -1 && h.size() == 101));
+
     cout << "end" << endl;
     // *it = 9 // compile error
 }
@@ -0,0 +1,111 @@
+/*
+
+Copyright 2019 flak authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include <flak/SmallVector.h>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+using namespace std;
+using namespace flak;
+
+// counts the heap allocations of the elements
+template<class T>
+struct CountingAllocator : allocator<T> {
+    static int allocations;
+
+    template<class U>
+    struct rebind {
+        typedef CountingAllocator<U> other;
+    };
+
+    CountingAllocator() {}
+
+    template<class U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        allocations++;
+        return allocator<T>::allocate(n);
+    }
+};
+template<class T> int CountingAllocator<T>::allocations = 0;
+
+void test1() {
+    typedef SmallVector<int, 8, CountingAllocator<int>> Small;
+    Small v;
+    assert((v.isInline() && v.capacity() == 8 && v.empty()));
+    for (int i = 0; i < 8; i++) {
+        v.push_back(i);
+    }
+    assert((v.isInline() && CountingAllocator<int>::allocations == 0));
+
+    // spills to the heap
+    v.push_back(8);
+    assert((!v.isInline() && CountingAllocator<int>::allocations == 1));
+    assert((v.size() == 9 && v.capacity() == 16));
+    for (int i = 0; i < 9; i++) {
+        assert((v[i] == i));
+    }
+
+    v.erase(v.begin() + 2, v.begin() + 5);
+    assert((v.size() == 6 && v[2] == 5 && v.back() == 8));
+    v.clear();
+    assert((v.empty() && !v.isInline()));
+
+    Small w{1, 2, 3};
+    assert((w.isInline() && w.size() == 3 && w.front() == 1 && w.back() == 3));
+    w.reserve(4);
+    assert((w.isInline()));
+    w.reserve(20);
+    assert((!w.isInline() && w.capacity() == 20 && w[1] == 2));
+    cout << "test 1 end" << endl;
+}
+
+void test2() {
+    // the elements own memory
+    SmallVector<string, 4> v;
+    for (int i = 0; i < 4; i++) {
+        v.emplace_back(30, 'a' + i);
+    }
+    SmallVector<string, 4> c(v);
+    assert((c.isInline() && c.size() == 4 && c[3] == string(30, 'd')));
+    for (int i = 4; i < 50; i++) {
+        v.emplace_back(30, 'a' + i % 26);
+    }
+    assert((!v.isInline() && v.size() == 50 && v[0] == string(30, 'a') && v[49] == string(30, 'x')));
+
+    c = v;
+    assert((c.size() == 50 && c[30] == v[30]));
+    v.erase(v.begin());
+    assert((v.size() == 49 && v[0] == string(30, 'b')));
+
+    SmallVector<unique_ptr<int>, 2> u;
+    for (int i = 0; i < 5; i++) {
+        u.emplace_back(new int(i));
+    }
+    assert((*u[4] == 4 && *u[0] == 0));
+
+    SmallVector<double, 3> d(5, 1.5);
+    assert((!d.isInline() && d.size() == 5 && d[4] == 1.5));
+    cout << "test 2 end" << endl;
+}
+
+int main() {
+    test1();
+    test2();
+}
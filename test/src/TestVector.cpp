@@ -2,6 +2,10 @@
 #include <vector>
 #include <cassert>
 #include <iostream>
+#include <string>
+#include <ratio>
+#include <stdexcept>
+#include <utility>
 using namespace std;
 using namespace flak;
 
@@ -127,6 +131,114 @@ void test6() {
     cout << "test 6 end" << endl;
 }
 
+// counts the copies, a moved from object is empty
+struct Counted {
+    static int copies;
+    string s;
+    Counted(const string& x) : s(x) {}
+    Counted(const string& x, int n) : s(x + to_string(n)) {}
+    Counted(const Counted& x) : s(x.s) { copies++; }
+    Counted(Counted&& x) noexcept : s(std::move(x.s)) {}
+    Counted& operator=(const Counted& x) { s = x.s; copies++; return *this; }
+    Counted& operator=(Counted&& x) { s = std::move(x.s); return *this; }
+};
+int Counted::copies = 0;
+
+void test7() {
+    Vector<Counted> v;
+    v.reserve(4);
+    Counted c("a");
+    v.push_back(c);
+    assert((Counted::copies == 1));
+    v.push_back(std::move(c));
+    assert((Counted::copies == 1 && c.s.empty()));
+    v.emplace_back("b", 2);
+    v.emplace_back(string("c"));
+    assert((Counted::copies == 1));
+    assert((v.size() == 4 && v[0].s == "a" && v[1].s == "a" && v[2].s == "b2" && v[3].s == "c"));
+
+    // it grows, and the new element refers to an old one
+    v.emplace_back(v[0]);
+    assert((v.size() == 5 && v[4].s == "a"));
+
+    Vector<string> vs;
+    for (int i = 0; i < 100; i++) {
+        vs.emplace_back(10, 'a' + i % 26);
+    }
+    assert((vs.size() == 100 && vs[27] == string(10, 'b')));
+    cout << "test 7 end" << endl;
+}
+
+// the move constructor may throw, so growing copies it
+struct MayThrow {
+    static int copies;
+    static int throwAt;
+    int v;
+    MayThrow(int x) : v(x) {}
+    MayThrow(const MayThrow& x) : v(x.v) {
+        if (++copies == throwAt) {
+            throw runtime_error("copy");
+        }
+    }
+    MayThrow(MayThrow&& x) : v(x.v) {}
+    MayThrow& operator=(const MayThrow& x) = default;
+};
+int MayThrow::copies = 0;
+int MayThrow::throwAt = -1;
+
+void test8() {
+    // strings are moved, not copied, when the vector grows
+    Counted::copies = 0;
+    Vector<Counted> v;
+    for (int i = 0; i < 1000; i++) {
+        v.emplace_back("s", i);
+    }
+    v.reserve(5000);
+    assert((Counted::copies == 0 && v.size() == 1000 && v[999].s == "s999"));
+    v.erase(v.begin(), v.begin() + 10);
+    assert((Counted::copies == 0 && v.size() == 990 && v[0].s == "s10"));
+
+    // trivially copyable types
+    Vector<int> vi;
+    for (int i = 0; i < 100000; i++) {
+        vi.push_back(i);
+    }
+    for (int i = 0; i < 100000; i++) {
+        assert((vi[i] == i));
+    }
+
+    // the growth factor
+    Vector<int, allocator<int>, ratio<3, 2>> vg;
+    size_t caps[] = {1, 2, 3, 4, 6, 9, 13};
+    int k = 0;
+    for (int i = 0; i < 13; i++) {
+        vg.push_back(i);
+        if (vg.capacity() != caps[k]) {
+            assert((vg.capacity() == caps[++k]));
+        }
+    }
+    assert((k == 6 && vg.size() == 13 && vg[12] == 12));
+
+    // a throwing copy while growing leaves the vector unchanged
+    Vector<MayThrow> vt;
+    for (int i = 0; i < 8; i++) {
+        vt.emplace_back(i);
+    }
+    MayThrow::copies = 0;
+    MayThrow::throwAt = 5;
+    bool thrown = false;
+    try {
+        vt.emplace_back(8);
+    } catch (const runtime_error&) {
+        thrown = true;
+    }
+    assert((thrown && vt.size() == 8 && vt.capacity() == 8 && vt[7].v == 7));
+    MayThrow::throwAt = -1;
+    vt.emplace_back(8);
+    assert((vt.size() == 9 && vt[8].v == 8 && vt[0].v == 0));
+    cout << "test 8 end" << endl;
+}
+
 int main() {
     test1();
     test2();
@@ -134,4 +246,6 @@ int main() {
     test4();
     test5();
     test6();
+    test7();
+    test8();
 }
\ No newline at end of file